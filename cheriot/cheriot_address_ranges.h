@@ -0,0 +1,59 @@
+// Copyright 2024 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef MPACT_CHERIOT_CHERIOT_ADDRESS_RANGES_H_
+#define MPACT_CHERIOT_CHERIOT_ADDRESS_RANGES_H_
+
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+// This file defines a small set of inclusive address ranges. It is used to
+// describe the memory mapped devices that the paths that access simulated
+// memory directly, or that compare or snapshot it, have to leave alone, since
+// device accesses may have side effects. The number of ranges is expected to
+// be small, so they are kept in a vector and searched linearly.
+
+namespace mpact {
+namespace sim {
+namespace cheriot {
+
+class CheriotAddressRanges {
+ public:
+  CheriotAddressRanges() = default;
+
+  // Adds the range [base, top].
+  void Add(uint64_t base, uint64_t top) { ranges_.emplace_back(base, top); }
+
+  // Returns true if any of the size bytes starting at address is in one of
+  // the ranges.
+  bool Overlaps(uint64_t address, uint64_t size) const {
+    uint64_t last = address + size - 1;
+    for (auto const &[base, top] : ranges_) {
+      if ((address <= top) && (last >= base)) return true;
+    }
+    return false;
+  }
+
+  bool empty() const { return ranges_.empty(); }
+
+ private:
+  std::vector<std::pair<uint64_t, uint64_t>> ranges_;
+};
+
+}  // namespace cheriot
+}  // namespace sim
+}  // namespace mpact
+
+#endif  // MPACT_CHERIOT_CHERIOT_ADDRESS_RANGES_H_
@@ -0,0 +1,198 @@
+// Copyright 2024 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "cheriot/cheriot_branch_predictor.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "absl/log/check.h"
+#include "absl/numeric/bits.h"
+#include "absl/status/status.h"
+#include "absl/strings/numbers.h"
+#include "absl/strings/str_cat.h"
+#include "absl/strings/str_split.h"
+#include "absl/strings/string_view.h"
+#include "mpact/sim/generic/component.h"
+#include "mpact/sim/generic/counters.h"
+
+namespace mpact {
+namespace sim {
+namespace cheriot {
+
+namespace {
+
+constexpr uint64_t kDefaultTableSize = 1024;
+constexpr uint64_t kDefaultRasDepth = 8;
+// Initial counter value: weakly not taken.
+constexpr uint8_t kWeaklyNotTaken = 1;
+
+}  // namespace
+
+CheriotBranchPredictor::CheriotBranchPredictor(std::string name,
+                                               Component *parent)
+    : Component(std::move(name), parent),
+      branches_("branches", 0),
+      branch_mispredicts_("branch_mispredicts", 0),
+      jumps_("jumps", 0),
+      indirect_mispredicts_("indirect_mispredicts", 0),
+      returns_("returns", 0),
+      return_mispredicts_("return_mispredicts", 0),
+      penalty_cycles_("penalty_cycles", 0) {
+  CHECK_OK(AddCounter(&branches_));
+  CHECK_OK(AddCounter(&branch_mispredicts_));
+  CHECK_OK(AddCounter(&jumps_));
+  CHECK_OK(AddCounter(&indirect_mispredicts_));
+  CHECK_OK(AddCounter(&returns_));
+  CHECK_OK(AddCounter(&return_mispredicts_));
+  CHECK_OK(AddCounter(&penalty_cycles_));
+}
+
+CheriotBranchPredictor::CheriotBranchPredictor(std::string name)
+    : CheriotBranchPredictor(std::move(name), nullptr) {}
+
+absl::Status CheriotBranchPredictor::Configure(
+    const std::string &config, SimpleCounter<uint64_t> *cycle_counter) {
+  if (is_configured_) {
+    return absl::FailedPreconditionError(
+        "Branch predictor already configured");
+  }
+  std::vector<absl::string_view> values = absl::StrSplit(config, ',');
+  if (values.empty() || (values.size() > 4)) {
+    return absl::InvalidArgumentError(absl::StrCat(
+        "Branch predictor configuration '", config,
+        "' must have the format <type>[,<table size>[,<ras depth>"
+        "[,<mispredict penalty>]]]"));
+  }
+  Type type;
+  if (values[0] == "static") {
+    type = Type::kStatic;
+  } else if (values[0] == "bimodal") {
+    type = Type::kBimodal;
+  } else if (values[0] == "gshare") {
+    type = Type::kGshare;
+  } else {
+    return absl::InvalidArgumentError(
+        absl::StrCat("Unknown branch predictor type: '", values[0], "'"));
+  }
+  uint64_t table_size = kDefaultTableSize;
+  uint64_t ras_depth = kDefaultRasDepth;
+  uint64_t penalty = 0;
+  if (((values.size() > 1) && !absl::SimpleAtoi(values[1], &table_size)) ||
+      ((values.size() > 2) && !absl::SimpleAtoi(values[2], &ras_depth)) ||
+      ((values.size() > 3) && !absl::SimpleAtoi(values[3], &penalty))) {
+    return absl::InvalidArgumentError(absl::StrCat(
+        "Invalid branch predictor configuration: '", config, "'"));
+  }
+  if (!absl::has_single_bit(table_size)) {
+    return absl::InvalidArgumentError(
+        absl::StrCat("Branch predictor table size must be a power of two: '",
+                     config, "'"));
+  }
+  type_ = type;
+  index_mask_ = table_size - 1;
+  penalty_ = static_cast<int>(penalty);
+  cycle_counter_ = cycle_counter;
+  counters_.assign(table_size, kWeaklyNotTaken);
+  targets_.assign(table_size, 0);
+  ras_.assign(ras_depth, 0);
+  is_configured_ = true;
+  return absl::OkStatus();
+}
+
+void CheriotBranchPredictor::ConditionalBranch(uint64_t pc, uint64_t target,
+                                               bool taken) {
+  if (!is_configured_) return;
+  branches_.Increment(1);
+  bool predicted_taken;
+  if (type_ == Type::kStatic) {
+    predicted_taken = target < pc;
+  } else {
+    uint8_t &counter = counters_[Index(pc)];
+    predicted_taken = counter >= 2;
+    if (taken) {
+      counter += counter < 3;
+    } else {
+      counter -= counter > 0;
+    }
+    history_ = (history_ << 1) | (taken ? 1 : 0);
+  }
+  if (predicted_taken != taken) Mispredict(pc, branch_mispredicts_);
+}
+
+void CheriotBranchPredictor::DirectJump(uint64_t pc, bool is_call,
+                                        uint64_t return_address) {
+  if (!is_configured_) return;
+  jumps_.Increment(1);
+  if (is_call) PushReturnAddress(return_address);
+}
+
+void CheriotBranchPredictor::IndirectJump(uint64_t pc, uint64_t target,
+                                          bool is_call, bool is_return,
+                                          uint64_t return_address) {
+  if (!is_configured_) return;
+  jumps_.Increment(1);
+  if (is_return) {
+    returns_.Increment(1);
+    bool hit = false;
+    if (ras_count_ > 0) {
+      hit = ras_[ras_top_] == target;
+      ras_top_ = (ras_top_ + ras_.size() - 1) % ras_.size();
+      ras_count_--;
+    }
+    if (!hit) Mispredict(pc, return_mispredicts_);
+  } else {
+    uint64_t &last_target = targets_[(pc >> 1) & index_mask_];
+    if (last_target != target) Mispredict(pc, indirect_mispredicts_);
+    last_target = target;
+  }
+  if (is_call) PushReturnAddress(return_address);
+}
+
+void CheriotBranchPredictor::PushReturnAddress(uint64_t return_address) {
+  if (ras_.empty()) return;
+  ras_top_ = (ras_top_ + 1) % ras_.size();
+  ras_[ras_top_] = return_address;
+  ras_count_ = std::min<int>(ras_count_ + 1, ras_.size());
+}
+
+void CheriotBranchPredictor::Mispredict(uint64_t pc,
+                                        SimpleCounter<uint64_t> &counter) {
+  counter.Increment(1);
+  mispredicts_by_pc_[pc]++;
+  if (penalty_ == 0) return;
+  penalty_cycles_.Increment(penalty_);
+  if (cycle_counter_ != nullptr) cycle_counter_->Increment(penalty_);
+}
+
+void CheriotBranchPredictor::WriteProfile(std::ostream &os) const {
+  std::vector<std::pair<uint64_t, uint64_t>> entries(
+      mispredicts_by_pc_.begin(), mispredicts_by_pc_.end());
+  std::sort(entries.begin(), entries.end(), [](auto const &a, auto const &b) {
+    return (a.second > b.second) ||
+           ((a.second == b.second) && (a.first < b.first));
+  });
+  os << "pc,mispredicts\n";
+  for (auto const &[pc, count] : entries) {
+    os << absl::StrCat("0x", absl::Hex(pc), ",", count, "\n");
+  }
+}
+
+}  // namespace cheriot
+}  // namespace sim
+}  // namespace mpact
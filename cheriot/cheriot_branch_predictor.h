@@ -0,0 +1,155 @@
+// Copyright 2024 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef MPACT_CHERIOT_CHERIOT_BRANCH_PREDICTOR_H_
+#define MPACT_CHERIOT_CHERIOT_BRANCH_PREDICTOR_H_
+
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include "absl/container/flat_hash_map.h"
+#include "absl/status/status.h"
+#include "mpact/sim/generic/component.h"
+#include "mpact/sim/generic/counters.h"
+
+// This file defines a model of a branch predictor. It is informed of the
+// outcome of every conditional branch, jump and cjalr by the semantic
+// functions, and counts how many of them it would have mispredicted.
+// Conditional branches are predicted by one of:
+//
+//   static:  backward branches are predicted taken, forward not taken.
+//   bimodal: a table of 2 bit saturating counters indexed by the pc.
+//   gshare:  a table of 2 bit saturating counters indexed by the pc xor'ed
+//            with the global branch history.
+//
+// Direct jumps are always predicted correctly. Returns (cjr cra) are
+// predicted by a return address stack that is pushed by calls that link
+// to cra. Other indirect jumps are predicted by a table of last targets
+// indexed by the pc.
+//
+// The model does not affect the results of the simulation. If a mispredict
+// penalty is configured, it is added to the cycle counter for each
+// mispredict.
+
+namespace mpact {
+namespace sim {
+namespace cheriot {
+
+using ::mpact::sim::generic::Component;
+using ::mpact::sim::generic::SimpleCounter;
+
+class CheriotBranchPredictor : public Component {
+ public:
+  enum class Type {
+    kStatic,
+    kBimodal,
+    kGshare,
+  };
+
+  CheriotBranchPredictor(std::string name, Component *parent);
+  explicit CheriotBranchPredictor(std::string name);
+  CheriotBranchPredictor(const CheriotBranchPredictor &) = delete;
+  CheriotBranchPredictor &operator=(const CheriotBranchPredictor &) = delete;
+  ~CheriotBranchPredictor() override = default;
+
+  // Configures the predictor. The configuration string has the format:
+  //   <type>[,<table size>[,<ras depth>[,<mispredict penalty>]]]
+  // where type is one of static, bimodal or gshare, table size is the number
+  // of entries in the counter and indirect target tables (a power of two,
+  // default 1024), ras depth is the number of return address stack entries
+  // (default 8), and mispredict penalty is the number of cycles added to the
+  // cycle counter for each mispredict (default 0). The cycle counter may be
+  // null.
+  absl::Status Configure(const std::string &config,
+                         SimpleCounter<uint64_t> *cycle_counter);
+
+  // Called for each conditional branch, whether taken or not.
+  void ConditionalBranch(uint64_t pc, uint64_t target, bool taken);
+  // Called for each direct jump. If is_call is true, the return address is
+  // pushed on the return address stack.
+  void DirectJump(uint64_t pc, bool is_call, uint64_t return_address);
+  // Called for each indirect jump. A return pops the return address stack,
+  // a call pushes the return address.
+  void IndirectJump(uint64_t pc, uint64_t target, bool is_call,
+                    bool is_return, uint64_t return_address);
+
+  // Write the mispredicts per pc in csv format, most mispredicted first.
+  void WriteProfile(std::ostream &os) const;
+
+  // Accessors.
+  bool is_configured() const { return is_configured_; }
+  Type type() const { return type_; }
+  int table_size() const { return static_cast<int>(counters_.size()); }
+  int ras_depth() const { return static_cast<int>(ras_.size()); }
+  const absl::flat_hash_map<uint64_t, uint64_t> &mispredicts_by_pc() const {
+    return mispredicts_by_pc_;
+  }
+  SimpleCounter<uint64_t> *counter_branches() { return &branches_; }
+  SimpleCounter<uint64_t> *counter_branch_mispredicts() {
+    return &branch_mispredicts_;
+  }
+  SimpleCounter<uint64_t> *counter_jumps() { return &jumps_; }
+  SimpleCounter<uint64_t> *counter_indirect_mispredicts() {
+    return &indirect_mispredicts_;
+  }
+  SimpleCounter<uint64_t> *counter_returns() { return &returns_; }
+  SimpleCounter<uint64_t> *counter_return_mispredicts() {
+    return &return_mispredicts_;
+  }
+  SimpleCounter<uint64_t> *counter_penalty_cycles() {
+    return &penalty_cycles_;
+  }
+
+ private:
+  int Index(uint64_t pc) const {
+    uint64_t index = pc >> 1;
+    if (type_ == Type::kGshare) index ^= history_;
+    return static_cast<int>(index & index_mask_);
+  }
+  void PushReturnAddress(uint64_t return_address);
+  void Mispredict(uint64_t pc, SimpleCounter<uint64_t> &counter);
+
+  bool is_configured_ = false;
+  Type type_ = Type::kStatic;
+  uint64_t index_mask_ = 0;
+  uint64_t history_ = 0;
+  int penalty_ = 0;
+  SimpleCounter<uint64_t> *cycle_counter_ = nullptr;
+  // 2 bit saturating counters. Values 2 and 3 predict taken.
+  std::vector<uint8_t> counters_;
+  // Last target of indirect jumps.
+  std::vector<uint64_t> targets_;
+  // Return address stack, used as a circular buffer so that deep call
+  // chains overwrite the oldest entries.
+  std::vector<uint64_t> ras_;
+  int ras_top_ = 0;
+  int ras_count_ = 0;
+  absl::flat_hash_map<uint64_t, uint64_t> mispredicts_by_pc_;
+
+  SimpleCounter<uint64_t> branches_;
+  SimpleCounter<uint64_t> branch_mispredicts_;
+  SimpleCounter<uint64_t> jumps_;
+  SimpleCounter<uint64_t> indirect_mispredicts_;
+  SimpleCounter<uint64_t> returns_;
+  SimpleCounter<uint64_t> return_mispredicts_;
+  SimpleCounter<uint64_t> penalty_cycles_;
+};
+
+}  // namespace cheriot
+}  // namespace sim
+}  // namespace mpact
+
+#endif  // MPACT_CHERIOT_CHERIOT_BRANCH_PREDICTOR_H_
@@ -101,6 +101,19 @@ absl::Status CheriotCLIForwarder::Run() { return cheriot_cli_top_->CLIRun(); }
 
 absl::Status CheriotCLIForwarder::Wait() { return cheriot_cli_top_->CLIWait(); }
 
+absl::Status CheriotCLIForwarder::RunAsync(uint64_t max_instructions,
+                                           RunCallback done) {
+  return cheriot_cli_top_->CLIRunAsync(max_instructions, std::move(done));
+}
+
+absl::Status CheriotCLIForwarder::CancelRun() {
+  return cheriot_cli_top_->CLICancelRun();
+}
+
+absl::StatusOr<int> CheriotCLIForwarder::GetRunEventFd() {
+  return cheriot_cli_top_->CLIGetRunEventFd();
+}
+
 // Returns the current run status.
 absl::StatusOr<RunStatus> CheriotCLIForwarder::GetRunStatus() {
   return cheriot_cli_top_->CLIGetRunStatus();
@@ -83,6 +83,10 @@ class CheriotCLIForwarder : public CheriotDebugInterface {
   absl::Status Run() override;
   // Wait until the current core halts execution.
   absl::Status Wait() override;
+  // Asynchronous run control.
+  absl::Status RunAsync(uint64_t max_instructions, RunCallback done) override;
+  absl::Status CancelRun() override;
+  absl::StatusOr<int> GetRunEventFd() override;
 
   // Returns the current run status.
   absl::StatusOr<RunStatus> GetRunStatus() override;
@@ -0,0 +1,161 @@
+// Copyright 2024 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "cheriot/cheriot_coverage.h"
+
+#include <cstdint>
+#include <istream>
+#include <ostream>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "absl/log/log.h"
+#include "absl/numeric/bits.h"
+#include "absl/status/status.h"
+#include "absl/strings/numbers.h"
+#include "absl/strings/str_cat.h"
+#include "absl/strings/str_split.h"
+#include "absl/strings/string_view.h"
+
+namespace mpact {
+namespace sim {
+namespace cheriot {
+
+CheriotCoverage::CheriotCoverage(std::vector<std::string> opcode_names)
+    : opcode_names_(std::move(opcode_names)),
+      executed_(opcode_names_.size(), 0),
+      exceptions_(opcode_names_.size(), 0),
+      cheri_exceptions_(opcode_names_.size(), 0),
+      csrs_(kNumCsrs, 0) {
+  for (int i = 0; i < opcode_names_.size(); i++) {
+    opcode_index_.emplace(opcode_names_[i], i);
+  }
+}
+
+void CheriotCoverage::WriteReport(std::ostream &os) const {
+  int num_executed = 0;
+  uint32_t all_exceptions = 0;
+  uint32_t all_cheri_exceptions = 0;
+  for (int i = 0; i < executed_.size(); i++) {
+    num_executed += executed_[i];
+    all_exceptions |= exceptions_[i];
+    all_cheri_exceptions |= cheri_exceptions_[i];
+  }
+  int num_csrs = 0;
+  for (auto csr : csrs_) num_csrs += csr != 0;
+  os << "# CHERIoT ISA coverage\n";
+  os << absl::StrCat("# opcodes executed: ", num_executed, "/",
+                     executed_.size(), "\n");
+  os << absl::StrCat("# exception causes: ", absl::popcount(all_exceptions),
+                     "\n");
+  os << absl::StrCat("# cheri exception codes: ",
+                     absl::popcount(all_cheri_exceptions), "\n");
+  os << absl::StrCat("# csrs accessed: ", num_csrs, "\n");
+  // Opcodes: name, executed, exception causes, CHERI exception codes.
+  for (int i = 0; i < executed_.size(); i++) {
+    os << absl::StrCat("opcode ", opcode_names_[i], " ",
+                       static_cast<int>(executed_[i]), " 0x",
+                       absl::Hex(exceptions_[i]), " 0x",
+                       absl::Hex(cheri_exceptions_[i]), "\n");
+  }
+  os << absl::StrCat("interrupts 0x", absl::Hex(interrupts_), "\n");
+  // CSRs: index, accesses (bit 0 read, bit 1 write).
+  for (int i = 0; i < kNumCsrs; i++) {
+    if (csrs_[i] == 0) continue;
+    os << absl::StrCat("csr 0x", absl::Hex(i), " ",
+                       static_cast<int>(csrs_[i]), "\n");
+  }
+  // Capabilities: (code,) permission format, object type mask.
+  for (int code = 0; code < kNumCheriCodes; code++) {
+    for (int format = 0; format < kNumPermissionFormats; format++) {
+      if (cap_faults_[code][format] == 0) continue;
+      os << absl::StrCat("cap_fault 0x", absl::Hex(code), " ", format, " 0x",
+                         absl::Hex(cap_faults_[code][format]), "\n");
+    }
+  }
+  for (int format = 0; format < kNumPermissionFormats; format++) {
+    if (cap_jumps_[format] == 0) continue;
+    os << absl::StrCat("cap_jump ", format, " 0x",
+                       absl::Hex(cap_jumps_[format]), "\n");
+  }
+}
+
+absl::Status CheriotCoverage::Merge(std::istream &is) {
+  std::string line;
+  int line_number = 0;
+  while (std::getline(is, line)) {
+    line_number++;
+    std::vector<absl::string_view> fields =
+        absl::StrSplit(line, ' ', absl::SkipWhitespace());
+    if (fields.empty() || fields[0][0] == '#') continue;
+    auto error = [&]() {
+      return absl::InvalidArgumentError(absl::StrCat(
+          "Invalid coverage report line ", line_number, ": '", line, "'"));
+    };
+    uint32_t values[3];
+    if (fields[0] == "opcode") {
+      if ((fields.size() != 5) || !absl::SimpleAtoi(fields[2], &values[0]) ||
+          !absl::SimpleHexAtoi(fields[3], &values[1]) ||
+          !absl::SimpleHexAtoi(fields[4], &values[2])) {
+        return error();
+      }
+      auto iter = opcode_index_.find(fields[1]);
+      if (iter == opcode_index_.end()) {
+        LOG(WARNING) << "Coverage report opcode '" << fields[1]
+                     << "' is not known - ignored";
+        continue;
+      }
+      int opcode = iter->second;
+      executed_[opcode] |= values[0] != 0;
+      exceptions_[opcode] |= values[1];
+      cheri_exceptions_[opcode] |= values[2];
+    } else if (fields[0] == "interrupts") {
+      if ((fields.size() != 2) || !absl::SimpleHexAtoi(fields[1], &values[0])) {
+        return error();
+      }
+      interrupts_ |= values[0];
+    } else if (fields[0] == "csr") {
+      if ((fields.size() != 3) || !absl::SimpleHexAtoi(fields[1], &values[0]) ||
+          !absl::SimpleAtoi(fields[2], &values[1]) ||
+          (values[0] >= kNumCsrs)) {
+        return error();
+      }
+      csrs_[values[0]] |= values[1] & (kCsrRead | kCsrWrite);
+    } else if (fields[0] == "cap_fault") {
+      if ((fields.size() != 4) || !absl::SimpleHexAtoi(fields[1], &values[0]) ||
+          !absl::SimpleAtoi(fields[2], &values[1]) ||
+          !absl::SimpleHexAtoi(fields[3], &values[2]) ||
+          (values[0] >= kNumCheriCodes) ||
+          (values[1] >= kNumPermissionFormats)) {
+        return error();
+      }
+      cap_faults_[values[0]][values[1]] |= values[2];
+    } else if (fields[0] == "cap_jump") {
+      if ((fields.size() != 3) || !absl::SimpleAtoi(fields[1], &values[0]) ||
+          !absl::SimpleHexAtoi(fields[2], &values[1]) ||
+          (values[0] >= kNumPermissionFormats)) {
+        return error();
+      }
+      cap_jumps_[values[0]] |= values[1];
+    } else {
+      return error();
+    }
+  }
+  return absl::OkStatus();
+}
+
+}  // namespace cheriot
+}  // namespace sim
+}  // namespace mpact
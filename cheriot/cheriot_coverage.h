@@ -0,0 +1,134 @@
+// Copyright 2024 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef MPACT_CHERIOT_CHERIOT_COVERAGE_H_
+#define MPACT_CHERIOT_CHERIOT_COVERAGE_H_
+
+#include <cstdint>
+#include <istream>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include "absl/container/flat_hash_map.h"
+#include "absl/status/status.h"
+
+// This file defines a collector of ISA functional coverage. It records which
+// opcodes were executed, which exception causes and CHERI exception codes
+// each opcode raised, which CSRs were read and written, and which
+// combinations of permission format and object type were seen in capability
+// jump targets and in capabilities that caused CHERI exceptions.
+//
+// All the coverage is kept in fixed size bitmaps, so recording an event is a
+// single or into memory. This keeps the cost low enough to leave coverage
+// enabled in every run. The report is a text file that lists every point,
+// and a report from an earlier run can be merged in before the new one is
+// written, so that coverage accumulates across runs (e.g., of a test suite).
+
+namespace mpact {
+namespace sim {
+namespace cheriot {
+
+class CheriotCoverage {
+ public:
+  static constexpr int kNumCsrs = 4096;
+  // Bits in the CSR bitmap.
+  static constexpr uint8_t kCsrRead = 0b01;
+  static constexpr uint8_t kCsrWrite = 0b10;
+  // Number of CHERI exception codes, and permission formats and object types
+  // of capabilities.
+  static constexpr int kNumCheriCodes = 32;
+  static constexpr int kNumPermissionFormats = 8;
+  static constexpr int kNumObjectTypes = 16;
+
+  // The opcode names are those of the decoder, indexed by opcode value.
+  explicit CheriotCoverage(std::vector<std::string> opcode_names);
+  CheriotCoverage(const CheriotCoverage &) = delete;
+  CheriotCoverage &operator=(const CheriotCoverage &) = delete;
+
+  // Called for each executed instruction.
+  void Executed(int opcode) { executed_[opcode] = 1; }
+  // Called for each trap. Interrupts are recorded by cause only, exceptions
+  // by cause and the opcode of the instruction that raised them.
+  void Trap(bool is_interrupt, int opcode, uint64_t cause) {
+    if (cause >= 32) return;
+    if (is_interrupt) {
+      interrupts_ |= 1U << cause;
+    } else {
+      exceptions_[opcode] |= 1U << cause;
+    }
+  }
+  // Called for each CHERI exception, with the permission format and object
+  // type of the capability that caused it.
+  void CheriException(int opcode, uint32_t code, uint32_t permissions_format,
+                      uint32_t object_type) {
+    code &= kNumCheriCodes - 1;
+    cheri_exceptions_[opcode] |= 1U << code;
+    cap_faults_[code][permissions_format & (kNumPermissionFormats - 1)] |=
+        1U << (object_type & (kNumObjectTypes - 1));
+  }
+  // Called for the target capability of each capability jump.
+  void CapabilityJump(uint32_t permissions_format, uint32_t object_type) {
+    cap_jumps_[permissions_format & (kNumPermissionFormats - 1)] |=
+        1U << (object_type & (kNumObjectTypes - 1));
+  }
+  // Called for each permitted CSR access.
+  void CsrAccess(uint32_t csr, bool is_write) {
+    csrs_[csr & (kNumCsrs - 1)] |= is_write ? kCsrWrite : kCsrRead;
+  }
+
+  // Write the coverage report.
+  void WriteReport(std::ostream &os) const;
+  // Merge a coverage report written by WriteReport into the coverage. Opcodes
+  // that are not known to this decoder are ignored.
+  absl::Status Merge(std::istream &is);
+
+  // Accessors.
+  int num_opcodes() const { return static_cast<int>(executed_.size()); }
+  bool executed(int opcode) const { return executed_[opcode] != 0; }
+  uint32_t exceptions(int opcode) const { return exceptions_[opcode]; }
+  uint32_t cheri_exceptions(int opcode) const {
+    return cheri_exceptions_[opcode];
+  }
+  uint32_t interrupts() const { return interrupts_; }
+  uint8_t csr(uint32_t csr) const { return csrs_[csr & (kNumCsrs - 1)]; }
+  uint16_t cap_faults(uint32_t code, uint32_t permissions_format) const {
+    return cap_faults_[code & (kNumCheriCodes - 1)]
+                      [permissions_format & (kNumPermissionFormats - 1)];
+  }
+  uint16_t cap_jumps(uint32_t permissions_format) const {
+    return cap_jumps_[permissions_format & (kNumPermissionFormats - 1)];
+  }
+
+ private:
+  std::vector<std::string> opcode_names_;
+  absl::flat_hash_map<std::string, int> opcode_index_;
+  // Per opcode coverage. The exception masks are indexed by exception cause
+  // and CHERI exception code respectively.
+  std::vector<uint8_t> executed_;
+  std::vector<uint32_t> exceptions_;
+  std::vector<uint32_t> cheri_exceptions_;
+  uint32_t interrupts_ = 0;
+  std::vector<uint8_t> csrs_;
+  // Object type masks indexed by CHERI exception code (for faults) and by
+  // permission format.
+  uint16_t cap_faults_[kNumCheriCodes][kNumPermissionFormats] = {};
+  uint16_t cap_jumps_[kNumPermissionFormats] = {};
+};
+
+}  // namespace cheriot
+}  // namespace sim
+}  // namespace mpact
+
+#endif  // MPACT_CHERIOT_CHERIOT_COVERAGE_H_
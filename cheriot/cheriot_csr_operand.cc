@@ -0,0 +1,74 @@
+// Copyright 2024 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "cheriot/cheriot_csr_operand.h"
+
+#include <cstdint>
+
+#include "absl/strings/str_cat.h"
+#include "cheriot/cheriot_pmp_checker.h"
+#include "cheriot/riscv_cheriot_csr_enum.h"
+#include "mpact/sim/generic/type_helpers.h"
+#include "riscv//riscv_csr.h"
+#include "riscv//riscv_state.h"
+
+namespace mpact {
+namespace sim {
+namespace cheriot {
+
+using ::mpact::sim::generic::operator*;  // NOLINT: is used below (clang error).
+using ::mpact::sim::riscv::PrivilegeMode;
+
+CsrAccess GetCsrAccess(int csr_index, bool is_write) {
+  auto required_mode = (csr_index >> 8) & 0x3;
+  auto current_mode = PrivilegeMode::kMachine;
+  // If the register isn't available in CHERIoT, it's illegal.
+  if (required_mode == *PrivilegeMode::kSupervisor) return CsrAccess::kIllegal;
+  // So is an access from a lower privilege mode.
+  if (*current_mode < required_mode) return CsrAccess::kIllegal;
+  // Accesses to fflags, frm, and fcsr are all ok.
+  if ((csr_index >= *RiscVCheriotCsrEnum::kFFlags) &&
+      (csr_index <= *RiscVCheriotCsrEnum::kFCsr)) {
+    return CsrAccess::kAllowed;
+  }
+  // Reads to MCycle, MInstret, MHpmcounterN are all ok.
+  if (!is_write && (((csr_index >= *RiscVCheriotCsrEnum::kMCycle) &&
+                     (csr_index <= *RiscVCheriotCsrEnum::kMHpmcounter31)) ||
+                    ((csr_index >= *RiscVCheriotCsrEnum::kMCycleH) &&
+                     (csr_index <= *RiscVCheriotCsrEnum::kMHpmcounter31H)))) {
+    return CsrAccess::kAllowed;
+  }
+  // Other non-user CSRs require the pcc capability to have permission.
+  if (required_mode != *PrivilegeMode::kUser) {
+    return CsrAccess::kNeedsSystemRegisterPermission;
+  }
+  return CsrAccess::kAllowed;
+}
+
+CheriotCsrOperand::CheriotCsrOperand(uint32_t csr_index,
+                                     RiscVCsrInterface *csr, bool resolved)
+    : ImmediateOperand<uint32_t>(csr_index, csr == nullptr
+                                                ? absl::StrCat(csr_index)
+                                                : csr->name()),
+      csr_(csr),
+      is_resolved_(resolved),
+      is_pmp_csr_(CheriotPmpChecker::IsPmpCsr(csr_index)) {
+  for (int is_write = 0; is_write < 2; is_write++) {
+    access_[is_write] = GetCsrAccess(csr_index, is_write != 0);
+  }
+}
+
+}  // namespace cheriot
+}  // namespace sim
+}  // namespace mpact
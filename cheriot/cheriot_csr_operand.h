@@ -0,0 +1,78 @@
+// Copyright 2024 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef MPACT_CHERIOT_CHERIOT_CSR_OPERAND_H_
+#define MPACT_CHERIOT_CHERIOT_CSR_OPERAND_H_
+
+#include <cstdint>
+
+#include "mpact/sim/generic/immediate_operand.h"
+#include "riscv//riscv_csr.h"
+#include "riscv//riscv_state.h"
+
+// This file defines the source operand used for the CSR field of the Zicsr
+// instructions. In addition to the CSR index (the value of the operand), it
+// holds a pointer to the CSR object and the access permissions for reads and
+// writes, so that the semantic functions don't have to look up the CSR and
+// decode the index every time the instruction is executed.
+
+namespace mpact {
+namespace sim {
+namespace cheriot {
+
+using ::mpact::sim::generic::ImmediateOperand;
+using ::mpact::sim::riscv::RiscVCsrInterface;
+
+// Result of checking the access to a CSR.
+enum class CsrAccess : uint8_t {
+  // The access is allowed.
+  kAllowed = 0,
+  // The access raises an illegal instruction exception.
+  kIllegal,
+  // The access is allowed if pcc has the PermitAccessSystemRegisters
+  // permission, otherwise it raises a CHERI exception.
+  kNeedsSystemRegisterPermission,
+};
+
+// Returns the access for the given CSR index. As the simulated core always
+// executes in machine mode, the access is checked for machine mode.
+CsrAccess GetCsrAccess(int csr_index, bool is_write);
+
+class CheriotCsrOperand final : public ImmediateOperand<uint32_t> {
+ public:
+  // The csr is null if the index doesn't name a CSR. If resolved is false,
+  // the semantic functions ignore the csr and access permissions held by the
+  // operand, and look them up each time the instruction is executed instead.
+  CheriotCsrOperand(uint32_t csr_index, RiscVCsrInterface *csr,
+                    bool resolved = true);
+
+  RiscVCsrInterface *csr() const { return csr_; }
+  bool is_resolved() const { return is_resolved_; }
+  CsrAccess access(bool is_write) const { return access_[is_write ? 1 : 0]; }
+  // True if writes to the CSR invalidate cached PMP decisions.
+  bool is_pmp_csr() const { return is_pmp_csr_; }
+
+ private:
+  RiscVCsrInterface *csr_;
+  bool is_resolved_;
+  bool is_pmp_csr_;
+  // Indexed by is_write.
+  CsrAccess access_[2];
+};
+
+}  // namespace cheriot
+}  // namespace sim
+}  // namespace mpact
+
+#endif  // MPACT_CHERIOT_CHERIOT_CSR_OPERAND_H_
@@ -58,6 +58,37 @@ class CheriotDebugInterface : public generic::CoreDebugInterface {
   // Enable/disable breaking on control flow change.
   virtual void SetBreakOnControlFlowChange(bool enabled) = 0;
   virtual bool BreakOnControlFlowChange() = 0;
+
+  // Halt reason reported when a run ends because it reached its instruction
+  // limit.
+  static constexpr HaltReasonValueType kInstructionLimit =
+      static_cast<HaltReasonValueType>(HaltReason::kUserSpecifiedMin) + 5;
+
+  // Outcome of a run started by RunAsync.
+  struct RunResult {
+    HaltReasonValueType halt_reason;
+    // Instructions and cycles simulated during the run.
+    uint64_t num_instructions;
+    uint64_t num_cycles;
+  };
+  using RunCallback = absl::AnyInvocable<void(const RunResult &)>;
+
+  // Allow the core to free-run in a separate thread until it halts, or until
+  // max_instructions have been executed (0 for no limit). When the run ends,
+  // the run event fd is signaled, and then done (if non-null) is called from
+  // the simulation thread. The callback may start a new run. Wait() may be
+  // used as with Run(). It also waits for done to return, and for any run
+  // that done starts, so it must not be called from done.
+  virtual absl::Status RunAsync(uint64_t max_instructions,
+                                RunCallback done) = 0;
+  // Request that the current run stop as soon as possible without waiting for
+  // it to do so. The run reports kUserRequest as its halt reason, unless it
+  // was already halting for another reason. Does nothing if not running.
+  virtual absl::Status CancelRun() = 0;
+  // Returns an eventfd that is incremented each time a run completes, so that
+  // completions can be handled from an event loop instead of a blocked
+  // thread. Returns an error if the eventfd cannot be created.
+  virtual absl::StatusOr<int> GetRunEventFd() = 0;
 };
 
 }  // namespace mpact::sim::cheriot
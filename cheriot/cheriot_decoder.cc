@@ -21,6 +21,7 @@
 #include "cheriot/riscv_cheriot_decoder.h"
 #include "cheriot/riscv_cheriot_encoding.h"
 #include "cheriot/riscv_cheriot_enums.h"
+#include "cheriot/riscv_cheriot_instructions.h"
 #include "mpact/sim/generic/instruction.h"
 #include "mpact/sim/generic/type_helpers.h"
 #include "mpact/sim/util/memory/memory_interface.h"
@@ -95,6 +96,7 @@ generic::Instruction *CheriotDecoder::DecodeInstruction(uint64_t address) {
   // Call the isa decoder to obtain a new instruction object for the instruction
   // word that was parsed above.
   auto *instruction = cheriot_isa_->Decode(address, cheriot_encoding_);
+  SelectCoreVersionSemanticFunction<isa32::OpcodeEnum>(state_, instruction);
   return instruction;
 }
 
@@ -72,6 +72,13 @@ class CheriotDecoder : public generic::DecoderInterface {
     return isa32::kOpcodeNames[index];
   }
 
+  // Disables the decode fast paths, i.e., the decode tables and the decode
+  // time resolution of CSR operands, e.g., for a lockstep reference.
+  void DisableFastPaths() {
+    cheriot_encoding_->set_use_decode_tables(false);
+    cheriot_encoding_->set_resolve_csr_operands(false);
+  }
+
   // Getter.
   isa32::RiscVCheriotEncoding *cheriot_encoding() const {
     return cheriot_encoding_;
@@ -0,0 +1,264 @@
+// Copyright 2024 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "cheriot/cheriot_elf_loader.h"
+
+#include <elf.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "absl/status/status.h"
+#include "absl/status/statusor.h"
+#include "absl/strings/str_cat.h"
+#include "absl/strings/string_view.h"
+#include "mpact/sim/generic/core_debug_interface.h"
+#include "mpact/sim/generic/data_buffer.h"
+#include "mpact/sim/util/memory/memory_interface.h"
+
+namespace mpact {
+namespace sim {
+namespace cheriot {
+
+using ::mpact::sim::generic::DataBuffer;
+
+namespace {
+
+bool IsZero(const uint8_t *data, size_t size) {
+  return std::all_of(data, data + size, [](uint8_t byte) { return byte == 0; });
+}
+
+}  // namespace
+
+CheriotElfLoader::~CheriotElfLoader() { Close(); }
+
+void CheriotElfLoader::Close() {
+  if (data_ != nullptr) {
+    munmap(const_cast<uint8_t *>(data_), size_);
+  }
+  data_ = nullptr;
+  size_ = 0;
+  symbols_loaded_ = false;
+  symbols_.clear();
+}
+
+absl::Status CheriotElfLoader::Open(const std::string &file_name) {
+  Close();
+  int fd = open(file_name.c_str(), O_RDONLY);
+  if (fd < 0) {
+    return absl::NotFoundError(
+        absl::StrCat("Unable to open '", file_name, "': ", strerror(errno)));
+  }
+  struct stat file_stat;
+  if (fstat(fd, &file_stat) != 0) {
+    close(fd);
+    return absl::InternalError(
+        absl::StrCat("Unable to stat '", file_name, "': ", strerror(errno)));
+  }
+  size_t size = file_stat.st_size;
+  if (size < sizeof(Elf32_Ehdr)) {
+    close(fd);
+    return absl::InvalidArgumentError(
+        absl::StrCat("'", file_name, "' is not an ELF file"));
+  }
+  void *data = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+  // The mapping stays valid after the file is closed.
+  close(fd);
+  if (data == MAP_FAILED) {
+    return absl::InternalError(
+        absl::StrCat("Unable to map '", file_name, "': ", strerror(errno)));
+  }
+  data_ = static_cast<const uint8_t *>(data);
+  size_ = size;
+  auto *header = reinterpret_cast<const Elf32_Ehdr *>(data_);
+  if ((std::memcmp(header->e_ident, ELFMAG, SELFMAG) != 0) ||
+      (header->e_ident[EI_CLASS] != ELFCLASS32) ||
+      (header->e_ident[EI_DATA] != ELFDATA2LSB)) {
+    Close();
+    return absl::InvalidArgumentError(absl::StrCat(
+        "'", file_name, "' is not a 32 bit little endian ELF file"));
+  }
+  if ((header->e_phentsize != sizeof(Elf32_Phdr)) ||
+      (header->e_phoff + header->e_phnum * sizeof(Elf32_Phdr) > size_)) {
+    Close();
+    return absl::InvalidArgumentError(
+        absl::StrCat("'", file_name, "' has an invalid program header table"));
+  }
+  entry_point_ = header->e_entry;
+  return absl::OkStatus();
+}
+
+absl::StatusOr<uint64_t> CheriotElfLoader::WriteSegments(
+    WriteFunction write, bool memory_is_zero) {
+  if (data_ == nullptr) return absl::FailedPreconditionError("No ELF file");
+  auto *header = reinterpret_cast<const Elf32_Ehdr *>(data_);
+  auto *phdrs = reinterpret_cast<const Elf32_Phdr *>(data_ + header->e_phoff);
+  for (int i = 0; i < header->e_phnum; i++) {
+    const Elf32_Phdr &phdr = phdrs[i];
+    if ((phdr.p_type != PT_LOAD) || (phdr.p_memsz == 0)) continue;
+    if ((phdr.p_offset + static_cast<uint64_t>(phdr.p_filesz) > size_) ||
+        (phdr.p_filesz > phdr.p_memsz)) {
+      return absl::InvalidArgumentError(
+          absl::StrCat("Invalid segment ", i, " in ELF file"));
+    }
+    uint64_t address = phdr.p_vaddr;
+    const uint8_t *src = data_ + phdr.p_offset;
+    for (size_t offset = 0; offset < phdr.p_filesz; offset += kChunkSize) {
+      size_t size = std::min<size_t>(kChunkSize, phdr.p_filesz - offset);
+      if (memory_is_zero && IsZero(src + offset, size)) continue;
+      auto status = write(address + offset, src + offset, size);
+      if (!status.ok()) return status;
+    }
+    // Zero fill the remainder of the segment (bss).
+    if (memory_is_zero) continue;
+    for (size_t offset = phdr.p_filesz; offset < phdr.p_memsz;
+         offset += kChunkSize) {
+      size_t size = std::min<size_t>(kChunkSize, phdr.p_memsz - offset);
+      auto status = write(address + offset, nullptr, size);
+      if (!status.ok()) return status;
+    }
+  }
+  return entry_point_;
+}
+
+absl::StatusOr<uint64_t> CheriotElfLoader::LoadSegments(
+    MemoryInterface *memory, bool memory_is_zero) {
+  DataBuffer *chunk_db = db_factory_.Allocate<uint8_t>(kChunkSize);
+  chunk_db->set_latency(0);
+  auto result = WriteSegments(
+      [&](uint64_t address, const uint8_t *data, size_t size) {
+        DataBuffer *db = chunk_db;
+        if (size != kChunkSize) {
+          db = db_factory_.Allocate<uint8_t>(size);
+          db->set_latency(0);
+        }
+        if (data != nullptr) {
+          std::memcpy(db->raw_ptr(), data, size);
+        } else {
+          std::memset(db->raw_ptr(), 0, size);
+        }
+        memory->Store(address, db);
+        if (db != chunk_db) db->DecRef();
+        return absl::OkStatus();
+      },
+      memory_is_zero);
+  chunk_db->DecRef();
+  return result;
+}
+
+absl::StatusOr<uint64_t> CheriotElfLoader::LoadSegments(
+    CoreDebugInterface *dbg_if, bool memory_is_zero) {
+  std::vector<uint8_t> zeros;
+  return WriteSegments(
+      [&](uint64_t address, const uint8_t *data, size_t size) -> absl::Status {
+        if (data == nullptr) {
+          zeros.resize(kChunkSize, 0);
+          data = zeros.data();
+        }
+        auto res = dbg_if->WriteMemory(address, data, size);
+        if (!res.ok()) return res.status();
+        return absl::OkStatus();
+      },
+      memory_is_zero);
+}
+
+absl::StatusOr<uint64_t> CheriotElfLoader::LoadProgram(
+    const std::string &file_name, MemoryInterface *memory,
+    bool memory_is_zero) {
+  auto status = Open(file_name);
+  if (!status.ok()) return status;
+  return LoadSegments(memory, memory_is_zero);
+}
+
+absl::StatusOr<uint64_t> CheriotElfLoader::LoadProgram(
+    const std::string &file_name, CoreDebugInterface *dbg_if,
+    bool memory_is_zero) {
+  auto status = Open(file_name);
+  if (!status.ok()) return status;
+  return LoadSegments(dbg_if, memory_is_zero);
+}
+
+absl::Status CheriotElfLoader::LoadSymbols() {
+  symbols_loaded_ = true;
+  auto *header = reinterpret_cast<const Elf32_Ehdr *>(data_);
+  if ((header->e_shoff == 0) || (header->e_shentsize != sizeof(Elf32_Shdr)) ||
+      (header->e_shoff + header->e_shnum * sizeof(Elf32_Shdr) > size_)) {
+    return absl::NotFoundError("No section header table");
+  }
+  auto *shdrs = reinterpret_cast<const Elf32_Shdr *>(data_ + header->e_shoff);
+  for (int i = 0; i < header->e_shnum; i++) {
+    const Elf32_Shdr &symtab = shdrs[i];
+    if (symtab.sh_type != SHT_SYMTAB) continue;
+    if ((symtab.sh_link >= header->e_shnum) ||
+        (symtab.sh_offset + static_cast<uint64_t>(symtab.sh_size) > size_)) {
+      return absl::InvalidArgumentError("Invalid symbol table");
+    }
+    const Elf32_Shdr &strtab = shdrs[symtab.sh_link];
+    if (strtab.sh_offset + static_cast<uint64_t>(strtab.sh_size) > size_) {
+      return absl::InvalidArgumentError("Invalid string table");
+    }
+    auto *strings = reinterpret_cast<const char *>(data_ + strtab.sh_offset);
+    auto *syms = reinterpret_cast<const Elf32_Sym *>(data_ + symtab.sh_offset);
+    int num_syms = symtab.sh_size / sizeof(Elf32_Sym);
+    for (int j = 0; j < num_syms; j++) {
+      const Elf32_Sym &sym = syms[j];
+      if ((sym.st_name == 0) || (sym.st_name >= strtab.sh_size)) continue;
+      absl::string_view name(
+          strings + sym.st_name,
+          strnlen(strings + sym.st_name, strtab.sh_size - sym.st_name));
+      // Keep the first definition of a name.
+      symbols_.try_emplace(name, sym.st_value, sym.st_size);
+    }
+  }
+  return absl::OkStatus();
+}
+
+absl::StatusOr<std::pair<uint64_t, uint64_t>> CheriotElfLoader::GetSymbol(
+    absl::string_view name) {
+  if (data_ == nullptr) return absl::FailedPreconditionError("No ELF file");
+  if (!symbols_loaded_) {
+    auto status = LoadSymbols();
+    if (!status.ok()) return status;
+  }
+  auto iter = symbols_.find(name);
+  if (iter == symbols_.end()) {
+    return absl::NotFoundError(absl::StrCat("Symbol '", name, "' not found"));
+  }
+  return iter->second;
+}
+
+absl::StatusOr<uint64_t> CheriotElfLoader::GetStackSize() const {
+  if (data_ == nullptr) return absl::FailedPreconditionError("No ELF file");
+  auto *header = reinterpret_cast<const Elf32_Ehdr *>(data_);
+  auto *phdrs = reinterpret_cast<const Elf32_Phdr *>(data_ + header->e_phoff);
+  for (int i = 0; i < header->e_phnum; i++) {
+    if ((phdrs[i].p_type == PT_GNU_STACK) && (phdrs[i].p_memsz != 0)) {
+      return phdrs[i].p_memsz;
+    }
+  }
+  return absl::NotFoundError("No GNU_STACK segment with non-zero size");
+}
+
+}  // namespace cheriot
+}  // namespace sim
+}  // namespace mpact
@@ -0,0 +1,110 @@
+// Copyright 2024 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef MPACT_CHERIOT_CHERIOT_ELF_LOADER_H_
+#define MPACT_CHERIOT_CHERIOT_ELF_LOADER_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <utility>
+
+#include "absl/container/flat_hash_map.h"
+#include "absl/functional/function_ref.h"
+#include "absl/status/status.h"
+#include "absl/status/statusor.h"
+#include "absl/strings/string_view.h"
+#include "mpact/sim/generic/core_debug_interface.h"
+#include "mpact/sim/generic/data_buffer.h"
+#include "mpact/sim/util/memory/memory_interface.h"
+
+// This file defines a loader for 32 bit little endian ELF executables that is
+// used to quickly load the program segments into simulated memory. The file
+// is mapped into the host address space, and each PT_LOAD segment is copied
+// into memory using a small number of large stores. Symbols are only parsed
+// the first time a symbol is looked up.
+
+namespace mpact {
+namespace sim {
+namespace cheriot {
+
+using ::mpact::sim::generic::CoreDebugInterface;
+using ::mpact::sim::generic::DataBufferFactory;
+using ::mpact::sim::util::MemoryInterface;
+
+class CheriotElfLoader {
+ public:
+  // Size of the stores used to copy segment data into memory.
+  static constexpr int kChunkSize = 64 * 1024;
+
+  CheriotElfLoader() = default;
+  CheriotElfLoader(const CheriotElfLoader &) = delete;
+  CheriotElfLoader &operator=(const CheriotElfLoader &) = delete;
+  ~CheriotElfLoader();
+
+  // Maps the ELF file and checks the ELF header.
+  absl::Status Open(const std::string &file_name);
+  // Copies the PT_LOAD segments into memory and returns the entry point. If
+  // memory_is_zero is true, the memory is assumed to be zero initialized, so
+  // chunks of zeros (including bss) are not stored. This leaves the pages of
+  // demand allocated memories untouched.
+  absl::StatusOr<uint64_t> LoadSegments(MemoryInterface *memory,
+                                        bool memory_is_zero);
+  // Same as above, but writes the segments using the debug interface. The
+  // data is written directly from the mapped file.
+  absl::StatusOr<uint64_t> LoadSegments(CoreDebugInterface *dbg_if,
+                                        bool memory_is_zero);
+  // Convenience methods that call Open and LoadSegments.
+  absl::StatusOr<uint64_t> LoadProgram(const std::string &file_name,
+                                       MemoryInterface *memory,
+                                       bool memory_is_zero);
+  absl::StatusOr<uint64_t> LoadProgram(const std::string &file_name,
+                                       CoreDebugInterface *dbg_if,
+                                       bool memory_is_zero);
+
+  // Returns the value and size of the named symbol.
+  absl::StatusOr<std::pair<uint64_t, uint64_t>> GetSymbol(
+      absl::string_view name);
+  // Returns the size of the PT_GNU_STACK segment if it is non-zero.
+  absl::StatusOr<uint64_t> GetStackSize() const;
+
+  uint64_t entry_point() const { return entry_point_; }
+
+ private:
+  // Function used to write size bytes of data (or zeros if data is nullptr)
+  // to memory at address. At most kChunkSize bytes are written per call.
+  using WriteFunction = absl::FunctionRef<absl::Status(
+      uint64_t address, const uint8_t *data, size_t size)>;
+
+  // Unmaps the file.
+  void Close();
+  // Writes the PT_LOAD segments using the write function.
+  absl::StatusOr<uint64_t> WriteSegments(WriteFunction write,
+                                         bool memory_is_zero);
+  // Parses the symbol table.
+  absl::Status LoadSymbols();
+
+  const uint8_t *data_ = nullptr;
+  size_t size_ = 0;
+  uint64_t entry_point_ = 0;
+  bool symbols_loaded_ = false;
+  absl::flat_hash_map<std::string, std::pair<uint64_t, uint64_t>> symbols_;
+  DataBufferFactory db_factory_;
+};
+
+}  // namespace cheriot
+}  // namespace sim
+}  // namespace mpact
+
+#endif  // MPACT_CHERIOT_CHERIOT_ELF_LOADER_H_
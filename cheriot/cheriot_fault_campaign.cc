@@ -0,0 +1,744 @@
+// Copyright 2024 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "cheriot/cheriot_fault_campaign.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "absl/container/flat_hash_set.h"
+#include "absl/status/status.h"
+#include "absl/status/statusor.h"
+#include "absl/strings/str_cat.h"
+#include "absl/strings/str_split.h"
+#include "absl/strings/string_view.h"
+#include "cheriot/cheriot_register.h"
+#include "cheriot/cheriot_state.h"
+#include "cheriot/cheriot_top.h"
+#include "mpact/sim/generic/core_debug_interface.h"
+#include "mpact/sim/generic/data_buffer.h"
+#include "mpact/sim/generic/instruction.h"
+#include "mpact/sim/generic/ref_count.h"
+#include "mpact/sim/generic/register.h"
+#include "mpact/sim/generic/type_helpers.h"
+#include "mpact/sim/util/memory/memory_interface.h"
+#include "mpact/sim/util/memory/tagged_memory_interface.h"
+#include "riscv//stoull_wrapper.h"
+
+namespace mpact {
+namespace sim {
+namespace cheriot {
+
+using ::mpact::sim::generic::operator*;  // NOLINT: is used below (clang error).
+using ::mpact::sim::generic::Instruction;
+using ::mpact::sim::generic::ReferenceCount;
+using ::mpact::sim::util::AtomicMemoryOpInterface;
+using ::mpact::sim::util::TaggedMemoryInterface;
+using HaltReason = ::mpact::sim::generic::CoreDebugInterface::HaltReason;
+
+namespace {
+
+constexpr uint64_t kGranuleSize = 8;
+constexpr uint64_t kGranuleMask = ~(kGranuleSize - 1);
+// Number of tag bytes (one per granule) in a page.
+constexpr uint64_t kPageTags = CheriotFaultCampaign::kPageSize / kGranuleSize;
+
+// Machine mode CSRs that are saved and compared. The counters are restored
+// separately, and are not compared, as the timing of a masked variant may
+// differ from that of the golden run.
+constexpr const char *kCsrNames[] = {
+    "mstatus",   "misa",      "mie",        "mip",        "mtvec",
+    "mepc",      "mcause",    "mtval",      "mscratch",   "mshwm",
+    "mshwmb",    "pmpcfg0",   "pmpcfg1",    "pmpcfg2",    "pmpcfg3",
+    "pmpaddr0",  "pmpaddr1",  "pmpaddr2",   "pmpaddr3",   "pmpaddr4",
+    "pmpaddr5",  "pmpaddr6",  "pmpaddr7",   "pmpaddr8",   "pmpaddr9",
+    "pmpaddr10", "pmpaddr11", "pmpaddr12",  "pmpaddr13",  "pmpaddr14",
+    "pmpaddr15",
+};
+
+// Registers used for generated register faults, and the bit range of all
+// register faults.
+constexpr int kFirstFaultRegister = 1;
+constexpr int kLastFaultRegister = 15;
+constexpr int kRegisterBits = 32;
+
+// Interrupt codes that can be injected.
+constexpr int kSoftwareInterrupt = 3;
+constexpr int kTimerInterrupt = 7;
+constexpr int kExternalInterrupt = 11;
+
+constexpr struct {
+  CheriotFaultCampaign::FaultType type;
+  const char *name;
+} kFaultTypeNames[] = {
+    {CheriotFaultCampaign::FaultType::kRegisterBitFlip, "reg"},
+    {CheriotFaultCampaign::FaultType::kCapabilityBitFlip, "cap"},
+    {CheriotFaultCampaign::FaultType::kRegisterTagDrop, "regtag"},
+    {CheriotFaultCampaign::FaultType::kMemoryBitFlip, "mem"},
+    {CheriotFaultCampaign::FaultType::kMemoryTagDrop, "memtag"},
+    {CheriotFaultCampaign::FaultType::kInterrupt, "irq"},
+};
+
+absl::StatusOr<uint64_t> ParseNumber(absl::string_view text) {
+  std::string str(text);
+  size_t index = 0;
+  auto result = riscv::internal::stoull(str, &index, 0);
+  if (!result.ok() || (index != str.size())) {
+    return absl::InvalidArgumentError(
+        absl::StrCat("Invalid number: '", text, "'"));
+  }
+  return result.value();
+}
+
+}  // namespace
+
+// Saves the original contents of the pages that are written, including by
+// atomic memory operations, and forwards all accesses to the wrapped
+// interfaces.
+class CheriotFaultCampaign::PageTracker : public TaggedMemoryInterface,
+                                          public AtomicMemoryOpInterface {
+ public:
+  PageTracker(CheriotFaultCampaign *campaign, TaggedMemoryInterface *memory,
+              AtomicMemoryOpInterface *atomic)
+      : campaign_(campaign), memory_(memory), atomic_(atomic) {}
+
+  void Load(uint64_t address, DataBuffer *db, DataBuffer *tags,
+            Instruction *inst, ReferenceCount *context) override {
+    memory_->Load(address, db, tags, inst, context);
+  }
+  void Load(uint64_t address, DataBuffer *db, Instruction *inst,
+            ReferenceCount *context) override {
+    memory_->Load(address, db, inst, context);
+  }
+  void Load(DataBuffer *address_db, DataBuffer *mask_db, int el_size,
+            DataBuffer *db, Instruction *inst,
+            ReferenceCount *context) override {
+    memory_->Load(address_db, mask_db, el_size, db, inst, context);
+  }
+  void Store(uint64_t address, DataBuffer *db, DataBuffer *tags) override {
+    campaign_->OnWrite(address, db != nullptr
+                                    ? db->size<uint8_t>()
+                                    : tags->size<uint8_t>() * kGranuleSize);
+    memory_->Store(address, db, tags);
+  }
+  void Store(uint64_t address, DataBuffer *db) override {
+    campaign_->OnWrite(address, db->size<uint8_t>());
+    memory_->Store(address, db);
+  }
+  void Store(DataBuffer *address_db, DataBuffer *mask_db, int el_size,
+             DataBuffer *db) override {
+    for (auto address : address_db->Get<uint64_t>()) {
+      campaign_->OnWrite(address, el_size);
+    }
+    memory_->Store(address_db, mask_db, el_size, db);
+  }
+  absl::Status PerformMemoryOp(uint64_t address, Operation op, DataBuffer *db,
+                               Instruction *inst,
+                               ReferenceCount *context) override {
+    if (atomic_ == nullptr) {
+      return absl::UnimplementedError("Atomic memory operations unavailable");
+    }
+    if (op != Operation::kLoadLinked) {
+      campaign_->OnWrite(address, db->size<uint8_t>());
+    }
+    return atomic_->PerformMemoryOp(address, op, db, inst, context);
+  }
+
+ private:
+  CheriotFaultCampaign *campaign_;
+  TaggedMemoryInterface *memory_;
+  AtomicMemoryOpInterface *atomic_;
+};
+
+CheriotFaultCampaign::CheriotFaultCampaign(CheriotTop *top)
+    : top_(top),
+      state_(top->state()),
+      memory_(state_->tagged_memory()),
+      atomic_memory_(state_->atomic_tagged_memory()) {
+  tracker_ = std::make_unique<PageTracker>(this, memory_, atomic_memory_);
+  state_->set_tagged_memory(tracker_.get());
+  if (atomic_memory_ != nullptr) {
+    state_->set_atomic_tagged_memory(tracker_.get());
+  }
+  // Atomic memory operations performed in place would bypass the tracker.
+  state_->set_amo_direct_enabled(false);
+  state_->set_on_trap([this](bool is_interrupt, uint64_t, uint64_t ec,
+                             uint64_t, const Instruction *) {
+    if (!is_interrupt && (ec == CheriotState::kCheriExceptionCode)) {
+      cheri_traps_++;
+    }
+    return false;
+  });
+}
+
+CheriotFaultCampaign::~CheriotFaultCampaign() {
+  state_->set_on_trap(nullptr);
+  if (state_->tagged_memory() == tracker_.get()) {
+    state_->set_tagged_memory(memory_);
+  }
+  if (state_->atomic_tagged_memory() == tracker_.get()) {
+    state_->set_atomic_tagged_memory(atomic_memory_);
+  }
+}
+
+absl::Status CheriotFaultCampaign::Prepare(uint64_t injection_point,
+                                           uint64_t max_instructions) {
+  if (prepared_) {
+    return absl::FailedPreconditionError("Campaign already prepared");
+  }
+  // Run to the injection point.
+  bool halted = false;
+  if (injection_point > 0) {
+    auto result = RunInstructions(injection_point, halted);
+    if (!result.ok()) return result.status();
+    if (halted) {
+      return absl::InvalidArgumentError(
+          absl::StrCat("Program halted after ", result.value(),
+                       " instructions, before the injection point ",
+                       injection_point));
+    }
+  }
+  Snapshot();
+  // Golden run.
+  cheri_traps_ = 0;
+  uint64_t limit = max_instructions == 0
+                       ? std::numeric_limits<uint64_t>::max()
+                       : max_instructions;
+  auto result = RunInstructions(limit, halted);
+  if (!result.ok()) return result.status();
+  if (!halted) {
+    return absl::InvalidArgumentError(absl::StrCat(
+        "Golden run did not complete in ", max_instructions, " instructions"));
+  }
+  golden_instructions_ = result.value();
+  golden_cheri_traps_ = cheri_traps_;
+  auto halt_result = top_->GetLastHaltReason();
+  if (!halt_result.ok()) return halt_result.status();
+  golden_halt_reason_ = halt_result.value();
+  SaveRegisters(golden_registers_);
+  golden_csrs_.clear();
+  for (auto const *name : kCsrNames) {
+    auto csr = state_->csr_set()->GetCsr(name);
+    if (!csr.ok()) continue;
+    golden_csrs_.emplace_back(name, csr.value()->GetUint32());
+  }
+  for (auto const &[page, unused] : saved_pages_) {
+    golden_pages_.emplace(page, ReadPage(page));
+  }
+  Restore();
+  prepared_ = true;
+  return absl::OkStatus();
+}
+
+absl::StatusOr<CheriotFaultCampaign::Outcome> CheriotFaultCampaign::RunVariant(
+    const Fault &fault) {
+  if (!prepared_) {
+    return absl::FailedPreconditionError("Campaign not prepared");
+  }
+  uint64_t limit = golden_instructions_ * hang_factor_ + hang_margin_;
+  uint64_t count = 0;
+  bool halted = false;
+  cheri_traps_ = 0;
+  absl::Status status = absl::OkStatus();
+  // Run up to the fault and inject it.
+  if (fault.delay > 0) {
+    auto result = RunInstructions(std::min(fault.delay, limit), halted);
+    if (!result.ok()) status = result.status();
+    if (result.ok()) count += result.value();
+  }
+  if (status.ok() && !halted) {
+    status = Inject(fault);
+    if (status.ok() && (fault.type == FaultType::kInterrupt)) {
+      auto result = RunInstructions(std::min(fault.duration, limit - count),
+                                    halted);
+      if (!result.ok()) status = result.status();
+      if (result.ok()) count += result.value();
+      if (status.ok()) status = SetInterrupt(fault.bit, false);
+    }
+  }
+  // Run to the end of the program, or the hang limit.
+  if (status.ok() && !halted && (count < limit)) {
+    auto result = RunInstructions(limit - count, halted);
+    if (!result.ok()) status = result.status();
+    if (result.ok()) count += result.value();
+  }
+  Outcome outcome = Outcome::kSilentCorruption;
+  if (status.ok()) {
+    auto halt_result = top_->GetLastHaltReason();
+    if (cheri_traps_ > golden_cheri_traps_) {
+      outcome = Outcome::kCheriTrap;
+    } else if (!halted) {
+      outcome = Outcome::kHang;
+    } else if (halt_result.ok() &&
+               (halt_result.value() == golden_halt_reason_) &&
+               MatchesGolden()) {
+      outcome = Outcome::kMasked;
+    }
+  }
+  Restore();
+  if (!status.ok()) return status;
+  return outcome;
+}
+
+std::vector<CheriotFaultCampaign::Fault> CheriotFaultCampaign::GenerateFaults(
+    int count, uint64_t seed) const {
+  std::mt19937_64 rng(seed);
+  std::uniform_int_distribution<int> type_dist(
+      0, static_cast<int>(FaultType::kInterrupt));
+  std::uniform_int_distribution<uint64_t> delay_dist(
+      0, golden_instructions_ > 0 ? golden_instructions_ - 1 : 0);
+  std::uniform_int_distribution<int> reg_dist(kFirstFaultRegister,
+                                              kLastFaultRegister);
+  std::uniform_int_distribution<int> bit_dist(0, kRegisterBits - 1);
+  std::uniform_int_distribution<int> byte_bit_dist(0, 7);
+  std::uniform_int_distribution<uint64_t> offset_dist(0, kPageSize - 1);
+  std::uniform_int_distribution<int> irq_dist(0, 2);
+  constexpr int kIrqCodes[] = {kSoftwareInterrupt, kTimerInterrupt,
+                               kExternalInterrupt};
+  std::vector<uint64_t> pages;
+  for (auto const &[page, unused] : golden_pages_) pages.push_back(page);
+  std::uniform_int_distribution<size_t> page_dist(
+      0, pages.empty() ? 0 : pages.size() - 1);
+  std::vector<Fault> faults;
+  faults.reserve(count);
+  for (int i = 0; i < count; i++) {
+    Fault fault;
+    fault.type = static_cast<FaultType>(type_dist(rng));
+    fault.delay = delay_dist(rng);
+    bool is_memory_fault = (fault.type == FaultType::kMemoryBitFlip) ||
+                           (fault.type == FaultType::kMemoryTagDrop);
+    // Without any written pages, memory faults become register faults.
+    if (is_memory_fault && pages.empty()) {
+      fault.type = fault.type == FaultType::kMemoryBitFlip
+                       ? FaultType::kRegisterBitFlip
+                       : FaultType::kRegisterTagDrop;
+    }
+    switch (fault.type) {
+      case FaultType::kRegisterBitFlip:
+      case FaultType::kCapabilityBitFlip:
+      case FaultType::kRegisterTagDrop:
+        fault.reg = absl::StrCat("c", reg_dist(rng));
+        if (fault.type != FaultType::kRegisterTagDrop) {
+          fault.bit = bit_dist(rng);
+        }
+        break;
+      case FaultType::kMemoryBitFlip:
+      case FaultType::kMemoryTagDrop:
+        fault.address = pages[page_dist(rng)] + offset_dist(rng);
+        if (fault.type == FaultType::kMemoryBitFlip) {
+          fault.bit = byte_bit_dist(rng);
+        } else {
+          fault.address &= kGranuleMask;
+        }
+        break;
+      case FaultType::kInterrupt:
+        fault.bit = kIrqCodes[irq_dist(rng)];
+        fault.duration = 1;
+        break;
+    }
+    faults.push_back(fault);
+  }
+  return faults;
+}
+
+absl::StatusOr<CheriotFaultCampaign::Fault> CheriotFaultCampaign::ParseFault(
+    absl::string_view text) {
+  std::vector<absl::string_view> fields =
+      absl::StrSplit(text, absl::ByAnyChar(" \t"), absl::SkipEmpty());
+  if (fields.size() < 2) {
+    return absl::InvalidArgumentError(
+        absl::StrCat("Invalid fault: '", text, "'"));
+  }
+  Fault fault;
+  auto delay = ParseNumber(fields[0]);
+  if (!delay.ok()) return delay.status();
+  fault.delay = delay.value();
+  bool found = false;
+  for (auto const &[type, name] : kFaultTypeNames) {
+    if (fields[1] != name) continue;
+    fault.type = type;
+    found = true;
+    break;
+  }
+  if (!found) {
+    return absl::InvalidArgumentError(
+        absl::StrCat("Invalid fault type: '", fields[1], "'"));
+  }
+  // Number of arguments of the fault type.
+  size_t num_args = 2;
+  if ((fault.type == FaultType::kRegisterTagDrop) ||
+      (fault.type == FaultType::kMemoryTagDrop)) {
+    num_args = 1;
+  }
+  if (fields.size() != num_args + 2) {
+    return absl::InvalidArgumentError(
+        absl::StrCat("Wrong number of arguments for fault: '", text, "'"));
+  }
+  switch (fault.type) {
+    case FaultType::kRegisterBitFlip:
+    case FaultType::kCapabilityBitFlip:
+    case FaultType::kRegisterTagDrop:
+      fault.reg = std::string(fields[2]);
+      break;
+    case FaultType::kMemoryBitFlip:
+    case FaultType::kMemoryTagDrop: {
+      auto address = ParseNumber(fields[2]);
+      if (!address.ok()) return address.status();
+      fault.address = address.value();
+      break;
+    }
+    case FaultType::kInterrupt: {
+      auto code = ParseNumber(fields[2]);
+      if (!code.ok()) return code.status();
+      if ((code.value() != kSoftwareInterrupt) &&
+          (code.value() != kTimerInterrupt) &&
+          (code.value() != kExternalInterrupt)) {
+        return absl::InvalidArgumentError(
+            absl::StrCat("Invalid interrupt code: ", code.value()));
+      }
+      fault.bit = static_cast<int>(code.value());
+      auto duration = ParseNumber(fields[3]);
+      if (!duration.ok()) return duration.status();
+      if (duration.value() == 0) {
+        return absl::InvalidArgumentError("Interrupt duration must be > 0");
+      }
+      fault.duration = duration.value();
+      return fault;
+    }
+  }
+  if (num_args == 2) {
+    auto bit = ParseNumber(fields[3]);
+    if (!bit.ok()) return bit.status();
+    int max_bit =
+        fault.type == FaultType::kMemoryBitFlip ? 7 : kRegisterBits - 1;
+    if (bit.value() > max_bit) {
+      return absl::InvalidArgumentError(
+          absl::StrCat("Invalid bit index: ", bit.value()));
+    }
+    fault.bit = static_cast<int>(bit.value());
+  }
+  return fault;
+}
+
+std::string CheriotFaultCampaign::FaultString(const Fault &fault) {
+  absl::string_view name = "unknown";
+  for (auto const &[type, type_name] : kFaultTypeNames) {
+    if (type == fault.type) name = type_name;
+  }
+  switch (fault.type) {
+    case FaultType::kRegisterBitFlip:
+    case FaultType::kCapabilityBitFlip:
+      return absl::StrCat(fault.delay, " ", name, " ", fault.reg, " ",
+                          fault.bit);
+    case FaultType::kRegisterTagDrop:
+      return absl::StrCat(fault.delay, " ", name, " ", fault.reg);
+    case FaultType::kMemoryBitFlip:
+      return absl::StrCat(fault.delay, " ", name, " 0x",
+                          absl::Hex(fault.address), " ", fault.bit);
+    case FaultType::kMemoryTagDrop:
+      return absl::StrCat(fault.delay, " ", name, " 0x",
+                          absl::Hex(fault.address));
+    case FaultType::kInterrupt:
+      return absl::StrCat(fault.delay, " ", name, " ", fault.bit, " ",
+                          fault.duration);
+  }
+  return absl::StrCat(fault.delay, " ", name);
+}
+
+absl::string_view CheriotFaultCampaign::OutcomeName(Outcome outcome) {
+  switch (outcome) {
+    case Outcome::kMasked:
+      return "masked";
+    case Outcome::kCheriTrap:
+      return "cheri_trap";
+    case Outcome::kHang:
+      return "hang";
+    case Outcome::kSilentCorruption:
+      return "silent_corruption";
+  }
+  return "unknown";
+}
+
+void CheriotFaultCampaign::SaveRegisters(std::vector<SavedRegister> &saved) {
+  saved.clear();
+  absl::flat_hash_set<RegisterBase *> visited;
+  for (auto const &[name, reg] : *state_->registers()) {
+    // Skip aliases.
+    if (!visited.insert(reg).second) continue;
+    SavedRegister saved_reg;
+    saved_reg.reg = reg;
+    if (auto *cap = dynamic_cast<CheriotRegister *>(reg); cap != nullptr) {
+      saved_reg.capability = std::make_unique<CheriotRegister>(state_, name);
+      saved_reg.capability->CopyFrom(*cap);
+    } else {
+      auto *db = reg->data_buffer();
+      if (db == nullptr) continue;
+      auto *raw = static_cast<uint8_t *>(db->raw_ptr());
+      saved_reg.data.assign(raw, raw + db->size<uint8_t>());
+    }
+    saved.push_back(std::move(saved_reg));
+  }
+}
+
+void CheriotFaultCampaign::Snapshot() {
+  SaveRegisters(registers_);
+  csrs_.clear();
+  for (auto const *name : kCsrNames) {
+    auto csr = state_->csr_set()->GetCsr(name);
+    if (!csr.ok()) continue;
+    csrs_.emplace_back(name, csr.value()->GetUint32());
+  }
+  device_words_.clear();
+  auto *db = db_factory_.Allocate<uint32_t>(1);
+  for (auto const &[base, size] : saved_ranges_) {
+    for (uint64_t address = base; address < base + size;
+         address += sizeof(uint32_t)) {
+      memory_->Load(address, db, nullptr, nullptr);
+      device_words_.emplace_back(address, db->Get<uint32_t>(0));
+    }
+  }
+  db->DecRef();
+  num_instructions_ = top_->counter_num_instructions()->GetValue();
+  num_cycles_ = top_->counter_num_cycles()->GetValue();
+  saved_pages_.clear();
+  tracking_ = true;
+}
+
+void CheriotFaultCampaign::Restore() {
+  // Stop tracking so that the restoring writes are not recorded.
+  tracking_ = false;
+  for (auto const &[page, contents] : saved_pages_) WritePage(page, contents);
+  saved_pages_.clear();
+  for (auto const &saved_reg : registers_) {
+    if (saved_reg.capability != nullptr) {
+      static_cast<CheriotRegister *>(saved_reg.reg)
+          ->CopyFrom(*saved_reg.capability);
+      continue;
+    }
+    auto *db = saved_reg.reg->data_buffer();
+    if ((db == nullptr) || (db->size<uint8_t>() != saved_reg.data.size())) {
+      continue;
+    }
+    std::memcpy(db->raw_ptr(), saved_reg.data.data(), saved_reg.data.size());
+  }
+  for (auto const &[name, value] : csrs_) {
+    auto csr = state_->csr_set()->GetCsr(name);
+    if (csr.ok()) csr.value()->Set(value);
+  }
+  // The PMP decisions cached by the variant may no longer hold.
+  state_->pmp_checker()->Invalidate();
+  auto *db = db_factory_.Allocate<uint32_t>(1);
+  for (auto const &[address, value] : device_words_) {
+    db->Set<uint32_t>(0, value);
+    memory_->Store(address, db);
+  }
+  db->DecRef();
+  top_->counter_num_instructions()->SetValue(num_instructions_);
+  top_->counter_num_cycles()->SetValue(num_cycles_);
+  top_->ClearHaltReason();
+  state_->CheckForInterrupt();
+  tracking_ = true;
+}
+
+absl::StatusOr<uint64_t> CheriotFaultCampaign::RunInstructions(uint64_t count,
+                                                                bool &halted) {
+  halted = false;
+  uint64_t total = 0;
+  while (total < count) {
+    uint64_t num = std::min<uint64_t>(count - total,
+                                      std::numeric_limits<int>::max());
+    auto result = top_->Step(static_cast<int>(num));
+    if (!result.ok()) return result.status();
+    total += result.value();
+    auto halt_result = top_->GetLastHaltReason();
+    if (!halt_result.ok()) return halt_result.status();
+    if ((halt_result.value() != *HaltReason::kNone) || (result.value() == 0)) {
+      halted = true;
+      break;
+    }
+  }
+  return total;
+}
+
+absl::Status CheriotFaultCampaign::Inject(const Fault &fault) {
+  switch (fault.type) {
+    case FaultType::kRegisterBitFlip:
+    case FaultType::kCapabilityBitFlip:
+    case FaultType::kRegisterTagDrop: {
+      auto iter = state_->registers()->find(fault.reg);
+      if (iter == state_->registers()->end()) {
+        return absl::NotFoundError(
+            absl::StrCat("Register '", fault.reg, "' not found"));
+      }
+      RegisterBase *reg = iter->second;
+      auto *cap = dynamic_cast<CheriotRegister *>(reg);
+      if (cap == nullptr) {
+        if (fault.type != FaultType::kRegisterBitFlip) {
+          return absl::InvalidArgumentError(
+              absl::StrCat("'", fault.reg, "' is not a capability register"));
+        }
+        auto *db = reg->data_buffer();
+        if ((db == nullptr) || (fault.bit / 8 >= db->size<uint8_t>())) {
+          return absl::InvalidArgumentError(absl::StrCat(
+              "Invalid bit ", fault.bit, " for register '", fault.reg, "'"));
+        }
+        static_cast<uint8_t *>(db->raw_ptr())[fault.bit / 8] ^=
+            1 << (fault.bit % 8);
+        return absl::OkStatus();
+      }
+      if (fault.bit >= kRegisterBits) {
+        return absl::InvalidArgumentError(absl::StrCat(
+            "Invalid bit ", fault.bit, " for register '", fault.reg, "'"));
+      }
+      uint32_t mask = uint32_t{1} << fault.bit;
+      if (fault.type == FaultType::kRegisterTagDrop) {
+        cap->Invalidate();
+      } else if (fault.type == FaultType::kCapabilityBitFlip) {
+        cap->Expand(cap->address(), cap->Compress() ^ mask, cap->tag());
+      } else if (cap->is_null()) {
+        cap->data_buffer()->Set<uint32_t>(0, cap->address() ^ mask);
+      } else {
+        cap->Expand(cap->address() ^ mask, cap->Compress(), cap->tag());
+      }
+      return absl::OkStatus();
+    }
+    case FaultType::kMemoryBitFlip:
+    case FaultType::kMemoryTagDrop: {
+      // Modify the granule through the state, so that the page is saved and
+      // any tag cache sees the write.
+      uint64_t granule = fault.address & kGranuleMask;
+      auto *db = db_factory_.Allocate<uint8_t>(kGranuleSize);
+      auto *tag_db = db_factory_.Allocate<uint8_t>(1);
+      state_->tagged_memory()->Load(granule, db, tag_db, nullptr, nullptr);
+      if (fault.type == FaultType::kMemoryBitFlip) {
+        db->Get<uint8_t>()[fault.address - granule] ^= 1 << fault.bit;
+      } else {
+        tag_db->Set<uint8_t>(0, 0);
+      }
+      state_->tagged_memory()->Store(granule, db, tag_db);
+      db->DecRef();
+      tag_db->DecRef();
+      top_->InvalidateDecodeCache(granule, kGranuleSize);
+      return absl::OkStatus();
+    }
+    case FaultType::kInterrupt:
+      return SetInterrupt(fault.bit, true);
+  }
+  return absl::InvalidArgumentError("Invalid fault type");
+}
+
+absl::Status CheriotFaultCampaign::SetInterrupt(int code, bool value) {
+  switch (code) {
+    case kSoftwareInterrupt:
+      state_->mip()->set_msip(value);
+      break;
+    case kTimerInterrupt:
+      state_->mip()->set_mtip(value);
+      break;
+    case kExternalInterrupt:
+      state_->mip()->set_meip(value);
+      break;
+    default:
+      return absl::InvalidArgumentError(
+          absl::StrCat("Invalid interrupt code: ", code));
+  }
+  state_->CheckForInterrupt();
+  return absl::OkStatus();
+}
+
+bool CheriotFaultCampaign::MatchesGolden() {
+  for (auto const &saved_reg : golden_registers_) {
+    if (saved_reg.capability != nullptr) {
+      auto *cap = static_cast<CheriotRegister *>(saved_reg.reg);
+      if ((cap->address() != saved_reg.capability->address()) ||
+          !(*cap == *saved_reg.capability)) {
+        return false;
+      }
+      continue;
+    }
+    auto *db = saved_reg.reg->data_buffer();
+    if ((db == nullptr) || (db->size<uint8_t>() != saved_reg.data.size()) ||
+        (std::memcmp(db->raw_ptr(), saved_reg.data.data(),
+                     saved_reg.data.size()) != 0)) {
+      return false;
+    }
+  }
+  for (auto const &[name, value] : golden_csrs_) {
+    auto csr = state_->csr_set()->GetCsr(name);
+    if (!csr.ok() || (csr.value()->GetUint32() != value)) return false;
+  }
+  // Pages written by the golden run are compared to its final contents, and
+  // other pages written by the variant to their snapshot contents.
+  for (auto const &[page, contents] : saved_pages_) {
+    if (golden_pages_.contains(page)) continue;
+    Page current = ReadPage(page);
+    if ((current.data != contents.data) || (current.tags != contents.tags)) {
+      return false;
+    }
+  }
+  for (auto const &[page, contents] : golden_pages_) {
+    Page current = ReadPage(page);
+    if ((current.data != contents.data) || (current.tags != contents.tags)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+void CheriotFaultCampaign::OnWrite(uint64_t address, uint64_t size) {
+  if (!tracking_ || (size == 0)) return;
+  if (excluded_ranges_.Overlaps(address, size)) return;
+  uint64_t last = (address + size - 1) & ~(kPageSize - 1);
+  for (uint64_t page = address & ~(kPageSize - 1); page <= last;
+       page += kPageSize) {
+    if (saved_pages_.contains(page)) continue;
+    saved_pages_.emplace(page, ReadPage(page));
+  }
+}
+
+CheriotFaultCampaign::Page CheriotFaultCampaign::ReadPage(uint64_t page) {
+  Page contents;
+  auto *db = db_factory_.Allocate<uint8_t>(kPageSize);
+  auto *tag_db = db_factory_.Allocate<uint8_t>(kPageTags);
+  memory_->Load(page, db, tag_db, nullptr, nullptr);
+  auto data = db->Get<uint8_t>();
+  auto tags = tag_db->Get<uint8_t>();
+  contents.data.assign(data.begin(), data.end());
+  contents.tags.assign(tags.begin(), tags.end());
+  db->DecRef();
+  tag_db->DecRef();
+  return contents;
+}
+
+void CheriotFaultCampaign::WritePage(uint64_t page, const Page &contents) {
+  auto *db = db_factory_.Allocate<uint8_t>(kPageSize);
+  auto *tag_db = db_factory_.Allocate<uint8_t>(kPageTags);
+  std::memcpy(db->raw_ptr(), contents.data.data(), kPageSize);
+  std::memcpy(tag_db->raw_ptr(), contents.tags.data(), kPageTags);
+  memory_->Store(page, db, tag_db);
+  db->DecRef();
+  tag_db->DecRef();
+  // The page may have contained instructions that were decoded.
+  top_->InvalidateDecodeCache(page, kPageSize);
+}
+
+}  // namespace cheriot
+}  // namespace sim
+}  // namespace mpact
@@ -0,0 +1,232 @@
+// Copyright 2024 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef MPACT_CHERIOT_CHERIOT_FAULT_CAMPAIGN_H_
+#define MPACT_CHERIOT_CHERIOT_FAULT_CAMPAIGN_H_
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "absl/container/btree_map.h"
+#include "absl/status/status.h"
+#include "absl/status/statusor.h"
+#include "absl/strings/string_view.h"
+#include "cheriot/cheriot_address_ranges.h"
+#include "cheriot/cheriot_register.h"
+#include "cheriot/cheriot_state.h"
+#include "cheriot/cheriot_top.h"
+#include "mpact/sim/generic/data_buffer.h"
+#include "mpact/sim/generic/register.h"
+#include "mpact/sim/util/memory/memory_interface.h"
+#include "mpact/sim/util/memory/tagged_memory_interface.h"
+
+// This file defines a fault injection campaign engine. The program is run once
+// up to the injection point, where a snapshot is taken of:
+//
+//   - All registers, including the full capability of capability registers.
+//   - The machine mode CSRs that are not counters.
+//   - The instruction and cycle counters.
+//   - Any device registers that are added as saved ranges.
+//
+// Memory is snapshotted lazily: a page tracker in front of the memory
+// interfaces of the state saves each page (data and tags) the first time it
+// is written after the snapshot, and restoring writes the saved pages back.
+// The golden run continues from the snapshot to the end of the program, and
+// its final state is recorded. Each variant is then run from the restored
+// snapshot with one fault injected, and is classified as:
+//
+//   - kCheriTrap: it took more CHERI exceptions than the golden run.
+//   - kHang: it ran for longer than the hang limit.
+//   - kMasked: its final state is the same as that of the golden run.
+//   - kSilentCorruption: its final state differs.
+//
+// Memory written other than through the state (e.g., by semihosting calls)
+// is not tracked, and device state other than the saved ranges is not
+// restored, so programs that depend on either may be misclassified. Neither is
+// host file state, so mpact_cheriot rejects campaigns on programs that read
+// files through semihosting. Host I/O
+// of semihosting calls is not suppressed either, so e.g. console output after
+// the injection point is repeated by the golden run and by each variant.
+
+namespace mpact {
+namespace sim {
+namespace cheriot {
+
+using ::mpact::sim::generic::DataBuffer;
+using ::mpact::sim::generic::RegisterBase;
+
+class CheriotFaultCampaign {
+ public:
+  static constexpr uint64_t kPageSize = 4096;
+
+  enum class FaultType {
+    // Flip a bit of the integer value (address) of a register.
+    kRegisterBitFlip,
+    // Flip a bit of the compressed capability metadata of a register.
+    kCapabilityBitFlip,
+    // Clear the tag of a capability register.
+    kRegisterTagDrop,
+    // Flip a bit of a byte in memory.
+    kMemoryBitFlip,
+    // Clear the tag of the memory granule.
+    kMemoryTagDrop,
+    // Assert an interrupt for a number of instructions.
+    kInterrupt,
+  };
+
+  struct Fault {
+    FaultType type = FaultType::kRegisterBitFlip;
+    // Number of instructions after the injection point the fault is injected.
+    uint64_t delay = 0;
+    // Register name for register faults.
+    std::string reg;
+    // Address for memory faults.
+    uint64_t address = 0;
+    // Bit index for bit flips, interrupt code (3, 7 or 11) for interrupts.
+    int bit = 0;
+    // Number of instructions an interrupt is asserted.
+    uint64_t duration = 1;
+  };
+
+  enum class Outcome { kMasked = 0, kCheriTrap, kHang, kSilentCorruption };
+  static constexpr int kNumOutcomes = 4;
+
+  // The campaign is run on the top, which is not owned. A page tracker is
+  // inserted in front of the memory interfaces of its state, so this must be
+  // done after any other memory interfaces have been inserted. The trap
+  // callback of the state is replaced.
+  explicit CheriotFaultCampaign(CheriotTop *top);
+  CheriotFaultCampaign(const CheriotFaultCampaign &) = delete;
+  CheriotFaultCampaign &operator=(const CheriotFaultCampaign &) = delete;
+  ~CheriotFaultCampaign();
+
+  // Writes to these address ranges are not tracked, e.g., for memory mapped
+  // devices, where loads may have side effects.
+  void set_excluded_ranges(const CheriotAddressRanges &ranges) {
+    excluded_ranges_ = ranges;
+  }
+  // The 32 bit device registers in [base, base + size) are saved in the
+  // snapshot, and restored with it.
+  void AddSavedRange(uint64_t base, uint64_t size) {
+    saved_ranges_.emplace_back(base, size);
+  }
+  // The hang limit of a variant is factor times the golden run length plus
+  // margin instructions.
+  void set_hang_limit(uint64_t factor, uint64_t margin) {
+    hang_factor_ = factor;
+    hang_margin_ = margin;
+  }
+
+  // Runs the program to the injection point (instruction count), takes the
+  // snapshot, and then performs the golden run for up to max_instructions
+  // (0 for no limit).
+  absl::Status Prepare(uint64_t injection_point, uint64_t max_instructions);
+  // Runs a variant with the fault injected, and returns its outcome. The
+  // snapshot is restored afterwards.
+  absl::StatusOr<Outcome> RunVariant(const Fault &fault);
+  // Generates count random faults, with memory faults in the pages written by
+  // the golden run and delays within its length.
+  std::vector<Fault> GenerateFaults(int count, uint64_t seed) const;
+
+  // Parses a fault: "<delay> <type> <arguments>", where the type and its
+  // arguments are one of:
+  //   reg <register> <bit>
+  //   cap <register> <bit>
+  //   regtag <register>
+  //   mem <address> <bit>
+  //   memtag <address>
+  //   irq <code> <duration>
+  // Register bits are in [0, 31] and memory bits in [0, 7].
+  static absl::StatusOr<Fault> ParseFault(absl::string_view text);
+  // Formats a fault in the form accepted by ParseFault.
+  static std::string FaultString(const Fault &fault);
+  static absl::string_view OutcomeName(Outcome outcome);
+
+  // Accessors.
+  uint64_t golden_instructions() const { return golden_instructions_; }
+  int golden_cheri_traps() const { return golden_cheri_traps_; }
+
+ private:
+  class PageTracker;
+  // Snapshot of a register.
+  struct SavedRegister {
+    RegisterBase *reg;
+    // The full capability for capability registers.
+    std::unique_ptr<CheriotRegister> capability;
+    // The data buffer contents for other registers.
+    std::vector<uint8_t> data;
+  };
+  // Data and tags of a page.
+  struct Page {
+    std::vector<uint8_t> data;
+    std::vector<uint8_t> tags;
+  };
+
+  // Snapshot and restore.
+  void SaveRegisters(std::vector<SavedRegister> &saved);
+  void Snapshot();
+  void Restore();
+  // Runs up to count instructions. Returns the number of instructions run
+  // and sets halted if the run ended before that.
+  absl::StatusOr<uint64_t> RunInstructions(uint64_t count, bool &halted);
+  // Injects the fault.
+  absl::Status Inject(const Fault &fault);
+  absl::Status SetInterrupt(int code, bool value);
+  // Returns true if the current final state matches that of the golden run.
+  bool MatchesGolden();
+  // Called by the page tracker before each write. Saves the pages that are
+  // written to for the first time since the snapshot.
+  void OnWrite(uint64_t address, uint64_t size);
+  Page ReadPage(uint64_t page);
+  void WritePage(uint64_t page, const Page &contents);
+
+  CheriotTop *top_;
+  CheriotState *state_;
+  // The memory interfaces in front of which the tracker is inserted.
+  util::TaggedMemoryInterface *memory_;
+  util::AtomicMemoryOpInterface *atomic_memory_;
+  std::unique_ptr<PageTracker> tracker_;
+  bool tracking_ = false;
+  generic::DataBufferFactory db_factory_;
+  CheriotAddressRanges excluded_ranges_;
+  std::vector<std::pair<uint64_t, uint64_t>> saved_ranges_;
+  uint64_t hang_factor_ = 2;
+  uint64_t hang_margin_ = 10'000;
+  bool prepared_ = false;
+  int cheri_traps_ = 0;
+  // Snapshot.
+  std::vector<SavedRegister> registers_;
+  std::vector<std::pair<std::string, uint32_t>> csrs_;
+  std::vector<std::pair<uint64_t, uint32_t>> device_words_;
+  uint64_t num_instructions_ = 0;
+  uint64_t num_cycles_ = 0;
+  // Original contents of the pages written since the snapshot.
+  absl::btree_map<uint64_t, Page> saved_pages_;
+  // Final state of the golden run.
+  std::vector<SavedRegister> golden_registers_;
+  std::vector<std::pair<std::string, uint32_t>> golden_csrs_;
+  absl::btree_map<uint64_t, Page> golden_pages_;
+  uint64_t golden_instructions_ = 0;
+  int golden_cheri_traps_ = 0;
+  uint64_t golden_halt_reason_ = 0;
+};
+
+}  // namespace cheriot
+}  // namespace sim
+}  // namespace mpact
+
+#endif  // MPACT_CHERIOT_CHERIOT_FAULT_CAMPAIGN_H_
@@ -21,6 +21,7 @@
 #include "absl/container/flat_hash_map.h"
 #include "absl/functional/any_invocable.h"
 #include "absl/strings/str_cat.h"
+#include "cheriot/cheriot_csr_operand.h"
 #include "cheriot/cheriot_getter_helpers.h"
 #include "cheriot/cheriot_register.h"
 #include "cheriot/cheriot_state.h"
@@ -133,11 +134,8 @@ void AddCheriotSourceGetters(SourceOpGetterMap &getter_map,
   Insert(getter_map, *Enum::kCsr, [common]() {
     auto csr_indx = Extractors::IType::ExtractUImm12(common->inst_word());
     auto res = common->state()->csr_set()->GetCsr(csr_indx);
-    if (!res.ok()) {
-      return new ImmediateOperand<uint32_t>(csr_indx);
-    }
-    auto *csr = res.value();
-    return new ImmediateOperand<uint32_t>(csr_indx, csr->name());
+    return new CheriotCsrOperand(csr_indx, res.ok() ? res.value() : nullptr,
+                                 common->resolve_csr_operands());
   });
   Insert(getter_map, *Enum::kICbImm8, [common]() {
     return new ImmediateOperand<int32_t>(
@@ -32,7 +32,7 @@ namespace mpact::sim::cheriot {
 
 CheriotInstrumentationControl::CheriotInstrumentationControl(
     DebugCommandShell *shell, CheriotTop *cheriot_top,
-    TaggedMemoryUseProfiler *mem_profiler)
+    CheriotMemoryUseProfiler *mem_profiler)
     : shell_(shell),
       top_(cheriot_top),
       mem_profiler_(mem_profiler),
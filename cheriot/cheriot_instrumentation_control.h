@@ -20,20 +20,18 @@
 #include <string>
 
 #include "absl/strings/string_view.h"
+#include "cheriot/cheriot_memory_use_profiler.h"
 #include "cheriot/cheriot_top.h"
 #include "cheriot/debug_command_shell.h"
-#include "mpact/sim/util/memory/memory_use_profiler.h"
 #include "re2/re2.h"
 
 namespace mpact::sim::cheriot {
 
-using ::mpact::sim::util::TaggedMemoryUseProfiler;
-
 class CheriotInstrumentationControl {
  public:
   CheriotInstrumentationControl(DebugCommandShell *shell,
                                 CheriotTop *cheriot_top,
-                                TaggedMemoryUseProfiler *mem_profiler);
+                                CheriotMemoryUseProfiler *mem_profiler);
 
   bool PerformShellCommand(absl::string_view input,
                            const DebugCommandShell::CoreAccess &core_access,
@@ -44,7 +42,7 @@ class CheriotInstrumentationControl {
  private:
   DebugCommandShell *shell_;
   CheriotTop *top_ = nullptr;
-  TaggedMemoryUseProfiler *mem_profiler_;
+  CheriotMemoryUseProfiler *mem_profiler_;
   LazyRE2 pattern_re_;
 };
 
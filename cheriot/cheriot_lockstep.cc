@@ -0,0 +1,424 @@
+// Copyright 2024 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "cheriot/cheriot_lockstep.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "absl/container/btree_set.h"
+#include "absl/container/flat_hash_set.h"
+#include "absl/functional/function_ref.h"
+#include "absl/status/status.h"
+#include "absl/strings/str_cat.h"
+#include "cheriot/cheriot_register.h"
+#include "cheriot/cheriot_state.h"
+#include "cheriot/cheriot_top.h"
+#include "mpact/sim/generic/data_buffer.h"
+#include "mpact/sim/generic/instruction.h"
+#include "mpact/sim/generic/ref_count.h"
+#include "mpact/sim/generic/register.h"
+#include "mpact/sim/generic/type_helpers.h"
+#include "mpact/sim/util/memory/memory_interface.h"
+#include "mpact/sim/util/memory/tagged_memory_interface.h"
+
+namespace mpact {
+namespace sim {
+namespace cheriot {
+
+using ::mpact::sim::generic::operator*;  // NOLINT: is used below (clang error).
+using ::mpact::sim::generic::DataBuffer;
+using ::mpact::sim::generic::Instruction;
+using ::mpact::sim::generic::ReferenceCount;
+using ::mpact::sim::generic::RegisterBase;
+using ::mpact::sim::util::AtomicMemoryOpInterface;
+using ::mpact::sim::util::TaggedMemoryInterface;
+using HaltReason = ::mpact::sim::generic::CoreDebugInterface::HaltReason;
+
+namespace {
+
+constexpr uint64_t kGranuleMask = ~uint64_t{7};
+
+// Machine mode CSRs that are compared. The counters are not compared, as
+// mcycle depends on the timing models, and the instruction counts are
+// compared when stepping.
+constexpr const char *kCsrNames[] = {
+    "mstatus", "misa", "mie", "mip", "mtvec", "mepc",
+    "mcause", "mtval", "mscratch", "mshwm", "mshwmb",
+};
+
+// Semihosting operations that write simulated memory or that have no host
+// I/O.
+constexpr uint32_t kSysRead = 0x06;
+constexpr uint32_t kSysTmpnam = 0x0d;
+constexpr uint32_t kSysGetCmdline = 0x15;
+constexpr uint32_t kSysHeapInfo = 0x16;
+constexpr uint32_t kSysExit = 0x18;
+constexpr uint32_t kSysExitExtended = 0x20;
+constexpr uint32_t kSysElapsed = 0x30;
+
+uint32_t LoadWord(CheriotState *state, uint64_t address) {
+  auto *db = state->db_factory()->Allocate<uint32_t>(1);
+  state->DbgLoadMemory(address, db);
+  uint32_t value = db->Get<uint32_t>(0);
+  db->DecRef();
+  return value;
+}
+
+std::string CapabilityString(const CheriotRegister *cap) {
+  return absl::StrCat("0x", absl::Hex(cap->address()), " tag ", cap->tag(),
+                      " base 0x", absl::Hex(cap->base()), " top 0x",
+                      absl::Hex(cap->top()), " perms 0x",
+                      absl::Hex(cap->permissions()), " otype ",
+                      cap->object_type());
+}
+
+}  // namespace
+
+// Records the granules that are stored to, including by atomic memory
+// operations, and forwards all accesses to the wrapped interfaces.
+class CheriotLockstep::StoreTracker : public TaggedMemoryInterface,
+                                      public AtomicMemoryOpInterface {
+ public:
+  StoreTracker(absl::btree_set<uint64_t> *granules,
+               TaggedMemoryInterface *memory, AtomicMemoryOpInterface *atomic)
+      : granules_(granules), memory_(memory), atomic_(atomic) {}
+
+  void Load(uint64_t address, DataBuffer *db, DataBuffer *tags,
+            Instruction *inst, ReferenceCount *context) override {
+    memory_->Load(address, db, tags, inst, context);
+  }
+  void Load(uint64_t address, DataBuffer *db, Instruction *inst,
+            ReferenceCount *context) override {
+    memory_->Load(address, db, inst, context);
+  }
+  void Load(DataBuffer *address_db, DataBuffer *mask_db, int el_size,
+            DataBuffer *db, Instruction *inst,
+            ReferenceCount *context) override {
+    memory_->Load(address_db, mask_db, el_size, db, inst, context);
+  }
+  void Store(uint64_t address, DataBuffer *db, DataBuffer *tags) override {
+    Record(address, db != nullptr ? db->size<uint8_t>()
+                                  : tags->size<uint8_t>() * 8);
+    memory_->Store(address, db, tags);
+  }
+  void Store(uint64_t address, DataBuffer *db) override {
+    Record(address, db->size<uint8_t>());
+    memory_->Store(address, db);
+  }
+  void Store(DataBuffer *address_db, DataBuffer *mask_db, int el_size,
+             DataBuffer *db) override {
+    for (auto address : address_db->Get<uint64_t>()) Record(address, el_size);
+    memory_->Store(address_db, mask_db, el_size, db);
+  }
+  absl::Status PerformMemoryOp(uint64_t address, Operation op, DataBuffer *db,
+                               Instruction *inst,
+                               ReferenceCount *context) override {
+    if (atomic_ == nullptr) {
+      return absl::UnimplementedError("Atomic memory operations unavailable");
+    }
+    if (op != Operation::kLoadLinked) Record(address, db->size<uint8_t>());
+    return atomic_->PerformMemoryOp(address, op, db, inst, context);
+  }
+
+ private:
+  void Record(uint64_t address, int size) {
+    if (size <= 0) return;
+    uint64_t last = (address + size - 1) & kGranuleMask;
+    for (uint64_t granule = address & kGranuleMask; granule <= last;
+         granule += 8) {
+      granules_->insert(granule);
+    }
+  }
+
+  absl::btree_set<uint64_t> *granules_;
+  TaggedMemoryInterface *memory_;
+  AtomicMemoryOpInterface *atomic_;
+};
+
+CheriotLockstep::CheriotLockstep(CheriotTop *top, CheriotTop *reference)
+    : top_(top), reference_(reference) {}
+
+CheriotLockstep::~CheriotLockstep() = default;
+
+void CheriotLockstep::TrackStores(CheriotState *state) {
+  auto tracker = std::make_unique<StoreTracker>(
+      &stored_granules_, state->tagged_memory(),
+      state->atomic_tagged_memory());
+  state->set_tagged_memory(tracker.get());
+  if (state->atomic_tagged_memory() != nullptr) {
+    state->set_atomic_tagged_memory(tracker.get());
+  }
+  trackers_.push_back(std::move(tracker));
+}
+
+absl::Status CheriotLockstep::Run(uint64_t interval,
+                                  uint64_t max_instructions) {
+  if (interval == 0) {
+    return absl::InvalidArgumentError("Lockstep interval must be > 0");
+  }
+  while (!diverged_ &&
+         ((max_instructions == 0) || (num_instructions_ < max_instructions))) {
+    uint64_t count = interval;
+    if (max_instructions != 0) {
+      count = std::min(count, max_instructions - num_instructions_);
+    }
+    count = std::min<uint64_t>(count, std::numeric_limits<int>::max());
+    auto top_result = top_->Step(static_cast<int>(count));
+    if (!top_result.ok()) return top_result.status();
+    int stepped = top_result.value();
+    if (stepped > 0) {
+      auto reference_result = reference_->Step(stepped);
+      if (!reference_result.ok()) return reference_result.status();
+      num_instructions_ += stepped;
+      if (!semihosting_error_.empty()) {
+        SetDivergence(semihosting_error_);
+        semihosting_error_.clear();
+        break;
+      }
+      if (reference_result.value() != stepped) {
+        SetDivergence(absl::StrCat("reference stepped ",
+                                   reference_result.value(), " of ", stepped,
+                                   " instructions"));
+        break;
+      }
+    }
+    if (!Compare()) break;
+    auto halt_result = top_->GetLastHaltReason();
+    if (!halt_result.ok()) return halt_result.status();
+    if ((halt_result.value() != *HaltReason::kNone) || (stepped == 0)) break;
+  }
+  return absl::OkStatus();
+}
+
+bool CheriotLockstep::Compare() {
+  differences_.clear();
+  CompareRegisters();
+  CompareCsrs();
+  CompareMemory();
+  stored_granules_.clear();
+  if (differences_.empty()) return true;
+  SetDivergence("state differs");
+  return false;
+}
+
+void CheriotLockstep::TopSemihostingCall(absl::FunctionRef<void()> perform) {
+  auto *state = top_->state();
+  auto *a0 = state->GetRegister<CheriotRegister>("c10").first;
+  uint32_t block = state->GetRegister<CheriotRegister>("c11").first->address();
+  SemihostingResult result;
+  result.operation = a0->address();
+  perform();
+  result.a0 = std::make_unique<CheriotRegister>(state, "semihosting_a0");
+  result.a0->CopyFrom(*a0);
+  // Save the simulated memory written by the call, if any. The parameter
+  // block is read after the call, which doesn't modify it.
+  uint64_t size = 0;
+  result.address = 0;
+  switch (result.operation) {
+    case kSysRead:
+      result.address = LoadWord(state, block + sizeof(uint32_t));
+      size = LoadWord(state, block + 2 * sizeof(uint32_t));
+      break;
+    case kSysTmpnam:
+      result.address = LoadWord(state, block);
+      size = LoadWord(state, block + 2 * sizeof(uint32_t));
+      break;
+    case kSysElapsed:
+      result.address = block;
+      size = sizeof(uint64_t);
+      break;
+    default:
+      break;
+  }
+  if (size > 0) {
+    auto *db = state->db_factory()->Allocate<uint8_t>(size);
+    state->DbgLoadMemory(result.address, db);
+    auto data = db->Get<uint8_t>();
+    result.data.assign(data.begin(), data.end());
+    db->DecRef();
+  }
+  semihosting_results_.push_back(std::move(result));
+}
+
+void CheriotLockstep::ReferenceSemihostingCall(
+    absl::FunctionRef<void()> perform) {
+  auto *state = reference_->state();
+  auto *a0 = state->GetRegister<CheriotRegister>("c10").first;
+  uint32_t operation = a0->address();
+  if (semihosting_results_.empty() ||
+      (semihosting_results_.front().operation != operation)) {
+    if (semihosting_error_.empty()) {
+      semihosting_error_ = absl::StrCat("reference semihosting call 0x",
+                                        absl::Hex(operation),
+                                        " was not made by the top");
+    }
+    return;
+  }
+  auto result = std::move(semihosting_results_.front());
+  semihosting_results_.pop_front();
+  // Calls without host I/O are made by the reference as well, e.g., so that
+  // it halts on exit.
+  if ((operation == kSysGetCmdline) || (operation == kSysHeapInfo) ||
+      (operation == kSysExit) || (operation == kSysExitExtended)) {
+    perform();
+    return;
+  }
+  a0->CopyFrom(*result.a0);
+  if (!result.data.empty()) {
+    auto *db = state->db_factory()->Allocate<uint8_t>(result.data.size());
+    std::memcpy(db->raw_ptr(), result.data.data(), result.data.size());
+    state->DbgStoreMemory(result.address, db);
+    db->DecRef();
+  }
+}
+
+void CheriotLockstep::AddDifference(const std::string &difference) {
+  differences_.push_back(difference);
+}
+
+void CheriotLockstep::CompareRegisters() {
+  auto *registers = top_->state()->registers();
+  auto *reference_registers = reference_->state()->registers();
+  // Sort the names so that the report is deterministic, and skip aliases.
+  std::vector<std::string> names;
+  names.reserve(registers->size());
+  for (auto const &[name, unused] : *registers) names.push_back(name);
+  std::sort(names.begin(), names.end());
+  absl::flat_hash_set<RegisterBase *> visited;
+  for (auto const &name : names) {
+    RegisterBase *reg = registers->at(name);
+    if (!visited.insert(reg).second) continue;
+    // Registers are created when first referenced by a decoded instruction,
+    // so the reference may not have it yet.
+    auto iter = reference_registers->find(name);
+    if (iter == reference_registers->end()) continue;
+    RegisterBase *reference_reg = iter->second;
+    auto *cap = dynamic_cast<CheriotRegister *>(reg);
+    auto *reference_cap = dynamic_cast<CheriotRegister *>(reference_reg);
+    if ((cap != nullptr) && (reference_cap != nullptr)) {
+      if ((cap->address() == reference_cap->address()) &&
+          (*cap == *reference_cap)) {
+        continue;
+      }
+      AddDifference(absl::StrCat(name, ": ", CapabilityString(cap), " vs ",
+                                 CapabilityString(reference_cap)));
+      continue;
+    }
+    auto *db = reg->data_buffer();
+    auto *reference_db = reference_reg->data_buffer();
+    if ((db == nullptr) || (reference_db == nullptr)) continue;
+    int size = db->size<uint8_t>();
+    if ((size == reference_db->size<uint8_t>()) &&
+        (std::memcmp(db->raw_ptr(), reference_db->raw_ptr(), size) == 0)) {
+      continue;
+    }
+    auto value = top_->ReadRegister(name);
+    auto reference_value = reference_->ReadRegister(name);
+    if (value.ok() && reference_value.ok()) {
+      AddDifference(absl::StrCat(name, ": 0x", absl::Hex(value.value()),
+                                 " vs 0x", absl::Hex(reference_value.value())));
+    } else {
+      AddDifference(absl::StrCat(name, ": contents differ"));
+    }
+  }
+}
+
+void CheriotLockstep::CompareCsrs() {
+  for (auto const *name : kCsrNames) {
+    auto csr = top_->state()->csr_set()->GetCsr(name);
+    auto reference_csr = reference_->state()->csr_set()->GetCsr(name);
+    if (!csr.ok() || !reference_csr.ok()) continue;
+    uint32_t value = csr.value()->GetUint32();
+    uint32_t reference_value = reference_csr.value()->GetUint32();
+    if (value == reference_value) continue;
+    AddDifference(absl::StrCat(name, ": 0x", absl::Hex(value), " vs 0x",
+                               absl::Hex(reference_value)));
+  }
+}
+
+void CheriotLockstep::CompareMemory() {
+  for (uint64_t granule : stored_granules_) {
+    if (excluded_ranges_.Overlaps(granule, sizeof(uint64_t))) continue;
+    uint64_t data = 0;
+    uint64_t reference_data = 0;
+    uint8_t tag = 0;
+    uint8_t reference_tag = 0;
+    if (!top_->ReadMemory(granule, &data, sizeof(data)).ok() ||
+        !reference_->ReadMemory(granule, &reference_data, sizeof(data)).ok() ||
+        !top_->ReadTagMemory(granule, &tag, 1).ok() ||
+        !reference_->ReadTagMemory(granule, &reference_tag, 1).ok()) {
+      continue;
+    }
+    if ((data == reference_data) && (tag == reference_tag)) continue;
+    AddDifference(absl::StrCat(
+        "memory 0x", absl::Hex(granule, absl::kZeroPad8), ": 0x",
+        absl::Hex(data, absl::kZeroPad16), " tag ", tag, " vs 0x",
+        absl::Hex(reference_data, absl::kZeroPad16), " tag ", reference_tag));
+  }
+}
+
+std::string CheriotLockstep::TraceWindow(CheriotTop *top) {
+  auto db_result = top->GetRegisterDataBuffer("$branch_trace");
+  auto head_result = top->ReadRegister("$branch_trace_head");
+  auto size_result = top->ReadRegister("$branch_trace_size");
+  if (!db_result.ok() || !head_result.ok() || !size_result.ok()) {
+    return "    (branch trace unavailable)\n";
+  }
+  auto *trace =
+      reinterpret_cast<BranchTraceEntry *>(db_result.value()->raw_ptr());
+  int size = static_cast<int>(size_result.value());
+  int head = static_cast<int>(head_result.value());
+  int window = std::min(size, kTraceWindow);
+  std::string output;
+  // Oldest entry first.
+  for (int i = window - 1; i >= 0; i--) {
+    auto const &entry = trace[(head - i + size) % size];
+    if (entry.count == 0) continue;
+    absl::StrAppend(&output, "    0x", absl::Hex(entry.from, absl::kZeroPad8),
+                    " -> 0x", absl::Hex(entry.to, absl::kZeroPad8), " (",
+                    entry.count, ")\n");
+  }
+  return output;
+}
+
+void CheriotLockstep::SetDivergence(const std::string &reason) {
+  diverged_ = true;
+  report_ = absl::StrCat("Lockstep divergence after ", num_instructions_,
+                         " instructions: ", reason, "\n");
+  for (auto const &difference : differences_) {
+    absl::StrAppend(&report_, "  ", difference, "\n");
+  }
+  for (auto *top : {top_, reference_}) {
+    absl::StrAppend(&report_, top == top_ ? "top" : "reference", ":\n");
+    auto pc = top->ReadRegister("pcc");
+    if (pc.ok()) {
+      auto disasm = top->GetDisassembly(pc.value());
+      absl::StrAppend(&report_, "  next: 0x",
+                      absl::Hex(pc.value(), absl::kZeroPad8), " ",
+                      disasm.ok() ? disasm.value() : "", "\n");
+    }
+    absl::StrAppend(&report_, "  branch trace:\n", TraceWindow(top));
+  }
+}
+
+}  // namespace cheriot
+}  // namespace sim
+}  // namespace mpact
@@ -0,0 +1,153 @@
+// Copyright 2024 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef MPACT_CHERIOT_CHERIOT_LOCKSTEP_H_
+#define MPACT_CHERIOT_CHERIOT_LOCKSTEP_H_
+
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "absl/container/btree_set.h"
+#include "absl/functional/function_ref.h"
+#include "absl/status/status.h"
+#include "cheriot/cheriot_address_ranges.h"
+#include "cheriot/cheriot_register.h"
+#include "cheriot/cheriot_state.h"
+#include "cheriot/cheriot_top.h"
+
+// This file defines a lockstep checker that runs two simulator instances on
+// the same program and compares their architectural state at regular
+// intervals. One instance (the top) uses the optimized configuration, such as
+// reserved host memory with in place atomic memory operations, and caches or
+// other models. The other (the reference) uses the default demand allocated
+// memory and no models. The reference should also have the fast paths of its
+// decoder (DisableFastPaths()) and the PMP decision cache disabled, so that
+// these are checked against the generic implementations. After every interval
+// both are stepped by the same number of instructions, and the following are
+// compared:
+//
+//   - All registers, including pcc, the special capability registers and, for
+//     capability registers, the full decoded capability.
+//   - The machine mode CSRs that are not counters.
+//   - Every 8 byte granule (data and tag) that either instance stored to since
+//     the last comparison.
+//
+// Semihosting calls are only performed by the top, so that host I/O, such as
+// console output, file writes and reads from stdin, is not repeated by the
+// reference. The result of each call on the top, i.e., a0 and any simulated
+// memory written by the call, is recorded and replayed when the reference
+// makes the same call. Only the calls without host I/O (exit, command line and
+// heap info) are performed by both.
+//
+// The first divergence stops the run, and is reported together with the
+// disassembly of the next instruction and the most recent branch trace
+// entries of both instances. Since the divergence can only be narrowed down
+// to an interval, an interval of 1 gives the exact instruction.
+
+namespace mpact {
+namespace sim {
+namespace cheriot {
+
+class CheriotLockstep {
+ public:
+  // Number of most recent branch trace entries that are reported.
+  static constexpr int kTraceWindow = 8;
+
+  // Neither top is owned by the checker.
+  CheriotLockstep(CheriotTop *top, CheriotTop *reference);
+  CheriotLockstep(const CheriotLockstep &) = delete;
+  CheriotLockstep &operator=(const CheriotLockstep &) = delete;
+  ~CheriotLockstep();
+
+  // Inserts a store tracker in front of the tagged and atomic memory
+  // interfaces of the state. This must be done for the states of both tops
+  // before running, after any other memory interfaces have been inserted.
+  void TrackStores(CheriotState *state);
+  // Stores to these address ranges are not compared, e.g., for memory mapped
+  // devices, where loads may have side effects.
+  void set_excluded_ranges(const CheriotAddressRanges &ranges) {
+    excluded_ranges_ = ranges;
+  }
+
+  // Steps both tops interval instructions at a time, and compares them after
+  // each interval, until the top halts, they diverge, or max_instructions
+  // (if non-zero) have been executed. An error is returned if either top
+  // fails to step. Divergences are not errors, but are reported by diverged()
+  // and report().
+  absl::Status Run(uint64_t interval, uint64_t max_instructions);
+  // Compares the state of the tops. Returns false and sets the report if they
+  // differ.
+  bool Compare();
+
+  // Called from the ebreak handlers of the top and the reference respectively
+  // for a semihosting call. perform makes the call. The top always makes the
+  // call and records its result. The reference only makes calls without host
+  // I/O, and otherwise replays the result recorded by the top.
+  void TopSemihostingCall(absl::FunctionRef<void()> perform);
+  void ReferenceSemihostingCall(absl::FunctionRef<void()> perform);
+
+  // Accessors.
+  bool diverged() const { return diverged_; }
+  const std::string &report() const { return report_; }
+  uint64_t num_instructions() const { return num_instructions_; }
+
+ private:
+  class StoreTracker;
+
+  // Result of a semihosting call made by the top.
+  struct SemihostingResult {
+    uint32_t operation;
+    // Copy of a0 after the call.
+    std::unique_ptr<CheriotRegister> a0;
+    // Simulated memory written by the call.
+    uint64_t address;
+    std::vector<uint8_t> data;
+  };
+
+  // Appends a line describing a difference to the report.
+  void AddDifference(const std::string &difference);
+  // Compares the registers, CSRs and stored memory respectively.
+  void CompareRegisters();
+  void CompareCsrs();
+  void CompareMemory();
+  // Returns the most recent branch trace entries of the top.
+  std::string TraceWindow(CheriotTop *top);
+  // Sets the report for a divergence.
+  void SetDivergence(const std::string &reason);
+
+  CheriotTop *top_;
+  CheriotTop *reference_;
+  std::vector<std::unique_ptr<StoreTracker>> trackers_;
+  CheriotAddressRanges excluded_ranges_;
+  // Addresses of the granules stored to since the last comparison.
+  absl::btree_set<uint64_t> stored_granules_;
+  std::vector<std::string> differences_;
+  // Semihosting results recorded by the top that the reference has yet to
+  // replay, and the first replay error since the last comparison.
+  std::deque<SemihostingResult> semihosting_results_;
+  std::string semihosting_error_;
+  uint64_t num_instructions_ = 0;
+  bool diverged_ = false;
+  std::string report_;
+};
+
+}  // namespace cheriot
+}  // namespace sim
+}  // namespace mpact
+
+#endif  // MPACT_CHERIOT_CHERIOT_LOCKSTEP_H_
@@ -0,0 +1,229 @@
+// Copyright 2024 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "cheriot/cheriot_memory_use_profiler.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <memory>
+#include <ostream>
+
+#include "absl/numeric/bits.h"
+#include "absl/strings/str_cat.h"
+#include "mpact/sim/generic/data_buffer.h"
+#include "mpact/sim/generic/instruction.h"
+#include "mpact/sim/generic/ref_count.h"
+#include "mpact/sim/util/memory/tagged_memory_interface.h"
+
+namespace mpact {
+namespace sim {
+namespace cheriot {
+
+namespace {
+
+// Returns a mask with bits first through last (inclusive) set.
+inline uint64_t BitRange(int first, int last) {
+  return (~uint64_t{0} >> (63 - last)) & (~uint64_t{0} << first);
+}
+
+}  // namespace
+
+CheriotMemoryUseProfiler::CheriotMemoryUseProfiler(
+    TaggedMemoryInterface *memory)
+    : memory_(memory) {}
+
+CheriotMemoryUseProfiler::~CheriotMemoryUseProfiler() = default;
+
+void CheriotMemoryUseProfiler::Load(uint64_t address, DataBuffer *db,
+                                    DataBuffer *tags, Instruction *inst,
+                                    ReferenceCount *context) {
+  if (is_enabled_) MarkUsed(address, db->size<uint8_t>());
+  memory_->Load(address, db, tags, inst, context);
+  // The loaded tags reflect the current state of memory.
+  if (is_enabled_ && (tags != nullptr)) {
+    UpdateTags(address, db->size<uint8_t>(), tags);
+  }
+}
+
+void CheriotMemoryUseProfiler::Load(uint64_t address, DataBuffer *db,
+                                    Instruction *inst,
+                                    ReferenceCount *context) {
+  if (is_enabled_) MarkUsed(address, db->size<uint8_t>());
+  memory_->Load(address, db, inst, context);
+}
+
+void CheriotMemoryUseProfiler::Load(DataBuffer *address_db,
+                                    DataBuffer *mask_db, int el_size,
+                                    DataBuffer *db, Instruction *inst,
+                                    ReferenceCount *context) {
+  if (is_enabled_) {
+    auto addresses = address_db->Get<uint64_t>();
+    auto mask = mask_db->Get<bool>();
+    for (int i = 0; i < addresses.size(); i++) {
+      if (mask[i]) MarkUsed(addresses[i], el_size);
+    }
+  }
+  memory_->Load(address_db, mask_db, el_size, db, inst, context);
+}
+
+void CheriotMemoryUseProfiler::Store(uint64_t address, DataBuffer *db,
+                                     DataBuffer *tags) {
+  if (is_enabled_) {
+    MarkUsed(address, db->size<uint8_t>());
+    UpdateTags(address, db->size<uint8_t>(), tags);
+  }
+  memory_->Store(address, db, tags);
+}
+
+void CheriotMemoryUseProfiler::Store(uint64_t address, DataBuffer *db) {
+  if (is_enabled_) {
+    MarkUsed(address, db->size<uint8_t>());
+    UpdateTags(address, db->size<uint8_t>(), nullptr);
+  }
+  memory_->Store(address, db);
+}
+
+void CheriotMemoryUseProfiler::Store(DataBuffer *address_db,
+                                     DataBuffer *mask_db, int el_size,
+                                     DataBuffer *db) {
+  if (is_enabled_) {
+    auto addresses = address_db->Get<uint64_t>();
+    auto mask = mask_db->Get<bool>();
+    for (int i = 0; i < addresses.size(); i++) {
+      if (!mask[i]) continue;
+      MarkUsed(addresses[i], el_size);
+      UpdateTags(addresses[i], el_size, nullptr);
+    }
+  }
+  memory_->Store(address_db, mask_db, el_size, db);
+}
+
+CheriotMemoryUseProfiler::Page *CheriotMemoryUseProfiler::GetPage(
+    uint64_t page_number) {
+  if (page_number == last_page_number_) return last_page_;
+  Page *page = nullptr;
+  PageTable *table = nullptr;
+  if (page_number < kNumTablePages) {
+    auto &entry = directory_[page_number >> kDirectoryShift];
+    if (entry == nullptr) {
+      entry = std::make_unique<PageTable>();
+      entry->fill(nullptr);
+    }
+    table = entry.get();
+    page = (*table)[page_number & (kDirectorySize - 1)];
+  } else {
+    auto iter = pages_.find(page_number);
+    if (iter != pages_.end()) page = iter->second.get();
+  }
+  if (page == nullptr) {
+    auto new_page = std::make_unique<Page>();
+    page = new_page.get();
+    pages_.emplace(page_number, std::move(new_page));
+    if (table != nullptr) (*table)[page_number & (kDirectorySize - 1)] = page;
+  }
+  last_page_number_ = page_number;
+  last_page_ = page;
+  return page;
+}
+
+void CheriotMemoryUseProfiler::MarkUsed(uint64_t address, int size) {
+  if (size <= 0) return;
+  uint64_t end = address + size;
+  while (address < end) {
+    uint64_t page_number = address >> kPageShift;
+    uint64_t page_end = std::min(end, (page_number + 1) << kPageShift);
+    Page *page = GetPage(page_number);
+    int first = (address & (kPageSize - 1)) >> kWordShift;
+    int last = ((page_end - 1) & (kPageSize - 1)) >> kWordShift;
+    // Accesses that are within a single 64 bit word of the bitmap (all but
+    // the largest vector accesses) take the first iteration only.
+    for (int word = first >> 6; word <= (last >> 6); word++) {
+      int lo = std::max(first, word << 6) & 63;
+      int hi = std::min(last, (word << 6) + 63) & 63;
+      page->used[word] |= BitRange(lo, hi);
+    }
+    address = page_end;
+  }
+}
+
+void CheriotMemoryUseProfiler::UpdateTags(uint64_t address, int size,
+                                          DataBuffer *tags) {
+  if (size <= 0) return;
+  uint64_t granule = address >> kGranuleShift;
+  uint64_t last_granule = (address + size - 1) >> kGranuleShift;
+  for (int i = 0; granule <= last_granule; granule++, i++) {
+    Page *page = GetPage(granule >> (kPageShift - kGranuleShift));
+    int index = granule & (kGranulesPerPage - 1);
+    uint64_t bit = uint64_t{1} << (index & 63);
+    bool valid = (tags != nullptr) && (i < tags->size<uint8_t>()) &&
+                 (tags->Get<uint8_t>(i) != 0);
+    if (valid) {
+      page->tags[index >> 6] |= bit;
+    } else {
+      page->tags[index >> 6] &= ~bit;
+    }
+  }
+}
+
+void CheriotMemoryUseProfiler::WriteProfile(std::ostream &os) {
+  bool in_range = false;
+  uint64_t range_start = 0;
+  uint64_t range_end = 0;
+  auto write_range = [&os](uint64_t start, uint64_t end) {
+    os << absl::StrCat("0x", absl::Hex(start, absl::kZeroPad8), " - 0x",
+                       absl::Hex(end - 1, absl::kZeroPad8), "\n");
+  };
+  for (auto const &[page_number, page] : pages_) {
+    uint64_t page_base = page_number << kPageShift;
+    for (int word = 0; word < page->used.size(); word++) {
+      uint64_t bits = page->used[word];
+      uint64_t word_base = page_base + ((uint64_t{64} * word) << kWordShift);
+      while (bits != 0) {
+        int start = absl::countr_zero(bits);
+        int length = absl::countr_one(bits >> start);
+        uint64_t start_address =
+            word_base + (static_cast<uint64_t>(start) << kWordShift);
+        uint64_t end_address =
+            start_address + (static_cast<uint64_t>(length) << kWordShift);
+        if (in_range && (start_address == range_end)) {
+          range_end = end_address;
+        } else {
+          if (in_range) write_range(range_start, range_end);
+          in_range = true;
+          range_start = start_address;
+          range_end = end_address;
+        }
+        bits = (start + length >= 64) ? 0 : bits & (~uint64_t{0}
+                                                    << (start + length));
+      }
+    }
+  }
+  if (in_range) write_range(range_start, range_end);
+}
+
+void CheriotMemoryUseProfiler::WriteTagHeatmap(std::ostream &os) {
+  os << "page,valid_capabilities\n";
+  for (auto const &[page_number, page] : pages_) {
+    int count = 0;
+    for (auto bits : page->tags) count += absl::popcount(bits);
+    if (count == 0) continue;
+    os << absl::StrCat("0x", absl::Hex(page_number << kPageShift,
+                                       absl::kZeroPad8),
+                       ",", count, "\n");
+  }
+}
+
+}  // namespace cheriot
+}  // namespace sim
+}  // namespace mpact
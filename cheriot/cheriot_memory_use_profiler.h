@@ -0,0 +1,123 @@
+// Copyright 2024 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef MPACT_CHERIOT_CHERIOT_MEMORY_USE_PROFILER_H_
+#define MPACT_CHERIOT_CHERIOT_MEMORY_USE_PROFILER_H_
+
+#include <array>
+#include <cstdint>
+#include <memory>
+#include <ostream>
+
+#include "absl/container/btree_map.h"
+#include "mpact/sim/generic/data_buffer.h"
+#include "mpact/sim/generic/instruction.h"
+#include "mpact/sim/generic/ref_count.h"
+#include "mpact/sim/util/memory/tagged_memory_interface.h"
+
+// This file defines a tagged memory interface that is inserted in front of
+// the data memory to record which memory locations are accessed by the
+// simulated program, and which capability granules hold valid capabilities.
+//
+// The profiler keeps a bitmap per 4KiB page of memory that has been accessed,
+// allocated the first time the page is touched. Recording an access is
+// typically a single shift-and-or into the page bitmap. Coalescing the used
+// memory into address ranges is only done when the profile is written.
+
+namespace mpact {
+namespace sim {
+namespace cheriot {
+
+using ::mpact::sim::generic::DataBuffer;
+using ::mpact::sim::generic::Instruction;
+using ::mpact::sim::generic::ReferenceCount;
+using ::mpact::sim::util::TaggedMemoryInterface;
+
+class CheriotMemoryUseProfiler : public TaggedMemoryInterface {
+ public:
+  // Page size and tracking granularities (log2 of the byte sizes).
+  static constexpr int kPageShift = 12;
+  static constexpr int kWordShift = 2;
+  static constexpr int kGranuleShift = 3;
+
+  explicit CheriotMemoryUseProfiler(TaggedMemoryInterface *memory);
+  CheriotMemoryUseProfiler(const CheriotMemoryUseProfiler &) = delete;
+  CheriotMemoryUseProfiler &operator=(const CheriotMemoryUseProfiler &) =
+      delete;
+  ~CheriotMemoryUseProfiler() override;
+
+  // TaggedMemoryInterface overrides. The accesses are recorded (if enabled)
+  // and forwarded to the memory interface.
+  void Load(uint64_t address, DataBuffer *db, DataBuffer *tags,
+            Instruction *inst, ReferenceCount *context) override;
+  void Load(uint64_t address, DataBuffer *db, Instruction *inst,
+            ReferenceCount *context) override;
+  void Load(DataBuffer *address_db, DataBuffer *mask_db, int el_size,
+            DataBuffer *db, Instruction *inst,
+            ReferenceCount *context) override;
+  void Store(uint64_t address, DataBuffer *db, DataBuffer *tags) override;
+  void Store(uint64_t address, DataBuffer *db) override;
+  void Store(DataBuffer *address_db, DataBuffer *mask_db, int el_size,
+             DataBuffer *db) override;
+
+  // Writes the used memory ranges, one range per line, in increasing address
+  // order.
+  void WriteProfile(std::ostream &os);
+  // Writes the number of valid capabilities in each page that has held a
+  // valid capability, in csv format.
+  void WriteTagHeatmap(std::ostream &os);
+
+  bool is_enabled() const { return is_enabled_; }
+  void set_is_enabled(bool is_enabled) { is_enabled_ = is_enabled; }
+
+ private:
+  static constexpr int kPageSize = 1 << kPageShift;
+  static constexpr int kWordsPerPage = kPageSize >> kWordShift;
+  static constexpr int kGranulesPerPage = kPageSize >> kGranuleShift;
+  // Pages below 4GiB are found through a two level table indexed by the page
+  // number. Pages above that are only found through the page map.
+  static constexpr int kDirectoryShift = 10;
+  static constexpr int kDirectorySize = 1 << kDirectoryShift;
+  static constexpr uint64_t kNumTablePages = uint64_t{1}
+                                             << (2 * kDirectoryShift);
+
+  struct Page {
+    std::array<uint64_t, kWordsPerPage / 64> used = {};
+    std::array<uint64_t, kGranulesPerPage / 64> tags = {};
+  };
+  using PageTable = std::array<Page *, kDirectorySize>;
+
+  // Returns the bitmaps for the page, allocating them if needed.
+  Page *GetPage(uint64_t page_number);
+  // Marks [address, address + size) as used.
+  void MarkUsed(uint64_t address, int size);
+  // Updates the valid capability bits for the granules covered by the access.
+  // If tags is nullptr, the tags are cleared (data store).
+  void UpdateTags(uint64_t address, int size, DataBuffer *tags);
+
+  TaggedMemoryInterface *memory_;
+  bool is_enabled_ = true;
+  // Most recently used page.
+  uint64_t last_page_number_ = ~uint64_t{0};
+  Page *last_page_ = nullptr;
+  std::array<std::unique_ptr<PageTable>, kDirectorySize> directory_;
+  // Owns the pages, ordered by page number.
+  absl::btree_map<uint64_t, std::unique_ptr<Page>> pages_;
+};
+
+}  // namespace cheriot
+}  // namespace sim
+}  // namespace mpact
+
+#endif  // MPACT_CHERIOT_CHERIOT_MEMORY_USE_PROFILER_H_
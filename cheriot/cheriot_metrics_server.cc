@@ -0,0 +1,232 @@
+// Copyright 2024 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "cheriot/cheriot_metrics_server.h"
+
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <thread>  // NOLINT: third party code.
+
+#include "absl/log/log.h"
+#include "absl/status/status.h"
+#include "absl/strings/ascii.h"
+#include "absl/strings/str_cat.h"
+#include "absl/strings/string_view.h"
+#include "absl/synchronization/notification.h"
+#include "absl/time/time.h"
+#include "mpact/sim/generic/component.h"
+#include "mpact/sim/proto/component_data.pb.h"
+#include "src/google/protobuf/text_format.h"
+
+namespace mpact {
+namespace sim {
+namespace cheriot {
+
+namespace {
+
+// How long the simulation thread is given to take a snapshot before the
+// server assumes it isn't advancing and takes the snapshot itself.
+constexpr absl::Duration kSnapshotTimeout = absl::Milliseconds(100);
+// How often the server checks whether it has been stopped.
+constexpr int kPollIntervalMs = 100;
+// How long to wait for a client to send its request.
+constexpr int kRequestTimeoutMs = 1000;
+constexpr int kMaxRequestSize = 64;
+
+std::string MetricName(absl::string_view name) {
+  std::string metric(name);
+  for (auto &c : metric) {
+    if (!absl::ascii_isalnum(c) && (c != '_') && (c != ':')) c = '_';
+  }
+  if (metric.empty() || absl::ascii_isdigit(metric[0])) {
+    metric.insert(0, "_");
+  }
+  return metric;
+}
+
+void AppendPrometheus(const ComponentData &data, absl::string_view prefix,
+                      std::string &output) {
+  std::string path = prefix.empty() ? MetricName(data.name())
+                                    : absl::StrCat(prefix, "_",
+                                                   MetricName(data.name()));
+  for (auto const &entry : data.statistics()) {
+    std::string name = absl::StrCat(path, "_", MetricName(entry.name()));
+    if (entry.has_uint64_value()) {
+      absl::StrAppend(&output, name, " ", entry.uint64_value(), "\n");
+    } else if (entry.has_sint64_value()) {
+      absl::StrAppend(&output, name, " ", entry.sint64_value(), "\n");
+    } else if (entry.has_double_value()) {
+      absl::StrAppend(&output, name, " ", entry.double_value(), "\n");
+    } else if (entry.has_bool_value()) {
+      absl::StrAppend(&output, name, " ", entry.bool_value() ? 1 : 0, "\n");
+    }
+    // Other (string) values can't be represented as samples.
+  }
+  for (auto const &child : data.component_data()) {
+    AppendPrometheus(child, path, output);
+  }
+}
+
+// Write all of the buffer to the file descriptor.
+bool WriteAll(int fd, absl::string_view buffer) {
+  while (!buffer.empty()) {
+    ssize_t count = send(fd, buffer.data(), buffer.size(), MSG_NOSIGNAL);
+    if (count < 0) {
+      if (errno == EINTR) continue;
+      return false;
+    }
+    buffer.remove_prefix(count);
+  }
+  return true;
+}
+
+}  // namespace
+
+CheriotMetricsServer::CheriotMetricsServer(Component *root) : root_(root) {}
+
+CheriotMetricsServer::~CheriotMetricsServer() { Stop(); }
+
+absl::Status CheriotMetricsServer::Start(const std::string &socket_path) {
+  if (listen_fd_ >= 0) {
+    return absl::FailedPreconditionError("Metrics server already started");
+  }
+  sockaddr_un addr;
+  std::memset(&addr, 0, sizeof(addr));
+  addr.sun_family = AF_UNIX;
+  if (socket_path.empty() || (socket_path.size() >= sizeof(addr.sun_path))) {
+    return absl::InvalidArgumentError(
+        absl::StrCat("Invalid metrics socket path: '", socket_path, "'"));
+  }
+  std::memcpy(addr.sun_path, socket_path.data(), socket_path.size());
+  int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+  if (fd < 0) {
+    return absl::InternalError(
+        absl::StrCat("Unable to create metrics socket: ", strerror(errno)));
+  }
+  unlink(socket_path.c_str());
+  if ((bind(fd, reinterpret_cast<sockaddr *>(&addr), sizeof(addr)) != 0) ||
+      (listen(fd, 4) != 0)) {
+    auto status = absl::InternalError(absl::StrCat(
+        "Unable to listen on '", socket_path, "': ", strerror(errno)));
+    close(fd);
+    return status;
+  }
+  listen_fd_ = fd;
+  socket_path_ = socket_path;
+  stop_ = false;
+  server_thread_ = std::thread([this]() { Serve(); });
+  return absl::OkStatus();
+}
+
+void CheriotMetricsServer::Stop() {
+  if (listen_fd_ < 0) return;
+  stop_ = true;
+  server_thread_.join();
+  close(listen_fd_);
+  listen_fd_ = -1;
+  unlink(socket_path_.c_str());
+}
+
+void CheriotMetricsServer::Serve() {
+  pollfd pfd = {listen_fd_, POLLIN, 0};
+  while (!stop_) {
+    int res = poll(&pfd, 1, kPollIntervalMs);
+    if (res <= 0) continue;
+    int fd = accept4(listen_fd_, nullptr, nullptr, SOCK_CLOEXEC);
+    if (fd < 0) continue;
+    HandleConnection(fd);
+    close(fd);
+  }
+}
+
+void CheriotMetricsServer::HandleConnection(int fd) {
+  // Read the request line, if any. A client that just connects and reads gets
+  // the default format once the request times out.
+  std::string request;
+  pollfd pfd = {fd, POLLIN, 0};
+  char buffer[kMaxRequestSize];
+  while ((request.size() < kMaxRequestSize) &&
+         (request.find('\n') == std::string::npos) &&
+         (poll(&pfd, 1, kRequestTimeoutMs) > 0)) {
+    ssize_t count = recv(fd, buffer, sizeof(buffer), 0);
+    if (count <= 0) break;
+    request.append(buffer, count);
+  }
+  request = std::string(absl::StripAsciiWhitespace(request));
+
+  ComponentData data;
+  auto status = Snapshot(&data);
+  if (!status.ok()) {
+    (void)WriteAll(fd, absl::StrCat("# error: ", status.message(), "\n"));
+    return;
+  }
+  std::string output;
+  if (request == "proto") {
+    if (!google::protobuf::TextFormat::PrintToString(data, &output)) {
+      output = "# error: unable to print proto\n";
+    }
+  } else {
+    output = ToPrometheus(data);
+  }
+  if (!WriteAll(fd, output)) {
+    LOG(WARNING) << "Unable to write metrics: " << strerror(errno);
+  }
+}
+
+absl::Status CheriotMetricsServer::Snapshot(ComponentData *data) {
+  absl::Notification done;
+  request_data_ = data;
+  request_done_ = &done;
+  snapshot_requested_ = true;
+  if (done.WaitForNotificationWithTimeout(kSnapshotTimeout)) {
+    return request_status_;
+  }
+  // If the request is still pending, the simulation isn't advancing, so
+  // withdraw it. The counters are only exported directly if the simulation is
+  // halted, as they could otherwise be updated while being exported.
+  // Otherwise the simulation thread has just picked it up, so wait for it to
+  // finish.
+  if (snapshot_requested_.exchange(false)) {
+    if ((is_halted_ != nullptr) && is_halted_()) return root_->Export(data);
+    return absl::UnavailableError(
+        "Snapshot unavailable: simulation is not advancing or halted");
+  }
+  done.WaitForNotification();
+  return request_status_;
+}
+
+void CheriotMetricsServer::TakeSnapshot() {
+  // The server may have withdrawn the request in the meantime.
+  if (!snapshot_requested_.exchange(false)) return;
+  request_status_ = root_->Export(request_data_);
+  request_done_->Notify();
+}
+
+std::string CheriotMetricsServer::ToPrometheus(const ComponentData &data) {
+  std::string output;
+  AppendPrometheus(data, "", output);
+  return output;
+}
+
+}  // namespace cheriot
+}  // namespace sim
+}  // namespace mpact
@@ -0,0 +1,115 @@
+// Copyright 2024 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef MPACT_CHERIOT_CHERIOT_METRICS_SERVER_H_
+#define MPACT_CHERIOT_CHERIOT_METRICS_SERVER_H_
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <thread>  // NOLINT: third party code.
+#include <utility>
+
+#include "absl/functional/any_invocable.h"
+#include "absl/status/status.h"
+#include "absl/synchronization/notification.h"
+#include "mpact/sim/generic/component.h"
+#include "mpact/sim/generic/counters.h"
+#include "mpact/sim/proto/component_data.pb.h"
+
+// This file defines a server that makes the statistics counters of a component
+// hierarchy available while the simulation is running. It listens on a Unix
+// domain socket, and for each connection reads an optional one line request,
+// writes a snapshot of the counters and closes the connection. The request
+// "proto" returns the snapshot as a text format ComponentData proto (the same
+// format as the counter file written at exit), anything else returns it in the
+// Prometheus text exposition format, e.g.:
+//
+//   socat - UNIX-CONNECT:/tmp/cheriot.sock
+//
+// The counters are updated by the simulation thread without any locking, so
+// snapshots are taken by the simulation thread itself. The server is added as
+// a listener to a counter that is incremented every cycle, and when a snapshot
+// has been requested, the next increment exports the counters at that cycle
+// boundary. If the simulation isn't advancing, the server takes the snapshot
+// itself after a short timeout, but only if the is_halted callback reports
+// that the simulation is halted, as the counters may otherwise be updated
+// while they are exported. If not, the request is answered with an error.
+
+namespace mpact {
+namespace sim {
+namespace cheriot {
+
+using ::mpact::sim::generic::Component;
+using ::mpact::sim::generic::CounterValueSetInterface;
+using ::mpact::sim::proto::ComponentData;
+
+class CheriotMetricsServer : public CounterValueSetInterface<uint64_t> {
+ public:
+  // The root component is not owned by the server.
+  explicit CheriotMetricsServer(Component *root);
+  CheriotMetricsServer(const CheriotMetricsServer &) = delete;
+  CheriotMetricsServer &operator=(const CheriotMetricsServer &) = delete;
+  ~CheriotMetricsServer() override;
+
+  // Start serving on a Unix domain socket at the given path. Any existing
+  // file at that path is removed first.
+  absl::Status Start(const std::string &socket_path);
+  // Stop the server and remove the socket. Called by the destructor.
+  void Stop();
+  // Set the callback that returns true when the simulation is halted, so that
+  // the server may export the counters itself. Must be set before Start().
+  void set_is_halted(absl::AnyInvocable<bool()> is_halted) {
+    is_halted_ = std::move(is_halted);
+  }
+
+  // CounterValueSetInterface override. Called by the per-cycle counter from
+  // the simulation thread.
+  void SetValue(const uint64_t &value) override {
+    if (snapshot_requested_.load(std::memory_order_relaxed)) TakeSnapshot();
+  }
+
+  // Format the counters in the component data in the Prometheus text format.
+  // Each counter is named by its component path and name, with characters not
+  // allowed in Prometheus metric names replaced by '_'.
+  static std::string ToPrometheus(const ComponentData &data);
+
+ private:
+  // Server thread main loop.
+  void Serve();
+  void HandleConnection(int fd);
+  // Obtain a consistent snapshot of the counters.
+  absl::Status Snapshot(ComponentData *data);
+  // Called from the simulation thread to service a snapshot request.
+  void TakeSnapshot();
+
+  Component *root_;
+  absl::AnyInvocable<bool()> is_halted_;
+  std::string socket_path_;
+  int listen_fd_ = -1;
+  std::thread server_thread_;
+  std::atomic<bool> stop_ = false;
+  // Snapshot request state. The request fields are written by the server
+  // thread before snapshot_requested_ is set.
+  std::atomic<bool> snapshot_requested_ = false;
+  ComponentData *request_data_ = nullptr;
+  absl::Status request_status_;
+  absl::Notification *request_done_ = nullptr;
+};
+
+}  // namespace cheriot
+}  // namespace sim
+}  // namespace mpact
+
+#endif  // MPACT_CHERIOT_CHERIOT_METRICS_SERVER_H_
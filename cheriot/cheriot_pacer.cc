@@ -0,0 +1,104 @@
+// Copyright 2024 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "cheriot/cheriot_pacer.h"
+
+#include <chrono>  // NOLINT: steady_clock is needed for pacing.
+#include <cstdint>
+#include <thread>  // NOLINT: sleep_until is needed for pacing.
+
+#include "absl/status/status.h"
+#include "mpact/sim/generic/component.h"
+#include "mpact/sim/generic/counters.h"
+
+namespace mpact {
+namespace sim {
+namespace cheriot {
+
+namespace {
+
+uint64_t ToUsec(CheriotPacer::Clock::duration duration) {
+  return std::chrono::duration_cast<std::chrono::microseconds>(duration)
+      .count();
+}
+
+}  // namespace
+
+CheriotPacer::CheriotPacer(double frequency, uint64_t max_lag_usec)
+    : frequency_(frequency),
+      max_lag_(std::chrono::microseconds(max_lag_usec)),
+      num_quanta_("pacing_quanta", 0),
+      num_late_quanta_("pacing_late_quanta", 0),
+      num_resyncs_("pacing_resyncs", 0),
+      sleep_usec_("pacing_sleep_usec", 0),
+      max_lag_usec_("pacing_max_lag_usec", 0),
+      max_oversleep_usec_("pacing_max_oversleep_usec", 0) {}
+
+absl::Status CheriotPacer::AddCounters(generic::Component *component) {
+  for (auto *counter : {&num_quanta_, &num_late_quanta_, &num_resyncs_,
+                        &sleep_usec_, &max_lag_usec_, &max_oversleep_usec_}) {
+    auto status = component->AddCounter(counter);
+    if (!status.ok()) return status;
+  }
+  return absl::OkStatus();
+}
+
+void CheriotPacer::Start(uint64_t cycles) {
+  start_time_ = Clock::now();
+  start_cycles_ = cycles;
+  started_ = true;
+}
+
+CheriotPacer::Clock::time_point CheriotPacer::DueTime(uint64_t cycles) const {
+  double seconds = static_cast<double>(cycles - start_cycles_) / frequency_;
+  return start_time_ + std::chrono::duration_cast<Clock::duration>(
+                           std::chrono::duration<double>(seconds));
+}
+
+void CheriotPacer::Pace(uint64_t cycles) {
+  if (!started_ || (cycles < start_cycles_)) {
+    Start(cycles);
+    return;
+  }
+  num_quanta_.Increment(1);
+  auto now = Clock::now();
+  auto due = DueTime(cycles);
+  if (due <= now) {
+    // Behind the target. Make up for it in the following quanta, unless it
+    // is too far behind.
+    auto lag = now - due;
+    num_late_quanta_.Increment(1);
+    uint64_t lag_usec = ToUsec(lag);
+    if (lag_usec > max_lag_usec_.GetValue()) max_lag_usec_.SetValue(lag_usec);
+    if (lag > max_lag_) {
+      num_resyncs_.Increment(1);
+      Start(cycles);
+    }
+    return;
+  }
+  if (due - now < kMinSleep) return;
+  std::this_thread::sleep_until(due);
+  auto wake = Clock::now();
+  sleep_usec_.Increment(ToUsec(wake - now));
+  if (wake > due) {
+    uint64_t oversleep_usec = ToUsec(wake - due);
+    if (oversleep_usec > max_oversleep_usec_.GetValue()) {
+      max_oversleep_usec_.SetValue(oversleep_usec);
+    }
+  }
+}
+
+}  // namespace cheriot
+}  // namespace sim
+}  // namespace mpact
@@ -0,0 +1,96 @@
+// Copyright 2024 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef MPACT_CHERIOT_CHERIOT_PACER_H_
+#define MPACT_CHERIOT_CHERIOT_PACER_H_
+
+#include <chrono>  // NOLINT: steady_clock is needed for pacing.
+#include <cstdint>
+
+#include "absl/status/status.h"
+#include "mpact/sim/generic/component.h"
+#include "mpact/sim/generic/counters.h"
+
+// This file defines a pacer that throttles a simulation to a target simulated
+// clock frequency, e.g., so that devices driven through a pty or socket uart
+// see realistic timing. It is called at the end of each quantum of simulation
+// with the current cycle count, and sleeps until the host monotonic clock
+// catches up with the simulated time of that cycle. No per instruction checks
+// are needed.
+//
+// If the simulation falls behind the target by more than the maximum lag
+// (e.g., because it was stopped in a debugger), the pacer resynchronizes
+// instead of running flat out until it has caught up.
+
+namespace mpact {
+namespace sim {
+namespace cheriot {
+
+class CheriotPacer {
+ public:
+  using Clock = std::chrono::steady_clock;
+  static constexpr uint64_t kDefaultMaxLagUsec = 100'000;
+
+  // The frequency is in Hz. Lags up to max_lag_usec are made up for.
+  CheriotPacer(double frequency, uint64_t max_lag_usec);
+  CheriotPacer(const CheriotPacer &) = delete;
+  CheriotPacer &operator=(const CheriotPacer &) = delete;
+
+  // Add the pacing counters to the component.
+  absl::Status AddCounters(generic::Component *component);
+
+  // Starts pacing from the given cycle count at the current host time.
+  void Start(uint64_t cycles);
+  // Called at the end of a quantum. Sleeps until the simulated time of the
+  // cycle count, if it is ahead of the host time.
+  void Pace(uint64_t cycles);
+
+  // Accessors.
+  double frequency() const { return frequency_; }
+  uint64_t num_quanta() const { return num_quanta_.GetValue(); }
+  uint64_t num_late_quanta() const { return num_late_quanta_.GetValue(); }
+  uint64_t num_resyncs() const { return num_resyncs_.GetValue(); }
+  uint64_t sleep_usec() const { return sleep_usec_.GetValue(); }
+  uint64_t max_lag_usec() const { return max_lag_usec_.GetValue(); }
+  uint64_t max_oversleep_usec() const {
+    return max_oversleep_usec_.GetValue();
+  }
+
+ private:
+  // Sleeps shorter than this are skipped, as they are dominated by the sleep
+  // overhead. The time is made up in the next quantum.
+  static constexpr auto kMinSleep = std::chrono::microseconds(50);
+
+  // Returns the host time at which the cycle count is due.
+  Clock::time_point DueTime(uint64_t cycles) const;
+
+  double frequency_;
+  Clock::duration max_lag_;
+  Clock::time_point start_time_;
+  uint64_t start_cycles_ = 0;
+  bool started_ = false;
+  // Drift statistics.
+  generic::SimpleCounter<uint64_t> num_quanta_;
+  generic::SimpleCounter<uint64_t> num_late_quanta_;
+  generic::SimpleCounter<uint64_t> num_resyncs_;
+  generic::SimpleCounter<uint64_t> sleep_usec_;
+  generic::SimpleCounter<uint64_t> max_lag_usec_;
+  generic::SimpleCounter<uint64_t> max_oversleep_usec_;
+};
+
+}  // namespace cheriot
+}  // namespace sim
+}  // namespace mpact
+
+#endif  // MPACT_CHERIOT_CHERIOT_PACER_H_
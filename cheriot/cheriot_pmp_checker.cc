@@ -0,0 +1,161 @@
+// Copyright 2024 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "cheriot/cheriot_pmp_checker.h"
+
+#include <cstdint>
+
+#include "absl/log/check.h"
+#include "absl/numeric/bits.h"
+#include "cheriot/riscv_cheriot_csr_enum.h"
+#include "mpact/sim/generic/type_helpers.h"
+#include "riscv//riscv_csr.h"
+#include "riscv//riscv_state.h"
+
+namespace mpact {
+namespace sim {
+namespace cheriot {
+
+using ::mpact::sim::generic::operator*;  // NOLINT: is used below (clang error).
+
+namespace {
+
+// Fields of a pmpcfg entry.
+constexpr uint8_t kPermissionMask = 0b111;
+constexpr int kAddressModeShift = 3;
+constexpr uint8_t kAddressModeMask = 0b11;
+constexpr uint8_t kLock = 0x80;
+
+// Address matching modes.
+constexpr uint8_t kOff = 0;
+constexpr uint8_t kTor = 1;
+constexpr uint8_t kNa4 = 2;
+constexpr uint8_t kNapot = 3;
+
+}  // namespace
+
+CheriotPmpChecker::CheriotPmpChecker(RiscVCsrSet *csr_set) {
+  for (int i = 0; i < cfg_csrs_.size(); i++) {
+    auto res = csr_set->GetCsr(*RiscVCheriotCsrEnum::kPmpCfg0 + i);
+    CHECK_OK(res.status());
+    cfg_csrs_[i] = res.value();
+  }
+  for (int i = 0; i < addr_csrs_.size(); i++) {
+    auto res = csr_set->GetCsr(*RiscVCheriotCsrEnum::kPmpAddr0 + i);
+    CHECK_OK(res.status());
+    addr_csrs_[i] = res.value();
+  }
+}
+
+bool CheriotPmpChecker::IsPmpCsr(int csr_index) {
+  return (csr_index >= *RiscVCheriotCsrEnum::kPmpCfg0) &&
+         (csr_index <= *RiscVCheriotCsrEnum::kPmpAddr15);
+}
+
+void CheriotPmpChecker::Invalidate() {
+  stale_ = true;
+  for (auto &entry : cache_) entry.tag = kInvalidTag;
+}
+
+void CheriotPmpChecker::Refresh() {
+  stale_ = false;
+  uint64_t prev_addr = 0;
+  for (int i = 0; i < kNumEntries; i++) {
+    cfg_[i] = (cfg_csrs_[i >> 2]->GetUint32() >> ((i & 3) * 8)) & 0xff;
+    uint64_t addr = addr_csrs_[i]->GetUint32();
+    lo_[i] = 0;
+    hi_[i] = 0;
+    switch ((cfg_[i] >> kAddressModeShift) & kAddressModeMask) {
+      case kOff:
+        break;
+      case kTor:
+        lo_[i] = prev_addr << 2;
+        hi_[i] = addr << 2;
+        break;
+      case kNa4:
+        lo_[i] = addr << 2;
+        hi_[i] = lo_[i] + 4;
+        break;
+      case kNapot: {
+        // The number of trailing ones encodes the size of the region.
+        int ones = absl::countr_one(static_cast<uint32_t>(addr));
+        uint64_t size = uint64_t{8} << ones;
+        lo_[i] = (addr << 2) & ~(size - 1);
+        hi_[i] = lo_[i] + size;
+        break;
+      }
+    }
+    prev_addr = addr;
+  }
+}
+
+uint8_t CheriotPmpChecker::EntryPermissions(int entry,
+                                            PrivilegeMode mode) const {
+  // Machine mode accesses are only checked against locked entries.
+  if ((mode == PrivilegeMode::kMachine) && !(cfg_[entry] & kLock)) {
+    return kPermissionMask;
+  }
+  return cfg_[entry] & kPermissionMask;
+}
+
+uint8_t CheriotPmpChecker::Permissions(uint64_t address, uint64_t size,
+                                       PrivilegeMode mode,
+                                       bool *uniform) const {
+  uint64_t end = address + size;
+  for (int i = 0; i < kNumEntries; i++) {
+    if ((lo_[i] >= hi_[i]) || (hi_[i] <= address) || (lo_[i] >= end)) {
+      continue;
+    }
+    // The first matching entry determines the permissions, but the access
+    // fails if it is only partially covered by the entry.
+    if ((lo_[i] <= address) && (hi_[i] >= end)) {
+      return EntryPermissions(i, mode);
+    }
+    if (uniform != nullptr) *uniform = false;
+    return 0;
+  }
+  // If no entry matches, only machine mode accesses are permitted.
+  return mode == PrivilegeMode::kMachine ? kPermissionMask : 0;
+}
+
+bool CheriotPmpChecker::CheckSlow(uint64_t address, int size,
+                                  PrivilegeMode mode, Access access) {
+  if (!cache_enabled_) {
+    Refresh();
+    uint8_t permissions = Permissions(address, size, mode, nullptr);
+    return (permissions & static_cast<uint8_t>(access)) != 0;
+  }
+  if (stale_) Refresh();
+  uint64_t page = address >> kPageShift;
+  if (((address + size - 1) >> kPageShift) == page) {
+    // Compute the decision for the whole page. If it is the same for every
+    // byte in the page, cache it.
+    bool uniform = true;
+    uint8_t permissions =
+        Permissions(page << kPageShift, uint64_t{1} << kPageShift, mode,
+                    &uniform);
+    if (uniform) {
+      auto &entry = cache_[page & (kCacheSize - 1)];
+      entry.tag = Tag(page, mode);
+      entry.permissions = permissions;
+      return (permissions & static_cast<uint8_t>(access)) != 0;
+    }
+  }
+  uint8_t permissions = Permissions(address, size, mode, nullptr);
+  return (permissions & static_cast<uint8_t>(access)) != 0;
+}
+
+}  // namespace cheriot
+}  // namespace sim
+}  // namespace mpact
@@ -0,0 +1,124 @@
+// Copyright 2024 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef MPACT_CHERIOT_CHERIOT_PMP_CHECKER_H_
+#define MPACT_CHERIOT_CHERIOT_PMP_CHECKER_H_
+
+#include <array>
+#include <cstdint>
+
+#include "riscv//riscv_csr.h"
+#include "riscv//riscv_state.h"
+
+// This file defines the class used to check loads, stores and instruction
+// fetches against the physical memory protection (PMP) configuration in the
+// pmpcfg and pmpaddr CSRs.
+//
+// Scanning all 16 PMP entries for every access is expensive, so the decision
+// for a 4KiB page is cached for the privilege mode the access was made in,
+// provided that the page lies entirely within the highest priority matching
+// PMP region (or in no region at all). The cache must be invalidated by
+// calling Invalidate() whenever a pmpcfg or pmpaddr CSR is written. With the
+// cache disabled, e.g., for a lockstep reference, the CSRs are decoded and all
+// entries are scanned for every access.
+
+namespace mpact {
+namespace sim {
+namespace cheriot {
+
+using ::mpact::sim::riscv::PrivilegeMode;
+using ::mpact::sim::riscv::RiscVCsrInterface;
+using ::mpact::sim::riscv::RiscVCsrSet;
+
+class CheriotPmpChecker {
+ public:
+  // Access types. The values match the permission bits in pmpcfg.
+  enum class Access : uint8_t {
+    kRead = 0b001,
+    kWrite = 0b010,
+    kExecute = 0b100,
+  };
+
+  static constexpr int kNumEntries = 16;
+  static constexpr int kPageShift = 12;
+  static constexpr int kCacheSize = 64;
+
+  // The PMP CSRs must already have been added to the csr set.
+  explicit CheriotPmpChecker(RiscVCsrSet *csr_set);
+  CheriotPmpChecker(const CheriotPmpChecker &) = delete;
+  CheriotPmpChecker &operator=(const CheriotPmpChecker &) = delete;
+
+  // Returns true if the access of size bytes at address is permitted.
+  bool Check(uint64_t address, int size, PrivilegeMode mode, Access access) {
+    uint64_t page = address >> kPageShift;
+    if (((address + size - 1) >> kPageShift) == page) {
+      auto const &entry = cache_[page & (kCacheSize - 1)];
+      if (entry.tag == Tag(page, mode)) {
+        return (entry.permissions & static_cast<uint8_t>(access)) != 0;
+      }
+    }
+    return CheckSlow(address, size, mode, access);
+  }
+
+  // Invalidates the cached decisions. Must be called after any write to a
+  // pmpcfg or pmpaddr CSR.
+  void Invalidate();
+  // Enables or disables the caching of decisions and decoded CSRs.
+  void set_cache_enabled(bool value) {
+    cache_enabled_ = value;
+    Invalidate();
+  }
+
+  // Returns true if the csr index is that of a pmpcfg or pmpaddr CSR.
+  static bool IsPmpCsr(int csr_index);
+
+ private:
+  struct CacheEntry {
+    uint64_t tag = kInvalidTag;
+    uint8_t permissions = 0;
+  };
+  static constexpr uint64_t kInvalidTag = ~uint64_t{0};
+  static uint64_t Tag(uint64_t page, PrivilegeMode mode) {
+    return (page << 2) | static_cast<uint64_t>(mode);
+  }
+
+  bool CheckSlow(uint64_t address, int size, PrivilegeMode mode,
+                 Access access);
+  // Reads the PMP CSRs and computes the address range of each entry.
+  void Refresh();
+  // Returns the permissions of the highest priority entry that matches the
+  // address range [address, address + size), or the default permissions if
+  // no entry matches. If uniform is non-null, it is set to false if the
+  // permissions are not the same for every byte in the range.
+  uint8_t Permissions(uint64_t address, uint64_t size, PrivilegeMode mode,
+                      bool *uniform) const;
+  // Permissions of a matching entry for the given privilege mode.
+  uint8_t EntryPermissions(int entry, PrivilegeMode mode) const;
+
+  std::array<RiscVCsrInterface *, kNumEntries / 4> cfg_csrs_;
+  std::array<RiscVCsrInterface *, kNumEntries> addr_csrs_;
+  // Decoded entries. An entry matches [lo_, hi_) if lo_ < hi_.
+  bool stale_ = true;
+  bool cache_enabled_ = true;
+  std::array<uint8_t, kNumEntries> cfg_;
+  std::array<uint64_t, kNumEntries> lo_;
+  std::array<uint64_t, kNumEntries> hi_;
+  std::array<CacheEntry, kCacheSize> cache_;
+};
+
+}  // namespace cheriot
+}  // namespace sim
+}  // namespace mpact
+
+#endif  // MPACT_CHERIOT_CHERIOT_PMP_CHECKER_H_
@@ -64,10 +64,10 @@ void CheriotRegister::ResetMemoryRoot() {
   set_object_type(kUnsealed);
   set_reserved(0);
   set_tag(true);
-  is_dirty_ = true;
-  is_null_ = false;
-  exponent_ = 24;
-  raw_ = Compress();
+  cap_.is_dirty = true;
+  cap_.is_null = false;
+  cap_.exponent = 24;
+  cap_.raw = Compress();
 }
 
 void CheriotRegister::ResetExecuteRoot() {
@@ -80,10 +80,10 @@ void CheriotRegister::ResetExecuteRoot() {
   set_object_type(kUnsealed);
   set_reserved(0);
   set_tag(true);
-  is_dirty_ = true;
-  is_null_ = false;
-  exponent_ = 24;
-  raw_ = Compress();
+  cap_.is_dirty = true;
+  cap_.is_null = false;
+  cap_.exponent = 24;
+  cap_.raw = Compress();
 }
 
 void CheriotRegister::ResetSealingRoot() {
@@ -94,10 +94,10 @@ void CheriotRegister::ResetSealingRoot() {
   set_object_type(kUnsealed);
   set_reserved(0);
   set_tag(true);
-  is_dirty_ = true;
-  is_null_ = false;
-  exponent_ = 24;
-  raw_ = Compress();
+  cap_.is_dirty = true;
+  cap_.is_null = false;
+  cap_.exponent = 24;
+  cap_.raw = Compress();
 }
 
 void CheriotRegister::Clear() {
@@ -108,10 +108,10 @@ void CheriotRegister::Clear() {
   set_object_type(kUnsealed);
   set_reserved(0);
   set_tag(false);
-  is_dirty_ = true;
-  is_null_ = false;
-  raw_ = 0;
-  exponent_ = 0;
+  cap_.is_dirty = true;
+  cap_.is_null = false;
+  cap_.raw = 0;
+  cap_.exponent = 0;
 }
 
 void CheriotRegister::ClearPermissions(uint32_t permission_bits) {
@@ -120,9 +120,9 @@ void CheriotRegister::ClearPermissions(uint32_t permission_bits) {
 }
 
 bool CheriotRegister::SetBounds(uint32_t req_base, uint64_t req_length) {
-  if (is_null_) {
+  if (cap_.is_null) {
     Expand(address(), 0, /*tag=*/false);
-    is_null_ = false;
+    cap_.is_null = false;
   }
   // Compute the requested top based on base and length.
   uint64_t new_top = static_cast<uint64_t>(req_base) + req_length;
@@ -138,8 +138,8 @@ bool CheriotRegister::SetBounds(uint32_t req_base, uint64_t req_length) {
   if (exp == 0) {
     set_base(req_base);
     set_top(req_base + req_length);
-    exponent_ = 0;
-    raw_ = Compress();
+    cap_.exponent = 0;
+    cap_.raw = Compress();
     return true; /* exact */
   }
 
@@ -160,7 +160,7 @@ bool CheriotRegister::SetBounds(uint32_t req_base, uint64_t req_length) {
     new_exp = 23 - absl::countl_zero(static_cast<uint32_t>(new_length) | 0x1ff);
     if (new_exp > 14) new_exp = 24;
   }
-  exponent_ = new_exp;
+  cap_.exponent = new_exp;
   // Check if the rounding of base and top increased the length so much that it
   // now requires a larger exponent. If so, recompute base and top. This can
   // only happen once, so no need to recheck.
@@ -178,7 +178,7 @@ bool CheriotRegister::SetBounds(uint32_t req_base, uint64_t req_length) {
   // Set the top and base.
   set_top(new_top);
   set_base(new_base);
-  raw_ = Compress();
+  cap_.raw = Compress();
   // If the address is not in bounds, clear the tag.
   if ((address() > top()) || (address() < base())) Invalidate();
   // If the length and the base are the same as requested, the bounds were
@@ -187,27 +187,29 @@ bool CheriotRegister::SetBounds(uint32_t req_base, uint64_t req_length) {
 }
 
 std::pair<uint32_t, uint64_t> CheriotRegister::ComputeBounds() {
-  if (is_null_) {
+  if (cap_.is_null) {
     Expand(address(), 0, /*tag=*/false);
   }
-  uint64_t base_bits = raw_ & 0x1ff;
-  uint64_t top_bits = (raw_ >> 9) & 0x1ff;
-  uint64_t a_mid = (address() >> exponent_) & 0x1ff;
+  uint64_t base_bits = cap_.raw & 0x1ff;
+  uint64_t top_bits = (cap_.raw >> 9) & 0x1ff;
+  uint64_t a_mid = (address() >> cap_.exponent) & 0x1ff;
   uint64_t a_hi = (a_mid < base_bits ? 1 : 0);
   uint64_t t_hi = top_bits < base_bits ? 1 : 0;
   uint64_t c_b = 0 - a_hi;
   uint64_t c_t = t_hi - a_hi;
   uint64_t address64 = address();
-  uint64_t a_top = address64 >> (exponent_ + 9);
-  uint64_t base = ((a_top + c_b) << (exponent_ + 9)) | (base_bits << exponent_);
+  uint64_t a_top = address64 >> (cap_.exponent + 9);
+  uint64_t base = ((a_top + c_b) << (cap_.exponent + 9)) |
+                  (base_bits << cap_.exponent);
   base &= 0xffff'ffff;
-  uint64_t top = ((a_top + c_t) << (exponent_ + 9)) | (top_bits << exponent_);
+  uint64_t top = ((a_top + c_t) << (cap_.exponent + 9)) |
+                 (top_bits << cap_.exponent);
   top &= 0x1'ffff'ffffULL;
   return std::make_pair(static_cast<uint32_t>(base), top);
 }
 
 uint32_t CheriotRegister::Compress() const {
-  if (is_null_) return 0;
+  if (cap_.is_null) return 0;
 
   uint32_t compressed = 0;
   // Compute the compressed permissions representation.
@@ -216,11 +218,11 @@ uint32_t CheriotRegister::Compress() const {
   // on the capability type.
   compressed |= (object_type() & 0b111) << 22;
   compressed |= permissions_field << 25;
-  compressed |= reserved_ << 31;
+  compressed |= cap_.reserved << 31;
   // If the expanded capability is not dirty, we don't have to re-do the
   // exponent and top/base computations.
-  if (!is_dirty_) {
-    compressed |= raw_ & 0x3f'ffff;
+  if (!cap_.is_dirty) {
+    compressed |= cap_.raw & 0x3f'ffff;
     return compressed;
   }
   // Compute exponent.
@@ -280,7 +282,7 @@ void CheriotRegister::Expand(uint32_t address, uint32_t compressed, bool tag) {
     set_base(new_base);
     set_top(new_top & 0x1'ffff'ffffULL);
   }
-  exponent_ = exp;
+  cap_.exponent = exp;
   uint32_t obj_type = Extract(compressed, kObjectType[0], kObjectType[1]);
   if (obj_type && (new_permissions & kPermitExecute) == 0) {
     // Bit 3 of the object type is implied by the capability type. For non
@@ -292,27 +294,27 @@ void CheriotRegister::Expand(uint32_t address, uint32_t compressed, bool tag) {
   set_reserved(Extract(compressed, kReserved[0], kReserved[1]));
   set_tag(tag);
   data_buffer()->Set<uint32_t>(0, address);
-  raw_ = compressed;
-  is_dirty_ = false;
-  is_null_ = false;
-  raw_ = compressed;
+  cap_.raw = compressed;
+  cap_.is_dirty = false;
+  cap_.is_null = false;
+  cap_.raw = compressed;
 }
 
 void CheriotRegister::Validate() {
-  if (!tag() | is_null_) return;
+  if (!tag() | cap_.is_null) return;
 
   // The capability is still valid if the address is representable.
   set_tag(IsRepresentable());
 }
 
 bool CheriotRegister::IsValid() const {
-  if (!tag() || is_null_) return false;
+  if (!tag() || cap_.is_null) return false;
   uint32_t address = data_buffer()->Get<uint32_t>(0);
   return (address < top()) && (address >= base());
 }
 
 bool CheriotRegister::IsSealed() const {
-  if (is_null_ || !tag()) return false;
+  if (cap_.is_null || !tag()) return false;
 
   if (HasPermission(kPermitExecute)) {
     return (object_type() == kInterruptInheritingSentry) ||
@@ -329,9 +331,9 @@ bool CheriotRegister::IsSealed() const {
 
 absl::Status CheriotRegister::Seal(const CheriotRegister &source,
                                    uint32_t obj_type) {
-  if (is_null_) {
+  if (cap_.is_null) {
     Expand(address(), 0, /*tag=*/false);
-    is_null_ = false;
+    cap_.is_null = false;
   }
   absl::Status status = absl::OkStatus();
   // Check that the conditions are correct for sealing the target capability.
@@ -389,9 +391,9 @@ absl::Status CheriotRegister::Seal(const CheriotRegister &source,
 
 absl::Status CheriotRegister::Unseal(const CheriotRegister &source,
                                      uint32_t obj_type) {
-  if (is_null_) {
+  if (cap_.is_null) {
     Expand(address(), 0, /*tag=*/false);
-    is_null_ = false;
+    cap_.is_null = false;
   }
   // Check that the conditions are correct for unsealing the target capability.
   auto status = absl::OkStatus();
@@ -425,39 +427,31 @@ bool CheriotRegister::IsUnsealed() const {
 }
 
 bool CheriotRegister::IsRepresentable() const {
-  if (exponent_ == 24) return true;
+  if (cap_.exponent == 24) return true;
   uint64_t address = data_buffer()->Get<uint32_t>(0);
   uint64_t cap_base = base();
   return (cap_base <= address) &&
-         (address < (cap_base + (1ULL << (exponent_ + 9))));
+         (address < (cap_base + (1ULL << (cap_.exponent + 9))));
 }
 
 bool CheriotRegister::IsSentry() const {
-  return !is_null_ && (object_type() >= kInterruptInheritingSentry) &&
+  return !cap_.is_null && (object_type() >= kInterruptInheritingSentry) &&
          (object_type() <= kInterruptEnablingBackwardSentry);
 }
 
 bool CheriotRegister::IsBackwardSentry() const {
-  return !is_null_ && ((object_type() == kInterruptEnablingBackwardSentry) ||
-                       (object_type() == kInterruptDisablingBackwardSentry));
+  return !cap_.is_null &&
+         ((object_type() == kInterruptEnablingBackwardSentry) ||
+          (object_type() == kInterruptDisablingBackwardSentry));
 }
 
 void CheriotRegister::CopyFrom(const CheriotRegister &other) {
-  data_buffer()->CopyFrom(other.data_buffer());
-  if (other.is_null_) {
+  data_buffer()->Set<uint32_t>(0, other.address());
+  if (other.cap_.is_null) {
     Expand(address(), 0, /*tag=*/false);
     return;
   }
-  is_null_ = false;
-  set_tag(other.tag());
-  set_top(other.top());
-  set_base(other.base());
-  set_permissions(other.permissions());
-  set_object_type(other.object_type());
-  set_reserved(other.reserved());
-  exponent_ = other.exponent();
-  is_dirty_ = other.is_dirty_;
-  raw_ = other.raw_;
+  cap_ = other.cap_;
 }
 
 bool CheriotRegister::operator==(const CheriotRegister &other) const {
@@ -474,7 +468,7 @@ bool CheriotRegister::IsMemoryEqual(const CheriotRegister &other) const {
 void CheriotRegister::SetAddress(uint32_t address) {
   if (!tag()) {
     data_buffer()->Set<uint32_t>(0, address);
-    uint64_t mask = ~((1ULL << (exponent_ + 9)) - 1);
+    uint64_t mask = ~((1ULL << (cap_.exponent + 9)) - 1);
     auto len = length();
     set_base(address & mask);
     set_top(static_cast<uint64_t>(base()) + len);
@@ -513,7 +507,7 @@ std::string CheriotRegister::AsString() const {
 
 // Determine the current permission format.
 PermissionFormats CheriotRegister::GetPermissionFormat() const {
-  if (is_null_) return kSealing;
+  if (cap_.is_null) return kSealing;
   // Check to see if it is an executable permission format.
   if ((permissions() & kImpliedCapabilities[kExecutable]) ==
       kImpliedCapabilities[kExecutable]) {
@@ -548,7 +542,7 @@ PermissionFormats CheriotRegister::GetPermissionFormat() const {
 
 uint32_t CheriotRegister::CompressPermissions() const {
   // Determine the target format based on the currently set permissions.
-  if (is_null_) return 0;
+  if (cap_.is_null) return 0;
 
   auto format = GetPermissionFormat();
   uint32_t compressed;
@@ -22,6 +22,7 @@
 
 #include <cstdint>
 #include <string>
+#include <type_traits>
 #include <utility>
 
 #include "absl/status/status.h"
@@ -171,8 +172,8 @@ class CheriotRegister : public generic::Register<uint32_t> {
   // Update address with change to base and top as needed.
   void SetAddress(uint32_t address);
   // Accessors.
-  bool tag() const { return is_null_ ? false : tag_; }
-  void set_tag(bool tag) { tag_ = tag; }
+  bool tag() const { return cap_.is_null ? false : cap_.tag; }
+  void set_tag(bool tag) { cap_.tag = tag; }
 
   uint32_t address() const { return data_buffer()->Get<uint32_t>(0); }
   void set_address(uint32_t address) {
@@ -180,26 +181,35 @@ class CheriotRegister : public generic::Register<uint32_t> {
     Validate();
   }
 
-  uint64_t top() const { return is_null_ ? address() & ~0x1ffULL : top_; }
-  uint32_t base() const { return is_null_ ? address() & ~0x1ffULL : base_; }
+  uint64_t top() const {
+    return cap_.is_null ? address() & ~0x1ffULL : cap_.top;
+  }
+  uint32_t base() const {
+    return cap_.is_null ? address() & ~0x1ffULL : cap_.base;
+  }
   uint64_t length() const {
     // Length is only 33 bits, so mask off the value.
-    return is_null_ ? 0 : (top_ - base_) & 0x1'ffff'ffffULL;
+    return cap_.is_null ? 0 : (cap_.top - cap_.base) & 0x1'ffff'ffffULL;
+  }
+  uint32_t exponent() const { return cap_.is_null ? 0 : cap_.exponent; }
+  uint32_t permissions() const { return cap_.is_null ? 0 : cap_.permissions; }
+  void set_permissions(uint32_t permissions) {
+    cap_.permissions = permissions;
   }
-  uint32_t exponent() const { return is_null_ ? 0 : exponent_; }
-  uint32_t permissions() const { return is_null_ ? 0 : permissions_; }
-  void set_permissions(uint32_t permissions) { permissions_ = permissions; }
 
-  uint32_t object_type() const { return is_null_ ? 0 : object_type_; }
+  uint32_t object_type() const { return cap_.is_null ? 0 : cap_.object_type; }
   void set_object_type(uint32_t object_type) {
-    object_type_ = object_type & 0xf;
+    cap_.object_type = object_type & 0xf;
   }
 
-  uint32_t reserved() const { return is_null_ ? 0 : reserved_; }
-  void set_reserved(uint32_t reserved) { reserved_ = reserved & 0x1; }
+  uint32_t reserved() const { return cap_.is_null ? 0 : cap_.reserved; }
+  void set_reserved(uint32_t reserved) { cap_.reserved = reserved & 0x1; }
 
-  bool is_null() const { return is_null_; }
-  void set_is_null() { is_null_ = true; }
+  bool is_null() const { return cap_.is_null; }
+  void set_is_null() { cap_.is_null = true; }
+
+  // Get the permission format based on the current permissions.
+  PermissionFormats GetPermissionFormat() const;
 
  private:
   // These are the capabilities in each compressed capability permission format
@@ -312,41 +322,49 @@ class CheriotRegister : public generic::Register<uint32_t> {
       kPermitStoreLocalCapability | kPermitLoadMutable,
       kPermitStoreLocalCapability | kPermitLoadMutable | kPermitLoadGlobal,
   };
-  // Get the permission format based on the current permissions.
-  PermissionFormats GetPermissionFormat() const;
   // Return the current permissions in compressed form.
   uint32_t CompressPermissions() const;
   // Return the expanded view of the given compressed form of permissions.
   uint32_t ExpandPermissions(uint32_t compressed) const;
 
-  // If top or base is changed, set is_dirty_ so that the values get properly
+  // If top or base is changed, set is_dirty so that the values get properly
   // compressed if written to memory.
   void set_top(uint64_t top) {
-    top_ = top;
-    is_dirty_ = true;
+    cap_.top = top;
+    cap_.is_dirty = true;
   }
   void set_base(uint32_t base) {
-    base_ = base;
-    is_dirty_ = true;
+    cap_.base = base;
+    cap_.is_dirty = true;
   }
 
-  PermissionFormats permissions_format() const { return permissions_format_; }
+  PermissionFormats permissions_format() const {
+    return static_cast<PermissionFormats>(cap_.permissions_format);
+  }
   void set_permissions_format(PermissionFormats format) {
-    permissions_format_ = format;
+    cap_.permissions_format = format;
   }
-  bool tag_ = false;
-  uint64_t top_;
-  uint32_t base_;
-  // Stores the 12 permissions.
-  uint32_t permissions_;
-  PermissionFormats permissions_format_;
-  // Stores the 3 bit object type.
-  uint32_t object_type_;
-  uint32_t reserved_;
-  bool is_dirty_ = false;
-  bool is_null_ = false;
-  uint32_t raw_ = 0xdeadbeef;
-  uint32_t exponent_ = 0;
+  // The expanded capability fields, cached alongside the compressed form. The
+  // struct is trivially copyable, so copying a capability between registers
+  // is a single move of the struct and the address.
+  struct Fields {
+    uint64_t top = 0;
+    uint32_t base = 0;
+    uint32_t raw = 0xdeadbeef;
+    // Stores the 12 permissions.
+    uint16_t permissions = 0;
+    // Stores the 4 bit object type.
+    uint8_t object_type = 0;
+    uint8_t exponent = 0;
+    uint8_t permissions_format = kSealing;
+    uint8_t reserved = 0;
+    bool tag = false;
+    bool is_dirty = false;
+    bool is_null = false;
+  };
+  static_assert(std::is_trivially_copyable_v<Fields>);
+
+  Fields cap_;
 };
 
 }  // namespace cheriot
@@ -25,6 +25,7 @@
 #include <memory>
 #include <string>
 #include <string_view>
+#include <thread>  // NOLINT: third party code.
 
 #include "absl/functional/bind_front.h"
 #include "absl/log/check.h"
@@ -36,6 +37,7 @@
 #include "cheriot/cheriot_debug_info.h"
 #include "cheriot/cheriot_debug_interface.h"
 #include "cheriot/cheriot_decoder.h"
+#include "cheriot/cheriot_elf_loader.h"
 #include "cheriot/cheriot_instrumentation_control.h"
 #include "cheriot/cheriot_renode_cli_top.h"
 #include "cheriot/cheriot_renode_register_info.h"
@@ -105,6 +107,12 @@ constexpr std::string_view kInstProfile = "instProfile";
 constexpr std::string_view kMemProfile = "memProfile";
 constexpr std::string_view kICache = "iCache";
 constexpr std::string_view kDCache = "dCache";
+constexpr std::string_view kBranchPredictor = "branchPredictor";
+constexpr std::string_view kReserveMemory = "reserveMemory";
+constexpr std::string_view kHugePages = "hugePages";
+constexpr std::string_view kPmp = "pmp";
+constexpr std::string_view kMetricsSocket = "metricsSocket";
+constexpr std::string_view kPacingFrequency = "pacingFrequency";
 // Cpu names
 constexpr std::string_view kBaseName = "Mpact.Cheriot";
 constexpr std::string_view kRvvName = "Mpact.CheriotRvv";
@@ -118,6 +126,8 @@ CheriotRenode::CheriotRenode(std::string name, MemoryInterface *renode_sysbus)
 CheriotRenode::~CheriotRenode() {
   // Halt the core just to be safe.
   if (cheriot_top_ != nullptr) (void)cheriot_top_->Halt();
+  delete metrics_server_;
+  metrics_server_ = nullptr;
   // Write out instruction profile.
   if (inst_profiler_ != nullptr) {
     std::string inst_profile_file_name =
@@ -142,6 +152,16 @@ CheriotRenode::~CheriotRenode() {
       mem_profiler_->WriteProfile(mem_profile_file);
     }
     mem_profile_file.close();
+    std::string tag_heatmap_file_name =
+        absl::StrCat("./mpact_cheriot_", name_, "_tag_heatmap.csv");
+    std::fstream tag_heatmap_file(tag_heatmap_file_name.c_str(),
+                                  std::ios_base::out);
+    if (!tag_heatmap_file.good()) {
+      LOG(ERROR) << "Failed to write tag heatmap to file";
+    } else {
+      mem_profiler_->WriteTagHeatmap(tag_heatmap_file);
+    }
+    tag_heatmap_file.close();
   }
   // Export counters.
   if (cheriot_top_ != nullptr) {
@@ -170,12 +190,16 @@ CheriotRenode::~CheriotRenode() {
   delete cheriot_renode_cli_top_;
   delete cheriot_cli_forwarder_;
   delete cheriot_decoder_;
+  // The pacer's counters are registered with the top, so it is deleted after
+  // the counters have been exported.
+  delete pacer_;
   delete cheriot_top_;
   delete cheriot_state_;
   delete semihost_;
   delete router_;
   delete atomic_memory_;
   delete tagged_memory_;
+  delete demand_memory_;
   delete clint_;
   delete tagged_sysbus_;
 }
@@ -191,11 +215,19 @@ absl::StatusOr<uint64_t> CheriotRenode::LoadExecutable(
     }
     entry_pt = res.value();
   } else {
-    auto res = program_loader_->LoadProgram(elf_file_name);
+    // Copy the segments in bulk, then load the symbols. The memory is not
+    // known to be zero, so bss is zero filled.
+    CheriotElfLoader elf_file;
+    auto res = elf_file.LoadProgram(elf_file_name, this,
+                                    /*memory_is_zero=*/false);
     if (!res.ok()) {
       return res.status();
     }
     entry_pt = res.value();
+    auto sym_res = program_loader_->LoadSymbols(elf_file_name);
+    if (!sym_res.ok()) {
+      return sym_res.status();
+    }
   }
   auto res = program_loader_->GetSymbol("tohost");
   // Add watchpoint for tohost if the symbol exists.
@@ -239,21 +271,31 @@ absl::StatusOr<uint64_t> CheriotRenode::LoadExecutable(
   return entry_pt;
 }
 
-// Each of the following methods checks to see if the command line enabled
-// "top" interface is null. If it is not, it uses that to control the simulator,
-// as it provides proper prioritization and handling of both ReNode and command
-// line commands. Otherwise it uses the cheriot_top interface directly.
+// Each of the following methods uses DoWithControl to either call the
+// cheriot_top interface directly, or, when a command line client has control,
+// go through the command line enabled "top" interface, as it provides proper
+// prioritization and handling of both ReNode and command line commands.
 
 absl::StatusOr<int> CheriotRenode::Step(int num) {
-  if (cheriot_renode_cli_top_ != nullptr)
-    return cheriot_renode_cli_top_->RenodeStep(num);
-  return cheriot_top_->Step(num);
+  bool direct_step = false;
+  auto result = DoWithControl<absl::StatusOr<int>>(
+      [&]() {
+        direct_step = true;
+        return cheriot_top_->Step(num);
+      },
+      [&]() { return cheriot_renode_cli_top_->RenodeStep(num); });
+  // Each successful step request is a pacing quantum. Steps made while the
+  // command line client has control aren't paced.
+  if ((pacer_ != nullptr) && direct_step && result.ok()) {
+    pacer_->Pace(cheriot_top_->counter_num_cycles()->GetValue());
+  }
+  return result;
 }
 
 absl::StatusOr<HaltReasonValueType> CheriotRenode::GetLastHaltReason() {
-  if (cheriot_renode_cli_top_ != nullptr)
-    return cheriot_renode_cli_top_->RenodeGetLastHaltReason();
-  return cheriot_top_->GetLastHaltReason();
+  return DoWithControl<absl::StatusOr<HaltReasonValueType>>(
+      [&]() { return cheriot_top_->GetLastHaltReason(); },
+      [&]() { return cheriot_renode_cli_top_->RenodeGetLastHaltReason(); });
 }
 
 // Perform direct read of the memory through the renode router. The renode
@@ -285,9 +327,11 @@ absl::StatusOr<uint64_t> CheriotRenode::ReadRegister(uint32_t reg_id) {
     return absl::NotFoundError(
         absl::StrCat("Not found reg id: ", absl::Hex(reg_id)));
   }
-  if (cheriot_renode_cli_top_ != nullptr)
-    return cheriot_renode_cli_top_->RenodeReadRegister(ptr->second);
-  return cheriot_top_->ReadRegister(ptr->second);
+  return DoWithControl<absl::StatusOr<uint64_t>>(
+      [&]() { return cheriot_top_->ReadRegister(ptr->second); },
+      [&]() {
+        return cheriot_renode_cli_top_->RenodeReadRegister(ptr->second);
+      });
 }
 
 absl::Status CheriotRenode::WriteRegister(uint32_t reg_id, uint64_t value) {
@@ -296,9 +340,22 @@ absl::Status CheriotRenode::WriteRegister(uint32_t reg_id, uint64_t value) {
     return absl::NotFoundError(
         absl::StrCat("Not found reg id: ", absl::Hex(reg_id)));
   }
-  if (cheriot_renode_cli_top_ != nullptr)
-    return cheriot_renode_cli_top_->RenodeWriteRegister(ptr->second, value);
-  return cheriot_top_->WriteRegister(ptr->second, value);
+  return DoWithControl<absl::Status>(
+      [&]() { return cheriot_top_->WriteRegister(ptr->second, value); },
+      [&]() {
+        return cheriot_renode_cli_top_->RenodeWriteRegister(ptr->second, value);
+      });
+}
+
+void CheriotRenode::SetCLIConnected(bool connected) {
+  if (connected) {
+    // Request control and wait for the Renode thread to leave any direct
+    // call to the top.
+    cli_requested_.store(true);
+    while (in_direct_call_.load()) std::this_thread::yield();
+  }
+  cheriot_renode_cli_top_->SetConnected(connected);
+  if (!connected) cli_requested_.store(false);
 }
 
 int32_t CheriotRenode::GetRenodeRegisterInfoSize() const {
@@ -348,12 +405,17 @@ absl::Status CheriotRenode::SetConfig(const char *config_names[],
                                       const char *config_values[], int size) {
   std::string icache_cfg;
   std::string dcache_cfg;
+  std::string branch_predictor_cfg;
+  std::string metrics_socket;
   uint64_t tagged_memory_base = 0;
   uint64_t tagged_memory_size = 0;
   uint64_t revocation_memory_base = 0;
   uint64_t clint_mmr_base = 0;
   uint64_t clint_period = 100;  // 100 by default.
+  uint64_t pacing_frequency = 0;
   bool do_inst_profile = false;
+  bool reserve_memory = false;
+  bool use_huge_pages = false;
   int cli_port = 0;
   int wait_for_cli = 0;
   for (int i = 0; i < size; ++i) {
@@ -364,6 +426,10 @@ absl::Status CheriotRenode::SetConfig(const char *config_names[],
       icache_cfg = str_value;
     } else if (name == kDCache) {
       dcache_cfg = str_value;
+    } else if (name == kBranchPredictor) {
+      branch_predictor_cfg = str_value;
+    } else if (name == kMetricsSocket) {
+      metrics_socket = str_value;
     } else {
       // Numeric config values.
       auto res = ParseNumber(str_value);
@@ -386,10 +452,18 @@ absl::Status CheriotRenode::SetConfig(const char *config_names[],
         cli_port = value;
       } else if (name == kWaitForCLI) {
         wait_for_cli = value;
+      } else if (name == kReserveMemory) {
+        reserve_memory = value != 0;
+      } else if (name == kHugePages) {
+        use_huge_pages = value != 0;
       } else if (name == kInstProfile) {
         do_inst_profile = value != 0;
       } else if (name == kMemProfile) {
         mem_profiler_->set_is_enabled(value != 0);
+      } else if (name == kPacingFrequency) {
+        pacing_frequency = value;
+      } else if (name == kPmp) {
+        cheriot_state_->set_pmp_enabled(value != 0);
       } else if (name == kCoreVersion) {
         cheriot_state_->set_core_version(value);
       } else {
@@ -401,6 +475,12 @@ absl::Status CheriotRenode::SetConfig(const char *config_names[],
   if (tagged_memory_size == 0) {
     return absl::InvalidArgumentError("tagged_memory_size is 0");
   }
+  // Back the memory range with a single host memory reservation.
+  if (reserve_memory) {
+    auto status = tagged_memory_->Reserve(tagged_memory_base,
+                                          tagged_memory_size, use_huge_pages);
+    if (!status.ok()) return status;
+  }
   // Add the memory targets.
   CHECK_OK(router_->AddTarget<AtomicMemoryOpInterface>(
       atomic_memory_, tagged_memory_base,
@@ -434,8 +514,27 @@ absl::Status CheriotRenode::SetConfig(const char *config_names[],
       cheriot_top_->counter_pc()->AddListener(inst_profiler_);
     }
   }
+  // Serve live counter snapshots on a Unix domain socket.
+  if (!metrics_socket.empty() && (metrics_server_ == nullptr)) {
+    metrics_server_ = new CheriotMetricsServer(cheriot_top_);
+    metrics_server_->set_is_halted([this]() {
+      return cheriot_top_->GetRunStatus().value() == RunStatus::kHalted;
+    });
+    auto status = metrics_server_->Start(metrics_socket);
+    if (!status.ok()) return status;
+    cheriot_top_->counter_num_cycles()->AddListener(metrics_server_);
+  }
+  // Throttle the simulation to the given clock frequency.
+  if ((pacing_frequency != 0) && (pacer_ == nullptr)) {
+    pacer_ = new CheriotPacer(static_cast<double>(pacing_frequency),
+                              CheriotPacer::kDefaultMaxLagUsec);
+    auto status = pacer_->AddCounters(cheriot_top_);
+    if (!status.ok()) return status;
+  }
   // If the cli port has been specified, then instantiate the requisite classes.
   if (cli_port != 0 && (cheriot_renode_cli_top_ == nullptr)) {
+    // If the CLI is waited for, it has control from the start.
+    cli_requested_.store(wait_for_cli != 0);
     cheriot_renode_cli_top_ =
         new CheriotRenodeCLITop(cheriot_top_, wait_for_cli != 0);
     cheriot_cli_forwarder_ = new CheriotCLIForwarder(cheriot_renode_cli_top_);
@@ -449,10 +548,9 @@ absl::Status CheriotRenode::SetConfig(const char *config_names[],
         instrumentation_control_->Usage(),
         absl::bind_front(&CheriotInstrumentationControl::PerformShellCommand,
                          instrumentation_control_));
-    socket_cli_ =
-        new SocketCLI(cli_port, *cmd_shell_,
-                      absl::bind_front(&CheriotRenodeCLITop::SetConnected,
-                                       cheriot_renode_cli_top_));
+    socket_cli_ = new SocketCLI(
+        cli_port, *cmd_shell_,
+        absl::bind_front(&CheriotRenode::SetCLIConnected, this));
     if (!socket_cli_->good()) {
       return absl::InternalError(
           absl::StrCat("Failed to create socket CLI (", errno, ")"));
@@ -475,8 +573,22 @@ absl::Status CheriotRenode::SetConfig(const char *config_names[],
     if (!status.ok()) return status;
     // Hook the cache into the memory port.
     auto *dcache = cheriot_top_->dcache();
-    dcache->set_tagged_memory(cheriot_top_->state()->tagged_memory());
+    auto *memory = cheriot_top_->state()->tagged_memory();
+    dcache->set_tagged_memory(memory);
     cheriot_top_->state()->set_tagged_memory(dcache);
+    cheriot_top_->state()->set_uncached_memory(memory);
+  }
+  if (!branch_predictor_cfg.empty()) {
+    ComponentValueEntry branch_predictor_value;
+    branch_predictor_value.set_name("branch_predictor");
+    branch_predictor_value.set_string_value(branch_predictor_cfg);
+    auto *cfg = cheriot_top_->GetConfig("branch_predictor");
+    auto status = cfg->Import(&branch_predictor_value);
+    if (!status.ok()) return status;
+    // The configuration is applied by a callback, so check its result.
+    if (cheriot_top_->branch_predictor() == nullptr) {
+      return cheriot_top_->branch_predictor_status();
+    }
   }
   return absl::OkStatus();
 }
@@ -505,7 +617,7 @@ absl::Status CheriotRenode::InitializeSimulator(const std::string &cpu_type) {
   auto *data_memory = static_cast<TaggedMemoryInterface *>(router_);
   // Instantiate memory profiler, but disable it until the config information
   // has been received.
-  mem_profiler_ = new TaggedMemoryUseProfiler(data_memory);
+  mem_profiler_ = new CheriotMemoryUseProfiler(data_memory);
   data_memory = mem_profiler_;
   mem_profiler_->set_is_enabled(false);
   cheriot_state_ = new CheriotState(
@@ -572,8 +684,10 @@ absl::Status CheriotRenode::InitializeSimulator(const std::string &cpu_type) {
   // memories will be added to the renode router immediately as the default
   // target, since memory references from ReNode are only in the memory range
   // exposed on the sysbus.
-  tagged_memory_ =
+  demand_memory_ =
       new mpact::sim::util::TaggedFlatDemandMemory(kCapabilityGranule);
+  tagged_memory_ =
+      new CheriotReservedMemory(kCapabilityGranule, demand_memory_);
   atomic_memory_ = new mpact::sim::util::AtomicMemory(tagged_memory_);
 
   // Need to set up the renode router with the tagged_memory.
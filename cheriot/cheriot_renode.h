@@ -17,6 +17,7 @@
 #ifndef MPACT_CHERIOT__CHERIOT_RENODE_H_
 #define MPACT_CHERIOT__CHERIOT_RENODE_H_
 
+#include <atomic>
 #include <cstddef>
 #include <cstdint>
 #include <string>
@@ -25,7 +26,11 @@
 #include "absl/status/statusor.h"
 #include "cheriot/cheriot_cli_forwarder.h"
 #include "cheriot/cheriot_instrumentation_control.h"
+#include "cheriot/cheriot_memory_use_profiler.h"
+#include "cheriot/cheriot_metrics_server.h"
+#include "cheriot/cheriot_pacer.h"
 #include "cheriot/cheriot_renode_cli_top.h"
+#include "cheriot/cheriot_reserved_memory.h"
 #include "cheriot/cheriot_state.h"
 #include "cheriot/cheriot_top.h"
 #include "cheriot/debug_command_shell.h"
@@ -33,7 +38,6 @@
 #include "mpact/sim/generic/data_buffer.h"
 #include "mpact/sim/util/memory/atomic_memory.h"
 #include "mpact/sim/util/memory/memory_interface.h"
-#include "mpact/sim/util/memory/memory_use_profiler.h"
 #include "mpact/sim/util/memory/single_initiator_router.h"
 #include "mpact/sim/util/memory/tagged_flat_demand_memory.h"
 #include "mpact/sim/util/memory/tagged_memory_interface.h"
@@ -73,7 +77,6 @@ using ::mpact::sim::util::MemoryInterface;
 using ::mpact::sim::util::SingleInitiatorRouter;
 using ::mpact::sim::util::TaggedFlatDemandMemory;
 using ::mpact::sim::util::TaggedMemoryInterface;
-using ::mpact::sim::util::TaggedMemoryUseProfiler;
 using ::mpact::sim::util::renode::SocketCLI;
 
 class CheriotRenode : public util::renode::RenodeDebugInterface {
@@ -144,6 +147,27 @@ class CheriotRenode : public util::renode::RenodeDebugInterface {
   absl::Status InitializeSimulator(const std::string &cpu_type);
 
  private:
+  // Control handoff between the Renode thread and the CLI. The Renode thread
+  // owns the core and calls the top directly, checking only an atomic flag,
+  // until a CLI client connects (or the CLI is waited for). The connecting
+  // CLI thread requests control and waits for any direct call in progress to
+  // complete. From then on, calls are made through the CLI top, which
+  // arbitrates between Renode and CLI commands, until the client disconnects.
+  template <typename T, typename DirectFunction, typename CLIFunction>
+  T DoWithControl(DirectFunction direct, CLIFunction cli) {
+    if (cheriot_renode_cli_top_ == nullptr) return direct();
+    in_direct_call_.store(true);
+    if (cli_requested_.load()) {
+      in_direct_call_.store(false, std::memory_order_release);
+      return cli();
+    }
+    T result = direct();
+    in_direct_call_.store(false, std::memory_order_release);
+    return result;
+  }
+  // Called by the socket CLI when a client connects or disconnects.
+  void SetCLIConnected(bool connected);
+
   std::string name_;
   MemoryInterface *renode_sysbus_ = nullptr;
   TaggedMemoryInterface *data_memory_ = nullptr;
@@ -156,16 +180,22 @@ class CheriotRenode : public util::renode::RenodeDebugInterface {
   SingleInitiatorRouter *renode_router_ = nullptr;
   DataBufferFactory db_factory_;
   AtomicMemory *atomic_memory_ = nullptr;
-  TaggedFlatDemandMemory *tagged_memory_ = nullptr;
+  TaggedFlatDemandMemory *demand_memory_ = nullptr;
+  // Forwards to the demand memory until a memory range is reserved.
+  CheriotReservedMemory *tagged_memory_ = nullptr;
   RiscVClint *clint_ = nullptr;
   SocketCLI *socket_cli_ = nullptr;
   CheriotRenodeCLITop *cheriot_renode_cli_top_ = nullptr;
+  std::atomic<bool> cli_requested_ = false;
+  std::atomic<bool> in_direct_call_ = false;
   CheriotCLIForwarder *cheriot_cli_forwarder_ = nullptr;
   ElfProgramLoader *program_loader_ = nullptr;
   DebugCommandShell *cmd_shell_ = nullptr;
   InstructionProfiler *inst_profiler_ = nullptr;
-  TaggedMemoryUseProfiler *mem_profiler_ = nullptr;
+  CheriotMemoryUseProfiler *mem_profiler_ = nullptr;
   CheriotInstrumentationControl *instrumentation_control_ = nullptr;
+  CheriotMetricsServer *metrics_server_ = nullptr;
+  CheriotPacer *pacer_ = nullptr;
   CheriotCpuType cpu_type_ = CheriotCpuType::kBase;
 };
 
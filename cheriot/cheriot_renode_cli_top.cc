@@ -96,6 +96,23 @@ absl::Status CheriotRenodeCLITop::CLIDisableAction(uint64_t address, int id) {
   });
 }
 
+absl::Status CheriotRenodeCLITop::CLIRunAsync(
+    uint64_t max_instructions, CheriotDebugInterface::RunCallback done) {
+  return DoWhenInControl<absl::Status>([this, max_instructions, &done]() {
+    return cheriot_top_->RunAsync(max_instructions, std::move(done));
+  });
+}
+
+// Cancelling a run and obtaining the eventfd are safe to do from any thread,
+// so they don't wait for the CLI to be in control.
+absl::Status CheriotRenodeCLITop::CLICancelRun() {
+  return cheriot_top_->CancelRun();
+}
+
+absl::StatusOr<int> CheriotRenodeCLITop::CLIGetRunEventFd() {
+  return cheriot_top_->GetRunEventFd();
+}
+
 }  // namespace cheriot
 }  // namespace sim
 }  // namespace mpact
@@ -52,6 +52,11 @@ class CheriotRenodeCLITop : public util::renode::RenodeCLITop {
   absl::Status CLIEnableAction(uint64_t address, int id);
   absl::Status CLIDisableAction(uint64_t address, int id);
 
+  absl::Status CLIRunAsync(uint64_t max_instructions,
+                           CheriotDebugInterface::RunCallback done);
+  absl::Status CLICancelRun();
+  absl::StatusOr<int> CLIGetRunEventFd();
+
  private:
   CheriotTop *cheriot_top_ = nullptr;
 };
@@ -0,0 +1,235 @@
+// Copyright 2024 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "cheriot/cheriot_reserved_memory.h"
+
+#include <sys/mman.h>
+
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+
+#include "absl/log/check.h"
+#include "absl/log/log.h"
+#include "absl/numeric/bits.h"
+#include "absl/status/status.h"
+#include "absl/strings/str_cat.h"
+#include "mpact/sim/generic/data_buffer.h"
+#include "mpact/sim/generic/instruction.h"
+#include "mpact/sim/generic/ref_count.h"
+
+namespace mpact {
+namespace sim {
+namespace cheriot {
+
+namespace {
+
+// Reserves size bytes of zero initialized host memory without committing
+// swap space for it.
+void *ReserveHostMemory(size_t size) {
+  return mmap(nullptr, size, PROT_READ | PROT_WRITE,
+              MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+}
+
+}  // namespace
+
+CheriotReservedMemory::CheriotReservedMemory(unsigned granule_size,
+                                             TaggedMemoryInterface *fallback)
+    : granule_shift_(absl::bit_width(granule_size) - 1), fallback_(fallback) {
+  CHECK(absl::has_single_bit(granule_size))
+      << "Granule size must be a power of two";
+}
+
+CheriotReservedMemory::~CheriotReservedMemory() {
+  if (data_ != nullptr) munmap(data_, size_);
+  if (tags_ != nullptr) munmap(tags_, tags_size_);
+}
+
+absl::Status CheriotReservedMemory::Reserve(uint64_t base, uint64_t size,
+                                            bool use_huge_pages) {
+  if (data_ != nullptr) {
+    return absl::FailedPreconditionError("Memory already reserved");
+  }
+  uint64_t granule_mask = (uint64_t{1} << granule_shift_) - 1;
+  if ((size == 0) || (base & granule_mask) || (size & granule_mask)) {
+    return absl::InvalidArgumentError(
+        "Reserved memory base and size must be non-zero multiples of the "
+        "granule size");
+  }
+  if (base + size - 1 < base) {
+    return absl::InvalidArgumentError("Reserved memory range wraps around");
+  }
+  void *data = ReserveHostMemory(size);
+  if (data == MAP_FAILED) {
+    return absl::ResourceExhaustedError(absl::StrCat(
+        "Unable to reserve ", size, " bytes: ", strerror(errno)));
+  }
+  size_t tags_size = size >> granule_shift_;
+  void *tags = ReserveHostMemory(tags_size);
+  if (tags == MAP_FAILED) {
+    munmap(data, size);
+    return absl::ResourceExhaustedError(absl::StrCat(
+        "Unable to reserve ", tags_size, " tag bytes: ", strerror(errno)));
+  }
+  if (use_huge_pages) {
+#ifdef MADV_HUGEPAGE
+    if (madvise(data, size, MADV_HUGEPAGE) != 0) {
+      LOG(WARNING) << "Huge pages not available: " << strerror(errno);
+    }
+#else
+    LOG(WARNING) << "Huge pages not supported on this host";
+#endif
+  }
+  data_ = static_cast<uint8_t *>(data);
+  tags_ = static_cast<uint8_t *>(tags);
+  tags_size_ = tags_size;
+  base_ = base;
+  size_ = size;
+  return absl::OkStatus();
+}
+
+void CheriotReservedMemory::Load(uint64_t address, DataBuffer *db,
+                                 DataBuffer *tags, Instruction *inst,
+                                 ReferenceCount *context) {
+  int size = db != nullptr ? db->size<uint8_t>() : 0;
+  int64_t offset = Offset(address, size);
+  if (offset < 0) {
+    fallback_->Load(address, db, tags, inst, context);
+    return;
+  }
+  int latency = 0;
+  if (db != nullptr) {
+    std::memcpy(db->raw_ptr(), data_ + offset, size);
+    latency = db->latency();
+  }
+  if (tags != nullptr) {
+    uint64_t granule = offset >> granule_shift_;
+    int num_tags = tags->size<uint8_t>();
+    if (granule + num_tags > tags_size_) num_tags = tags_size_ - granule;
+    std::memcpy(tags->raw_ptr(), tags_ + granule, num_tags);
+    if (db == nullptr) latency = tags->latency();
+  }
+  FinishLoad(latency, inst, context);
+}
+
+void CheriotReservedMemory::Load(uint64_t address, DataBuffer *db,
+                                 Instruction *inst, ReferenceCount *context) {
+  int64_t offset = Offset(address, db->size<uint8_t>());
+  if (offset < 0) {
+    fallback_->Load(address, db, inst, context);
+    return;
+  }
+  std::memcpy(db->raw_ptr(), data_ + offset, db->size<uint8_t>());
+  FinishLoad(db->latency(), inst, context);
+}
+
+void CheriotReservedMemory::Load(DataBuffer *address_db, DataBuffer *mask_db,
+                                 int el_size, DataBuffer *db,
+                                 Instruction *inst, ReferenceCount *context) {
+  auto addresses = address_db->Get<uint64_t>();
+  auto mask = mask_db->Get<bool>();
+  // Forward the whole access if any active element is outside the range.
+  for (int i = 0; i < addresses.size(); i++) {
+    if (mask[i] && (Offset(addresses[i], el_size) < 0)) {
+      fallback_->Load(address_db, mask_db, el_size, db, inst, context);
+      return;
+    }
+  }
+  auto *dest = static_cast<uint8_t *>(db->raw_ptr());
+  for (int i = 0; i < addresses.size(); i++) {
+    if (!mask[i]) continue;
+    std::memcpy(dest + i * el_size, data_ + (addresses[i] - base_), el_size);
+  }
+  FinishLoad(db->latency(), inst, context);
+}
+
+void CheriotReservedMemory::Store(uint64_t address, DataBuffer *db,
+                                  DataBuffer *tags) {
+  int64_t offset = Offset(address, db->size<uint8_t>());
+  if (offset < 0) {
+    fallback_->Store(address, db, tags);
+    return;
+  }
+  std::memcpy(data_ + offset, db->raw_ptr(), db->size<uint8_t>());
+  WriteTags(offset, db->size<uint8_t>(), tags);
+}
+
+void CheriotReservedMemory::Store(uint64_t address, DataBuffer *db) {
+  int64_t offset = Offset(address, db->size<uint8_t>());
+  if (offset < 0) {
+    fallback_->Store(address, db);
+    return;
+  }
+  std::memcpy(data_ + offset, db->raw_ptr(), db->size<uint8_t>());
+  WriteTags(offset, db->size<uint8_t>(), nullptr);
+}
+
+void CheriotReservedMemory::Store(DataBuffer *address_db, DataBuffer *mask_db,
+                                  int el_size, DataBuffer *db) {
+  auto addresses = address_db->Get<uint64_t>();
+  auto mask = mask_db->Get<bool>();
+  for (int i = 0; i < addresses.size(); i++) {
+    if (mask[i] && (Offset(addresses[i], el_size) < 0)) {
+      fallback_->Store(address_db, mask_db, el_size, db);
+      return;
+    }
+  }
+  auto *src = static_cast<const uint8_t *>(db->raw_ptr());
+  for (int i = 0; i < addresses.size(); i++) {
+    if (!mask[i]) continue;
+    uint64_t offset = addresses[i] - base_;
+    std::memcpy(data_ + offset, src + i * el_size, el_size);
+    WriteTags(offset, el_size, nullptr);
+  }
+}
+
+void CheriotReservedMemory::WriteTags(uint64_t offset, uint64_t size,
+                                      DataBuffer *tags) {
+  if (size == 0) return;
+  uint64_t first = offset >> granule_shift_;
+  uint64_t last = (offset + size - 1) >> granule_shift_;
+  if (tags == nullptr) {
+    // Only clear tags that are set, so that data stores don't allocate host
+    // pages for the tags of memory that never holds capabilities.
+    for (uint64_t granule = first; granule <= last; granule++) {
+      if (tags_[granule] != 0) tags_[granule] = 0;
+    }
+    return;
+  }
+  uint64_t num_tags = tags->size<uint8_t>();
+  for (uint64_t granule = first, i = 0; granule <= last; granule++, i++) {
+    tags_[granule] = (i < num_tags) && (tags->Get<uint8_t>(i) != 0);
+  }
+}
+
+void CheriotReservedMemory::FinishLoad(int latency, Instruction *inst,
+                                       ReferenceCount *context) {
+  // Execute the instruction to process and write back the load data.
+  if (nullptr == inst) return;
+  if (latency > 0) {
+    inst->IncRef();
+    if (context != nullptr) context->IncRef();
+    inst->state()->function_delay_line()->Add(latency, [inst, context]() {
+      inst->Execute(context);
+      if (context != nullptr) context->DecRef();
+      inst->DecRef();
+    });
+  } else {
+    inst->Execute(context);
+  }
+}
+
+}  // namespace cheriot
+}  // namespace sim
+}  // namespace mpact
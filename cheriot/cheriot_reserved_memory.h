@@ -0,0 +1,116 @@
+// Copyright 2024 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef MPACT_CHERIOT_CHERIOT_RESERVED_MEMORY_H_
+#define MPACT_CHERIOT_CHERIOT_RESERVED_MEMORY_H_
+
+#include <cstddef>
+#include <cstdint>
+
+#include "absl/status/status.h"
+#include "mpact/sim/generic/data_buffer.h"
+#include "mpact/sim/generic/instruction.h"
+#include "mpact/sim/generic/ref_count.h"
+#include "mpact/sim/util/memory/tagged_memory_interface.h"
+
+// This file defines a tagged memory that backs a single address range with
+// one host virtual memory reservation (mmap with MAP_NORESERVE), optionally
+// using transparent huge pages. The tags are kept in a parallel reservation
+// with one byte per capability granule. Host pages are only allocated by the
+// kernel when they are first written, so large, sparsely used address ranges
+// are cheap, and translating a simulated address is a subtraction and a
+// bounds check. Accesses outside the reserved range are forwarded to a
+// fallback memory.
+
+namespace mpact {
+namespace sim {
+namespace cheriot {
+
+using ::mpact::sim::generic::DataBuffer;
+using ::mpact::sim::generic::Instruction;
+using ::mpact::sim::generic::ReferenceCount;
+using ::mpact::sim::util::TaggedMemoryInterface;
+
+class CheriotReservedMemory : public TaggedMemoryInterface {
+ public:
+  // The granule size must be a power of two. The fallback memory is not owned
+  // by this class.
+  CheriotReservedMemory(unsigned granule_size, TaggedMemoryInterface *fallback);
+  CheriotReservedMemory(const CheriotReservedMemory &) = delete;
+  CheriotReservedMemory &operator=(const CheriotReservedMemory &) = delete;
+  ~CheriotReservedMemory() override;
+
+  // Reserves host memory for the address range [base, base + size). This can
+  // only be done once, and should be done before any data is stored to the
+  // range, as data previously stored to the fallback memory in the range is
+  // no longer visible.
+  absl::Status Reserve(uint64_t base, uint64_t size, bool use_huge_pages);
+
+  // TaggedMemoryInterface overrides.
+  void Load(uint64_t address, DataBuffer *db, DataBuffer *tags,
+            Instruction *inst, ReferenceCount *context) override;
+  void Load(uint64_t address, DataBuffer *db, Instruction *inst,
+            ReferenceCount *context) override;
+  void Load(DataBuffer *address_db, DataBuffer *mask_db, int el_size,
+            DataBuffer *db, Instruction *inst,
+            ReferenceCount *context) override;
+  void Store(uint64_t address, DataBuffer *db, DataBuffer *tags) override;
+  void Store(uint64_t address, DataBuffer *db) override;
+  void Store(DataBuffer *address_db, DataBuffer *mask_db, int el_size,
+             DataBuffer *db) override;
+
+  // Returns the host address of the size bytes at address, or nullptr if they
+  // are not all in the reserved range. This allows in-place read-modify-write
+  // accesses, which must call ClearTags for the bytes they write.
+  uint8_t *HostPointer(uint64_t address, uint64_t size) const {
+    int64_t offset = Offset(address, size);
+    return offset < 0 ? nullptr : data_ + offset;
+  }
+  // Clears the tags of the granules covering the size bytes at address, which
+  // must be in the reserved range.
+  void ClearTags(uint64_t address, uint64_t size) {
+    WriteTags(address - base_, size, nullptr);
+  }
+
+  uint64_t base() const { return base_; }
+  uint64_t size() const { return size_; }
+  bool is_reserved() const { return data_ != nullptr; }
+
+ private:
+  // Returns the offset of the access in the reserved range, or -1 if the
+  // access is not fully contained in the range.
+  int64_t Offset(uint64_t address, uint64_t size) const {
+    uint64_t offset = address - base_;
+    if ((offset >= size_) || (size > size_ - offset)) return -1;
+    return static_cast<int64_t>(offset);
+  }
+  // Sets (or clears) the tags of the granules covering the given byte range.
+  void WriteTags(uint64_t offset, uint64_t size, DataBuffer *tags);
+  // Executes the instruction (if any) to write back the load data.
+  void FinishLoad(int latency, Instruction *inst, ReferenceCount *context);
+
+  unsigned granule_shift_;
+  TaggedMemoryInterface *fallback_;
+  uint64_t base_ = 0;
+  uint64_t size_ = 0;
+  uint8_t *data_ = nullptr;
+  uint8_t *tags_ = nullptr;
+  size_t tags_size_ = 0;
+};
+
+}  // namespace cheriot
+}  // namespace sim
+}  // namespace mpact
+
+#endif  // MPACT_CHERIOT_CHERIOT_RESERVED_MEMORY_H_
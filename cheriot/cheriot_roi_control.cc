@@ -0,0 +1,147 @@
+// Copyright 2024 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "cheriot/cheriot_roi_control.h"
+
+#include <cstdint>
+#include <optional>
+
+#include "absl/status/status.h"
+#include "absl/strings/ascii.h"
+#include "absl/strings/str_cat.h"
+#include "absl/strings/str_split.h"
+#include "absl/strings/string_view.h"
+#include "cheriot/cheriot_memory_use_profiler.h"
+#include "cheriot/cheriot_top.h"
+#include "mpact/sim/util/memory/tagged_memory_interface.h"
+
+namespace mpact::sim::cheriot {
+
+CheriotRoiControl::CheriotRoiControl(CheriotTop *top,
+                                     TaggedMemoryInterface *dcache_memory,
+                                     CheriotMemoryUseProfiler *mem_profiler,
+                                     bool inst_profile)
+    : top_(top),
+      dcache_memory_(dcache_memory),
+      mem_profiler_(mem_profiler),
+      inst_profile_(inst_profile) {}
+
+absl::Status CheriotRoiControl::SetModels(absl::string_view models) {
+  uint32_t value = 0;
+  for (auto name : absl::StrSplit(models, ',', absl::SkipWhitespace())) {
+    name = absl::StripAsciiWhitespace(name);
+    if (name == "all") {
+      value |= kDefaultModels;
+    } else if (name == "icache") {
+      value |= kICache;
+    } else if (name == "dcache") {
+      value |= kDCache;
+    } else if (name == "tagcache") {
+      value |= kTagCache;
+    } else if (name == "bpred") {
+      value |= kBranchPredictor;
+    } else if (name == "btrace") {
+      value |= kBranchTrace;
+    } else if (name == "iprofile") {
+      value |= kInstProfile;
+    } else if (name == "mprofile") {
+      value |= kMemProfile;
+    } else if (name == "counters") {
+      value |= kCounters;
+    } else {
+      return absl::InvalidArgumentError(
+          absl::StrCat("Unknown ROI model: '", name, "'"));
+    }
+  }
+  models_ = value;
+  return absl::OkStatus();
+}
+
+absl::Status CheriotRoiControl::SetRegion(std::optional<uint64_t> start,
+                                          std::optional<uint64_t> end) {
+  if (start.has_value() && end.has_value() && (start.value() == end.value())) {
+    return absl::InvalidArgumentError(
+        "ROI start and end addresses must differ");
+  }
+  if (start.has_value()) {
+    auto result = top_->SetActionPoint(start.value(),
+                                       [this](uint64_t, int) { Enter(); });
+    if (!result.ok()) return result.status();
+  }
+  if (end.has_value()) {
+    auto result =
+        top_->SetActionPoint(end.value(), [this](uint64_t, int) { Exit(); });
+    if (!result.ok()) return result.status();
+  }
+  if (start.has_value()) {
+    Exit();
+  } else {
+    num_entries_ = 1;
+    entry_instructions_ = top_->counter_num_instructions()->GetValue();
+  }
+  return absl::OkStatus();
+}
+
+void CheriotRoiControl::Enter() {
+  if (in_roi_) return;
+  in_roi_ = true;
+  num_entries_++;
+  SetModelsEnabled(true);
+  entry_instructions_ = top_->counter_num_instructions()->GetValue();
+}
+
+void CheriotRoiControl::Exit() {
+  if (!in_roi_) return;
+  roi_instructions_ +=
+      top_->counter_num_instructions()->GetValue() - entry_instructions_;
+  SetModelsEnabled(false);
+  in_roi_ = false;
+}
+
+uint64_t CheriotRoiControl::roi_instructions() const {
+  if (!in_roi_) return roi_instructions_;
+  return roi_instructions_ + top_->counter_num_instructions()->GetValue() -
+         entry_instructions_;
+}
+
+void CheriotRoiControl::SetModelsEnabled(bool value) {
+  auto *state = top_->state();
+  if (models_ & kICache) top_->set_icache_enabled(value);
+  if ((models_ & kDCache) && (top_->dcache() != nullptr) &&
+      (dcache_memory_ != nullptr)) {
+    state->set_tagged_memory(value ? top_->dcache() : dcache_memory_);
+  }
+  if (models_ & kTagCache) {
+    state->set_tag_cache(value ? top_->tag_cache() : nullptr);
+  }
+  if (models_ & kBranchPredictor) {
+    state->set_branch_predictor(value ? top_->branch_predictor() : nullptr);
+  }
+  if (models_ & kBranchTrace) top_->set_branch_trace_enabled(value);
+  if ((models_ & kInstProfile) && inst_profile_) {
+    top_->counter_pc()->SetIsEnabled(value);
+  }
+  if ((models_ & kMemProfile) && (mem_profiler_ != nullptr)) {
+    mem_profiler_->set_is_enabled(value);
+  }
+  if (models_ & kCounters) {
+    if (value) {
+      top_->EnableStatistics();
+    } else {
+      top_->DisableStatistics();
+    }
+  }
+}
+
+}  // namespace mpact::sim::cheriot
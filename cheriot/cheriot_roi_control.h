@@ -0,0 +1,109 @@
+// Copyright 2024 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef MPACT_CHERIOT_CHERIOT_ROI_CONTROL_H_
+#define MPACT_CHERIOT_CHERIOT_ROI_CONTROL_H_
+
+#include <cstdint>
+#include <optional>
+
+#include "absl/status/status.h"
+#include "absl/strings/string_view.h"
+#include "cheriot/cheriot_memory_use_profiler.h"
+#include "cheriot/cheriot_top.h"
+#include "mpact/sim/util/memory/tagged_memory_interface.h"
+
+// This file defines a controller that scopes the detailed models of a
+// simulator instance to a region of interest (ROI) of the program, for use in
+// batch mode. The ROI is entered when the instruction at the start address is
+// executed, and left when the instruction at the end address is executed. The
+// selected models are detached outside of the ROI, so that the rest of the
+// program (e.g., boot and setup code) runs on the lean path. The ROI may be
+// entered more than once.
+
+namespace mpact::sim::cheriot {
+
+using ::mpact::sim::util::TaggedMemoryInterface;
+
+class CheriotRoiControl {
+ public:
+  // Models that can be scoped to the ROI. Only the models that are configured
+  // are affected.
+  enum Model : uint32_t {
+    kICache = 1 << 0,
+    kDCache = 1 << 1,
+    kTagCache = 1 << 2,
+    kBranchPredictor = 1 << 3,
+    kBranchTrace = 1 << 4,
+    kInstProfile = 1 << 5,
+    kMemProfile = 1 << 6,
+    // The statistics counters, including the instruction and cycle counters.
+    // Note that the clint and the cycle csrs are driven by the cycle counter,
+    // so time stands still outside the ROI.
+    kCounters = 1 << 7,
+  };
+  static constexpr uint32_t kDefaultModels = kICache | kDCache | kTagCache |
+                                             kBranchPredictor | kBranchTrace |
+                                             kInstProfile | kMemProfile;
+
+  // The dcache_memory is the memory interface below the data cache, which the
+  // state uses when the data cache is detached. It is nullptr if there is no
+  // data cache. The mem_profiler is nullptr if memory profiling is not
+  // enabled, and inst_profile is true if instruction profiling is.
+  CheriotRoiControl(CheriotTop *top, TaggedMemoryInterface *dcache_memory,
+                    CheriotMemoryUseProfiler *mem_profiler, bool inst_profile);
+  CheriotRoiControl(const CheriotRoiControl &) = delete;
+  CheriotRoiControl &operator=(const CheriotRoiControl &) = delete;
+
+  // Parses a comma separated list of model names: icache, dcache, tagcache,
+  // bpred, btrace, iprofile, mprofile, counters, or all (the default models).
+  absl::Status SetModels(absl::string_view models);
+
+  // Sets the start and end addresses of the ROI, and detaches the models if
+  // the program starts outside the ROI. If there is no start address, the
+  // program starts inside the ROI. If there is no end address, the ROI lasts
+  // until the end of the program.
+  absl::Status SetRegion(std::optional<uint64_t> start,
+                         std::optional<uint64_t> end);
+
+  // Attach or detach the selected models.
+  void Enter();
+  void Exit();
+
+  // Accessors.
+  uint32_t models() const { return models_; }
+  bool in_roi() const { return in_roi_; }
+  int num_entries() const { return num_entries_; }
+  // Number of instructions executed inside the ROI so far.
+  uint64_t roi_instructions() const;
+
+ private:
+  void SetModelsEnabled(bool value);
+
+  CheriotTop *top_;
+  TaggedMemoryInterface *dcache_memory_;
+  CheriotMemoryUseProfiler *mem_profiler_;
+  bool inst_profile_;
+  uint32_t models_ = kDefaultModels;
+  bool in_roi_ = true;
+  int num_entries_ = 0;
+  // Instruction count at the last entry, and the total of the completed
+  // entries.
+  uint64_t entry_instructions_ = 0;
+  uint64_t roi_instructions_ = 0;
+};
+
+}  // namespace mpact::sim::cheriot
+
+#endif  // MPACT_CHERIOT_CHERIOT_ROI_CONTROL_H_
@@ -18,6 +18,8 @@
 #include <string>
 
 #include "cheriot/cheriot_state.h"
+#include "cheriot/cheriot_vector_overlap.h"
+#include "cheriot/riscv_cheriot_instructions.h"
 #include "cheriot/riscv_cheriot_rvv_decoder.h"
 #include "cheriot/riscv_cheriot_rvv_encoding.h"
 #include "cheriot/riscv_cheriot_rvv_enums.h"
@@ -36,7 +38,7 @@ using ::mpact::sim::generic::operator*;  // NOLINT: is used below (clang error).
 
 CheriotRVVDecoder::CheriotRVVDecoder(CheriotState *state,
                                      util::MemoryInterface *memory)
-    : state_(state), memory_(memory) {
+    : state_(state), memory_(memory), overlap_table_(state) {
   // Need a data buffer to load instructions from memory. Allocate a single
   // buffer that can be reused for each instruction word.
   inst_db_ = db_factory_.Allocate<uint32_t>(1);
@@ -95,6 +97,11 @@ generic::Instruction *CheriotRVVDecoder::DecodeInstruction(uint64_t address) {
   // Call the isa decoder to obtain a new instruction object for the instruction
   // word that was parsed above.
   auto *instruction = cheriot_rvv_isa_->Decode(address, cheriot_rvv_encoding_);
+  SelectCoreVersionSemanticFunction<isa32_rvv::OpcodeEnum>(state_,
+                                                           instruction);
+  // Compute the vector register group overlap properties once, so that the
+  // vector instruction helpers don't have to on each execution.
+  overlap_table_.Annotate(instruction);
   return instruction;
 }
 
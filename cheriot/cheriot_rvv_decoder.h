@@ -21,6 +21,7 @@
 #include <memory>
 
 #include "cheriot/cheriot_state.h"
+#include "cheriot/cheriot_vector_overlap.h"
 #include "cheriot/riscv_cheriot_rvv_decoder.h"
 #include "cheriot/riscv_cheriot_rvv_encoding.h"
 #include "cheriot/riscv_cheriot_rvv_enums.h"
@@ -73,6 +74,14 @@ class CheriotRVVDecoder : public generic::DecoderInterface {
     return isa32_rvv::kOpcodeNames[index];
   }
 
+  // Disables the decode fast paths, i.e., the decode time resolution of CSR
+  // operands and the in place update of vector destinations, e.g., for a
+  // lockstep reference.
+  void DisableFastPaths() {
+    cheriot_rvv_encoding_->set_resolve_csr_operands(false);
+    overlap_table_.set_enabled(false);
+  }
+
   // Getter.
   isa32_rvv::RiscVCheriotRVVEncoding *cheriot_rvv_encoding() const {
     return cheriot_rvv_encoding_;
@@ -86,6 +95,8 @@ class CheriotRVVDecoder : public generic::DecoderInterface {
   isa32_rvv::RiscVCheriotRVVEncoding *cheriot_rvv_encoding_;
   isa32_rvv::RiscVCheriotRVVInstructionSetFactory *cheriot_rvv_isa_factory_;
   isa32_rvv::RiscVCheriotRVVInstructionSet *cheriot_rvv_isa_;
+  // Vector register group overlap properties of the decoded instructions.
+  VectorOverlapTable overlap_table_;
 };
 
 }  // namespace cheriot
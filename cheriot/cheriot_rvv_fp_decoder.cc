@@ -18,6 +18,8 @@
 #include <string>
 
 #include "cheriot/cheriot_state.h"
+#include "cheriot/cheriot_vector_overlap.h"
+#include "cheriot/riscv_cheriot_instructions.h"
 #include "cheriot/riscv_cheriot_rvv_fp_decoder.h"
 #include "cheriot/riscv_cheriot_rvv_fp_encoding.h"
 #include "cheriot/riscv_cheriot_rvv_fp_enums.h"
@@ -36,7 +38,7 @@ using ::mpact::sim::generic::operator*;  // NOLINT: is used below (clang error).
 
 CheriotRVVFPDecoder::CheriotRVVFPDecoder(CheriotState *state,
                                          util::MemoryInterface *memory)
-    : state_(state), memory_(memory) {
+    : state_(state), memory_(memory), overlap_table_(state) {
   // Need a data buffer to load instructions from memory. Allocate a single
   // buffer that can be reused for each instruction word.
   inst_db_ = db_factory_.Allocate<uint32_t>(1);
@@ -96,6 +98,11 @@ generic::Instruction *CheriotRVVFPDecoder::DecodeInstruction(uint64_t address) {
   // word that was parsed above.
   auto *instruction =
       cheriot_rvv_fp_isa_->Decode(address, cheriot_rvv_fp_encoding_);
+  SelectCoreVersionSemanticFunction<isa32_rvv_fp::OpcodeEnum>(state_,
+                                                              instruction);
+  // Compute the vector register group overlap properties once, so that the
+  // vector instruction helpers don't have to on each execution.
+  overlap_table_.Annotate(instruction);
   return instruction;
 }
 
@@ -21,6 +21,7 @@
 #include <memory>
 
 #include "cheriot/cheriot_state.h"
+#include "cheriot/cheriot_vector_overlap.h"
 #include "cheriot/riscv_cheriot_rvv_fp_decoder.h"
 #include "cheriot/riscv_cheriot_rvv_fp_encoding.h"
 #include "cheriot/riscv_cheriot_rvv_fp_enums.h"
@@ -73,6 +74,14 @@ class CheriotRVVFPDecoder : public generic::DecoderInterface {
     return isa32_rvv_fp::kOpcodeNames[index];
   }
 
+  // Disables the decode fast paths, i.e., the decode time resolution of CSR
+  // operands and the in place update of vector destinations, e.g., for a
+  // lockstep reference.
+  void DisableFastPaths() {
+    cheriot_rvv_fp_encoding_->set_resolve_csr_operands(false);
+    overlap_table_.set_enabled(false);
+  }
+
   // Getter.
   isa32_rvv_fp::RiscVCheriotRVVFPEncoding *cheriot_rvv_fp_encoding() const {
     return cheriot_rvv_fp_encoding_;
@@ -87,6 +96,8 @@ class CheriotRVVFPDecoder : public generic::DecoderInterface {
   isa32_rvv_fp::RiscVCheriotRVVFpInstructionSetFactory
       *cheriot_rvv_fp_isa_factory_;
   isa32_rvv_fp::RiscVCheriotRVVFpInstructionSet *cheriot_rvv_fp_isa_;
+  // Vector register group overlap properties of the decoded instructions.
+  VectorOverlapTable overlap_table_;
 };
 
 }  // namespace cheriot
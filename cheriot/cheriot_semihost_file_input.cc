@@ -0,0 +1,238 @@
+// Copyright 2024 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "cheriot/cheriot_semihost_file_input.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <string>
+
+#include "cheriot/cheriot_register.h"
+#include "cheriot/cheriot_reserved_memory.h"
+#include "cheriot/cheriot_state.h"
+#include "mpact/sim/util/memory/tagged_memory_interface.h"
+
+namespace mpact {
+namespace sim {
+namespace cheriot {
+
+namespace {
+
+// SYS_OPEN modes "r" and "rb".
+constexpr uint32_t kModeRead = 0;
+constexpr uint32_t kModeReadBinary = 1;
+constexpr char kConsoleName[] = ":tt";
+
+}  // namespace
+
+CheriotSemihostFileInput::CheriotSemihostFileInput(
+    CheriotState *state, TaggedMemoryInterface *memory,
+    CheriotReservedMemory *reserved_memory, bool use_mmap)
+    : state_(state),
+      memory_(memory),
+      reserved_memory_(reserved_memory),
+      use_mmap_(use_mmap) {
+  a0_ = state_->GetRegister<CheriotRegister>("c10").first;
+  a1_ = state_->GetRegister<CheriotRegister>("c11").first;
+}
+
+CheriotSemihostFileInput::~CheriotSemihostFileInput() {
+  for (auto &[handle, file] : files_) {
+    if (file.data != nullptr) {
+      munmap(const_cast<uint8_t *>(file.data), file.size);
+    }
+    close(file.fd);
+  }
+}
+
+bool CheriotSemihostFileInput::OnSemihostingCall() {
+  uint32_t operation = a0_->address();
+  uint32_t block = a1_->address();
+  if (operation == kSysOpen) {
+    uint32_t result;
+    if (!Open(block, result)) return false;
+    SetResult(result);
+    return true;
+  }
+  if ((operation != kSysClose) && (operation != kSysWrite) &&
+      (operation != kSysRead) && (operation != kSysIsTty) &&
+      (operation != kSysSeek) && (operation != kSysFlen)) {
+    return false;
+  }
+  uint32_t handle = GetParameter(block, 0);
+  File *file = GetFile(handle);
+  if (file == nullptr) return false;
+  switch (operation) {
+    case kSysClose:
+      SetResult(Close(file, handle));
+      break;
+    case kSysWrite:
+      // The file is read only, so nothing is written.
+      SetResult(GetParameter(block, 2));
+      break;
+    case kSysRead:
+      SetResult(Read(file, GetParameter(block, 1), GetParameter(block, 2)));
+      break;
+    case kSysIsTty:
+      SetResult(0);
+      break;
+    case kSysSeek:
+      SetResult(Seek(file, GetParameter(block, 1)));
+      break;
+    case kSysFlen:
+      SetResult(static_cast<uint32_t>(file->size));
+      break;
+  }
+  return true;
+}
+
+uint32_t CheriotSemihostFileInput::GetParameter(uint32_t block, int index) {
+  auto *db = db_factory_.Allocate<uint32_t>(1);
+  memory_->Load(block + index * sizeof(uint32_t), db, nullptr, nullptr);
+  uint32_t value = db->Get<uint32_t>(0);
+  db->DecRef();
+  return value;
+}
+
+CheriotSemihostFileInput::File *CheriotSemihostFileInput::GetFile(
+    uint32_t handle) {
+  auto iter = files_.find(handle);
+  return iter == files_.end() ? nullptr : &iter->second;
+}
+
+void CheriotSemihostFileInput::SetResult(uint32_t value) {
+  a0_->data_buffer()->Set<uint32_t>(0, value);
+  a0_->Invalidate();
+  a0_->set_is_null();
+}
+
+bool CheriotSemihostFileInput::Open(uint32_t block, uint32_t &result) {
+  uint32_t mode = GetParameter(block, 1);
+  if ((mode != kModeRead) && (mode != kModeReadBinary)) return false;
+  uint32_t name_address = GetParameter(block, 0);
+  uint32_t name_length = GetParameter(block, 2);
+  if (name_length == 0) return false;
+  auto *db = db_factory_.Allocate<char>(name_length);
+  memory_->Load(name_address, db, nullptr, nullptr);
+  std::string name(db->Get<char>().data(), name_length);
+  db->DecRef();
+  if (name == kConsoleName) return false;
+  // Let the general handler fail the open, so that it can report the error.
+  int fd = open(name.c_str(), O_RDONLY | O_CLOEXEC);
+  if (fd < 0) return false;
+  struct stat stat_buf;
+  if ((fstat(fd, &stat_buf) != 0) || !S_ISREG(stat_buf.st_mode)) {
+    close(fd);
+    return false;
+  }
+  File file;
+  file.fd = fd;
+  file.size = static_cast<uint64_t>(stat_buf.st_size);
+  if (use_mmap_ && (file.size > 0)) {
+    void *data = mmap(nullptr, file.size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (data != MAP_FAILED) file.data = static_cast<const uint8_t *>(data);
+  }
+  result = next_handle_++;
+  files_.emplace(result, file);
+  return true;
+}
+
+uint32_t CheriotSemihostFileInput::Close(File *file, uint32_t handle) {
+  if (file->data != nullptr) {
+    munmap(const_cast<uint8_t *>(file->data), file->size);
+  }
+  int status = close(file->fd);
+  files_.erase(handle);
+  return status == 0 ? 0 : static_cast<uint32_t>(-1);
+}
+
+uint32_t CheriotSemihostFileInput::Read(File *file, uint32_t address,
+                                        uint32_t length) {
+  uint64_t available =
+      file->position < file->size ? file->size - file->position : 0;
+  uint64_t copied =
+      CopyToMemory(file, address, std::min<uint64_t>(length, available));
+  // SYS_READ returns the number of bytes that were not read.
+  return length - static_cast<uint32_t>(copied);
+}
+
+uint32_t CheriotSemihostFileInput::Seek(File *file, uint32_t position) {
+  if (position > file->size) return static_cast<uint32_t>(-1);
+  file->position = position;
+  return 0;
+}
+
+uint64_t CheriotSemihostFileInput::CopyToMemory(File *file, uint64_t address,
+                                                uint64_t length) {
+  // Reads up to size bytes from the file position to host memory, and returns
+  // the number of bytes read.
+  auto read_file = [file](uint8_t *dest, uint64_t size) -> uint64_t {
+    if (file->data != nullptr) {
+      std::memcpy(dest, file->data + file->position, size);
+      file->position += size;
+      return size;
+    }
+    uint64_t count = 0;
+    while (count < size) {
+      ssize_t result = pread(file->fd, dest + count, size - count,
+                             static_cast<off_t>(file->position));
+      if (result < 0 && errno == EINTR) continue;
+      if (result <= 0) break;
+      count += result;
+      file->position += result;
+    }
+    return count;
+  };
+  // If the buffer is in reserved memory, read straight into it.
+  uint8_t *host = nullptr;
+  if ((reserved_memory_ != nullptr) && (length > 0) &&
+      !excluded_ranges_.Overlaps(address, length)) {
+    host = reserved_memory_->HostPointer(address, length);
+  }
+  if (host != nullptr) {
+    uint64_t count = read_file(host, length);
+    if (count > 0) reserved_memory_->ClearTags(address, count);
+    return count;
+  }
+  // Otherwise store the data in large chunks. Data stores clear the tags.
+  uint64_t copied = 0;
+  while (copied < length) {
+    uint64_t size = std::min<uint64_t>(length - copied, kChunkSize);
+    auto *db = db_factory_.Allocate<uint8_t>(size);
+    uint64_t count = read_file(db->Get<uint8_t>().data(), size);
+    if ((count > 0) && (count < size)) {
+      // Only store the bytes that were read.
+      auto *partial_db = db_factory_.Allocate<uint8_t>(count);
+      std::memcpy(partial_db->raw_ptr(), db->raw_ptr(), count);
+      db->DecRef();
+      db = partial_db;
+    }
+    if (count > 0) memory_->Store(address + copied, db);
+    db->DecRef();
+    copied += count;
+    if (count < size) break;
+  }
+  return copied;
+}
+
+}  // namespace cheriot
+}  // namespace sim
+}  // namespace mpact
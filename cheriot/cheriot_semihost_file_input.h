@@ -0,0 +1,130 @@
+// Copyright 2024 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef MPACT_CHERIOT_CHERIOT_SEMIHOST_FILE_INPUT_H_
+#define MPACT_CHERIOT_CHERIOT_SEMIHOST_FILE_INPUT_H_
+
+#include <cstdint>
+#include <string>
+
+#include "absl/container/flat_hash_map.h"
+#include "cheriot/cheriot_address_ranges.h"
+#include "cheriot/cheriot_register.h"
+#include "cheriot/cheriot_reserved_memory.h"
+#include "cheriot/cheriot_state.h"
+#include "mpact/sim/generic/data_buffer.h"
+#include "mpact/sim/util/memory/tagged_memory_interface.h"
+
+// This file defines a handler for the semihosting calls that read host files.
+// It is called for each semihosting call before the general semihosting
+// handler, and takes over the files that are opened for reading only (modes
+// "r" and "rb"), except for the console (":tt"). The data of SYS_READ is read
+// from the host file straight into simulated memory: when the buffer is in
+// reserved host memory the file is read directly into it, otherwise it is
+// written with a few large stores. In both cases the tags of the written
+// granules are cleared. Optionally, the files are mapped into the host address
+// space instead of being read.
+//
+// The handles of these files are distinct from those of the general handler,
+// so all other calls, and calls on other handles, are left to it.
+
+namespace mpact {
+namespace sim {
+namespace cheriot {
+
+using ::mpact::sim::generic::DataBufferFactory;
+using ::mpact::sim::util::TaggedMemoryInterface;
+
+class CheriotSemihostFileInput {
+ public:
+  // Semihosting operations.
+  static constexpr uint32_t kSysOpen = 0x01;
+  static constexpr uint32_t kSysClose = 0x02;
+  static constexpr uint32_t kSysWrite = 0x05;
+  static constexpr uint32_t kSysRead = 0x06;
+  static constexpr uint32_t kSysIsTty = 0x09;
+  static constexpr uint32_t kSysSeek = 0x0a;
+  static constexpr uint32_t kSysFlen = 0x0c;
+  // Handles returned by this class are kHandleBase + an index.
+  static constexpr uint32_t kHandleBase = 0x4000'0000;
+  // Size of the stores used when the buffer is not in reserved memory.
+  static constexpr int kChunkSize = 1024 * 1024;
+
+  // The memory is used to access the parameter blocks and buffers. If
+  // reserved_memory is not null, reads into buffers that it backs are done in
+  // place. Neither is owned by this class.
+  CheriotSemihostFileInput(CheriotState *state, TaggedMemoryInterface *memory,
+                           CheriotReservedMemory *reserved_memory,
+                           bool use_mmap);
+  CheriotSemihostFileInput(const CheriotSemihostFileInput &) = delete;
+  CheriotSemihostFileInput &operator=(const CheriotSemihostFileInput &) =
+      delete;
+  ~CheriotSemihostFileInput();
+
+  // Reads into these address ranges, e.g., of memory mapped devices, are
+  // never done in place.
+  void set_excluded_ranges(const CheriotAddressRanges &ranges) {
+    excluded_ranges_ = ranges;
+  }
+
+  // Called for each semihosting call. Returns true if the call was handled,
+  // and false if it should be passed on to the general semihosting handler.
+  bool OnSemihostingCall();
+
+  // Returns the number of files taken over so far.
+  uint32_t num_opened() const { return next_handle_ - kHandleBase; }
+
+ private:
+  struct File {
+    int fd = -1;
+    uint64_t size = 0;
+    uint64_t position = 0;
+    // Mapped file contents, or nullptr.
+    const uint8_t *data = nullptr;
+  };
+
+  // Returns the parameter word at the given index of the parameter block.
+  uint32_t GetParameter(uint32_t block, int index);
+  // Returns the file for the handle, or nullptr.
+  File *GetFile(uint32_t handle);
+  // Sets the return value in a0.
+  void SetResult(uint32_t value);
+
+  // Semihosting calls. Open returns false if the file is not taken over,
+  // otherwise it sets the handle in result. The others return the result.
+  bool Open(uint32_t block, uint32_t &result);
+  uint32_t Close(File *file, uint32_t handle);
+  uint32_t Read(File *file, uint32_t address, uint32_t length);
+  uint32_t Seek(File *file, uint32_t position);
+  // Copies length bytes from the file position into simulated memory, and
+  // returns the number of bytes copied.
+  uint64_t CopyToMemory(File *file, uint64_t address, uint64_t length);
+
+  CheriotState *state_;
+  TaggedMemoryInterface *memory_;
+  CheriotReservedMemory *reserved_memory_;
+  bool use_mmap_;
+  CheriotRegister *a0_;
+  CheriotRegister *a1_;
+  DataBufferFactory db_factory_;
+  uint32_t next_handle_ = kHandleBase;
+  absl::flat_hash_map<uint32_t, File> files_;
+  CheriotAddressRanges excluded_ranges_;
+};
+
+}  // namespace cheriot
+}  // namespace sim
+}  // namespace mpact
+
+#endif  // MPACT_CHERIOT_CHERIOT_SEMIHOST_FILE_INPUT_H_
@@ -25,8 +25,12 @@
 #include "absl/flags/flag.h"
 #include "absl/log/check.h"
 #include "absl/log/log.h"
+#include "absl/numeric/bits.h"
 #include "absl/strings/str_cat.h"
+#include "cheriot/cheriot_coverage.h"
 #include "cheriot/cheriot_register.h"
+#include "cheriot/cheriot_reserved_memory.h"
+#include "cheriot/cheriot_tag_cache.h"
 #include "cheriot/riscv_cheriot_csr_enum.h"
 #include "mpact/sim/generic/arch_state.h"
 #include "mpact/sim/generic/type_helpers.h"
@@ -49,6 +53,7 @@ namespace sim {
 namespace cheriot {
 
 using EC = ::mpact::sim::riscv::ExceptionCode;
+using PmpAccess = ::mpact::sim::cheriot::CheriotPmpChecker::Access;
 using PB = ::mpact::sim::cheriot::CheriotRegister::PermissionBits;
 using ::mpact::sim::generic::operator*;  // NOLINT: used below (clang error).
 using ::mpact::sim::riscv::IsaExtension;
@@ -258,6 +263,7 @@ void CreateCsrs(CheriotState *state,
   // PMP CSRs
   state->pmp_ = new RiscVPmp(state);
   state->pmp_->CreatePmpCsrs<T, RiscVCheriotCsrEnum>(state->csr_set());
+  state->pmp_checker_ = new CheriotPmpChecker(state->csr_set());
 
   // Simulator CSRs
 
@@ -275,7 +281,10 @@ CheriotState::CheriotState(std::string_view id,
       tagged_memory_(memory),
       atomic_tagged_memory_(atomic_memory),
       counter_interrupts_taken_("interrupts_taken", 0),
-      counter_interrupt_returns_("interrupt_returns", 0) {
+      counter_interrupt_returns_("interrupt_returns", 0),
+      counter_revoked_on_load_("revoked_on_load", 0),
+      counter_revocation_bits_set_("revocation_bits_set", 0),
+      counter_revocation_bits_cleared_("revocation_bits_cleared", 0) {
   for (auto &[name, index] : std::vector<std::pair<std::string, unsigned>>{
            {"c0", 0b0'00000},   {"c1", 0b0'00001},   {"c2", 0b0'00010},
            {"c3", 0b0'00011},   {"c4", 0b0'00100},   {"c5", 0b0'00101},
@@ -294,6 +303,9 @@ CheriotState::CheriotState(std::string_view id,
   }
   CHECK_OK(AddCounter(&counter_interrupts_taken_));
   CHECK_OK(AddCounter(&counter_interrupt_returns_));
+  CHECK_OK(AddCounter(&counter_revoked_on_load_));
+  CHECK_OK(AddCounter(&counter_revocation_bits_set_));
+  CHECK_OK(AddCounter(&counter_revocation_bits_cleared_));
   // Create root capabilities and the special capability CSRs.
   executable_root_ = new CheriotRegister(this, "executable_root");
   executable_root_->ResetExecuteRoot();
@@ -328,6 +340,8 @@ CheriotState::CheriotState(std::string_view id,
   }
   auto [cgp_reg, unused] = GetRegister<CheriotRegister>("cgp");
   cgp_ = cgp_reg;
+  cra_ = GetRegister<CheriotRegister>("c1").first;
+  ct0_ = GetRegister<CheriotRegister>("c5").first;
   // Create the other CSRs.
   csr_set_ = new RiscVCsrSet();
   CreateCsrs<uint32_t>(this, csr_vec_);
@@ -348,6 +362,7 @@ CheriotState::~CheriotState() {
   delete pc_src_operand_;
   for (auto *csr : csr_vec_) delete csr;
   delete csr_set_;
+  delete pmp_checker_;
   delete pmp_;
   delete temp_reg_;
   revocation_db_->DecRef();
@@ -388,6 +403,11 @@ void CheriotState::HandleCheriRegException(const Instruction *instruction,
     cap_index = iter->second;
   }
   mtval |= cap_index << 5;
+  if (coverage_ != nullptr) {
+    coverage_->CheriException(
+        instruction == nullptr ? 0 : instruction->opcode(), *code,
+        reg->GetPermissionFormat(), reg->object_type());
+  }
   Trap(/*is_interrupt*/ false, mtval, mcause, epc, instruction);
 }
 
@@ -416,6 +436,15 @@ void CheriotState::LoadCapability(const Instruction *instruction,
          instruction == nullptr ? 0 : instruction->address(), instruction);
     return;
   }
+  // Check the PMP permissions.
+  if (!CheckPmp(address, db->size<uint8_t>(), PmpAccess::kRead)) {
+    Trap(/*is_interrupt*/ false, address, *EC::kLoadAccessFault,
+         instruction == nullptr ? 0 : instruction->address(), instruction);
+    return;
+  }
+  if (tag_cache_ != nullptr) {
+    tag_cache_->ReadTags(address, db->size<uint8_t>());
+  }
   // Forward the load.
   tagged_memory_->Load(address, db, tags, child, context);
   if (!tracing_active_) return;
@@ -442,10 +471,19 @@ void CheriotState::StoreCapability(const Instruction *instruction,
          instruction == nullptr ? 0 : instruction->address(), instruction);
     return;
   }
+  // Check the PMP permissions.
+  if (!CheckPmp(address, db->size<uint8_t>(), PmpAccess::kWrite)) {
+    Trap(/*is_interrupt*/ false, address, *EC::kStoreAccessFault,
+         instruction == nullptr ? 0 : instruction->address(), instruction);
+    return;
+  }
   // Check for stack accesses relative to mshwm/mshwmb.
   if ((address >= mshwmb_->GetUint32()) && (address < mshwm_->GetUint32())) {
     mshwm_->Set(address);
   }
+  if (tag_cache_ != nullptr) {
+    tag_cache_->WriteTags(address, db->size<uint8_t>());
+  }
   // Forward the store.
   tagged_memory_->Store(address, db, tags);
   if (!tracing_active_) return;
@@ -465,6 +503,12 @@ void CheriotState::LoadMemory(const Instruction *inst, uint64_t address,
          inst == nullptr ? 0 : inst->address(), inst);
     return;
   }
+  // Check the PMP permissions.
+  if (!CheckPmp(address, db->size<uint8_t>(), PmpAccess::kRead)) {
+    Trap(/*is_interrupt*/ false, address, *EC::kLoadAccessFault,
+         inst == nullptr ? 0 : inst->address(), inst);
+    return;
+  }
   // Forward the load.
   tagged_memory_->Load(address, db, child_inst, context);
   if (!tracing_active_) return;
@@ -488,6 +532,12 @@ void CheriotState::LoadMemory(const Instruction *inst, DataBuffer *address_db,
       return;
     }
   }
+  // Check the PMP permissions of the active elements.
+  if (pmp_enabled_ &&
+      !CheckVectorPmp(address_db, mask_db, el_size, PmpAccess::kRead,
+                      *EC::kLoadAccessFault, inst)) {
+    return;
+  }
   // Forward the load.
   tagged_memory_->Load(address_db, mask_db, el_size, db, child_inst, context);
 }
@@ -500,12 +550,24 @@ void CheriotState::StoreMemory(const Instruction *inst, uint64_t address,
          inst == nullptr ? 0 : inst->address(), inst);
     return;
   }
+  // Check the PMP permissions.
+  if (!CheckPmp(address, db->size<uint8_t>(), PmpAccess::kWrite)) {
+    Trap(/*is_interrupt*/ false, address, *EC::kStoreAccessFault,
+         inst == nullptr ? 0 : inst->address(), inst);
+    return;
+  }
   // Check for stack accesses relative to mshwm/mshwmb.
   uint32_t address32 = static_cast<uint32_t>(address);
   if ((address32 >= mshwmb_->GetUint32()) &&
       (address32 < mshwm_->GetUint32())) {
     mshwm_->Set(address32);
   }
+  // Data stores clear the tags of the granules they write.
+  if (tag_cache_ != nullptr) {
+    tag_cache_->WriteTags(address, db->size<uint8_t>());
+  }
+  CountRevocationBitChanges(address, db->Get<uint8_t>().data(),
+                            db->size<uint8_t>());
   // Forward the store.
   tagged_memory_->Store(address, db);
   if (!tracing_active_) return;
@@ -528,6 +590,12 @@ void CheriotState::StoreMemory(const Instruction *inst, DataBuffer *address_db,
       return;
     }
   }
+  // Check the PMP permissions of the active elements.
+  if (pmp_enabled_ &&
+      !CheckVectorPmp(address_db, mask_db, el_size, PmpAccess::kWrite,
+                      *EC::kStoreAccessFault, inst)) {
+    return;
+  }
   // Check for stack accesses relative to mshwm/mshwmb.
   for (auto address : address_db->Get<uint64_t>()) {
     uint32_t address32 = static_cast<uint32_t>(address);
@@ -536,10 +604,79 @@ void CheriotState::StoreMemory(const Instruction *inst, DataBuffer *address_db,
       mshwm_->Set(address32);
     }
   }
+  auto mask = mask_db->Get<bool>();
+  auto addresses = address_db->Get<uint64_t>();
+  // Data stores clear the tags of the granules they write.
+  if (tag_cache_ != nullptr) {
+    for (int i = 0; i < addresses.size(); i++) {
+      if (mask[i]) tag_cache_->WriteTags(addresses[i], el_size);
+    }
+  }
+  // Count the revocation bits changed by each active element.
+  auto *bytes = db->Get<uint8_t>().data();
+  for (int i = 0; i < addresses.size(); i++) {
+    if (mask[i]) {
+      CountRevocationBitChanges(addresses[i], bytes + i * el_size, el_size);
+    }
+  }
   // Forward the store.
   tagged_memory_->Store(address_db, mask_db, el_size, db);
 }
 
+bool CheriotState::CheckVectorPmp(DataBuffer *address_db,
+                                  DataBuffer *mask_db, int el_size,
+                                  PmpAccess access, uint64_t exception_code,
+                                  const Instruction *inst) {
+  auto mask = mask_db->Get<bool>();
+  auto addresses = address_db->Get<uint64_t>();
+  for (int i = 0; i < addresses.size(); i++) {
+    if (!mask[i] || CheckPmp(addresses[i], el_size, access)) continue;
+    Trap(/*is_interrupt*/ false, addresses[i], exception_code,
+         inst == nullptr ? 0 : inst->address(), inst);
+    return false;
+  }
+  return true;
+}
+
+uint8_t *CheriotState::GetAmoHostPointer(uint64_t address, int size) {
+  if ((amo_memory_ == nullptr) || !amo_direct_enabled_) return nullptr;
+  // Misaligned operations take the regular path.
+  if ((address & (size - 1)) != 0) return nullptr;
+  if (amo_excluded_ranges_.Overlaps(address, size)) return nullptr;
+  uint8_t *host = amo_memory_->HostPointer(address, size);
+  if (host != nullptr) amo_memory_->ClearTags(address, size);
+  return host;
+}
+
+// The revocation bitmap is assumed to cover the memory from the revocation
+// ram base up to the start of the bitmap itself.
+void CheriotState::CountRevocationBitChanges(uint64_t address,
+                                             const uint8_t *bytes, int size) {
+  if (revocation_mem_base_ <= revocation_ram_base_) return;
+  uint64_t bitmap_end = revocation_mem_base_ +
+                        ((revocation_mem_base_ - revocation_ram_base_) >> 6);
+  if ((address + size <= revocation_mem_base_) || (address >= bitmap_end)) {
+    return;
+  }
+  auto *old_db = db_factory()->Allocate<uint8_t>(size);
+  // Read the old bits past any cache model, so they do not affect its stats.
+  uncached_memory()->Load(address, old_db, nullptr, nullptr);
+  auto old_bytes = old_db->Get<uint8_t>();
+  int64_t set = 0;
+  int64_t cleared = 0;
+  for (int i = 0; i < size; i++) {
+    uint64_t byte_address = address + i;
+    if ((byte_address < revocation_mem_base_) || (byte_address >= bitmap_end)) {
+      continue;
+    }
+    set += absl::popcount(static_cast<uint8_t>(~old_bytes[i] & bytes[i]));
+    cleared += absl::popcount(static_cast<uint8_t>(old_bytes[i] & ~bytes[i]));
+  }
+  old_db->DecRef();
+  if (set > 0) counter_revocation_bits_set_.Increment(set);
+  if (cleared > 0) counter_revocation_bits_cleared_.Increment(cleared);
+}
+
 void CheriotState::DbgStoreMemory(uint64_t address, DataBuffer *db) {
   tagged_memory_->Store(address, db);
 }
@@ -628,6 +765,10 @@ void CheriotState::Trap(bool is_interrupt, uint64_t trap_value,
                         const Instruction *inst) {
   // LOG(INFO) << "Trap: " << std::hex << is_interrupt << " " << trap_value
   //  << " " << exception_code << " " << epc;  // Call the handler.
+  if (coverage_ != nullptr) {
+    coverage_->Trap(is_interrupt, inst == nullptr ? 0 : inst->opcode(),
+                    exception_code);
+  }
   if (on_trap_ != nullptr) {
     bool res = on_trap_(is_interrupt, trap_value, exception_code, epc, inst);
     // If the handler returns true, the trap has been handled. Just return.
@@ -783,6 +924,9 @@ bool CheriotState::MustRevoke(uint32_t address) const {
   if (revocation_address < revocation_ram_base()) return false;
   uint64_t offset = (revocation_address - revocation_ram_base());
   uint64_t revocation_offset = offset >> 6;
+  if (tag_cache_ != nullptr) {
+    tag_cache_->LookupRevocationBit(revocation_address);
+  }
   tagged_memory_->Load(revocation_mem_base() + revocation_offset,
                        revocation_db_, nullptr, nullptr);
   uint8_t revocation_bits = revocation_db_->Get<uint8_t>(0);
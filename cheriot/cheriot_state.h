@@ -30,6 +30,8 @@
 #include "absl/status/status.h"
 #include "absl/strings/str_cat.h"
 #include "absl/strings/string_view.h"
+#include "cheriot/cheriot_address_ranges.h"
+#include "cheriot/cheriot_pmp_checker.h"
 #include "mpact/sim/generic/arch_state.h"
 #include "mpact/sim/generic/counters.h"
 #include "mpact/sim/generic/data_buffer.h"
@@ -78,8 +80,13 @@ using ::mpact::sim::riscv::RiscVSimpleCsr;
 using ::mpact::sim::riscv::RVVectorRegister;
 
 // Forward declare the CHERIoT register type.
+class CheriotBranchPredictor;
+class CheriotCoverage;
 class CheriotRegister;
+class CheriotReservedMemory;
+class CheriotTagCache;
 class CheriotVectorState;
+class VectorOverlapTable;
 
 // CHERIoT exception codes. These are used in addition to the ones defined for
 // vanilla RiscV.
@@ -320,6 +327,19 @@ class CheriotState : public generic::ArchState {
     return &counter_interrupt_returns_;
   }
 
+  // Revocation counters: capabilities invalidated on load because the
+  // revocation bit for their base is set, and the number of revocation bitmap
+  // bits set and cleared by stores.
+  SimpleCounter<int64_t> *counter_revoked_on_load() {
+    return &counter_revoked_on_load_;
+  }
+  SimpleCounter<int64_t> *counter_revocation_bits_set() {
+    return &counter_revocation_bits_set_;
+  }
+  SimpleCounter<int64_t> *counter_revocation_bits_cleared() {
+    return &counter_revocation_bits_cleared_;
+  }
+
   // Returns true if a capability register with the given base should be
   // revoked.
   bool MustRevoke(uint32_t address) const;
@@ -341,6 +361,15 @@ class CheriotState : public generic::ArchState {
     tagged_memory_ = tagged_memory;
   }
   util::TaggedMemoryInterface *tagged_memory() const { return tagged_memory_; }
+  // Optional memory behind any cache model interposed in the tagged memory
+  // port. Accesses the simulator makes for its own bookkeeping use it so that
+  // they are not seen by the cache model. It is not owned by the state.
+  void set_uncached_memory(util::TaggedMemoryInterface *uncached_memory) {
+    uncached_memory_ = uncached_memory;
+  }
+  util::TaggedMemoryInterface *uncached_memory() const {
+    return uncached_memory_ != nullptr ? uncached_memory_ : tagged_memory_;
+  }
   util::AtomicMemoryOpInterface *atomic_tagged_memory() const {
     return atomic_tagged_memory_;
   }
@@ -348,6 +377,51 @@ class CheriotState : public generic::ArchState {
       util::AtomicMemoryOpInterface *atomic_tagged_memory) {
     atomic_tagged_memory_ = atomic_tagged_memory;
   }
+  // Optional tag controller cache model. It is not owned by the state.
+  CheriotTagCache *tag_cache() const { return tag_cache_; }
+  void set_tag_cache(CheriotTagCache *tag_cache) { tag_cache_ = tag_cache; }
+  // Optional branch predictor model. It is not owned by the state.
+  CheriotBranchPredictor *branch_predictor() const {
+    return branch_predictor_;
+  }
+  void set_branch_predictor(CheriotBranchPredictor *branch_predictor) {
+    branch_predictor_ = branch_predictor;
+  }
+  // Optional ISA coverage collector. It is not owned by the state.
+  CheriotCoverage *coverage() const { return coverage_; }
+  void set_coverage(CheriotCoverage *coverage) { coverage_ = coverage; }
+  // Optional host backed memory that atomic memory operations (other than
+  // lr/sc) access in place, bypassing the atomic memory interface. It must be
+  // the memory the data accesses are routed to for addresses in its range,
+  // except for the excluded ranges (e.g., memory mapped devices). It is not
+  // owned by the state.
+  CheriotReservedMemory *amo_memory() const { return amo_memory_; }
+  void set_amo_memory(CheriotReservedMemory *amo_memory) {
+    amo_memory_ = amo_memory;
+  }
+  // Atomic memory operations on these ranges always take the regular path.
+  void set_amo_excluded_ranges(const CheriotAddressRanges &ranges) {
+    amo_excluded_ranges_ = ranges;
+  }
+  // The direct path is disabled while something (e.g., a data watchpoint)
+  // needs to observe atomic memory operations.
+  void set_amo_direct_enabled(bool value) { amo_direct_enabled_ = value; }
+  // Returns the host address of the size bytes at address if an atomic memory
+  // operation can be performed on them in place, otherwise nullptr. The tags
+  // of the granule are cleared, as the operation always writes.
+  uint8_t *GetAmoHostPointer(uint64_t address, int size);
+  // PMP checking of loads, stores and instruction fetches. It is disabled by
+  // default.
+  bool pmp_enabled() const { return pmp_enabled_; }
+  void set_pmp_enabled(bool value) { pmp_enabled_ = value; }
+  CheriotPmpChecker *pmp_checker() const { return pmp_checker_; }
+  // Returns true if the access is permitted by the PMP configuration for the
+  // current privilege mode.
+  bool CheckPmp(uint64_t address, int size, CheriotPmpChecker::Access access) {
+    return !pmp_enabled_ ||
+           pmp_checker_->Check(address, size, privilege_mode_, access);
+  }
+  PrivilegeMode privilege_mode() const { return privilege_mode_; }
 
   void set_branch(bool value) { branch_ = value; }
   bool branch() const { return branch_; }
@@ -365,6 +439,10 @@ class CheriotState : public generic::ArchState {
   // capability that is aliased with c3.
   CheriotRegister *pcc() const { return pcc_; }
   CheriotRegister *cgp() const { return cgp_; }
+  // Returns true if reg is one of the link registers, cra (c1) or ct0 (c5).
+  bool IsLinkRegister(const CheriotRegister *reg) const {
+    return (reg == cra_) || (reg == ct0_);
+  }
   // True if the misa register encodes support for compact instructions.
   bool has_compact() const {
     return (misa_->AsUint64() & *IsaExtension::kCompressed) != 0;
@@ -401,6 +479,12 @@ class CheriotState : public generic::ArchState {
   void set_rv_fp(RiscVFPState *rv_fp) { rv_fp_ = rv_fp; }
   CheriotVectorState *rv_vector() { return rv_vector_; }
   void set_rv_vector(CheriotVectorState *rv_vector) { rv_vector_ = rv_vector; }
+  VectorOverlapTable *vector_overlap_table() const {
+    return vector_overlap_table_;
+  }
+  void set_vector_overlap_table(VectorOverlapTable *table) {
+    vector_overlap_table_ = table;
+  }
   void set_vector_register_width(int value) { vector_register_width_ = value; }
   int vector_register_width() const { return vector_register_width_; }
   RiscVMStatus *mstatus() { return mstatus_; }
@@ -436,6 +520,15 @@ class CheriotState : public generic::ArchState {
 
  private:
   InterruptCode PickInterrupt(uint32_t interrupts);
+  // Updates the revocation bitmap counters for a store of size bytes to
+  // address if the store writes to the revocation bitmap.
+  void CountRevocationBitChanges(uint64_t address, const uint8_t *bytes,
+                                 int size);
+  // Checks the PMP permissions of the active elements of a vector access and
+  // raises the given exception for the first element that fails.
+  bool CheckVectorPmp(DataBuffer *address_db, DataBuffer *mask_db,
+                      int el_size, CheriotPmpChecker::Access access,
+                      uint64_t exception_code, const Instruction *inst);
   // Core version. Expressed as an integer where as version * 100. Thus
   // version 1.0 is 100, and 1.5 is 150. Default is 1.0 (or 100).
   int core_version_ = kVersion1Dot0;
@@ -448,13 +541,22 @@ class CheriotState : public generic::ArchState {
   // Special capability registers.
   CheriotRegister *pcc_ = nullptr;
   CheriotRegister *cgp_ = nullptr;
+  CheriotRegister *cra_ = nullptr;
+  CheriotRegister *ct0_ = nullptr;
   bool branch_ = false;
   int vector_register_width_ = 0;
   uint64_t max_physical_address_;
   uint64_t min_physical_address_ = 0;
   int num_tags_per_load_;
   util::TaggedMemoryInterface *tagged_memory_;
+  util::TaggedMemoryInterface *uncached_memory_ = nullptr;
   util::AtomicMemoryOpInterface *atomic_tagged_memory_;
+  CheriotTagCache *tag_cache_ = nullptr;
+  CheriotBranchPredictor *branch_predictor_ = nullptr;
+  CheriotCoverage *coverage_ = nullptr;
+  CheriotReservedMemory *amo_memory_ = nullptr;
+  CheriotAddressRanges amo_excluded_ranges_;
+  bool amo_direct_enabled_ = true;
   RiscVCsrSet *csr_set_;
   std::vector<absl::AnyInvocable<bool(const Instruction *)>> on_ebreak_;
   absl::AnyInvocable<bool(const Instruction *)> on_ecall_;
@@ -466,10 +568,15 @@ class CheriotState : public generic::ArchState {
   std::vector<RiscVCsrInterface *> csr_vec_;
   RiscVFPState *rv_fp_ = nullptr;
   CheriotVectorState *rv_vector_ = nullptr;
+  // Vector register group overlap properties of the decoded instructions.
+  VectorOverlapTable *vector_overlap_table_ = nullptr;
   // For interrupt handling.
   bool is_interrupt_available_ = false;
   SimpleCounter<int64_t> counter_interrupts_taken_;
   SimpleCounter<int64_t> counter_interrupt_returns_;
+  SimpleCounter<int64_t> counter_revoked_on_load_;
+  SimpleCounter<int64_t> counter_revocation_bits_set_;
+  SimpleCounter<int64_t> counter_revocation_bits_cleared_;
   InterruptCode available_interrupt_code_ = InterruptCode::kNone;
   InterruptInfoList interrupt_info_list_;
   // By default, execute in machine mode.
@@ -487,6 +594,8 @@ class CheriotState : public generic::ArchState {
   CheriotRegister *mtdc_ = nullptr;
   CheriotRegister *temp_reg_ = nullptr;
   RiscVPmp *pmp_ = nullptr;
+  CheriotPmpChecker *pmp_checker_ = nullptr;
+  bool pmp_enabled_ = false;
   RiscVCsrInterface *mtval_ = nullptr;
   RiscVCsrInterface *mcause_ = nullptr;
   RiscVCheri32PcSourceOperand *pc_src_operand_ = nullptr;
@@ -0,0 +1,164 @@
+// Copyright 2024 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "cheriot/cheriot_tag_cache.h"
+
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "absl/log/check.h"
+#include "absl/numeric/bits.h"
+#include "absl/status/status.h"
+#include "absl/strings/numbers.h"
+#include "absl/strings/str_cat.h"
+#include "absl/strings/str_split.h"
+#include "absl/strings/string_view.h"
+#include "mpact/sim/generic/component.h"
+
+namespace mpact {
+namespace sim {
+namespace cheriot {
+
+// Each tag bit covers a granule of this many bytes.
+constexpr int kGranuleSizeInBytes = 8;
+
+CheriotTagCache::CheriotTagCache(std::string name, Component *parent)
+    : Component(std::move(name), parent),
+      read_hits_("read_hits", 0),
+      read_misses_("read_misses", 0),
+      write_hits_("write_hits", 0),
+      write_misses_("write_misses", 0),
+      revocation_hits_("revocation_hits", 0),
+      revocation_misses_("revocation_misses", 0),
+      writebacks_("writebacks", 0) {
+  CHECK_OK(AddCounter(&read_hits_));
+  CHECK_OK(AddCounter(&read_misses_));
+  CHECK_OK(AddCounter(&write_hits_));
+  CHECK_OK(AddCounter(&write_misses_));
+  CHECK_OK(AddCounter(&revocation_hits_));
+  CHECK_OK(AddCounter(&revocation_misses_));
+  CHECK_OK(AddCounter(&writebacks_));
+}
+
+CheriotTagCache::CheriotTagCache(std::string name)
+    : CheriotTagCache(std::move(name), nullptr) {}
+
+absl::Status CheriotTagCache::Configure(const std::string &config) {
+  if (is_configured()) {
+    return absl::FailedPreconditionError("Tag cache already configured");
+  }
+  std::vector<absl::string_view> values = absl::StrSplit(config, ',');
+  if (values.size() != 3) {
+    return absl::InvalidArgumentError(absl::StrCat(
+        "Tag cache configuration '", config,
+        "' must have the format <size>,<line coverage>,<associativity>"));
+  }
+  uint64_t size;
+  uint64_t coverage;
+  uint64_t ways;
+  if (!absl::SimpleAtoi(values[0], &size) ||
+      !absl::SimpleAtoi(values[1], &coverage) ||
+      !absl::SimpleAtoi(values[2], &ways)) {
+    return absl::InvalidArgumentError(
+        absl::StrCat("Invalid tag cache configuration: '", config, "'"));
+  }
+  if (!absl::has_single_bit(size) || !absl::has_single_bit(coverage) ||
+      !absl::has_single_bit(ways)) {
+    return absl::InvalidArgumentError(absl::StrCat(
+        "Tag cache size, line coverage and associativity must be powers of "
+        "two: '",
+        config, "'"));
+  }
+  // Number of bytes of data covered by one byte of tags.
+  constexpr uint64_t kCoveragePerTagByte = kGranuleSizeInBytes * 8;
+  if (coverage < kCoveragePerTagByte) {
+    return absl::InvalidArgumentError(absl::StrCat(
+        "Tag cache line coverage must be at least ", kCoveragePerTagByte));
+  }
+  uint64_t line_size = coverage / kCoveragePerTagByte;
+  uint64_t num_lines = size / line_size;
+  if ((num_lines == 0) || (num_lines < ways)) {
+    return absl::InvalidArgumentError(absl::StrCat(
+        "Tag cache size ", size, " is too small for ", ways, " ways of ",
+        line_size, " byte lines"));
+  }
+  num_ways_ = ways;
+  num_sets_ = num_lines / ways;
+  line_shift_ = absl::countr_zero(coverage);
+  lines_.resize(num_lines);
+  return absl::OkStatus();
+}
+
+void CheriotTagCache::ReadTags(uint64_t address, int size) {
+  Access(address, size, /*is_write=*/false, /*is_revocation=*/false);
+}
+
+void CheriotTagCache::WriteTags(uint64_t address, int size) {
+  Access(address, size, /*is_write=*/true, /*is_revocation=*/false);
+}
+
+void CheriotTagCache::LookupRevocationBit(uint64_t address) {
+  Access(address, kGranuleSizeInBytes, /*is_write=*/false,
+         /*is_revocation=*/true);
+}
+
+void CheriotTagCache::Access(uint64_t address, int size, bool is_write,
+                             bool is_revocation) {
+  if (!is_configured() || (size <= 0)) return;
+  uint64_t first = address >> line_shift_;
+  uint64_t last = (address + size - 1) >> line_shift_;
+  for (uint64_t line = first; line <= last; line++) {
+    uint64_t key = (line << 1) | (is_revocation ? 1 : 0);
+    bool hit = AccessLine(key, is_write);
+    if (is_revocation) {
+      (hit ? revocation_hits_ : revocation_misses_).Increment(1);
+    } else if (is_write) {
+      (hit ? write_hits_ : write_misses_).Increment(1);
+    } else {
+      (hit ? read_hits_ : read_misses_).Increment(1);
+    }
+  }
+}
+
+bool CheriotTagCache::AccessLine(uint64_t key, bool is_write) {
+  // The set index skips the revocation bit of the key so that the tag and
+  // revocation lines for the same region map to the same set.
+  int set = (key >> 1) & (num_sets_ - 1);
+  Line *ways = &lines_[set * num_ways_];
+  use_count_++;
+  Line *victim = &ways[0];
+  for (int i = 0; i < num_ways_; i++) {
+    Line &line = ways[i];
+    if (line.valid && (line.key == key)) {
+      line.last_use = use_count_;
+      line.dirty |= is_write;
+      return true;
+    }
+    // Prefer an invalid line, otherwise the least recently used one.
+    if (!victim->valid) continue;
+    if (!line.valid || (line.last_use < victim->last_use)) victim = &line;
+  }
+  if (victim->valid && victim->dirty) writebacks_.Increment(1);
+  victim->valid = true;
+  victim->dirty = is_write;
+  victim->key = key;
+  victim->last_use = use_count_;
+  return false;
+}
+
+}  // namespace cheriot
+}  // namespace sim
+}  // namespace mpact
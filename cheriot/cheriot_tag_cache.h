@@ -0,0 +1,117 @@
+// Copyright 2024 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef MPACT_CHERIOT_CHERIOT_TAG_CACHE_H_
+#define MPACT_CHERIOT_CHERIOT_TAG_CACHE_H_
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "absl/status/status.h"
+#include "mpact/sim/generic/component.h"
+#include "mpact/sim/generic/counters.h"
+
+// This file defines a model of the cache in front of the tag table in the
+// CHERIoT tag controller. The tag table holds one tag bit per 8 byte
+// capability granule of memory, and the revocation bitmap holds one bit per
+// 8 byte granule of the revocable heap. Both are cached in lines that each
+// cover a fixed number of bytes of data memory.
+//
+// The model only tracks hits, misses and write-backs. It does not hold any
+// tag values, and does not affect the timing or the results of the
+// simulation.
+
+namespace mpact {
+namespace sim {
+namespace cheriot {
+
+using ::mpact::sim::generic::Component;
+using ::mpact::sim::generic::SimpleCounter;
+
+class CheriotTagCache : public Component {
+ public:
+  CheriotTagCache(std::string name, Component *parent);
+  explicit CheriotTagCache(std::string name);
+  CheriotTagCache(const CheriotTagCache &) = delete;
+  CheriotTagCache &operator=(const CheriotTagCache &) = delete;
+  ~CheriotTagCache() override = default;
+
+  // Configures the cache. The configuration string has the format:
+  //   <size>,<line coverage>,<associativity>
+  // where size is the number of bytes of tag storage in the cache, line
+  // coverage is the number of bytes of data memory covered by each line, and
+  // associativity is the number of ways. All values must be powers of two,
+  // and line coverage must be at least 64 (one byte of tags).
+  absl::Status Configure(const std::string &config);
+
+  // Tag reads for capability loads of size bytes at address.
+  void ReadTags(uint64_t address, int size);
+  // Tag writes for capability stores and data stores (which clear the tags)
+  // of size bytes at address.
+  void WriteTags(uint64_t address, int size);
+  // Revocation bitmap lookup for the capability granule at address.
+  void LookupRevocationBit(uint64_t address);
+
+  // Accessors.
+  bool is_configured() const { return !lines_.empty(); }
+  int num_sets() const { return num_sets_; }
+  int num_ways() const { return num_ways_; }
+  uint64_t line_coverage() const { return uint64_t{1} << line_shift_; }
+  SimpleCounter<uint64_t> *counter_read_hits() { return &read_hits_; }
+  SimpleCounter<uint64_t> *counter_read_misses() { return &read_misses_; }
+  SimpleCounter<uint64_t> *counter_write_hits() { return &write_hits_; }
+  SimpleCounter<uint64_t> *counter_write_misses() { return &write_misses_; }
+  SimpleCounter<uint64_t> *counter_revocation_hits() {
+    return &revocation_hits_;
+  }
+  SimpleCounter<uint64_t> *counter_revocation_misses() {
+    return &revocation_misses_;
+  }
+  SimpleCounter<uint64_t> *counter_writebacks() { return &writebacks_; }
+
+ private:
+  struct Line {
+    bool valid = false;
+    bool dirty = false;
+    uint64_t key = 0;
+    uint64_t last_use = 0;
+  };
+
+  // Accesses the lines covering [address, address + size). Revocation bitmap
+  // lines use a separate key space from tag lines.
+  void Access(uint64_t address, int size, bool is_write, bool is_revocation);
+  // Looks up a single line, allocating it on a miss. Returns true on a hit.
+  bool AccessLine(uint64_t key, bool is_write);
+
+  int num_sets_ = 0;
+  int num_ways_ = 0;
+  int line_shift_ = 0;
+  uint64_t use_count_ = 0;
+  std::vector<Line> lines_;
+
+  SimpleCounter<uint64_t> read_hits_;
+  SimpleCounter<uint64_t> read_misses_;
+  SimpleCounter<uint64_t> write_hits_;
+  SimpleCounter<uint64_t> write_misses_;
+  SimpleCounter<uint64_t> revocation_hits_;
+  SimpleCounter<uint64_t> revocation_misses_;
+  SimpleCounter<uint64_t> writebacks_;
+};
+
+}  // namespace cheriot
+}  // namespace sim
+}  // namespace mpact
+
+#endif  // MPACT_CHERIOT_CHERIOT_TAG_CACHE_H_
@@ -22,6 +22,7 @@
 #include "cheriot/riscv_cheriot_decoder.h"
 #include "cheriot/riscv_cheriot_encoding.h"
 #include "cheriot/riscv_cheriot_enums.h"
+#include "cheriot/riscv_cheriot_instructions.h"
 #include "mpact/sim/generic/instruction.h"
 #include "mpact/sim/generic/program_error.h"
 #include "mpact/sim/generic/type_helpers.h"
@@ -245,6 +246,7 @@ generic::Instruction *CheriotTestRigDecoder::DecodeInstruction(
   // Call the isa decoder to obtain a new instruction object for the instruction
   // word that was parsed above.
   auto *instruction = cheriot_isa_->Decode(address, cheriot_encoding_);
+  SelectCoreVersionSemanticFunction<OpcodeEnum>(state_, instruction);
   // For these formats, sail does not populate the rs1/rs2 address fields.
   if (format == FormatEnum::kIType || format == FormatEnum::kI5Type ||
       format == FormatEnum::kR2Type || format == FormatEnum::kCB ||
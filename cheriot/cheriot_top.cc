@@ -14,12 +14,19 @@
 
 #include "cheriot/cheriot_top.h"
 
+#include <sys/eventfd.h>
+#include <unistd.h>
+
 #include <algorithm>
+#include <atomic>
+#include <cerrno>
 #include <cstdint>
 #include <cstring>
+#include <limits>
 #include <string>
 #include <thread>  // NOLINT: third party code.
 #include <utility>
+#include <vector>
 
 #include "absl/functional/any_invocable.h"
 #include "absl/functional/bind_front.h"
@@ -29,10 +36,15 @@
 #include "absl/status/status.h"
 #include "absl/strings/str_cat.h"
 #include "absl/strings/str_format.h"
+#include "absl/synchronization/mutex.h"
 #include "absl/synchronization/notification.h"
+#include "cheriot/cheriot_branch_predictor.h"
+#include "cheriot/cheriot_coverage.h"
 #include "cheriot/cheriot_debug_interface.h"
+#include "cheriot/cheriot_pmp_checker.h"
 #include "cheriot/cheriot_register.h"
 #include "cheriot/cheriot_state.h"
+#include "cheriot/cheriot_tag_cache.h"
 #include "cheriot/riscv_cheriot_register_aliases.h"
 #include "mpact/sim/generic/action_point_manager_base.h"
 #include "mpact/sim/generic/breakpoint_manager.h"
@@ -53,6 +65,7 @@
 #include "riscv//riscv_action_point_memory_interface.h"
 #include "riscv//riscv_csr.h"
 #include "riscv//riscv_register.h"
+#include "riscv//riscv_state.h"
 
 namespace mpact {
 namespace sim {
@@ -62,7 +75,9 @@ using ::mpact::sim::generic::ActionPointManagerBase;
 using ::mpact::sim::generic::BreakpointManager;
 using ::mpact::sim::riscv::RiscVActionPointMemoryInterface;
 using ::mpact::sim::util::Cache;
+using ::mpact::sim::generic::operator*;  // NOLINT: used below (clang error).
 using EC = ::mpact::sim::cheriot::ExceptionCode;
+using RV_EC = ::mpact::sim::riscv::ExceptionCode;
 using PB = ::mpact::sim::cheriot::CheriotRegister::PermissionBits;
 
 CheriotTop::CheriotTop(std::string name, CheriotState *state,
@@ -76,7 +91,9 @@ CheriotTop::CheriotTop(std::string name, CheriotState *state,
       cap_reg_re_{
           R"((\w+)\.(top|base|length|tag|permissions|object_type|reserved))"},
       icache_config_("icache", ""),
-      dcache_config_("dcache", "") {
+      dcache_config_("dcache", ""),
+      tag_cache_config_("tagcache", ""),
+      branch_predictor_config_("branch_predictor", "") {
   CHECK_OK(AddChildComponent(*state_));
   // Register icache configuration, and set a callback for when the config
   // entry is written to.
@@ -88,22 +105,41 @@ CheriotTop::CheriotTop(std::string name, CheriotState *state,
   CHECK_OK(AddConfig(&dcache_config_));
   dcache_config_.AddValueWrittenCallback(
       [this]() { ConfigureCache(dcache_, dcache_config_); });
+  // Register tag cache configuration, and set a callback for when the config
+  // entry is written to.
+  CHECK_OK(AddConfig(&tag_cache_config_));
+  tag_cache_config_.AddValueWrittenCallback([this]() { ConfigureTagCache(); });
+  // Register branch predictor configuration, and set a callback for when the
+  // config entry is written to.
+  CHECK_OK(AddConfig(&branch_predictor_config_));
+  branch_predictor_config_.AddValueWrittenCallback(
+      [this]() { ConfigureBranchPredictor(); });
   Initialize();
 }
 
 CheriotTop::~CheriotTop() {
-  // If the simulator is still running, request a halt (set halted_ to true),
-  // and wait until the simulator finishes before continuing the destructor.
-  if (run_status_ == RunStatus::kRunning) {
-    run_halted_->WaitForNotification();
-    delete run_halted_;
-    run_halted_ = nullptr;
-  }
+  // If the simulator is still running, wait until the simulator finishes,
+  // and any completion callback has returned, before continuing the
+  // destructor.
+  CHECK_OK(Wait());
+  if (run_event_fd_ >= 0) close(run_event_fd_);
 
   if (branch_trace_db_ != nullptr) branch_trace_db_->DecRef();
 
   delete icache_;
   delete dcache_;
+  if (tag_cache_ != nullptr) {
+    state_->set_tag_cache(nullptr);
+    delete tag_cache_;
+  }
+  if (branch_predictor_ != nullptr) {
+    state_->set_branch_predictor(nullptr);
+    delete branch_predictor_;
+  }
+  if (coverage_ != nullptr) {
+    state_->set_coverage(nullptr);
+    delete coverage_;
+  }
   if (inst_db_) inst_db_->DecRef();
   delete rv_bp_manager_;
   delete cheriot_decode_cache_;
@@ -207,6 +243,62 @@ void CheriotTop::ConfigureCache(Cache *&cache, Config<std::string> &config) {
   }
 }
 
+void CheriotTop::ConfigureTagCache() {
+  if (tag_cache_ != nullptr) {
+    LOG(WARNING) << "Tag cache already configured - ignored";
+    return;
+  }
+  auto cfg_str = tag_cache_config_.GetValue();
+  if (cfg_str.empty()) {
+    LOG(WARNING) << "Tag cache configuration is empty - ignored";
+    return;
+  }
+  tag_cache_ = new CheriotTagCache(tag_cache_config_.name(), this);
+  absl::Status status = tag_cache_->Configure(cfg_str);
+  if (!status.ok()) {
+    LOG(ERROR) << "Failed to configure tag cache: " << status.message();
+    delete tag_cache_;
+    tag_cache_ = nullptr;
+    return;
+  }
+  state_->set_tag_cache(tag_cache_);
+}
+
+void CheriotTop::ConfigureBranchPredictor() {
+  if (branch_predictor_ != nullptr) {
+    LOG(WARNING) << "Branch predictor already configured - ignored";
+    return;
+  }
+  auto cfg_str = branch_predictor_config_.GetValue();
+  if (cfg_str.empty()) {
+    LOG(WARNING) << "Branch predictor configuration is empty - ignored";
+    return;
+  }
+  branch_predictor_ =
+      new CheriotBranchPredictor(branch_predictor_config_.name(), this);
+  branch_predictor_status_ =
+      branch_predictor_->Configure(cfg_str, &counter_num_cycles_);
+  if (!branch_predictor_status_.ok()) {
+    LOG(ERROR) << "Failed to configure branch predictor: "
+               << branch_predictor_status_.message();
+    delete branch_predictor_;
+    branch_predictor_ = nullptr;
+    return;
+  }
+  state_->set_branch_predictor(branch_predictor_);
+}
+
+CheriotCoverage *CheriotTop::EnableCoverage() {
+  if (coverage_ != nullptr) return coverage_;
+  std::vector<std::string> opcode_names;
+  for (int i = 0; i < cheriot_decoder_->GetNumOpcodes(); i++) {
+    opcode_names.push_back(cheriot_decoder_->GetOpcodeName(i));
+  }
+  coverage_ = new CheriotCoverage(std::move(opcode_names));
+  state_->set_coverage(coverage_);
+  return coverage_;
+}
+
 bool CheriotTop::ExecuteInstruction(Instruction *inst) {
   // Check that pcc has tag set.
   if (!pcc_->tag()) {
@@ -226,8 +318,16 @@ bool CheriotTop::ExecuteInstruction(Instruction *inst) {
                                     EC::kCapExBoundsViolation, pcc_);
     return true;
   }
+  // Check that the fetch is permitted by the PMP.
+  if (!state_->CheckPmp(inst->address(), inst->size(),
+                        CheriotPmpChecker::Access::kExecute)) {
+    state_->Trap(/*is_interrupt*/ false, inst->address(),
+                 *RV_EC::kInstructionAccessFault, inst->address(), inst);
+    return true;
+  }
   // Execute the instruction.
   inst->Execute(nullptr);
+  if (coverage_ != nullptr) coverage_->Executed(inst->opcode());
   counter_pc_.SetValue(inst->address());
   // Comment out instruction logging during execution.
   // LOG(INFO) << "[" << std::hex << inst->address() << "] " <<
@@ -269,7 +369,7 @@ absl::Status CheriotTop::StepPastBreakpoint() {
   real_inst->IncRef();
   uint64_t next_pc = pc + real_inst->size();
   bool executed = false;
-  if (icache_) ICacheFetch(pc);
+  if (icache_ && icache_enabled_) ICacheFetch(pc);
   do {
     executed = ExecuteInstruction(real_inst);
     counter_num_cycles_.Increment(1);
@@ -285,7 +385,7 @@ absl::Status CheriotTop::StepPastBreakpoint() {
   if (state_->branch()) {
     state_->set_branch(false);
     uint64_t pcc_val = pcc_->data_buffer()->Get<uint32_t>(0);
-    AddToBranchTrace(pc, pcc_val);
+    if (branch_trace_enabled_) AddToBranchTrace(pc, pcc_val);
     next_pc = pcc_val;
     if (break_on_control_flow_change_) {
       halted_ = true;
@@ -338,7 +438,7 @@ absl::StatusOr<int> CheriotTop::Step(int num) {
     // Set the next_pc to the next sequential instruction.
     next_pc = pc + inst->size();
     bool executed = false;
-    if (icache_) ICacheFetch(pc);
+    if (icache_ && icache_enabled_) ICacheFetch(pc);
     do {
       executed = ExecuteInstruction(inst);
       counter_num_cycles_.Increment(1);
@@ -361,7 +461,7 @@ absl::StatusOr<int> CheriotTop::Step(int num) {
     uint64_t pcc_val = pcc_->data_buffer()->Get<uint32_t>(0);
     if (state_->branch()) {
       state_->set_branch(false);
-      AddToBranchTrace(pc, pcc_val);
+      if (branch_trace_enabled_) AddToBranchTrace(pc, pcc_val);
       next_pc = pcc_val;
       if (break_on_control_flow_change_) {
         halted_ = true;
@@ -401,7 +501,38 @@ absl::StatusOr<int> CheriotTop::Step(int num) {
   return count;
 }
 
-absl::Status CheriotTop::Run() {
+absl::Status CheriotTop::Run() { return StartRun(0, nullptr); }
+
+absl::Status CheriotTop::RunAsync(uint64_t max_instructions,
+                                  RunCallback done) {
+  return StartRun(max_instructions, std::move(done));
+}
+
+absl::Status CheriotTop::CancelRun() {
+  // Only the cancel flag is written here, so that this can be called from any
+  // thread without racing the run loop's updates of halted_ and halt_reason_.
+  if (run_status_ == RunStatus::kRunning) cancel_requested_ = true;
+  return absl::OkStatus();
+}
+
+absl::StatusOr<int> CheriotTop::GetRunEventFd() {
+  if (run_event_fd_ >= 0) return run_event_fd_.load();
+  int fd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+  if (fd < 0) {
+    return absl::InternalError(
+        absl::StrCat("Unable to create run eventfd: ", strerror(errno)));
+  }
+  int expected = -1;
+  if (!run_event_fd_.compare_exchange_strong(expected, fd)) {
+    // Another thread created it first.
+    close(fd);
+    return expected;
+  }
+  return fd;
+}
+
+absl::Status CheriotTop::StartRun(uint64_t max_instructions,
+                                  RunCallback done) {
   if (halt_reason_ == *HaltReason::kProgramDone) {
     return absl::FailedPreconditionError("Run: Program has completed.");
   }
@@ -417,114 +548,169 @@ absl::Status CheriotTop::Run() {
     auto status = StepPastBreakpoint();
     if (!status.ok()) return status;
   }
+  absl::MutexLock lock(&run_mutex_);
+  // If the previous run was not waited for, release its notification object
+  // once that run's thread is done with it.
+  if (run_halted_ != nullptr) {
+    run_halted_->WaitForNotification();
+    delete run_halted_;
+  }
   run_status_ = RunStatus::kRunning;
   halt_reason_ = *HaltReason::kNone;
+  cancel_requested_ = false;
   halted_ = false;
 
   // The simulator is now run in a separate thread so as to allow a user
   // interface to continue operating. Allocate a new run_halted_ Notification
   // object, as they are single use only.
   run_halted_ = new absl::Notification();
+  num_run_threads_++;
   // The thread is detached so it executes without having to be joined.
-  std::thread([this]() {
-    // At the top of the loop this holds the address of the instruction to be
-    // executed next. Post-loop it holds the address of the next instruction to
-    // be executed.
-    uint64_t next_pc = pcc_->data_buffer()->Get<uint32_t>(0);
-    // This holds the value of the current pc, and post-loop, the address of
-    // the most recently executed instruction.
-    uint64_t pc = next_pc;
-    while (!halted_) {
-      auto *inst = cheriot_decode_cache_->GetDecodedInstruction(pc);
-      SetPc(pc);
-      next_pc = pc + inst->size();
-      bool executed = false;
-      if (icache_) ICacheFetch(pc);
-      do {
-        // Try executing the instruction. If it fails, advance a cycle
-        // and try again.
-        executed = ExecuteInstruction(inst);
-        counter_num_cycles_.Increment(1);
-        state_->AdvanceDelayLines();
-        // Check for interrupt.
-        if (state_->is_interrupt_available()) {
-          uint64_t epc = pc;
-          if (executed) {
-            epc = state_->branch() ? pcc_->data_buffer()->Get<uint32_t>(0)
-                                   : next_pc;
-          }
-          state_->TakeAvailableInterrupt(epc);
-        }
-      } while (!executed);
-      // Update counters.
-      counter_opcode_[inst->opcode()].Increment(1);
-      counter_num_instructions_.Increment(1);
-      // Get the next pc value.
-      uint64_t pcc_val = pcc_->data_buffer()->Get<uint32_t>(0);
-      if (state_->branch()) {
-        state_->set_branch(false);
-        AddToBranchTrace(pc, pcc_val);
-        next_pc = pcc_val;
-        if (break_on_control_flow_change_) {
-          halted_ = true;
-          halt_reason_ = *HaltReason::kHardwareBreakpoint;
-        }
+  std::thread([this, max_instructions, done = std::move(done),
+               run_halted = run_halted_]() mutable {
+    RunResult result = RunLoop(max_instructions);
+    // Notify that the run loop has completed. This is the last use of
+    // run_halted, which may be deleted as soon as it is notified.
+    run_halted->Notify();
+    run_status_ = RunStatus::kHalted;
+    int fd = run_event_fd_;
+    if (fd >= 0) {
+      uint64_t one = 1;
+      if (write(fd, &one, sizeof(one)) != sizeof(one)) {
+        LOG(WARNING) << "Unable to signal run eventfd: " << strerror(errno);
       }
-      if (!halted_) {
-        pc = next_pc;
-        continue;
+    }
+    // The callback is called last, so that it can start a new run.
+    if (done != nullptr) done(result);
+    absl::MutexLock lock(&run_mutex_);
+    num_run_threads_--;
+  }).detach();
+  return absl::OkStatus();
+}
+
+CheriotTop::RunResult CheriotTop::RunLoop(uint64_t max_instructions) {
+  uint64_t limit =
+      max_instructions == 0 ? std::numeric_limits<uint64_t>::max()
+                            : max_instructions;
+  uint64_t num_instructions = 0;
+  uint64_t num_cycles = 0;
+  // At the top of the loop this holds the address of the instruction to be
+  // executed next. Post-loop it holds the address of the next instruction to
+  // be executed.
+  uint64_t next_pc = pcc_->data_buffer()->Get<uint32_t>(0);
+  // This holds the value of the current pc, and post-loop, the address of
+  // the most recently executed instruction.
+  uint64_t pc = next_pc;
+  // The run is split into segments of run_quantum_ instructions, with a call
+  // to the quantum callback between them. The segment limit replaces the
+  // instruction limit check, so this adds no work per instruction.
+  uint64_t segment_limit =
+      run_quantum_ == 0 ? limit : std::min(limit, run_quantum_);
+  while (!halted_ && !cancel_requested_.load(std::memory_order_relaxed)) {
+    if (num_instructions >= segment_limit) {
+      if (segment_limit >= limit) break;
+      run_quantum_callback_();
+      segment_limit = std::min(limit, num_instructions + run_quantum_);
+      continue;
+    }
+    auto *inst = cheriot_decode_cache_->GetDecodedInstruction(pc);
+    SetPc(pc);
+    next_pc = pc + inst->size();
+    bool executed = false;
+    if (icache_ && icache_enabled_) ICacheFetch(pc);
+    do {
+      // Try executing the instruction. If it fails, advance a cycle
+      // and try again.
+      executed = ExecuteInstruction(inst);
+      counter_num_cycles_.Increment(1);
+      num_cycles++;
+      state_->AdvanceDelayLines();
+      // Check for interrupt.
+      if (state_->is_interrupt_available()) {
+        uint64_t epc = pc;
+        if (executed) {
+          epc = state_->branch() ? pcc_->data_buffer()->Get<uint32_t>(0)
+                                 : next_pc;
+        }
+        state_->TakeAvailableInterrupt(epc);
       }
-      // If it's an action point, just step over and continue executing, as
-      // this is not a full breakpoint.
-      if (halt_reason_ == *HaltReason::kActionPoint) {
-        auto status = StepPastBreakpoint();
-        if (!status.ok()) {
-          // If there is an error, signal a simulator error.
-          halt_reason_ = *HaltReason::kSimulatorError;
-          break;
-        };
-        // Reset the halt reason and continue;
-        halted_ = false;
-        halt_reason_ = *HaltReason::kNone;
-        pc = state_->pc_operand()->AsUint64(0);
-        continue;
+    } while (!executed);
+    // Update counters.
+    counter_opcode_[inst->opcode()].Increment(1);
+    counter_num_instructions_.Increment(1);
+    num_instructions++;
+    // Get the next pc value.
+    uint64_t pcc_val = pcc_->data_buffer()->Get<uint32_t>(0);
+    if (state_->branch()) {
+      state_->set_branch(false);
+      if (branch_trace_enabled_) AddToBranchTrace(pc, pcc_val);
+      next_pc = pcc_val;
+      if (break_on_control_flow_change_) {
+        halted_ = true;
+        halt_reason_ = *HaltReason::kHardwareBreakpoint;
       }
-      break;
     }
-    // Update the pc register, now that it can be read.
-    if (halt_reason_ == *HaltReason::kSoftwareBreakpoint) {
-      // If at a breakpoint, keep the pc at the current value.
-      SetPc(pc);
-    } else {
-      // Otherwise set it to point to the next instruction.
-      SetPc(next_pc);
+    if (!halted_) {
+      pc = next_pc;
+      continue;
     }
-    run_status_ = RunStatus::kHalted;
-    // Notify that the run has completed.
-    run_halted_->Notify();
-  }).detach();
-  return absl::OkStatus();
+    // If it's an action point, just step over and continue executing, as
+    // this is not a full breakpoint.
+    if (halt_reason_ == *HaltReason::kActionPoint) {
+      auto status = StepPastBreakpoint();
+      if (!status.ok()) {
+        // If there is an error, signal a simulator error.
+        halt_reason_ = *HaltReason::kSimulatorError;
+        break;
+      };
+      // Reset the halt reason and continue;
+      halted_ = false;
+      halt_reason_ = *HaltReason::kNone;
+      pc = state_->pc_operand()->AsUint64(0);
+      continue;
+    }
+    break;
+  }
+  // If the loop ended without a halt request, it was either cancelled or it
+  // reached the instruction limit.
+  if (!halted_) {
+    halt_reason_ = cancel_requested_ ? *HaltReason::kUserRequest
+                                     : kInstructionLimit;
+    halted_ = true;
+  }
+  // Update the pc register, now that it can be read.
+  if (halt_reason_ == *HaltReason::kSoftwareBreakpoint) {
+    // If at a breakpoint, keep the pc at the current value.
+    SetPc(pc);
+  } else {
+    // Otherwise set it to point to the next instruction.
+    SetPc(next_pc);
+  }
+  return {halt_reason_, num_instructions, num_cycles};
 }
 
 absl::Status CheriotTop::Wait() {
-  // If the simulator isn't running, then just return after deleting
-  // the notification object.
-  if (run_status_ != RunStatus::kRunning) {
+  absl::MutexLock lock(&run_mutex_);
+  // Wait for the simulator to finish - i.e., a notification on run_halted_.
+  // The lock is held while waiting, so a new run started by the completion
+  // callback cannot delete the notification object. The callback is only
+  // called after the notification, so this cannot deadlock.
+  if (run_halted_ != nullptr) {
+    run_halted_->WaitForNotification();
+    // Now delete the notification object - it is single use only.
     delete run_halted_;
     run_halted_ = nullptr;
-    return absl::OkStatus();
   }
-
-  // Wait for the simulator to finish - i.e., a notification on run_halted_.
-  run_halted_->WaitForNotification();
-  // Now delete the notification object - it is single use only.
-  delete run_halted_;
-  run_halted_ = nullptr;
+  // Wait for the run threads to return from their completion callbacks. This
+  // also waits for any run started by a callback.
+  run_mutex_.Await(absl::Condition(
+      +[](int *num_run_threads) { return *num_run_threads == 0; },
+      &num_run_threads_));
   return absl::OkStatus();
 }
 
 absl::StatusOr<CheriotTop::RunStatus> CheriotTop::GetRunStatus() {
-  return run_status_;
+  return run_status_.load();
 }
 
 absl::StatusOr<CheriotTop::HaltReasonValueType>
@@ -662,6 +848,9 @@ absl::Status CheriotTop::WriteRegister(const std::string &name,
     }
     auto *csr = *result;
     csr->Set(static_cast<uint32_t>(value));
+    // The CSR may be a PMP CSR. Debug writes are rare, so just drop the
+    // cached PMP decisions.
+    state_->pmp_checker()->Invalidate();
   }
 
   // If stopped at a software breakpoint and the pc is changed, change the
@@ -898,6 +1087,15 @@ absl::Status CheriotTop::SetDataWatchpoint(uint64_t address, size_t length,
       return wr_atomic_status;
     }
   }
+  if ((access_type == AccessType::kLoad) ||
+      (access_type == AccessType::kLoadStore)) {
+    load_watchpoints_.insert(address);
+  }
+  if ((access_type == AccessType::kStore) ||
+      (access_type == AccessType::kLoadStore)) {
+    store_watchpoints_.insert(address);
+  }
+  state_->set_amo_direct_enabled(false);
   return absl::OkStatus();
 }
 
@@ -910,6 +1108,7 @@ absl::Status CheriotTop::ClearDataWatchpoint(uint64_t address,
 
     auto rd_atomic_status = memory_watcher_->ClearLoadWatchCallback(address);
     if (!rd_atomic_status.ok()) return rd_atomic_status;
+    load_watchpoints_.erase(address);
   }
   if ((access_type == AccessType::kStore) ||
       (access_type == AccessType::kLoadStore)) {
@@ -918,7 +1117,10 @@ absl::Status CheriotTop::ClearDataWatchpoint(uint64_t address,
 
     auto wr_atomic_status = memory_watcher_->ClearStoreWatchCallback(address);
     if (!wr_atomic_status.ok()) return wr_atomic_status;
+    store_watchpoints_.erase(address);
   }
+  state_->set_amo_direct_enabled(load_watchpoints_.empty() &&
+                                 store_watchpoints_.empty());
   return absl::OkStatus();
 }
 
@@ -1049,6 +1251,21 @@ void CheriotTop::DisableStatistics() {
   }
 }
 
+void CheriotTop::ClearHaltReason() {
+  halt_reason_ = *HaltReason::kNone;
+  need_to_step_over_ = false;
+}
+
+void CheriotTop::InvalidateDecodeCache(uint64_t address, uint64_t size) {
+  if (size == 0) return;
+  // Instructions are at least 2 byte aligned, and at most 4 bytes long, so
+  // the one starting 2 bytes before the range may overlap it.
+  uint64_t start = (address & ~1ULL) >= 2 ? (address & ~1ULL) - 2 : 0;
+  for (uint64_t pc = start; pc < address + size; pc += 2) {
+    cheriot_decode_cache_->Invalidate(pc);
+  }
+}
+
 void CheriotTop::ICacheFetch(uint64_t address) {
   icache_->Load(address, inst_db_, nullptr, nullptr);
 }
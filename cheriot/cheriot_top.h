@@ -17,19 +17,27 @@
 #ifndef MPACT_CHERIOT__CHERIOT_TOP_H_
 #define MPACT_CHERIOT__CHERIOT_TOP_H_
 
+#include <atomic>
 #include <cstddef>
 #include <cstdint>
 #include <string>
+#include <utility>
 #include <vector>
 
+#include "absl/base/thread_annotations.h"
 #include "absl/container/flat_hash_map.h"
+#include "absl/container/flat_hash_set.h"
 #include "absl/functional/any_invocable.h"
 #include "absl/status/status.h"
 #include "absl/status/statusor.h"
+#include "absl/synchronization/mutex.h"
 #include "absl/synchronization/notification.h"
+#include "cheriot/cheriot_branch_predictor.h"
+#include "cheriot/cheriot_coverage.h"
 #include "cheriot/cheriot_debug_interface.h"
 #include "cheriot/cheriot_register.h"
 #include "cheriot/cheriot_state.h"
+#include "cheriot/cheriot_tag_cache.h"
 #include "mpact/sim/generic/action_point_manager_base.h"
 #include "mpact/sim/generic/breakpoint_manager.h"
 #include "mpact/sim/generic/component.h"
@@ -82,6 +90,10 @@ class CheriotTop : public generic::Component, public CheriotDebugInterface {
   absl::StatusOr<int> Step(int num) override;
   absl::Status Run() override;
   absl::Status Wait() override;
+  // Asynchronous run control.
+  absl::Status RunAsync(uint64_t max_instructions, RunCallback done) override;
+  absl::Status CancelRun() override;
+  absl::StatusOr<int> GetRunEventFd() override;
 
   absl::StatusOr<RunStatus> GetRunStatus() override;
   absl::StatusOr<HaltReasonValueType> GetLastHaltReason() override;
@@ -139,6 +151,32 @@ class CheriotTop : public generic::Component, public CheriotDebugInterface {
   void EnableStatistics();
   void DisableStatistics();
 
+  // Enable/disable the instruction cache model and the branch trace, e.g., to
+  // only model them within a region of interest. Both are enabled by default.
+  void set_icache_enabled(bool value) { icache_enabled_ = value; }
+  void set_branch_trace_enabled(bool value) { branch_trace_enabled_ = value; }
+
+  // Sets a callback that is called from the simulation thread every quantum
+  // instructions of a run, e.g., to pace the simulation. A quantum of 0
+  // removes the callback. Must only be called while the core is halted.
+  void SetRunQuantumCallback(uint64_t quantum,
+                             absl::AnyInvocable<void()> callback) {
+    run_quantum_ = callback == nullptr ? 0 : quantum;
+    run_quantum_callback_ = std::move(callback);
+  }
+
+  // Clears the last halt reason, e.g., after the state has been restored from
+  // a snapshot, so that a program that has completed can be run again.
+  void ClearHaltReason();
+  // Invalidates the decoded instructions that overlap the address range, e.g.,
+  // after memory has been written other than through the data accesses of the
+  // program.
+  void InvalidateDecodeCache(uint64_t address, uint64_t size);
+
+  // Enable ISA coverage collection. Returns the coverage collector, which is
+  // owned by the top. Calling it again returns the same collector.
+  CheriotCoverage *EnableCoverage();
+
   // Accessors.
   CheriotState *state() const { return state_; }
   // The following are not const as callers may need to call non-const methods
@@ -159,17 +197,32 @@ class CheriotTop : public generic::Component, public CheriotDebugInterface {
 
   Cache *icache() const { return icache_; }
   Cache *dcache() const { return dcache_; }
+  CheriotTagCache *tag_cache() const { return tag_cache_; }
+  CheriotBranchPredictor *branch_predictor() const { return branch_predictor_; }
+  // Result of the last attempt to configure the branch predictor.
+  const absl::Status &branch_predictor_status() const {
+    return branch_predictor_status_;
+  }
+  CheriotCoverage *coverage() const { return coverage_; }
 
  private:
   // Initialize the top.
   void Initialize();
   // Configure cache helper method.
   void ConfigureCache(Cache *&cache, Config<std::string> &config);
+  // Configure the tag controller cache model.
+  void ConfigureTagCache();
+  // Configure the branch predictor model.
+  void ConfigureBranchPredictor();
   // Execute instruction. Returns true if the instruction was executed (or
   // an exception was triggered).
   bool ExecuteInstruction(Instruction *inst);
   // Helper method to step past a breakpoint.
   absl::Status StepPastBreakpoint();
+  // Starts the simulation thread for Run and RunAsync.
+  absl::Status StartRun(uint64_t max_instructions, RunCallback done);
+  // Simulation loop for a run. Returns the halt reason and statistics.
+  RunResult RunLoop(uint64_t max_instructions);
   // Set the pc value.
   void SetPc(uint64_t value);
   void ICacheFetch(uint64_t address);
@@ -178,11 +231,22 @@ class CheriotTop : public generic::Component, public CheriotDebugInterface {
   // The DB factory is used to manage data buffers for memory read/writes.
   generic::DataBufferFactory db_factory_;
   // Current status and last halt reasons.
-  RunStatus run_status_ = RunStatus::kHalted;
+  std::atomic<RunStatus> run_status_ = RunStatus::kHalted;
   HaltReasonValueType halt_reason_ = *HaltReason::kNone;
   // Halting flag. This is set to true when execution must halt.
-  bool halted_ = false;
-  absl::Notification *run_halted_ = nullptr;
+  std::atomic<bool> halted_ = false;
+  // Set by CancelRun. This is separate from halted_, as the run loop clears
+  // halted_ when it steps over an action point.
+  std::atomic<bool> cancel_requested_ = false;
+  // Guards the run notification and the run thread count. The run loop does
+  // not take this lock.
+  absl::Mutex run_mutex_;
+  absl::Notification *run_halted_ ABSL_GUARDED_BY(run_mutex_) = nullptr;
+  // Number of run threads that have not yet returned from their completion
+  // callback.
+  int num_run_threads_ ABSL_GUARDED_BY(run_mutex_) = 0;
+  // Eventfd signaled when a run completes, or -1 if not yet created.
+  std::atomic<int> run_event_fd_ = -1;
   // The local CherIoT state.
   CheriotState *state_;
   // Flag that indicates an instruction needs to be stepped over.
@@ -204,6 +268,11 @@ class CheriotTop : public generic::Component, public CheriotDebugInterface {
   util::AtomicMemoryOpInterface *atomic_memory_ = nullptr;
   util::TaggedMemoryWatcher *tagged_watcher_ = nullptr;
   util::MemoryWatcher *memory_watcher_ = nullptr;
+  // Addresses of the active data watchpoints. Atomic memory operations are
+  // not performed in place on host memory while there are any, so that they
+  // go through the memory watcher.
+  absl::flat_hash_set<uint64_t> load_watchpoints_;
+  absl::flat_hash_set<uint64_t> store_watchpoints_;
   // Branch trace info - uses a circular buffer. The size is defined by the
   // constant kBranchTraceSize in the .cc file.
   BranchTraceEntry *branch_trace_;
@@ -231,9 +300,23 @@ class CheriotTop : public generic::Component, public CheriotDebugInterface {
   // Configuration items.
   Config<std::string> icache_config_;
   Config<std::string> dcache_config_;
+  Config<std::string> tag_cache_config_;
+  Config<std::string> branch_predictor_config_;
   // ICache & DCache.
   Cache *dcache_ = nullptr;
   Cache *icache_ = nullptr;
+  bool icache_enabled_ = true;
+  bool branch_trace_enabled_ = true;
+  // Run quantum and callback.
+  uint64_t run_quantum_ = 0;
+  absl::AnyInvocable<void()> run_quantum_callback_;
+  // Tag controller cache.
+  CheriotTagCache *tag_cache_ = nullptr;
+  // Branch predictor model.
+  CheriotBranchPredictor *branch_predictor_ = nullptr;
+  absl::Status branch_predictor_status_;
+  // ISA coverage collector.
+  CheriotCoverage *coverage_ = nullptr;
   DataBuffer *inst_db_ = nullptr;
 };
 
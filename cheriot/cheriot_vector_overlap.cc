@@ -0,0 +1,152 @@
+// Copyright 2024 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "cheriot/cheriot_vector_overlap.h"
+
+#include <algorithm>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "absl/strings/match.h"
+#include "absl/strings/numbers.h"
+#include "absl/strings/str_cat.h"
+#include "absl/strings/string_view.h"
+#include "cheriot/cheriot_state.h"
+#include "mpact/sim/generic/instruction.h"
+#include "riscv//riscv_register.h"
+
+namespace mpact {
+namespace sim {
+namespace cheriot {
+
+using ::mpact::sim::riscv::RV32VectorDestinationOperand;
+using ::mpact::sim::riscv::RV32VectorSourceOperand;
+
+namespace {
+
+// Returns the number of the first register in the vector register group
+// named by the operand, or -1 if the operand does not name a vector register
+// (e.g., the vector "true" mask operand).
+int GetVectorRegisterNumber(const std::string &op_name) {
+  absl::string_view name = op_name;
+  if (!absl::ConsumePrefix(&name, CheriotState::kVregPrefix)) return -1;
+  int num;
+  if (!absl::SimpleAtoi(name, &num)) return -1;
+  if ((num < 0) || (num > 31)) return -1;
+  return num;
+}
+
+VectorRegisterOverlap ComputeOverlap(int dest_first, int dest_size,
+                                     int src_first, int src_size) {
+  if ((src_first < 0) || (src_size <= 0)) return VectorRegisterOverlap::kNone;
+  // Only groups of the same size are treated as an exact alias. E.g., a mask
+  // source (a single register) that is the first register of the destination
+  // group is treated as a partial overlap.
+  if ((src_first == dest_first) && (src_size == dest_size)) {
+    return VectorRegisterOverlap::kExact;
+  }
+  int dest_last = dest_first + dest_size - 1;
+  int src_last = src_first + src_size - 1;
+  if ((src_last < dest_first) || (src_first > dest_last)) {
+    return VectorRegisterOverlap::kNone;
+  }
+  return VectorRegisterOverlap::kPartial;
+}
+
+}  // namespace
+
+VectorOverlapInfo::VectorOverlapInfo(
+    std::vector<VectorRegisterOverlap> source_overlap,
+    std::vector<RVVectorRegister *> dest_registers)
+    : source_overlap_(std::move(source_overlap)),
+      dest_registers_(std::move(dest_registers)) {
+  for (auto overlap : source_overlap_) {
+    summary_ = std::max(summary_, overlap);
+  }
+}
+
+VectorOverlapTable::VectorOverlapTable(CheriotState *state) : state_(state) {
+  state_->set_vector_overlap_table(this);
+}
+
+VectorOverlapTable::~VectorOverlapTable() {
+  if (state_->vector_overlap_table() == this) {
+    state_->set_vector_overlap_table(nullptr);
+  }
+  Clear();
+}
+
+void VectorOverlapTable::set_enabled(bool value) {
+  enabled_ = value;
+  if (!enabled_) Clear();
+}
+
+void VectorOverlapTable::Annotate(Instruction *inst) {
+  if (!enabled_ || (inst == nullptr)) return;
+  if (inst->child() != nullptr) return;
+  if (inst->DestinationsSize() == 0) return;
+  auto *dest_op =
+      dynamic_cast<RV32VectorDestinationOperand *>(inst->Destination(0));
+  if ((dest_op == nullptr) || (dest_op->latency() != 0)) return;
+  int dest_first = GetVectorRegisterNumber(dest_op->AsString());
+  if (dest_first < 0) return;
+  int dest_size = dest_op->size();
+  std::vector<RVVectorRegister *> dest_registers;
+  for (int i = 0; i < dest_size; i++) {
+    dest_registers.push_back(
+        state_
+            ->GetRegister<RVVectorRegister>(
+                absl::StrCat(CheriotState::kVregPrefix, dest_first + i))
+            .first);
+  }
+  std::vector<VectorRegisterOverlap> source_overlap;
+  for (int i = 0; i < inst->SourcesSize(); i++) {
+    auto *src_op = dynamic_cast<RV32VectorSourceOperand *>(inst->Source(i));
+    if (src_op == nullptr) {
+      source_overlap.push_back(VectorRegisterOverlap::kNone);
+      continue;
+    }
+    source_overlap.push_back(
+        ComputeOverlap(dest_first, dest_size,
+                       GetVectorRegisterNumber(src_op->AsString()),
+                       src_op->size()));
+  }
+  if (size() >= sweep_size_) Sweep();
+  VectorOverlapInfo info(std::move(source_overlap), std::move(dest_registers));
+  auto [iter, inserted] = info_.insert_or_assign(inst, std::move(info));
+  if (inserted) inst->IncRef();
+}
+
+void VectorOverlapTable::Sweep() {
+  for (auto iter = info_.begin(); iter != info_.end();) {
+    Instruction *inst = iter->first;
+    if (inst->ref_count() == 1) {
+      info_.erase(iter++);
+      inst->DecRef();
+    } else {
+      ++iter;
+    }
+  }
+  sweep_size_ = std::max(kMinSweepSize, 2 * size());
+}
+
+void VectorOverlapTable::Clear() {
+  for (auto &[inst, unused] : info_) inst->DecRef();
+  info_.clear();
+}
+
+}  // namespace cheriot
+}  // namespace sim
+}  // namespace mpact
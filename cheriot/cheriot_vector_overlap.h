@@ -0,0 +1,160 @@
+// Copyright 2024 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef MPACT_CHERIOT_CHERIOT_VECTOR_OVERLAP_H_
+#define MPACT_CHERIOT_CHERIOT_VECTOR_OVERLAP_H_
+
+#include <cstdint>
+#include <vector>
+
+#include "absl/container/flat_hash_map.h"
+#include "cheriot/cheriot_state.h"
+#include "mpact/sim/generic/instruction.h"
+#include "riscv//riscv_register.h"
+
+// This file defines the register group overlap properties that the vector
+// decoders compute once for each decoded instruction. The vector instruction
+// helpers use these to update the destination register group in place when
+// doing so cannot change the result, instead of copying the destination
+// register data buffers on every execution.
+
+namespace mpact {
+namespace sim {
+namespace cheriot {
+
+using ::mpact::sim::generic::Instruction;
+using ::mpact::sim::riscv::RVVectorRegister;
+
+// Overlap between the register group of the vector destination operand and
+// the register group of a source operand. Register groups are compared using
+// the largest group the operand can span, so the result holds for any lmul.
+enum class VectorRegisterOverlap : uint8_t {
+  // The register groups are disjoint (or the source is not a vector register).
+  kNone = 0,
+  // The register groups start at the same register and have the same size.
+  // For operations where the source and destination element widths are the
+  // same, each destination element aliases the source element with the same
+  // index.
+  kExact = 1,
+  // The register groups overlap, but not exactly.
+  kPartial = 2,
+};
+
+// Overlap properties for a decoded instruction.
+class VectorOverlapInfo {
+ public:
+  VectorOverlapInfo(std::vector<VectorRegisterOverlap> source_overlap,
+                    std::vector<RVVectorRegister *> dest_registers);
+
+  // Overlap of the destination with source operand i.
+  VectorRegisterOverlap source(int i) const {
+    return i < source_overlap_.size() ? source_overlap_[i]
+                                      : VectorRegisterOverlap::kNone;
+  }
+  // The largest overlap over all the source operands.
+  VectorRegisterOverlap summary() const { return summary_; }
+  // Registers in the destination register group.
+  RVVectorRegister *dest_register(int i) const { return dest_registers_[i]; }
+  int dest_size() const { return dest_registers_.size(); }
+
+ private:
+  std::vector<VectorRegisterOverlap> source_overlap_;
+  std::vector<RVVectorRegister *> dest_registers_;
+  VectorRegisterOverlap summary_ = VectorRegisterOverlap::kNone;
+};
+
+// Table of the overlap properties of decoded instructions. It is owned by the
+// decoder that computes them, and registers itself with the state so that the
+// vector instruction helpers can find it. The properties can't be kept in the
+// instruction's context, as that is replaced each time the instruction is
+// executed.
+//
+// The table holds a reference to each instruction in it, so that the address
+// of an instruction can't be reused by another instruction while its entry is
+// in the table. Instructions that are only referenced by the table, i.e., that
+// were evicted from the decode cache, are dropped as the table grows.
+class VectorOverlapTable {
+ public:
+  explicit VectorOverlapTable(CheriotState *state);
+  VectorOverlapTable(const VectorOverlapTable &) = delete;
+  VectorOverlapTable &operator=(const VectorOverlapTable &) = delete;
+  ~VectorOverlapTable();
+
+  // Computes the register group overlap properties of the instruction and
+  // adds them to the table. This is only done for instructions whose first
+  // destination is a vector register group with zero latency, and that do not
+  // have a child instruction (i.e., not for vector loads and stores).
+  void Annotate(Instruction *inst);
+  // If disabled, no instructions are annotated, so vector destinations are
+  // never updated in place, e.g., for a lockstep reference. Disabling the
+  // table removes the instructions already annotated.
+  void set_enabled(bool value);
+
+  // Returns the overlap properties of the instruction, or nullptr if it was
+  // not annotated.
+  const VectorOverlapInfo *Find(const Instruction *inst) const {
+    auto iter = info_.find(inst);
+    return iter == info_.end() ? nullptr : &iter->second;
+  }
+
+  int size() const { return info_.size(); }
+
+ private:
+  // Number of entries at which the table is first swept.
+  static constexpr int kMinSweepSize = 1024;
+
+  // Removes the instructions only referenced by the table.
+  void Sweep();
+  // Removes all instructions.
+  void Clear();
+
+  CheriotState *state_;
+  absl::flat_hash_map<Instruction *, VectorOverlapInfo> info_;
+  int sweep_size_ = kMinSweepSize;
+  bool enabled_ = true;
+};
+
+// Returns the overlap properties of the instruction from the table registered
+// with its state, or nullptr if there is none or the instruction was not
+// annotated.
+inline const VectorOverlapInfo *GetVectorOverlapInfo(const Instruction *inst) {
+  auto *table =
+      static_cast<CheriotState *>(inst->state())->vector_overlap_table();
+  if (table == nullptr) return nullptr;
+  return table->Find(inst);
+}
+
+// Returns true if the destination register group of the instruction can be
+// written in place without affecting the values read from the sources. That
+// is the case if no vector source overlaps the destination, or if the only
+// overlaps are exact and the operation does not change the element width.
+inline bool CanUpdateDestinationInPlace(const Instruction *inst,
+                                        bool same_element_width) {
+  auto *info = GetVectorOverlapInfo(inst);
+  if (info == nullptr) return false;
+  switch (info->summary()) {
+    case VectorRegisterOverlap::kNone:
+      return true;
+    case VectorRegisterOverlap::kExact:
+      return same_element_width;
+    default:
+      return false;
+  }
+}
+
+}  // namespace cheriot
+}  // namespace sim
+}  // namespace mpact
+
+#endif  // MPACT_CHERIOT_CHERIOT_VECTOR_OVERLAP_H_
@@ -281,6 +281,9 @@ void DebugCommandShell::Run(std::istream &is, std::ostream &os) {
           case *HaltReason::kDataWatchPoint:
             absl::StrAppend(&prompt, "Stopped at data watchpoint\n");
             break;
+          case CheriotDebugInterface::kInstructionLimit:
+            absl::StrAppend(&prompt, "Stopped at instruction limit\n");
+            break;
           case InterruptListener::kInterruptTaken:
             absl::StrAppend(&prompt, "Stopped at taken interrupt\n");
             break;
@@ -39,10 +39,21 @@
 #include "absl/strings/string_view.h"
 #include "absl/time/clock.h"
 #include "absl/time/time.h"
+#include "cheriot/cheriot_address_ranges.h"
+#include "cheriot/cheriot_coverage.h"
 #include "cheriot/cheriot_decoder.h"
+#include "cheriot/cheriot_elf_loader.h"
+#include "cheriot/cheriot_fault_campaign.h"
 #include "cheriot/cheriot_instrumentation_control.h"
+#include "cheriot/cheriot_lockstep.h"
+#include "cheriot/cheriot_memory_use_profiler.h"
+#include "cheriot/cheriot_metrics_server.h"
+#include "cheriot/cheriot_pacer.h"
+#include "cheriot/cheriot_reserved_memory.h"
+#include "cheriot/cheriot_roi_control.h"
 #include "cheriot/cheriot_rvv_decoder.h"
 #include "cheriot/cheriot_rvv_fp_decoder.h"
+#include "cheriot/cheriot_semihost_file_input.h"
 #include "cheriot/cheriot_state.h"
 #include "cheriot/cheriot_top.h"
 #include "cheriot/debug_command_shell.h"
@@ -53,7 +64,6 @@
 #include "mpact/sim/proto/component_data.pb.h"
 #include "mpact/sim/util/memory/atomic_memory.h"
 #include "mpact/sim/util/memory/memory_interface.h"
-#include "mpact/sim/util/memory/memory_use_profiler.h"
 #include "mpact/sim/util/memory/memory_watcher.h"
 #include "mpact/sim/util/memory/single_initiator_router.h"
 #include "mpact/sim/util/memory/tagged_flat_demand_memory.h"
@@ -66,11 +76,19 @@
 #include "riscv//riscv_arm_semihost.h"
 #include "riscv//riscv_clint.h"
 #include "riscv//riscv_counter_csr.h"
+#include "riscv//stoull_wrapper.h"
 #include "src/google/protobuf/text_format.h"
 
 using AddressRange = mpact::sim::util::MemoryWatcher::AddressRange;
+using ::mpact::sim::cheriot::CheriotAddressRanges;
 using ::mpact::sim::cheriot::CheriotDecoder;
+using ::mpact::sim::cheriot::CheriotElfLoader;
+using ::mpact::sim::cheriot::CheriotFaultCampaign;
 using ::mpact::sim::cheriot::CheriotInstrumentationControl;
+using ::mpact::sim::cheriot::CheriotLockstep;
+using ::mpact::sim::cheriot::CheriotMemoryUseProfiler;
+using ::mpact::sim::cheriot::CheriotReservedMemory;
+using ::mpact::sim::cheriot::CheriotSemihostFileInput;
 using ::mpact::sim::cheriot::CheriotRVVDecoder;
 using ::mpact::sim::cheriot::CheriotRVVFPDecoder;
 using ::mpact::sim::cheriot::CheriotState;
@@ -79,7 +97,6 @@ using ::mpact::sim::proto::ComponentData;
 using ::mpact::sim::riscv::RiscVCounterCsr;
 using ::mpact::sim::riscv::RiscVCounterCsrHigh;
 using ::mpact::sim::util::InstructionProfiler;
-using ::mpact::sim::util::TaggedMemoryUseProfiler;
 
 // Flat to specify core version.
 ABSL_FLAG(int, core_version, 100, "Core version");
@@ -161,6 +178,79 @@ ABSL_FLAG(uint64_t, uart, 0x1000'0000ULL, "Base address of uart");
 // Flag to enable and configure the instruction and data caches.
 ABSL_FLAG(std::string, icache, "", "Instruction cache configuration");
 ABSL_FLAG(std::string, dcache, "", "Data cache configuration");
+// Flag to enable and configure the tag controller cache model. The format is
+// <size>,<line coverage>,<associativity>.
+ABSL_FLAG(std::string, tagcache, "", "Tag cache configuration");
+
+// Branch predictor model configuration:
+//   <static|bimodal|gshare>[,<table size>[,<ras depth>[,<penalty>]]]
+ABSL_FLAG(std::string, branch_predictor, "",
+          "Branch predictor model configuration");
+
+// ISA coverage report file. If the file exists, the coverage it records is
+// merged with the coverage of this run before the file is rewritten.
+ABSL_FLAG(std::string, coverage, "", "ISA coverage report file");
+
+// Back the 32 bit address space with a single sparse host memory reservation
+// instead of demand allocated blocks, optionally using huge pages.
+ABSL_FLAG(bool, reserve_memory, false, "Reserve host memory for 4GiB");
+ABSL_FLAG(bool, huge_pages, false, "Use huge pages for reserved memory");
+
+// Check loads, stores and instruction fetches against the PMP configuration.
+ABSL_FLAG(bool, pmp, false, "Enable PMP checks");
+
+// Map files that are read through semihosting into the host address space
+// instead of reading them.
+ABSL_FLAG(bool, semihost_mmap, false, "Memory map semihosting input files");
+
+// Run a reference simulator instance in lockstep with the configured one, and
+// compare their state every N instructions (batch mode only). The reference
+// uses demand allocated memory without caches or other models. Its uart
+// output is discarded, and semihosting calls are only performed by the
+// configured instance, with their results replayed on the reference, so that
+// host I/O isn't repeated. Models that add cycles (e.g., mispredict
+// penalties) change when timer interrupts are taken, which is reported as a
+// divergence.
+ABSL_FLAG(uint64_t, lockstep, 0,
+          "Compare against a reference simulator every N instructions");
+
+// Region of interest for the detailed models in batch mode. The start and end
+// are the addresses (or symbols) of instructions, e.g., of labeled marker
+// instructions in the program. The models listed in roi_models (icache,
+// dcache, tagcache, bpred, btrace, iprofile, mprofile, counters, or all) are
+// only active from the start instruction up to the end instruction. Either
+// may be omitted, in which case the region extends to the beginning or the
+// end of the program.
+ABSL_FLAG(std::string, roi_start, "", "ROI start address or symbol");
+ABSL_FLAG(std::string, roi_end, "", "ROI end address or symbol");
+ABSL_FLAG(std::string, roi_models, "all", "Models that are only active in ROI");
+
+// Throttle the simulation to a target clock frequency (in Hz), e.g., when
+// driving external devices through the uart. The pacer is called every
+// pace_quantum instructions, and makes up for lags of up to pace_max_lag_usec.
+ABSL_FLAG(double, pace_frequency, 0.0, "Target simulated clock frequency");
+ABSL_FLAG(uint64_t, pace_quantum, 10'000, "Instructions per pacing quantum");
+ABSL_FLAG(uint64_t, pace_max_lag_usec,
+          mpact::sim::cheriot::CheriotPacer::kDefaultMaxLagUsec,
+          "Maximum pacing lag to make up for");
+
+// Fault injection campaign (batch mode only). The program is run to the
+// injection point (instruction count), where the state is snapshotted, and
+// then to its end for the golden run. Each fault, either from the campaign
+// file (one per line, see CheriotFaultCampaign::ParseFault) or randomly
+// generated, is injected into a run from the snapshot, and the outcome is
+// written to the report file (csv) and summarized. Semihosting output after
+// the injection point is repeated by the golden run and by each variant.
+ABSL_FLAG(std::string, fault_campaign, "", "File of faults to inject");
+ABSL_FLAG(int, fault_count, 0, "Number of random faults to inject");
+ABSL_FLAG(uint64_t, fault_seed, 1, "Seed for random faults");
+ABSL_FLAG(uint64_t, fault_injection_point, 0,
+          "Instruction count at which the snapshot is taken");
+ABSL_FLAG(std::string, fault_report, "", "Fault campaign report file");
+
+// Unix domain socket on which to serve live counter snapshots.
+ABSL_FLAG(std::string, metrics_socket, "",
+          "Serve counter snapshots on this Unix domain socket");
 
 constexpr char kStackEndSymbolName[] = "__stack_end";
 constexpr char kStackSizeSymbolName[] = "__stack_size";
@@ -168,6 +258,9 @@ constexpr char kStackSizeSymbolName[] = "__stack_size";
 constexpr int kCapabilityGranule = 8;
 
 using HaltReason = ::mpact::sim::generic::CoreDebugInterface::HaltReason;
+using RunStatus = ::mpact::sim::generic::CoreDebugInterface::RunStatus;
+using ::mpact::sim::cheriot::CheriotPacer;
+using ::mpact::sim::cheriot::CheriotRoiControl;
 using ::mpact::sim::cheriot::CheriotTop;
 using ::mpact::sim::generic::Instruction;
 using ::mpact::sim::proto::ComponentValueEntry;
@@ -239,6 +332,75 @@ bool HandleSimulatorTrap(bool is_interrupt, uint64_t trap_value, uint64_t ec,
   return false;
 }
 
+// Runs the fault injection campaign, and writes the report. Returns the exit
+// code. The positions of the files read through semihosting and the memory
+// they are read into are not part of the snapshot, so the campaign is
+// rejected as soon as the program opens such a file.
+static int RunFaultCampaign(CheriotFaultCampaign *campaign,
+                            std::vector<CheriotFaultCampaign::Fault> &faults,
+                            const CheriotSemihostFileInput *file_input) {
+  constexpr char kFileInputError[] =
+      "Fault campaign: programs that read files through semihosting are not "
+      "supported\n";
+  auto status = campaign->Prepare(absl::GetFlag(FLAGS_fault_injection_point),
+                                  /*max_instructions=*/0);
+  if (!status.ok()) {
+    std::cerr << "Fault campaign: " << status.message() << "\n";
+    return -1;
+  }
+  if (file_input->num_opened() > 0) {
+    std::cerr << kFileInputError;
+    return -1;
+  }
+  std::cerr << absl::StrFormat(
+      "Fault campaign: golden run of %llu instructions, %d CHERI traps\n",
+      campaign->golden_instructions(), campaign->golden_cheri_traps());
+  if (absl::GetFlag(FLAGS_fault_count) > 0) {
+    auto generated = campaign->GenerateFaults(absl::GetFlag(FLAGS_fault_count),
+                                              absl::GetFlag(FLAGS_fault_seed));
+    faults.insert(faults.end(), generated.begin(), generated.end());
+  }
+  std::ofstream report;
+  if (!absl::GetFlag(FLAGS_fault_report).empty()) {
+    report.open(absl::GetFlag(FLAGS_fault_report));
+    if (!report.good()) {
+      std::cerr << "Unable to open fault report file '"
+                << absl::GetFlag(FLAGS_fault_report) << "'\n";
+      return -1;
+    }
+    report << "fault,outcome\n";
+  }
+  int counts[CheriotFaultCampaign::kNumOutcomes] = {};
+  int exit_code = 0;
+  for (auto const &fault : faults) {
+    auto fault_string = CheriotFaultCampaign::FaultString(fault);
+    auto result = campaign->RunVariant(fault);
+    if (file_input->num_opened() > 0) {
+      std::cerr << "Fault '" << fault_string << "': " << kFileInputError;
+      return -1;
+    }
+    if (!result.ok()) {
+      std::cerr << "Fault '" << fault_string
+                << "': " << result.status().message() << "\n";
+      exit_code = -1;
+      continue;
+    }
+    counts[static_cast<int>(result.value())]++;
+    if (report.is_open()) {
+      report << fault_string << ","
+             << CheriotFaultCampaign::OutcomeName(result.value()) << "\n";
+    }
+  }
+  std::cerr << absl::StrFormat("Fault campaign: %d faults:", faults.size());
+  for (int i = 0; i < CheriotFaultCampaign::kNumOutcomes; i++) {
+    auto outcome = static_cast<CheriotFaultCampaign::Outcome>(i);
+    std::cerr << " " << CheriotFaultCampaign::OutcomeName(outcome) << " "
+              << counts[i];
+  }
+  std::cerr << "\n";
+  return exit_code;
+}
+
 // Main function for the simulator.
 int main(int argc, char **argv) {
   absl::SetProgramUsageMessage(argv[0]);
@@ -255,23 +417,51 @@ int main(int argc, char **argv) {
       full_file_name.substr(full_file_name.find_last_of('/') + 1);
   std::string file_basename = file_name.substr(0, file_name.find_first_of('.'));
 
-  auto *tagged_memory =
+  auto *demand_memory =
       new mpact::sim::util::TaggedFlatDemandMemory(kCapabilityGranule);
-  // Load the elf segments into memory.
-  mpact::sim::util::ElfProgramLoader elf_loader(tagged_memory);
-  auto load_result = elf_loader.LoadProgram(full_file_name);
+  TaggedMemoryInterface *tagged_memory = demand_memory;
+  CheriotReservedMemory *reserved_memory = nullptr;
+  if (absl::GetFlag(FLAGS_reserve_memory)) {
+    reserved_memory =
+        new CheriotReservedMemory(kCapabilityGranule, demand_memory);
+    auto status = reserved_memory->Reserve(0, 0x1'0000'0000ULL,
+                                           absl::GetFlag(FLAGS_huge_pages));
+    if (!status.ok()) {
+      std::cerr << "Error while reserving memory: " << status.message();
+      return -1;
+    }
+    tagged_memory = reserved_memory;
+  }
+  // Load the elf segments into memory. The memory was just created, so it
+  // is all zeros.
+  CheriotElfLoader elf_file;
+  auto load_result = elf_file.LoadProgram(full_file_name, tagged_memory,
+                                          /*memory_is_zero=*/true);
   if (!load_result.ok()) {
     std::cerr << "Error while loading '" << full_file_name
               << "': " << load_result.status().message();
     return -1;
   }
+  // The program loader is only used for symbol information by the
+  // instruction profiler and the debug command shell, so only load the
+  // symbols if one of them needs it.
+  mpact::sim::util::ElfProgramLoader elf_loader(tagged_memory);
+  bool elf_symbols_loaded = false;
+  auto load_elf_symbols = [&]() {
+    if (elf_symbols_loaded) return;
+    elf_symbols_loaded = true;
+    auto res = elf_loader.LoadSymbols(full_file_name);
+    if (!res.ok()) {
+      LOG(ERROR) << "Failed to load symbols: " << res.status().message();
+    }
+  };
   auto *router = new mpact::sim::util::SingleInitiatorRouter("router");
   TaggedMemoryInterface *data_memory =
       static_cast<TaggedMemoryInterface *>(router);
-  TaggedMemoryUseProfiler *memory_use_profiler = nullptr;
+  CheriotMemoryUseProfiler *memory_use_profiler = nullptr;
   // Check to see if memory use profiling is enabled, and if so, set it up.
   if (absl::GetFlag(FLAGS_mem_profile)) {
-    memory_use_profiler = new TaggedMemoryUseProfiler(data_memory);
+    memory_use_profiler = new CheriotMemoryUseProfiler(data_memory);
     // Disable until program execution.
     memory_use_profiler->set_is_enabled(false);
     data_memory = memory_use_profiler;
@@ -279,18 +469,28 @@ int main(int argc, char **argv) {
   CheriotState cheriot_state("CherIoT", data_memory,
                              static_cast<AtomicMemoryOpInterface *>(router));
   cheriot_state.set_core_version(absl::GetFlag(FLAGS_core_version));
+  cheriot_state.set_pmp_enabled(absl::GetFlag(FLAGS_pmp));
 
-  DecoderInterface *decoder = nullptr;
-  if (absl::GetFlag(FLAGS_rvv_fp)) {
-    decoder = new CheriotRVVFPDecoder(&cheriot_state,
-                                      static_cast<MemoryInterface *>(router));
-  } else if (absl::GetFlag(FLAGS_rvv_fp)) {
-    decoder = new CheriotRVVDecoder(&cheriot_state,
-                                    static_cast<MemoryInterface *>(router));
-  } else {
-    decoder = new CheriotDecoder(&cheriot_state,
-                                 static_cast<MemoryInterface *>(router));
-  }
+  // The decode fast paths are disabled for the lockstep reference, so that it
+  // checks them against the generated decoder and the execute time lookups.
+  auto create_decoder = [](CheriotState *state, MemoryInterface *memory,
+                           bool fast_paths) -> DecoderInterface * {
+    if (absl::GetFlag(FLAGS_rvv_fp)) {
+      auto *decoder = new CheriotRVVFPDecoder(state, memory);
+      if (!fast_paths) decoder->DisableFastPaths();
+      return decoder;
+    } else if (absl::GetFlag(FLAGS_rvv_fp)) {
+      auto *decoder = new CheriotRVVDecoder(state, memory);
+      if (!fast_paths) decoder->DisableFastPaths();
+      return decoder;
+    }
+    auto *decoder = new CheriotDecoder(state, memory);
+    if (!fast_paths) decoder->DisableFastPaths();
+    return decoder;
+  };
+  DecoderInterface *decoder =
+      create_decoder(&cheriot_state, static_cast<MemoryInterface *>(router),
+                     /*fast_paths=*/true);
 
   CheriotTop cheriot_top("Cheriot", &cheriot_state, decoder);
 
@@ -303,6 +503,7 @@ int main(int argc, char **argv) {
     if (!status.ok()) return -1;
   }
 
+  TaggedMemoryInterface *dcache_memory = nullptr;
   if (!absl::GetFlag(FLAGS_dcache).empty()) {
     ComponentValueEntry dcache_value;
     dcache_value.set_name("dcache");
@@ -312,13 +513,49 @@ int main(int argc, char **argv) {
     if (!status.ok()) return -1;
     // Hook the cache into the memory port.
     auto *dcache = cheriot_top.dcache();
-    dcache->set_memory(cheriot_top.state()->tagged_memory());
+    dcache_memory = cheriot_top.state()->tagged_memory();
+    dcache->set_memory(dcache_memory);
     cheriot_top.state()->set_tagged_memory(dcache);
+    cheriot_top.state()->set_uncached_memory(dcache_memory);
+  }
+
+  if (!absl::GetFlag(FLAGS_tagcache).empty()) {
+    ComponentValueEntry tag_cache_value;
+    tag_cache_value.set_name("tagcache");
+    tag_cache_value.set_string_value(absl::GetFlag(FLAGS_tagcache));
+    auto *cfg = cheriot_top.GetConfig("tagcache");
+    auto status = cfg->Import(&tag_cache_value);
+    if (!status.ok()) return -1;
+    if (cheriot_top.tag_cache() == nullptr) return -1;
+  }
+
+  if (!absl::GetFlag(FLAGS_branch_predictor).empty()) {
+    ComponentValueEntry branch_predictor_value;
+    branch_predictor_value.set_name("branch_predictor");
+    branch_predictor_value.set_string_value(
+        absl::GetFlag(FLAGS_branch_predictor));
+    auto *cfg = cheriot_top.GetConfig("branch_predictor");
+    auto status = cfg->Import(&branch_predictor_value);
+    if (!status.ok()) return -1;
+    if (cheriot_top.branch_predictor() == nullptr) return -1;
+  }
+
+  if (!absl::GetFlag(FLAGS_coverage).empty()) {
+    auto *coverage = cheriot_top.EnableCoverage();
+    std::ifstream coverage_file(absl::GetFlag(FLAGS_coverage));
+    if (coverage_file.good()) {
+      auto status = coverage->Merge(coverage_file);
+      if (!status.ok()) {
+        std::cerr << "Error merging coverage: " << status.message() << "\n";
+        return -1;
+      }
+    }
   }
 
   // Enable instruction profiling if the flag is set.
   InstructionProfiler *inst_profiler = nullptr;
   if (absl::GetFlag(FLAGS_inst_profile)) {
+    load_elf_symbols();
     inst_profiler = new InstructionProfiler(elf_loader, 2);
     cheriot_top.counter_pc()->AddListener(inst_profiler);
   } else {
@@ -328,7 +565,7 @@ int main(int argc, char **argv) {
   mpact::sim::generic::DataBuffer *db = nullptr;
 
   // If tohost exists, add a memory watcher to look for exit signal.
-  auto tohost_res = elf_loader.GetSymbol("tohost");
+  auto tohost_res = elf_file.GetSymbol("tohost");
   uint64_t tohost_addr = 0;
   if (tohost_res.ok()) {
     // tohost is declared as uint32_t tohost[2]. Writing an lsb of 1
@@ -399,14 +636,26 @@ int main(int argc, char **argv) {
 
   auto uart_base = absl::GetFlag(FLAGS_uart);
   auto clint_base = absl::GetFlag(FLAGS_clint);
-  CHECK_OK(router->AddTarget<MemoryInterface>(uart, uart_base,
-                                              uart_base + 0x100ULL - 1));
+  uint64_t uart_top = uart_base + 0x100ULL - 1;
+  uint64_t clint_top = clint_base + 0x10000ULL - 1;
+  // Memory mapped device accesses may have side effects, so the paths that
+  // access, compare or snapshot simulated memory directly leave them alone.
+  CheriotAddressRanges device_ranges;
+  device_ranges.Add(uart_base, uart_top);
+  device_ranges.Add(clint_base, clint_top);
+  CHECK_OK(router->AddTarget<MemoryInterface>(uart, uart_base, uart_top));
   auto *clint = new RiscVClint(/*period=*/100, cheriot_top.state()->mip());
   cheriot_top.counter_num_cycles()->AddListener(clint);
-  CHECK_OK(router->AddTarget<MemoryInterface>(clint, clint_base,
-                                              clint_base + 0x10000ULL - 1));
+  CHECK_OK(router->AddTarget<MemoryInterface>(clint, clint_base, clint_top));
   CHECK_OK(router->AddDefaultTarget<AtomicMemoryOpInterface>(atomic_memory));
   CHECK_OK(router->AddDefaultTarget<TaggedMemoryInterface>(tagged_memory));
+  // Atomic memory operations on the reserved memory are performed in place,
+  // except on the device ranges. The memory use profiler needs to see them,
+  // so it disables this.
+  if ((reserved_memory != nullptr) && !absl::GetFlag(FLAGS_mem_profile)) {
+    cheriot_top.state()->set_amo_memory(reserved_memory);
+    cheriot_top.state()->set_amo_excluded_ranges(device_ranges);
+  }
 
   // Set up a dummy WFI handler.
   cheriot_top.state()->set_on_wfi([](const Instruction *) { return true; });
@@ -424,13 +673,30 @@ int main(int argc, char **argv) {
   auto *semihost =
       new RiscVArmSemihost(RiscVArmSemihost::BitWidth::kWord32, memory, memory);
   semihost->SetCmdLine(arg_vec);
-  cheriot_top.state()->AddEbreakHandler([semihost](const Instruction *inst) {
-    if (semihost->IsSemihostingCall(inst)) {
-      semihost->OnEBreak(inst);
-      return true;
-    }
-    return false;
-  });
+  // Files opened for reading are served by the file input handler, which
+  // reads them straight into simulated memory.
+  auto *file_input = new CheriotSemihostFileInput(
+      cheriot_top.state(), static_cast<TaggedMemoryInterface *>(router),
+      reserved_memory, absl::GetFlag(FLAGS_semihost_mmap));
+  file_input->set_excluded_ranges(device_ranges);
+  // The lockstep checker, if enabled below, records the result of each
+  // semihosting call so that the reference can replay it.
+  std::unique_ptr<CheriotLockstep> lockstep;
+  cheriot_top.state()->AddEbreakHandler(
+      [semihost, file_input, &lockstep](const Instruction *inst) {
+        if (semihost->IsSemihostingCall(inst)) {
+          auto perform = [semihost, file_input, inst]() {
+            if (!file_input->OnSemihostingCall()) semihost->OnEBreak(inst);
+          };
+          if (lockstep != nullptr) {
+            lockstep->TopSemihostingCall(perform);
+          } else {
+            perform();
+          }
+          return true;
+        }
+        return false;
+      });
   semihost->set_exit_callback([&cheriot_top]() {
     cheriot_top.RequestHalt(HaltReason::kSemihostHaltRequest, nullptr);
   });
@@ -443,7 +709,7 @@ int main(int argc, char **argv) {
   uint64_t stack_end = 0;
 
   // Is the __stack_end symbol defined?
-  auto res = elf_loader.GetSymbol(kStackEndSymbolName);
+  auto res = elf_file.GetSymbol(kStackEndSymbolName);
   if (res.ok()) {
     stack_end = res.value().first;
     initialize_stack = true;
@@ -462,13 +728,13 @@ int main(int argc, char **argv) {
 
     // Does the executable have a valid GNU_STACK segment? If so, override the
     // default
-    auto loader_res = elf_loader.GetStackSize();
+    auto loader_res = elf_file.GetStackSize();
     if (loader_res.ok()) {
       stack_end = loader_res.value();
     }
 
     // If the __stack_size symbol is defined then override.
-    auto res = elf_loader.GetSymbol(kStackSizeSymbolName);
+    auto res = elf_file.GetSymbol(kStackSizeSymbolName);
     if (res.ok()) {
       stack_size = res.value().first;
     }
@@ -485,10 +751,140 @@ int main(int argc, char **argv) {
     }
   }
 
+  // Set up the reference simulator for lockstep checking. It loads the same
+  // program, and starts with the same pcc and sp.
+  uint64_t lockstep_interval = absl::GetFlag(FLAGS_lockstep);
+  std::unique_ptr<mpact::sim::util::TaggedFlatDemandMemory> reference_memory;
+  std::unique_ptr<mpact::sim::util::SingleInitiatorRouter> reference_router;
+  std::unique_ptr<CheriotState> reference_state;
+  std::unique_ptr<DecoderInterface> reference_decoder;
+  std::unique_ptr<CheriotTop> reference_top;
+  std::unique_ptr<mpact::sim::util::AtomicMemory> reference_atomic_memory;
+  std::unique_ptr<SimpleUart> reference_uart;
+  std::unique_ptr<RiscVClint> reference_clint;
+  std::unique_ptr<RiscVArmSemihost> reference_semihost;
+  std::ostream null_stream(nullptr);
+  if (lockstep_interval > 0) {
+    if (absl::GetFlag(FLAGS_i) || absl::GetFlag(FLAGS_interactive)) {
+      std::cerr << "Lockstep checking is only supported in batch mode\n";
+      return -1;
+    }
+    reference_memory =
+        std::make_unique<mpact::sim::util::TaggedFlatDemandMemory>(
+            kCapabilityGranule);
+    CheriotElfLoader reference_elf_file;
+    auto reference_load = reference_elf_file.LoadProgram(
+        full_file_name, reference_memory.get(), /*memory_is_zero=*/true);
+    if (!reference_load.ok()) {
+      std::cerr << "Error while loading reference: "
+                << reference_load.status().message();
+      return -1;
+    }
+    reference_router =
+        std::make_unique<mpact::sim::util::SingleInitiatorRouter>(
+            "reference_router");
+    reference_state = std::make_unique<CheriotState>(
+        "Reference",
+        static_cast<TaggedMemoryInterface *>(reference_router.get()),
+        static_cast<AtomicMemoryOpInterface *>(reference_router.get()));
+    reference_state->set_core_version(absl::GetFlag(FLAGS_core_version));
+    reference_state->set_pmp_enabled(absl::GetFlag(FLAGS_pmp));
+    reference_state->pmp_checker()->set_cache_enabled(false);
+    reference_decoder.reset(create_decoder(
+        reference_state.get(),
+        static_cast<MemoryInterface *>(reference_router.get()),
+        /*fast_paths=*/false));
+    reference_top = std::make_unique<CheriotTop>(
+        "Reference", reference_state.get(), reference_decoder.get());
+    reference_atomic_memory = std::make_unique<mpact::sim::util::AtomicMemory>(
+        reference_memory.get());
+    reference_uart =
+        std::make_unique<SimpleUart>(reference_state.get(), null_stream);
+    CHECK_OK(reference_router->AddTarget<MemoryInterface>(
+        reference_uart.get(), uart_base, uart_top));
+    reference_clint =
+        std::make_unique<RiscVClint>(/*period=*/100, reference_state->mip());
+    reference_top->counter_num_cycles()->AddListener(reference_clint.get());
+    CHECK_OK(reference_router->AddTarget<MemoryInterface>(
+        reference_clint.get(), clint_base, clint_top));
+    CHECK_OK(reference_router->AddDefaultTarget<AtomicMemoryOpInterface>(
+        reference_atomic_memory.get()));
+    CHECK_OK(reference_router->AddDefaultTarget<TaggedMemoryInterface>(
+        reference_memory.get()));
+    reference_state->set_on_wfi([](const Instruction *) { return true; });
+    reference_state->set_on_ecall([](const Instruction *) { return false; });
+    lockstep = std::make_unique<CheriotLockstep>(&cheriot_top,
+                                                 reference_top.get());
+    // The reference only makes the semihosting calls without host I/O, such
+    // as exit, and otherwise replays the results of the top's calls.
+    auto *reference_bus =
+        static_cast<MemoryInterface *>(reference_router.get());
+    reference_semihost = std::make_unique<RiscVArmSemihost>(
+        RiscVArmSemihost::BitWidth::kWord32, reference_bus, reference_bus);
+    reference_semihost->SetCmdLine(arg_vec);
+    reference_state->AddEbreakHandler(
+        [semihost = reference_semihost.get(),
+         lockstep = lockstep.get()](const Instruction *inst) {
+          if (semihost->IsSemihostingCall(inst)) {
+            lockstep->ReferenceSemihostingCall(
+                [semihost, inst]() { semihost->OnEBreak(inst); });
+            return true;
+          }
+          return false;
+        });
+    reference_semihost->set_exit_callback([&reference_top]() {
+      reference_top->RequestHalt(HaltReason::kSemihostHaltRequest, nullptr);
+    });
+    for (auto const *name : {"pcc", "sp"}) {
+      auto value = cheriot_top.ReadRegister(name);
+      CHECK_OK(value.status());
+      CHECK_OK(reference_top->WriteRegister(name, value.value()));
+    }
+    lockstep->TrackStores(cheriot_top.state());
+    lockstep->TrackStores(reference_state.get());
+    lockstep->set_excluded_ranges(device_ranges);
+  }
+
   mpact::sim::generic::SimpleCounter<double> counter_sec("simulation_time_sec",
                                                          0.0);
 
   CHECK_OK(cheriot_top.AddCounter(&counter_sec));
+  // Serve live counter snapshots if requested. The server is notified of every
+  // cycle so that snapshots are taken by the simulation thread.
+  std::unique_ptr<mpact::sim::cheriot::CheriotMetricsServer> metrics_server;
+  if (!absl::GetFlag(FLAGS_metrics_socket).empty()) {
+    metrics_server =
+        std::make_unique<mpact::sim::cheriot::CheriotMetricsServer>(
+            &cheriot_top);
+    metrics_server->set_is_halted([&cheriot_top]() {
+      return cheriot_top.GetRunStatus().value() == RunStatus::kHalted;
+    });
+    auto status = metrics_server->Start(absl::GetFlag(FLAGS_metrics_socket));
+    if (!status.ok()) {
+      std::cerr << "Error starting metrics server: " << status.message()
+                << "\n";
+      return -1;
+    }
+    cheriot_top.counter_num_cycles()->AddListener(metrics_server.get());
+  }
+  // Pace the simulation if requested. The pacer is called from the run loop
+  // between quanta, and starts pacing at the first one.
+  std::unique_ptr<CheriotPacer> pacer;
+  if (absl::GetFlag(FLAGS_pace_frequency) > 0.0) {
+    if (absl::GetFlag(FLAGS_pace_quantum) == 0) {
+      std::cerr << "Pacing quantum must be > 0\n";
+      return -1;
+    }
+    pacer = std::make_unique<CheriotPacer>(
+        absl::GetFlag(FLAGS_pace_frequency),
+        absl::GetFlag(FLAGS_pace_max_lag_usec));
+    CHECK_OK(pacer->AddCounters(&cheriot_top));
+    cheriot_top.SetRunQuantumCallback(
+        absl::GetFlag(FLAGS_pace_quantum),
+        [&cheriot_top, pacer = pacer.get()]() {
+          pacer->Pace(cheriot_top.counter_num_cycles()->GetValue());
+        });
+  }
   // Set up control-c handling.
   top = &cheriot_top;
   struct sigaction sa;
@@ -509,9 +905,87 @@ int main(int argc, char **argv) {
 
   // Determine if this is being run interactively or as a batch job.
   bool interactive = absl::GetFlag(FLAGS_i) || absl::GetFlag(FLAGS_interactive);
+
+  // Set up the region of interest. The detailed models are detached until the
+  // start instruction is executed.
+  std::unique_ptr<CheriotRoiControl> roi_control;
+  if (!absl::GetFlag(FLAGS_roi_start).empty() ||
+      !absl::GetFlag(FLAGS_roi_end).empty()) {
+    if (interactive || (lockstep != nullptr)) {
+      std::cerr << "ROI control is only supported in batch mode without "
+                   "lockstep checking\n";
+      return -1;
+    }
+    // Resolves an address or symbol name.
+    auto get_location =
+        [&elf_file](const std::string &location) -> std::optional<uint64_t> {
+      if (location.empty()) return std::nullopt;
+      size_t index;
+      auto result = mpact::sim::riscv::internal::stoull(location, &index, 0);
+      if (result.ok() && (index >= location.size())) return result.value();
+      auto symbol = elf_file.GetSymbol(location);
+      if (!symbol.ok()) return std::nullopt;
+      return symbol.value().first;
+    };
+    auto roi_start = get_location(absl::GetFlag(FLAGS_roi_start));
+    auto roi_end = get_location(absl::GetFlag(FLAGS_roi_end));
+    if ((!roi_start.has_value() && !absl::GetFlag(FLAGS_roi_start).empty()) ||
+        (!roi_end.has_value() && !absl::GetFlag(FLAGS_roi_end).empty())) {
+      std::cerr << "Unable to resolve ROI start or end\n";
+      return -1;
+    }
+    roi_control = std::make_unique<CheriotRoiControl>(
+        &cheriot_top, dcache_memory, memory_use_profiler,
+        inst_profiler != nullptr);
+    auto status = roi_control->SetModels(absl::GetFlag(FLAGS_roi_models));
+    if (status.ok()) status = roi_control->SetRegion(roi_start, roi_end);
+    if (!status.ok()) {
+      std::cerr << "Error setting up ROI: " << status.message() << "\n";
+      return -1;
+    }
+  }
+  // Set up the fault injection campaign.
+  std::unique_ptr<CheriotFaultCampaign> fault_campaign;
+  std::vector<CheriotFaultCampaign::Fault> faults;
+  if (!absl::GetFlag(FLAGS_fault_campaign).empty() ||
+      (absl::GetFlag(FLAGS_fault_count) > 0)) {
+    if (interactive || (lockstep != nullptr) || (roi_control != nullptr) ||
+        (pacer != nullptr)) {
+      std::cerr << "Fault campaigns are only supported in batch mode without "
+                   "lockstep checking, ROI control or pacing\n";
+      return -1;
+    }
+    if (!absl::GetFlag(FLAGS_fault_campaign).empty()) {
+      std::ifstream campaign_file(absl::GetFlag(FLAGS_fault_campaign));
+      if (!campaign_file.good()) {
+        std::cerr << "Unable to open fault campaign file '"
+                  << absl::GetFlag(FLAGS_fault_campaign) << "'\n";
+        return -1;
+      }
+      std::string line;
+      while (std::getline(campaign_file, line)) {
+        // Skip empty lines and comments.
+        auto pos = line.find_first_not_of(" \t");
+        if ((pos == std::string::npos) || (line[pos] == '#')) continue;
+        auto fault = CheriotFaultCampaign::ParseFault(line);
+        if (!fault.ok()) {
+          std::cerr << fault.status().message() << "\n";
+          return -1;
+        }
+        faults.push_back(fault.value());
+      }
+    }
+    fault_campaign = std::make_unique<CheriotFaultCampaign>(&cheriot_top);
+    fault_campaign->set_excluded_ranges(device_ranges);
+    // Save msip, mtimecmp and mtime of the clint.
+    fault_campaign->AddSavedRange(clint_base, 4);
+    fault_campaign->AddSavedRange(clint_base + 0x4000, 8);
+    fault_campaign->AddSavedRange(clint_base + 0xbff8, 8);
+  }
   CheriotInstrumentationControl *cheriot_instrumentation_control = nullptr;
   if (interactive) {
     mpact::sim::cheriot::DebugCommandShell cmd_shell;
+    load_elf_symbols();
     cmd_shell.AddCore({&cheriot_top, [&elf_loader]() { return &elf_loader; },
                        &cheriot_state});
     cheriot_instrumentation_control = new CheriotInstrumentationControl(
@@ -530,14 +1004,27 @@ int main(int argc, char **argv) {
 
     auto t0 = absl::Now();
 
-    auto run_status = cheriot_top.Run();
-    if (!run_status.ok()) {
-      std::cerr << run_status.message() << std::endl;
-    }
+    if (fault_campaign != nullptr) {
+      exit_code = RunFaultCampaign(fault_campaign.get(), faults, file_input);
+    } else if (lockstep != nullptr) {
+      auto lockstep_status = lockstep->Run(lockstep_interval, 0);
+      if (!lockstep_status.ok()) {
+        std::cerr << lockstep_status.message() << std::endl;
+      }
+      if (lockstep->diverged()) {
+        std::cerr << lockstep->report();
+        exit_code = -1;
+      }
+    } else {
+      auto run_status = cheriot_top.Run();
+      if (!run_status.ok()) {
+        std::cerr << run_status.message() << std::endl;
+      }
 
-    auto wait_status = cheriot_top.Wait();
-    if (!wait_status.ok()) {
-      std::cerr << wait_status.message() << std::endl;
+      auto wait_status = cheriot_top.Wait();
+      if (!wait_status.ok()) {
+        std::cerr << wait_status.message() << std::endl;
+      }
     }
 
     auto t1 = absl::Now();
@@ -551,6 +1038,18 @@ int main(int argc, char **argv) {
     std::cerr << absl::StrFormat(
         "Simulation done: %llu instructions in %0.1f sec (%0.1f MIPS)\n",
         num_instructions, sec, mips);
+    if (roi_control != nullptr) {
+      std::cerr << absl::StrFormat("ROI: %d entries, %llu instructions\n",
+                                   roi_control->num_entries(),
+                                   roi_control->roi_instructions());
+    }
+    if (pacer != nullptr) {
+      std::cerr << absl::StrFormat(
+          "Pacing: %llu quanta, %llu late (max lag %llu usec), %llu resyncs, "
+          "max oversleep %llu usec\n",
+          pacer->num_quanta(), pacer->num_late_quanta(), pacer->max_lag_usec(),
+          pacer->num_resyncs(), pacer->max_oversleep_usec());
+    }
   }
 
   // Write out memory use profile.
@@ -571,6 +1070,20 @@ int main(int argc, char **argv) {
     } else {
       memory_use_profiler->WriteProfile(memory_use_profile_file);
     }
+    std::string tag_heatmap_file_name;
+    if (FLAGS_output_dir.CurrentValue().empty()) {
+      tag_heatmap_file_name = "./" + file_basename + "_tag_heatmap.csv";
+    } else {
+      tag_heatmap_file_name = FLAGS_output_dir.CurrentValue() + "/" +
+                              file_basename + "_tag_heatmap.csv";
+    }
+    std::fstream tag_heatmap_file(tag_heatmap_file_name.c_str(),
+                                  std::ios_base::out);
+    if (!tag_heatmap_file.good()) {
+      LOG(ERROR) << "Failed to write tag heatmap to file";
+    } else {
+      memory_use_profiler->WriteTagHeatmap(tag_heatmap_file);
+    }
   }
 
   // Write out instruction profile.
@@ -592,6 +1105,39 @@ int main(int argc, char **argv) {
     }
   }
 
+  // Write out branch mispredicts per pc.
+  if (cheriot_top.branch_predictor() != nullptr) {
+    std::cerr << "Writing out branch mispredict profile\n";
+    std::string mispredict_file_name;
+    if (FLAGS_output_dir.CurrentValue().empty()) {
+      mispredict_file_name = "./" + file_basename + "_branch_mispredicts.csv";
+    } else {
+      mispredict_file_name = FLAGS_output_dir.CurrentValue() + "/" +
+                             file_basename + "_branch_mispredicts.csv";
+    }
+    std::fstream mispredict_file(mispredict_file_name.c_str(),
+                                 std::ios_base::out);
+    if (!mispredict_file.good()) {
+      LOG(ERROR) << "Failed to write branch mispredict profile to file";
+    } else {
+      cheriot_top.branch_predictor()->WriteProfile(mispredict_file);
+    }
+  }
+
+  // Write out the ISA coverage, including that merged from earlier runs.
+  if (cheriot_top.coverage() != nullptr) {
+    std::cerr << "Writing out ISA coverage\n";
+    std::fstream coverage_file(absl::GetFlag(FLAGS_coverage).c_str(),
+                               std::ios_base::out);
+    if (!coverage_file.good()) {
+      LOG(ERROR) << "Failed to write coverage to file";
+    } else {
+      cheriot_top.coverage()->WriteReport(coverage_file);
+    }
+  }
+
+  if (metrics_server != nullptr) metrics_server->Stop();
+
   // Export counters.
   std::cerr << "Exporting counters\n";
   auto component_proto = std::make_unique<ComponentData>();
@@ -622,8 +1168,10 @@ int main(int argc, char **argv) {
   delete cheriot_instrumentation_control;
   delete inst_profiler;
   delete atomic_memory;
-  delete tagged_memory;
+  delete reserved_memory;
+  delete demand_memory;
   delete memory_use_profiler;
+  delete file_input;
   delete semihost;
   if (db != nullptr) db->DecRef();
   return exit_code;
@@ -14,10 +14,15 @@
 
 #include "cheriot/riscv_cheriot_a_instructions.h"
 
+#include <algorithm>
 #include <cstdint>
+#include <cstring>
+#include <type_traits>
 
 #include "absl/status/status.h"
+#include "cheriot/cheriot_pmp_checker.h"
 #include "cheriot/cheriot_state.h"
+#include "cheriot/riscv_cheriot_instruction_helpers.h"
 #include "mpact/sim/generic/instruction.h"
 #include "mpact/sim/generic/type_helpers.h"
 #include "mpact/sim/util/memory/memory_interface.h"
@@ -35,6 +40,35 @@ using ::mpact::sim::generic::operator*;  // NOLINT: is used below (clang error).
 
 using Operation = util::AtomicMemoryOpInterface::Operation;
 using RV_EC = ::mpact::sim::riscv::ExceptionCode;
+using PmpAccess = ::mpact::sim::cheriot::CheriotPmpChecker::Access;
+
+// Returns the value written back to memory by the atomic memory operation.
+template <typename T>
+static inline T AmoValue(Operation op, T mem_value, T value) {
+  using S = typename std::make_signed<T>::type;
+  switch (op) {
+    case Operation::kAtomicSwap:
+      return value;
+    case Operation::kAtomicAdd:
+      return mem_value + value;
+    case Operation::kAtomicAnd:
+      return mem_value & value;
+    case Operation::kAtomicOr:
+      return mem_value | value;
+    case Operation::kAtomicXor:
+      return mem_value ^ value;
+    case Operation::kAtomicMax:
+      return std::max(static_cast<S>(mem_value), static_cast<S>(value));
+    case Operation::kAtomicMaxu:
+      return std::max(mem_value, value);
+    case Operation::kAtomicMin:
+      return std::min(static_cast<S>(mem_value), static_cast<S>(value));
+    case Operation::kAtomicMinu:
+      return std::min(mem_value, value);
+    default:
+      return mem_value;
+  }
+}
 
 // Helper function for the atomic memory operation semantic functions.
 template <typename T>
@@ -51,6 +85,36 @@ static inline void AInstructionHelper(Instruction *inst, Operation op,
   }
   // Submit the memory operation.
   auto address = generic::GetInstructionSource<uint64_t>(inst, 0);
+  // Check the PMP permissions. Load linked only reads and store conditional
+  // only writes, all other operations do both.
+  bool is_load_linked = op == Operation::kLoadLinked;
+  if ((!is_load_linked &&
+       !state->CheckPmp(address, sizeof(T), PmpAccess::kWrite)) ||
+      ((op != Operation::kStoreConditional) &&
+       !state->CheckPmp(address, sizeof(T), PmpAccess::kRead))) {
+    state->Trap(/*is_interrupt*/ false, address,
+                is_load_linked ? *RV_EC::kLoadAccessFault
+                               : *RV_EC::kStoreAccessFault,
+                inst->address(), inst);
+    return;
+  }
+  // Operations other than lr/sc on host backed memory are performed in place,
+  // and the old value is written directly to the destination register of the
+  // child instruction, which would otherwise write back the load data.
+  if ((op != Operation::kLoadLinked) && (op != Operation::kStoreConditional)) {
+    uint8_t *host = state->GetAmoHostPointer(address, sizeof(T));
+    if (host != nullptr) {
+      T value = generic::GetInstructionSource<T>(inst, 1);
+      T mem_value;
+      std::memcpy(&mem_value, host, sizeof(T));
+      T new_value = AmoValue(op, mem_value, value);
+      std::memcpy(host, &new_value, sizeof(T));
+      WriteCapIntResult(inst->child(), 0,
+                        static_cast<typename std::make_signed<T>::type>(
+                            mem_value));
+      return;
+    }
+  }
   auto *db = inst->state()->db_factory()->Allocate<T>(1);
   db->set_latency(0);
   // Only access the operand if there is a value to be read.
@@ -32,9 +32,76 @@ namespace cheriot {
 namespace isa32 {
 
 using Extractors = ::mpact::sim::cheriot::encoding::Extractors;
+using ::mpact::sim::cheriot::encoding::DecodeRiscVCheriotInst16WithFormat;
+using ::mpact::sim::cheriot::encoding::DecodeRiscVCheriotInst32WithFormat;
+
+namespace {
+
+// Major opcodes (bits 6..0) and the func3 values (as a bit mask) for which the
+// opcode and format in riscv_cheriot.bin_fmt are determined by the major
+// opcode and func3 fields alone. This has to be kept in sync with the
+// RiscVCheriotInst32 instruction group.
+struct Func3Decoded {
+  uint8_t opcode;
+  uint8_t func3_mask;
+};
+
+constexpr Func3Decoded kFunc3Decoded[] = {
+    {0b000'0011, 0b0011'1111},  // lb, lh, lw, lc, lbu, lhu.
+    {0b000'1111, 0b0000'0001},  // fence.
+    {0b001'0011, 0b1101'1101},  // ALU immediate, except shifts.
+    {0b001'0111, 0b1111'1111},  // auipcc.
+    {0b010'0011, 0b0000'1111},  // sb, sh, sw, sc.
+    {0b011'0111, 0b1111'1111},  // lui.
+    {0b101'1011, 0b0000'0110},  // cincaddrimm, csetboundsimm.
+    {0b110'0011, 0b1111'0011},  // Conditional branches.
+    {0b111'1011, 0b1111'1111},  // auicgp.
+};
+
+constexpr int Inst32Index(uint32_t inst_word) {
+  return ((inst_word & 0x7f) << 3) | ((inst_word >> 12) & 0x7);
+}
+
+// Returns the table of opcodes and formats for all 16 bit instruction words.
+const RiscVCheriotEncoding::DecodeEntry *Inst16Table() {
+  static const RiscVCheriotEncoding::DecodeEntry *table = []() {
+    auto *table = new RiscVCheriotEncoding::DecodeEntry[1 << 16];
+    for (uint32_t word = 0; word < (1 << 16); word++) {
+      auto [opcode, format] =
+          DecodeRiscVCheriotInst16WithFormat(static_cast<uint16_t>(word));
+      table[word] = {true, opcode, format};
+    }
+    return table;
+  }();
+  return table;
+}
+
+// Returns the first level table for 32 bit instruction words, indexed by the
+// major opcode and func3. Entries that need more fields to be decoded are
+// marked as unresolved.
+const RiscVCheriotEncoding::DecodeEntry *Inst32Table() {
+  static const RiscVCheriotEncoding::DecodeEntry *table = []() {
+    // Value initialized, i.e., all entries are unresolved.
+    auto *table = new RiscVCheriotEncoding::DecodeEntry[1 << 10]();
+    for (auto const &[major_opcode, func3_mask] : kFunc3Decoded) {
+      for (uint32_t func3 = 0; func3 < 8; func3++) {
+        if ((func3_mask & (1 << func3)) == 0) continue;
+        uint32_t word = (func3 << 12) | major_opcode;
+        auto [opcode, format] = DecodeRiscVCheriotInst32WithFormat(word);
+        table[Inst32Index(word)] = {true, opcode, format};
+      }
+    }
+    return table;
+  }();
+  return table;
+}
+
+}  // namespace
 
 RiscVCheriotEncoding::RiscVCheriotEncoding(CheriotState *state)
-    : RiscVCheriotEncodingCommon(state) {
+    : RiscVCheriotEncodingCommon(state),
+      inst16_table_(Inst16Table()),
+      inst32_table_(Inst32Table()) {
   source_op_getters_.emplace(*SourceOpEnum::kNone, []() { return nullptr; });
   dest_op_getters_.emplace(*DestOpEnum::kNone,
                            [](int latency) { return nullptr; });
@@ -54,23 +121,38 @@ RiscVCheriotEncoding::RiscVCheriotEncoding(CheriotState *state)
   }
 }
 
-// Parse the instruction word to determine the opcode.
+// Parse the instruction word to determine the opcode. Compact instructions
+// are looked up directly in the 16 bit table. For 32 bit instructions the
+// first level table is tried first, and only the instructions that need more
+// than the major opcode and func3 fields go through the generated decoder.
 void RiscVCheriotEncoding::ParseInstruction(uint32_t inst_word) {
   inst_word_ = inst_word;
-  if ((inst_word_ & 0x3) == 3) {
+  if (!use_decode_tables_) {
     auto [opcode, format] =
-        mpact::sim::cheriot::encoding::DecodeRiscVCheriotInst32WithFormat(
-            inst_word_);
+        (inst_word_ & 0x3) == 3
+            ? DecodeRiscVCheriotInst32WithFormat(inst_word_)
+            : DecodeRiscVCheriotInst16WithFormat(
+                  static_cast<uint16_t>(inst_word_ & 0xffff));
+    opcode_ = opcode;
+    format_ = format;
+    return;
+  }
+  if ((inst_word_ & 0x3) == 3) {
+    auto const &entry = inst32_table_[Inst32Index(inst_word_)];
+    if (entry.resolved) {
+      opcode_ = entry.opcode;
+      format_ = entry.format;
+      return;
+    }
+    auto [opcode, format] = DecodeRiscVCheriotInst32WithFormat(inst_word_);
     opcode_ = opcode;
     format_ = format;
     return;
   }
 
-  auto [opcode, format] =
-      mpact::sim::cheriot::encoding::DecodeRiscVCheriotInst16WithFormat(
-          static_cast<uint16_t>(inst_word_ & 0xffff));
-  opcode_ = opcode;
-  format_ = format;
+  auto const &entry = inst16_table_[inst_word_ & 0xffff];
+  opcode_ = entry.opcode;
+  format_ = entry.format;
 }
 
 DestinationOperandInterface *RiscVCheriotEncoding::GetDestination(
@@ -47,10 +47,23 @@ class RiscVCheriotEncoding : public RiscVCheriotEncodingCommon,
   using DestOpGetterMap = absl::flat_hash_map<
       int, absl::AnyInvocable<DestinationOperandInterface *(int)>>;
 
+  // Entry in the decode tables used by ParseInstruction.
+  struct DecodeEntry {
+    // False if the entry doesn't determine the opcode by itself.
+    bool resolved;
+    OpcodeEnum opcode;
+    FormatEnum format;
+  };
+
   explicit RiscVCheriotEncoding(CheriotState *state);
 
-  // Parses an instruction and determines the opcode.
+  // Parses an instruction and determines the opcode. The decode tables are
+  // built from the generated decoder on first use and shared by all
+  // instances.
   void ParseInstruction(uint32_t inst_word);
+  // If false, every instruction is parsed by the generated decoder, e.g., so
+  // that a lockstep reference doesn't depend on the decode tables.
+  void set_use_decode_tables(bool value) { use_decode_tables_ = value; }
 
   // RiscV32 CHERIoT has a single slot type and single entry, so the following
   // methods ignore those parameters.
@@ -103,6 +116,9 @@ class RiscVCheriotEncoding : public RiscVCheriotEncodingCommon,
  private:
   SourceOpGetterMap source_op_getters_;
   DestOpGetterMap dest_op_getters_;
+  const DecodeEntry *inst16_table_;
+  const DecodeEntry *inst32_table_;
+  bool use_decode_tables_ = true;
   OpcodeEnum opcode_;
   FormatEnum format_;
 };
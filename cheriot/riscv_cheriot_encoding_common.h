@@ -34,10 +34,16 @@ class RiscVCheriotEncodingCommon {
   // Accessors.
   CheriotState *state() const { return state_; }
   uint32_t inst_word() const { return inst_word_; }
+  // If false, the CSR operands are not resolved when an instruction is
+  // decoded, and the CSR is looked up each time it is executed, e.g., so
+  // that a lockstep reference doesn't depend on the decode time resolution.
+  bool resolve_csr_operands() const { return resolve_csr_operands_; }
+  void set_resolve_csr_operands(bool value) { resolve_csr_operands_ = value; }
 
  protected:
   CheriotState *state_;
   uint32_t inst_word_;
+  bool resolve_csr_operands_ = true;
 };
 
 }  // namespace cheriot
@@ -25,6 +25,7 @@
 #include <type_traits>
 
 #include "absl/log/log.h"
+#include "cheriot/cheriot_branch_predictor.h"
 #include "cheriot/cheriot_register.h"
 #include "cheriot/cheriot_state.h"
 #include "mpact/sim/generic/arch_state.h"
@@ -383,17 +384,24 @@ static inline void RVCheriotBranchConditional(
       typename std::make_unsigned<typename RegisterType::ValueType>::type;
   ValueType a = generic::GetInstructionSource<ValueType>(instruction, 0);
   ValueType b = generic::GetInstructionSource<ValueType>(instruction, 1);
-  if (cond(a, b)) {
-    UIntType offset = generic::GetInstructionSource<UIntType>(instruction, 2);
-    UIntType target = offset + instruction->address();
-    auto *state = static_cast<CheriotState *>(instruction->state());
-    auto *pcc = state->pcc();
-    if (!pcc->HasPermission(PB::kPermitExecute)) {
-      state->HandleCheriRegException(
-          instruction, pcc->address(),
-          ExceptionCode::kCapExPermitExecuteViolation, pcc);
-      return;
-    }
+  bool taken = cond(a, b);
+  auto *state = static_cast<CheriotState *>(instruction->state());
+  UIntType offset = generic::GetInstructionSource<UIntType>(instruction, 2);
+  UIntType target = offset + instruction->address();
+  auto *pcc = state->pcc();
+  if (taken && !pcc->HasPermission(PB::kPermitExecute)) {
+    state->HandleCheriRegException(instruction, pcc->address(),
+                                   ExceptionCode::kCapExPermitExecuteViolation,
+                                   pcc);
+    return;
+  }
+  // The branch predictor model needs to see both taken and not taken
+  // branches, but only those that commit.
+  auto *branch_predictor = state->branch_predictor();
+  if (branch_predictor != nullptr) {
+    branch_predictor->ConditionalBranch(instruction->address(), target, taken);
+  }
+  if (taken) {
     pcc->set_address(target);
     state->set_branch(true);
   }
@@ -20,6 +20,8 @@
 
 #include "absl/log/log.h"
 #include "absl/numeric/bits.h"
+#include "cheriot/cheriot_branch_predictor.h"
+#include "cheriot/cheriot_coverage.h"
 #include "cheriot/cheriot_register.h"
 #include "cheriot/cheriot_state.h"
 #include "mpact/sim/generic/data_buffer.h"
@@ -180,7 +182,8 @@ void CheriotCIncAddr(const Instruction *instruction) {
 static bool CheriotCJChecks(const Instruction *instruction, uint64_t new_pc,
                             const CheriotRegister *pcc) {
   auto *state = static_cast<CheriotState *>(instruction->state());
-  if (!state->has_compact() && (new_pc & 0b10)) {
+  // The target only depends on the immediate, so test it before reading misa.
+  if ((new_pc & 0b10) && !state->has_compact()) {
     state->Trap(/*is_interrupt*/ false, new_pc,
                 *riscv::ExceptionCode::kInstructionAddressMisaligned,
                 instruction->address(), instruction);
@@ -189,7 +192,11 @@ static bool CheriotCJChecks(const Instruction *instruction, uint64_t new_pc,
   return true;
 }
 
-void CheriotCJal(const Instruction *instruction) {
+// Helper for cjal. If seal_link is true, the link capability is sealed as a
+// backward sentry that restores the current interrupt enable on return. The
+// callers pass a constant, so each one is compiled without the test.
+static inline void CheriotCJalHelper(const Instruction *instruction,
+                                     bool seal_link) {
   auto *state = static_cast<CheriotState *>(instruction->state());
   auto offset = generic::GetInstructionSource<uint32_t>(instruction, 0);
   uint64_t new_pc = offset + instruction->address();
@@ -199,8 +206,8 @@ void CheriotCJal(const Instruction *instruction) {
   auto *cd = GetCapDest(instruction, 0);
   cd->CopyFrom(*pcc);
   cd->set_address(instruction->address() + instruction->size());
-  bool interrupt_enable = state->mstatus()->mie();
-  if (state->core_version() == CheriotState::kVersion0Dot5) {
+  if (seal_link) {
+    bool interrupt_enable = state->mstatus()->mie();
     (void)cd->Seal(*state->sealing_root(),
                    interrupt_enable
                        ? CapReg::kInterruptEnablingBackwardSentry
@@ -209,25 +216,23 @@ void CheriotCJal(const Instruction *instruction) {
   // Update pcc.
   pcc->set_address(new_pc);
   state->set_branch(true);
+  if (state->branch_predictor() != nullptr) {
+    state->branch_predictor()->DirectJump(
+        instruction->address(), /*is_call=*/state->IsLinkRegister(cd),
+        instruction->address() + instruction->size());
+  }
+}
+
+void CheriotCJal(const Instruction *instruction) {
+  CheriotCJalHelper(instruction, /*seal_link=*/false);
 }
 
 void CheriotCJalCra(const Instruction *instruction) {
-  auto *state = static_cast<CheriotState *>(instruction->state());
-  auto offset = generic::GetInstructionSource<uint32_t>(instruction, 0);
-  uint64_t new_pc = offset + instruction->address();
-  auto *pcc = state->pcc();
-  if (!CheriotCJChecks(instruction, new_pc, pcc)) return;
-  // Update link register.
-  auto *cd = GetCapDest(instruction, 0);
-  cd->CopyFrom(*pcc);
-  cd->set_address(instruction->address() + instruction->size());
-  bool interrupt_enable = state->mstatus()->mie();
-  (void)cd->Seal(*state->sealing_root(),
-                 interrupt_enable ? CapReg::kInterruptEnablingBackwardSentry
-                                  : CapReg::kInterruptDisablingBackwardSentry);
-  // Update pcc.
-  pcc->set_address(new_pc);
-  state->set_branch(true);
+  CheriotCJalHelper(instruction, /*seal_link=*/true);
+}
+
+void CheriotCJalV0Dot5(const Instruction *instruction) {
+  CheriotCJalHelper(instruction, /*seal_link=*/true);
 }
 
 void CheriotCJ(const Instruction *instruction) {
@@ -239,6 +244,10 @@ void CheriotCJ(const Instruction *instruction) {
   // Update pcc.
   pcc->set_address(new_pc);
   state->set_branch(true);
+  if (state->branch_predictor() != nullptr) {
+    state->branch_predictor()->DirectJump(instruction->address(),
+                                          /*is_call=*/false, 0);
+  }
 }
 
 // Helper function to check for exceptions for Jr and Jalr.
@@ -261,7 +270,7 @@ static bool CheriotCJrCheck(const Instruction *instruction, uint64_t new_pc,
                    (cs1->object_type() == CapReg::kInterruptInheritingSentry));
   ok |= has_dest && uses_ra && (cs1->object_type() >= CapReg::kUnsealed) &&
         (cs1->object_type() <= CapReg::kInterruptEnablingForwardSentry);
-  if ((cs1->IsSealed() && offset != 0) || !ok) {
+  if (((offset != 0) && cs1->IsSealed()) || !ok) {
     state->HandleCheriRegException(instruction, instruction->address(),
                                    EC::kCapExSealViolation, cs1);
     return false;
@@ -271,7 +280,7 @@ static bool CheriotCJrCheck(const Instruction *instruction, uint64_t new_pc,
                                    EC::kCapExPermitExecuteViolation, cs1);
     return false;
   }
-  if (!state->has_compact() && (new_pc & 0b10)) {
+  if ((new_pc & 0b10) && !state->has_compact()) {
     state->Trap(/*is_interrupt*/ false, new_pc,
                 *riscv::ExceptionCode::kInstructionAddressMisaligned,
                 instruction->address(), instruction);
@@ -280,14 +289,22 @@ static bool CheriotCJrCheck(const Instruction *instruction, uint64_t new_pc,
   return true;
 }
 
+// Helper for the cjalr variants. The flags are fixed by the encoding (and the
+// core version for seal_link), and the callers pass constants, so each variant
+// is compiled without the tests that don't apply to it.
 static inline void CheriotCJalrHelper(const Instruction *instruction,
-                                      bool has_dest, bool uses_ra) {
+                                      bool has_dest, bool uses_ra,
+                                      bool seal_link) {
   auto *state = static_cast<CheriotState *>(instruction->state());
   auto *cs1 = GetCapSource(instruction, 0);
   auto offset = generic::GetInstructionSource<uint32_t>(instruction, 1);
   auto *pcc = state->pcc();
   auto new_pc = offset + cs1->address();
   new_pc &= ~0b1ULL;
+  if (state->coverage() != nullptr) {
+    state->coverage()->CapabilityJump(cs1->GetPermissionFormat(),
+                                      cs1->object_type());
+  }
   if (!CheriotCJrCheck(instruction, new_pc, offset, cs1, has_dest, uses_ra)) {
     return;
   }
@@ -298,7 +315,7 @@ static inline void CheriotCJalrHelper(const Instruction *instruction,
     state->temp_reg()->set_address(instruction->address() +
                                    instruction->size());
     bool interrupt_enable = (mstatus->GetUint32() & 0b1000) != 0;
-    if ((state->core_version() == CheriotState::kVersion0Dot5) || uses_ra) {
+    if (seal_link) {
       auto status = state->temp_reg()->Seal(
           *state->sealing_root(),
           interrupt_enable ? CapReg::kInterruptEnablingBackwardSentry
@@ -324,6 +341,16 @@ static inline void CheriotCJalrHelper(const Instruction *instruction,
   }
   pcc->set_address(new_pc);
   state->set_branch(true);
+  if (state->branch_predictor() != nullptr) {
+    // Jumps that link to cra or ct0 are treated as calls, and cjr cra as a
+    // return.
+    bool is_call =
+        has_dest && state->IsLinkRegister(GetCapDest(instruction, 0));
+    state->branch_predictor()->IndirectJump(
+        instruction->address(), new_pc, is_call,
+        /*is_return=*/!has_dest && uses_ra,
+        instruction->address() + instruction->size());
+  }
   if (has_dest) {
     auto *cd = GetCapDest(instruction, 0);
     cd->CopyFrom(*state->temp_reg());
@@ -331,19 +358,28 @@ static inline void CheriotCJalrHelper(const Instruction *instruction,
 }
 
 void CheriotCJalr(const Instruction *instruction) {
-  CheriotCJalrHelper(instruction, /*has_dest=*/true, /*uses_ra=*/false);
+  CheriotCJalrHelper(instruction, /*has_dest=*/true, /*uses_ra=*/false,
+                     /*seal_link=*/false);
+}
+
+void CheriotCJalrV0Dot5(const Instruction *instruction) {
+  CheriotCJalrHelper(instruction, /*has_dest=*/true, /*uses_ra=*/false,
+                     /*seal_link=*/true);
 }
 
 void CheriotCJalrCra(const Instruction *instruction) {
-  CheriotCJalrHelper(instruction, /*has_dest=*/true, /*uses_ra=*/true);
+  CheriotCJalrHelper(instruction, /*has_dest=*/true, /*uses_ra=*/true,
+                     /*seal_link=*/true);
 }
 
 void CheriotCJrCra(const Instruction *instruction) {
-  CheriotCJalrHelper(instruction, /*has_dest=*/false, /*uses_ra=*/true);
+  CheriotCJalrHelper(instruction, /*has_dest=*/false, /*uses_ra=*/true,
+                     /*seal_link=*/false);
 }
 
 void CheriotCJr(const Instruction *instruction) {
-  CheriotCJalrHelper(instruction, /*has_dest=*/false, /*uses_ra=*/false);
+  CheriotCJalrHelper(instruction, /*has_dest=*/false, /*uses_ra=*/false,
+                     /*seal_link=*/false);
 }
 
 void CheriotCJalrZero(const Instruction *instruction) {
@@ -420,6 +456,7 @@ void CheriotCLcChild(const Instruction *instruction) {
       auto granule_addr = cd->base() & ~((1ULL << CapReg::kGranuleShift) - 1);
       if (state->MustRevoke(granule_addr)) {
         cd->Invalidate();
+        state->counter_revoked_on_load()->Increment(1);
       }
     }
   }
@@ -619,7 +656,13 @@ void CheriotCSpecialR(const Instruction *instruction) {
   cd->CopyFrom(*scr);
 }
 
-void CheriotCSpecialRW(const Instruction *instruction) {
+// Helper for cspecialrw. For mtcc and mepcc, align_mask selects the address
+// bits that must be clear, and the new value must be an unsealed executable
+// capability, otherwise it is invalidated. For the other special capability
+// registers align_mask is zero and the value is written as is. The decoder
+// selects the variant from the register number, so the callers pass constants.
+static inline void CheriotCSpecialRWHelper(const Instruction *instruction,
+                                           uint32_t align_mask) {
   auto *state = static_cast<CheriotState *>(instruction->state());
   // Decode will ensure that register scr is valid.
   auto *cs1 = GetCapSource(instruction, 0);
@@ -634,25 +677,29 @@ void CheriotCSpecialRW(const Instruction *instruction) {
   auto *temp_reg = state->temp_reg();
   temp_reg->CopyFrom(*cs1);
   cd->CopyFrom(*scr);
-  // If it's the mepcc register, make sure to clear any lsb.
-  if (scr->name() == "mepcc") {
-    if (temp_reg->address() & 0x1ULL) {
-      temp_reg->set_address(temp_reg->address() & ~0x1);
-      temp_reg->Invalidate();
-    } else if (temp_reg->IsSealed() ||
-               !temp_reg->HasPermission(CapReg::kPermitExecute)) {
-      temp_reg->Invalidate();
-    }
-  } else if (scr->name() == "mtcc") {
-    if (temp_reg->address() & 0x3ULL) {
-      temp_reg->set_address(temp_reg->address() & ~0x3ULL);
+  if (align_mask != 0) {
+    if (temp_reg->address() & align_mask) {
+      temp_reg->set_address(temp_reg->address() & ~align_mask);
       temp_reg->Invalidate();
     } else if (temp_reg->IsSealed() ||
                !temp_reg->HasPermission(CapReg::kPermitExecute)) {
       temp_reg->Invalidate();
     }
   }
-  scr->CopyFrom(*state->temp_reg());
+  scr->CopyFrom(*temp_reg);
+}
+
+void CheriotCSpecialRW(const Instruction *instruction) {
+  CheriotCSpecialRWHelper(instruction, /*align_mask=*/0);
+}
+
+void CheriotCSpecialRWMtcc(const Instruction *instruction) {
+  CheriotCSpecialRWHelper(instruction, /*align_mask=*/0x3);
+}
+
+void CheriotCSpecialRWMepcc(const Instruction *instruction) {
+  // Clear the lsb.
+  CheriotCSpecialRWHelper(instruction, /*align_mask=*/0x1);
 }
 
 void CheriotCSub(const Instruction *instruction) {
@@ -17,6 +17,7 @@
 #ifndef MPACT_CHERIOT__RISCV_CHERIOT_INSTRUCTIONS_H_
 #define MPACT_CHERIOT__RISCV_CHERIOT_INSTRUCTIONS_H_
 
+#include "cheriot/cheriot_state.h"
 #include "mpact/sim/generic/instruction.h"
 
 // This file declares the instruction semantic functions for the RiscV CHERIoT
@@ -73,12 +74,18 @@ void CheriotCIncAddr(const Instruction *instruction);
 // capability). The pcc is implied.
 void CheriotCJal(const Instruction *instruction);
 void CheriotCJalCra(const Instruction *instruction);
+// Version of CheriotCJal for core version 0.5, which seals the link
+// capability as a backward sentry.
+void CheriotCJalV0Dot5(const Instruction *instruction);
 // This instruction takes 1 source (an offset). The pcc is implied.
 void CheriotCJ(const Instruction *instruction);
 // This instruction takes 2 sources and one destination operand. Source 0 is the
 // source capability, source 1 is the offset. Destination 0 is the link
 // capability. The pcc is implied.
 void CheriotCJalr(const Instruction *instruction);
+// Version of CheriotCJalr for core version 0.5, which seals the link
+// capability as a backward sentry.
+void CheriotCJalrV0Dot5(const Instruction *instruction);
 // This instruction takes 2 sources. Source 0 is the source capability, source 1
 // is the offset. The pcc is implied.
 void CheriotCJr(const Instruction *instruction);
@@ -138,8 +145,11 @@ void CheriotCSetHigh(const Instruction *instruction);
 void CheriotCSpecialR(const Instruction *instruction);
 // This takes 2 source operands and 1 destination operand. Source 0 is the
 // source capability, source 1 is the special capability CSR. Destination 0
-// is the target capability.
+// is the target capability. The decoder selects the Mtcc and Mepcc versions
+// for those registers, and the plain version for mtdc and mscratchc.
 void CheriotCSpecialRW(const Instruction *instruction);
+void CheriotCSpecialRWMtcc(const Instruction *instruction);
+void CheriotCSpecialRWMepcc(const Instruction *instruction);
 // This takes 2 source operands and 1 destination operand. Sources 0 and 1
 // are capabilities. Destination 0 is an integer register.
 void CheriotCSub(const Instruction *instruction);
@@ -151,6 +161,32 @@ void CheriotCTestSubset(const Instruction *instruction);
 // Destination 0 is the target capability.
 void CheriotCUnseal(const Instruction *instruction);
 
+// Called by the decoders after an instruction has been decoded. Core version
+// 0.5 seals the link capability of every cjal and cjalr, not just of those
+// that link to cra, so replace their semantic functions with the 0.5 versions
+// instead of checking the version each time they are executed. The version
+// is read when the instruction is decoded, not when the decoder is created,
+// as it may be configured after the decoder has been created.
+template <typename OpcodeEnum>
+void SelectCoreVersionSemanticFunction(const CheriotState *state,
+                                       Instruction *inst) {
+  if ((inst == nullptr) ||
+      (state->core_version() != CheriotState::kVersion0Dot5)) {
+    return;
+  }
+  switch (static_cast<OpcodeEnum>(inst->opcode())) {
+    case OpcodeEnum::kCheriotJal:
+    case OpcodeEnum::kCheriotCjal:
+      inst->set_semantic_function(&CheriotCJalV0Dot5);
+      break;
+    case OpcodeEnum::kCheriotJalr:
+      inst->set_semantic_function(&CheriotCJalrV0Dot5);
+      break;
+    default:
+      break;
+  }
+}
+
 }  // namespace cheriot
 }  // namespace sim
 }  // namespace mpact
@@ -159,6 +159,38 @@ void Vfmvfs(const Instruction *inst) {
   rv_vector->clear_vstart();
 }
 
+// Converts a run of floating point values to integers in one pass when all of
+// them are in the range of the integer type, in which case the conversion is
+// exact up to truncation and raises no flags, the same as CvtHelper. The range
+// check doesn't short circuit, so that both loops can be vectorized by the
+// host compiler. Returns false if any value is out of range or NaN.
+template <typename From, typename To>
+inline bool CvtRun(To *dest, const From *src, int run) {
+  constexpr From kMax = static_cast<From>(std::numeric_limits<To>::max());
+  constexpr From kMin = static_cast<From>(std::numeric_limits<To>::min());
+  bool in_range = true;
+  for (int i = 0; i < run; i++) {
+    in_range &= (src[i] >= kMin) & (src[i] <= kMax);
+  }
+  if (!in_range) return false;
+  for (int i = 0; i < run; i++) dest[i] = static_cast<To>(src[i]);
+  return true;
+}
+
+// Floating point to integer conversion of the source vector group. Fully
+// enabled runs are converted by CvtRun, and any other elements by CvtHelper.
+template <typename From, typename To>
+inline void CvtSpanOp(CheriotVectorState *rv_vector, const Instruction *inst) {
+  RiscVUnaryVectorSpanOpWithFflags<To, From>(
+      rv_vector, inst,
+      [](From vs2) -> std::tuple<To, uint32_t> {
+        return CvtHelper<From, To>(vs2);
+      },
+      [](To *dest, const From *src, int run) {
+        return CvtRun<From, To>(dest, src, run);
+      });
+}
+
 // Convert floating point to unsigned integer.
 void Vfcvtxufv(const Instruction *inst) {
   auto *rv_fp = static_cast<CheriotState *>(inst->state())->rv_fp();
@@ -171,15 +203,9 @@ void Vfcvtxufv(const Instruction *inst) {
   int sew = rv_vector->selected_element_width();
   switch (sew) {
     case 4:
-      return RiscVUnaryVectorOpWithFflags<uint32_t, float>(
-          rv_vector, inst, [](float vs2) -> std::tuple<uint32_t, uint32_t> {
-            return CvtHelper<float, uint32_t>(vs2);
-          });
+      return CvtSpanOp<float, uint32_t>(rv_vector, inst);
     case 8:
-      return RiscVUnaryVectorOpWithFflags<uint64_t, double>(
-          rv_vector, inst, [](double vs2) -> std::tuple<uint64_t, uint32_t> {
-            return CvtHelper<double, uint64_t>(vs2);
-          });
+      return CvtSpanOp<double, uint64_t>(rv_vector, inst);
     default:
       LOG(ERROR) << "Vfcvt.xu.fv: Illegal sew (" << sew << ")";
       rv_vector->set_vector_exception();
@@ -199,15 +225,9 @@ void Vfcvtxfv(const Instruction *inst) {
   int sew = rv_vector->selected_element_width();
   switch (sew) {
     case 4:
-      return RiscVUnaryVectorOpWithFflags<int32_t, float>(
-          rv_vector, inst, [](float vs2) -> std::tuple<int32_t, uint32_t> {
-            return CvtHelper<float, int32_t>(vs2);
-          });
+      return CvtSpanOp<float, int32_t>(rv_vector, inst);
     case 8:
-      return RiscVUnaryVectorOpWithFflags<int64_t, double>(
-          rv_vector, inst, [](double vs2) -> std::tuple<int64_t, uint32_t> {
-            return CvtHelper<double, int64_t>(vs2);
-          });
+      return CvtSpanOp<double, int64_t>(rv_vector, inst);
     default:
       LOG(ERROR) << "Vfcvt.x.fv: Illegal sew (" << sew << ")";
       rv_vector->set_vector_exception();
@@ -228,11 +248,11 @@ void Vfcvtfxuv(const Instruction *inst) {
   ScopedFPStatus set_fpstatus(rv_fp->host_fp_interface());
   switch (sew) {
     case 4:
-      return RiscVUnaryVectorOp<float, uint32_t>(
+      return RiscVUnaryVectorSpanOp<float, uint32_t>(
           rv_vector, inst,
           [](uint32_t vs2) -> float { return static_cast<float>(vs2); });
     case 8:
-      return RiscVUnaryVectorOp<double, uint64_t>(
+      return RiscVUnaryVectorSpanOp<double, uint64_t>(
           rv_vector, inst,
           [](uint64_t vs2) -> double { return static_cast<double>(vs2); });
     default:
@@ -255,11 +275,11 @@ void Vfcvtfxv(const Instruction *inst) {
   ScopedFPStatus set_fpstatus(rv_fp->host_fp_interface());
   switch (sew) {
     case 4:
-      return RiscVUnaryVectorOp<float, int32_t>(
+      return RiscVUnaryVectorSpanOp<float, int32_t>(
           rv_vector, inst,
           [](int32_t vs2) -> float { return static_cast<float>(vs2); });
     case 8:
-      return RiscVUnaryVectorOp<double, int64_t>(
+      return RiscVUnaryVectorSpanOp<double, int64_t>(
           rv_vector, inst,
           [](int64_t vs2) -> double { return static_cast<double>(vs2); });
     default:
@@ -276,15 +296,9 @@ void Vfcvtrtzxufv(const Instruction *inst) {
   int sew = rv_vector->selected_element_width();
   switch (sew) {
     case 4:
-      return RiscVUnaryVectorOpWithFflags<uint32_t, float>(
-          rv_vector, inst, [](float vs2) -> std::tuple<uint32_t, uint32_t> {
-            return CvtHelper<float, uint32_t>(vs2);
-          });
+      return CvtSpanOp<float, uint32_t>(rv_vector, inst);
     case 8:
-      return RiscVUnaryVectorOpWithFflags<uint64_t, double>(
-          rv_vector, inst, [](double vs2) -> std::tuple<uint64_t, uint32_t> {
-            return CvtHelper<double, uint64_t>(vs2);
-          });
+      return CvtSpanOp<double, uint64_t>(rv_vector, inst);
     default:
       LOG(ERROR) << "Vfcvt.rtz.xu.fv: Illegal sew (" << sew << ")";
       rv_vector->set_vector_exception();
@@ -299,15 +313,9 @@ void Vfcvtrtzxfv(const Instruction *inst) {
   int sew = rv_vector->selected_element_width();
   switch (sew) {
     case 4:
-      return RiscVUnaryVectorOpWithFflags<int32_t, float>(
-          rv_vector, inst, [](float vs2) -> std::tuple<int32_t, uint32_t> {
-            return CvtHelper<float, int32_t>(vs2);
-          });
+      return CvtSpanOp<float, int32_t>(rv_vector, inst);
     case 8:
-      return RiscVUnaryVectorOpWithFflags<int64_t, double>(
-          rv_vector, inst, [](double vs2) -> std::tuple<int64_t, uint32_t> {
-            return CvtHelper<double, int64_t>(vs2);
-          });
+      return CvtSpanOp<double, int64_t>(rv_vector, inst);
     default:
       LOG(ERROR) << "Vfcvt.rtz.x.fv: Illegal sew (" << sew << ")";
       rv_vector->set_vector_exception();
@@ -327,10 +335,7 @@ void Vfwcvtxufv(const Instruction *inst) {
   int sew = rv_vector->selected_element_width();
   switch (sew) {
     case 4:
-      return RiscVUnaryVectorOpWithFflags<uint64_t, float>(
-          rv_vector, inst, [](float vs2) -> std::tuple<uint64_t, uint32_t> {
-            return CvtHelper<float, uint64_t>(vs2);
-          });
+      return CvtSpanOp<float, uint64_t>(rv_vector, inst);
     default:
       LOG(ERROR) << "Vfwcvt.xu.fv: Illegal sew (" << sew << ")";
       rv_vector->set_vector_exception();
@@ -350,10 +355,7 @@ void Vfwcvtxfv(const Instruction *inst) {
   int sew = rv_vector->selected_element_width();
   switch (sew) {
     case 4:
-      return RiscVUnaryVectorOpWithFflags<int64_t, float>(
-          rv_vector, inst, [](float vs2) -> std::tuple<int64_t, uint32_t> {
-            return CvtHelper<float, int64_t>(vs2);
-          });
+      return CvtSpanOp<float, int64_t>(rv_vector, inst);
     default:
       LOG(ERROR) << "Vfwcvt.x.fv: Illegal sew (" << sew << ")";
       rv_vector->set_vector_exception();
@@ -367,7 +369,7 @@ void Vfwcvtffv(const Instruction *inst) {
   int sew = rv_vector->selected_element_width();
   switch (sew) {
     case 4:
-      return RiscVUnaryVectorOp<double, float>(
+      return RiscVUnaryVectorSpanOp<double, float>(
           rv_vector, inst,
           [](float vs2) -> double { return static_cast<double>(vs2); });
     default:
@@ -390,11 +392,11 @@ void Vfwcvtfxuv(const Instruction *inst) {
   ScopedFPStatus set_fpstatus(rv_fp->host_fp_interface());
   switch (sew) {
     case 2:
-      return RiscVUnaryVectorOp<float, uint16_t>(
+      return RiscVUnaryVectorSpanOp<float, uint16_t>(
           rv_vector, inst,
           [](uint16_t vs2) -> float { return static_cast<float>(vs2); });
     case 4:
-      return RiscVUnaryVectorOp<double, uint32_t>(
+      return RiscVUnaryVectorSpanOp<double, uint32_t>(
           rv_vector, inst,
           [](uint32_t vs2) -> double { return static_cast<double>(vs2); });
     default:
@@ -417,11 +419,11 @@ void Vfwcvtfxv(const Instruction *inst) {
   ScopedFPStatus set_fpstatus(rv_fp->host_fp_interface());
   switch (sew) {
     case 2:
-      return RiscVUnaryVectorOp<float, int16_t>(
+      return RiscVUnaryVectorSpanOp<float, int16_t>(
           rv_vector, inst,
           [](int16_t vs2) -> float { return static_cast<float>(vs2); });
     case 4:
-      return RiscVUnaryVectorOp<double, int32_t>(
+      return RiscVUnaryVectorSpanOp<double, int32_t>(
           rv_vector, inst,
           [](int32_t vs2) -> double { return static_cast<double>(vs2); });
     default:
@@ -438,10 +440,7 @@ void Vfwcvtrtzxufv(const Instruction *inst) {
   int sew = rv_vector->selected_element_width();
   switch (sew) {
     case 4:
-      return RiscVUnaryVectorOpWithFflags<uint64_t, float>(
-          rv_vector, inst, [](float vs2) -> std::tuple<uint64_t, uint32_t> {
-            return CvtHelper<float, uint64_t>(vs2);
-          });
+      return CvtSpanOp<float, uint64_t>(rv_vector, inst);
     default:
       LOG(ERROR) << "Vwfcvt.rtz.xu.fv: Illegal sew (" << sew << ")";
       rv_vector->set_vector_exception();
@@ -456,10 +455,7 @@ void Vfwcvtrtzxfv(const Instruction *inst) {
   int sew = rv_vector->selected_element_width();
   switch (sew) {
     case 4:
-      return RiscVUnaryVectorOpWithFflags<int64_t, float>(
-          rv_vector, inst, [](float vs2) -> std::tuple<int64_t, uint32_t> {
-            return CvtHelper<float, int64_t>(vs2);
-          });
+      return CvtSpanOp<float, int64_t>(rv_vector, inst);
     default:
       LOG(ERROR) << "Vwfcvt.rtz.x.fv: Illegal sew (" << sew << ")";
       rv_vector->set_vector_exception();
@@ -479,15 +475,9 @@ void Vfncvtxufw(const Instruction *inst) {
   int sew = rv_vector->selected_element_width();
   switch (sew) {
     case 4:
-      return RiscVUnaryVectorOpWithFflags<uint16_t, float>(
-          rv_vector, inst, [](float vs2) -> std::tuple<uint16_t, uint32_t> {
-            return CvtHelper<float, uint16_t>(vs2);
-          });
+      return CvtSpanOp<float, uint16_t>(rv_vector, inst);
     case 8:
-      return RiscVUnaryVectorOpWithFflags<uint32_t, double>(
-          rv_vector, inst, [](double vs2) -> std::tuple<uint32_t, uint32_t> {
-            return CvtHelper<double, uint32_t>(vs2);
-          });
+      return CvtSpanOp<double, uint32_t>(rv_vector, inst);
     default:
       LOG(ERROR) << "Vfncvt.xu.fw: Illegal sew (" << sew << ")";
       rv_vector->set_vector_exception();
@@ -507,15 +497,9 @@ void Vfncvtxfw(const Instruction *inst) {
   int sew = rv_vector->selected_element_width();
   switch (sew) {
     case 4:
-      return RiscVUnaryVectorOpWithFflags<int16_t, float>(
-          rv_vector, inst, [](float vs2) -> std::tuple<int16_t, uint32_t> {
-            return CvtHelper<float, int16_t>(vs2);
-          });
+      return CvtSpanOp<float, int16_t>(rv_vector, inst);
     case 8:
-      return RiscVUnaryVectorOpWithFflags<int32_t, double>(
-          rv_vector, inst, [](double vs2) -> std::tuple<int32_t, uint32_t> {
-            return CvtHelper<double, int32_t>(vs2);
-          });
+      return CvtSpanOp<double, int32_t>(rv_vector, inst);
     default:
       LOG(ERROR) << "Vfncvt.x.fw: Illegal sew (" << sew << ")";
       rv_vector->set_vector_exception();
@@ -536,7 +520,7 @@ void Vfncvtffw(const Instruction *inst) {
   ScopedFPStatus set_fpstatus(rv_fp->host_fp_interface());
   switch (sew) {
     case 8:
-      return RiscVUnaryVectorOp<float, double>(
+      return RiscVUnaryVectorSpanOp<float, double>(
           rv_vector, inst,
           [](double vs2) -> float { return static_cast<float>(vs2); });
     default:
@@ -561,7 +545,7 @@ void Vfncvtrodffw(const Instruction *inst) {
   // in the original width mantissa.
   switch (sew) {
     case 8:
-      return RiscVUnaryVectorOp<float, double>(
+      return RiscVUnaryVectorSpanOp<float, double>(
           rv_vector, inst, [](double vs2) -> float {
             if (FPTypeInfo<double>::IsNaN(vs2) ||
                 FPTypeInfo<double>::IsInf(vs2)) {
@@ -600,7 +584,7 @@ void Vfncvtfxuw(const Instruction *inst) {
   ScopedFPStatus set_fpstatus(rv_fp->host_fp_interface());
   switch (sew) {
     case 8:
-      return RiscVUnaryVectorOp<float, uint64_t>(
+      return RiscVUnaryVectorSpanOp<float, uint64_t>(
           rv_vector, inst,
           [](uint64_t vs2) -> float { return static_cast<float>(vs2); });
     default:
@@ -623,7 +607,7 @@ void Vfncvtfxw(const Instruction *inst) {
   ScopedFPStatus set_fpstatus(rv_fp->host_fp_interface());
   switch (sew) {
     case 8:
-      return RiscVUnaryVectorOp<float, int64_t>(
+      return RiscVUnaryVectorSpanOp<float, int64_t>(
           rv_vector, inst,
           [](int64_t vs2) -> float { return static_cast<float>(vs2); });
     default:
@@ -640,15 +624,9 @@ void Vfncvtrtzxufw(const Instruction *inst) {
   int sew = rv_vector->selected_element_width();
   switch (sew) {
     case 4:
-      return RiscVUnaryVectorOpWithFflags<uint16_t, float>(
-          rv_vector, inst, [](float vs2) -> std::tuple<uint16_t, uint32_t> {
-            return CvtHelper<float, uint16_t>(vs2);
-          });
+      return CvtSpanOp<float, uint16_t>(rv_vector, inst);
     case 8:
-      return RiscVUnaryVectorOpWithFflags<uint32_t, double>(
-          rv_vector, inst, [](double vs2) -> std::tuple<uint32_t, uint32_t> {
-            return CvtHelper<double, uint32_t>(vs2);
-          });
+      return CvtSpanOp<double, uint32_t>(rv_vector, inst);
     default:
       LOG(ERROR) << "Vfcvt.rtz.xu.fw: Illegal sew (" << sew << ")";
       rv_vector->set_vector_exception();
@@ -663,15 +641,9 @@ void Vfncvtrtzxfw(const Instruction *inst) {
   int sew = rv_vector->selected_element_width();
   switch (sew) {
     case 4:
-      return RiscVUnaryVectorOpWithFflags<int16_t, float>(
-          rv_vector, inst, [](float vs2) -> std::tuple<int16_t, uint32_t> {
-            return CvtHelper<float, int16_t>(vs2);
-          });
+      return CvtSpanOp<float, int16_t>(rv_vector, inst);
     case 8:
-      return RiscVUnaryVectorOpWithFflags<int32_t, double>(
-          rv_vector, inst, [](double vs2) -> std::tuple<int32_t, uint32_t> {
-            return CvtHelper<double, int32_t>(vs2);
-          });
+      return CvtSpanOp<double, int32_t>(rv_vector, inst);
     default:
       LOG(ERROR) << "Vfcvt.rtz.xu.fw: Illegal sew (" << sew << ")";
       rv_vector->set_vector_exception();
@@ -710,20 +682,20 @@ void Vfsqrtv(const Instruction *inst) {
     ScopedFPStatus set_fpstatus(rv_fp->host_fp_interface());
     switch (sew) {
       case 4:
-        RiscVUnaryVectorOp<float, float>(rv_vector, inst,
-                                         [&flags](float vs2) -> float {
-                                           auto [res, f] = SqrtHelper(vs2);
-                                           flags |= f;
-                                           return res;
-                                         });
+        RiscVUnaryVectorSpanOp<float, float>(
+            rv_vector, inst, [&flags](float vs2) -> float {
+              auto [res, f] = SqrtHelper(vs2);
+              flags |= f;
+              return res;
+            });
         break;
       case 8:
-        RiscVUnaryVectorOp<double, double>(rv_vector, inst,
-                                           [&flags](double vs2) -> double {
-                                             auto [res, f] = SqrtHelper(vs2);
-                                             flags |= f;
-                                             return res;
-                                           });
+        RiscVUnaryVectorSpanOp<double, double>(
+            rv_vector, inst, [&flags](double vs2) -> double {
+              auto [res, f] = SqrtHelper(vs2);
+              flags |= f;
+              return res;
+            });
         break;
       default:
         LOG(ERROR) << "Vffcvt.f.xuv: Illegal sew (" << sew << ")";
@@ -806,23 +778,47 @@ inline std::tuple<T, uint32_t> RecipSqrt7Helper(T value) {
   return std::make_tuple(return_value, fflags);
 }
 
+// Reciprocal square root estimate. Positive normal values, which are the
+// common case, are classified from the bit pattern and looked up directly in
+// the 128 entry table. All other values go through RecipSqrt7Helper.
+template <typename T>
+inline std::tuple<T, uint32_t> RecipSqrt7Estimate(T value) {
+  using Uint = typename FPTypeInfo<T>::UIntType;
+  constexpr int kSigSize = FPTypeInfo<T>::kSigSize;
+  constexpr Uint kMaxExponent = FPTypeInfo<T>::kExpMask >> kSigSize;
+  Uint uint_value = *reinterpret_cast<Uint *>(&value);
+  Uint exponent = (uint_value & FPTypeInfo<T>::kExpMask) >> kSigSize;
+  bool sign = (uint_value >> (FPTypeInfo<T>::kBitSize - 1)) != 0;
+  if (sign || (exponent == 0) || (exponent == kMaxExponent)) {
+    return RecipSqrt7Helper(value);
+  }
+  int index =
+      (exponent & 0b1) << 6 | ((uint_value >> (kSigSize - 6)) & 0b11'1111);
+  Uint new_exponent = (3 * FPTypeInfo<T>::kExpBias - 1 - exponent) / 2;
+  Uint new_value =
+      (new_exponent << kSigSize) |
+      (static_cast<Uint>(kRecipSqrtMantissaTable[index]) << (kSigSize - 7));
+  return std::make_tuple(*reinterpret_cast<T *>(&new_value), 0);
+}
+
 // Approximation of reciprocal square root to 7 bits mantissa.
 void Vfrsqrt7v(const Instruction *inst) {
   auto *rv_fp = static_cast<CheriotState *>(inst->state())->rv_fp();
   auto *rv_vector = static_cast<CheriotState *>(inst->state())->rv_vector();
   int sew = rv_vector->selected_element_width();
+  // The host fp status is set up once for the whole instruction rather than
+  // for each element.
+  ScopedFPStatus set_fpstatus(rv_fp->host_fp_interface());
   switch (sew) {
     case 4:
-      return RiscVUnaryVectorOpWithFflags<float, float>(
-          rv_vector, inst, [rv_fp](float vs2) -> std::tuple<float, uint32_t> {
-            ScopedFPStatus set_fpstatus(rv_fp->host_fp_interface());
-            return RecipSqrt7Helper(vs2);
+      return RiscVUnaryVectorSpanOpWithFflags<float, float>(
+          rv_vector, inst, [](float vs2) -> std::tuple<float, uint32_t> {
+            return RecipSqrt7Estimate(vs2);
           });
     case 8:
-      return RiscVUnaryVectorOpWithFflags<double, double>(
-          rv_vector, inst, [rv_fp](double vs2) -> std::tuple<double, uint32_t> {
-            ScopedFPStatus set_fpstatus(rv_fp->host_fp_interface());
-            return RecipSqrt7Helper(vs2);
+      return RiscVUnaryVectorSpanOpWithFflags<double, double>(
+          rv_vector, inst, [](double vs2) -> std::tuple<double, uint32_t> {
+            return RecipSqrt7Estimate(vs2);
           });
     default:
       LOG(ERROR) << "vfrsqrt7.v: Illegal sew (" << sew << ")";
@@ -918,6 +914,29 @@ inline T Recip7Helper(T value, FPRoundingMode rm) {
   return std::numeric_limits<T>::quiet_NaN();
 }
 
+// Reciprocal estimate. Normal values whose reciprocal is also normal, which are
+// the common case, are classified from the bit pattern and looked up directly
+// in the 128 entry table. All other values go through Recip7Helper.
+template <typename T>
+inline T Recip7Estimate(T value, FPRoundingMode rm) {
+  using Uint = typename FPTypeInfo<T>::UIntType;
+  constexpr int kSigSize = FPTypeInfo<T>::kSigSize;
+  constexpr Uint kSignMask = Uint{1} << (FPTypeInfo<T>::kBitSize - 1);
+  Uint uint_value = *reinterpret_cast<Uint *>(&value);
+  Uint exponent = (uint_value & FPTypeInfo<T>::kExpMask) >> kSigSize;
+  constexpr Uint kMaxNormalExponent = 2 * FPTypeInfo<T>::kExpBias - 2;
+  // Beyond this exponent the reciprocal is denormal.
+  if ((exponent == 0) || (exponent > kMaxNormalExponent)) {
+    return Recip7Helper(value, rm);
+  }
+  int index = (uint_value >> (kSigSize - 7)) & 0b111'1111;
+  Uint new_exponent = 2 * FPTypeInfo<T>::kExpBias - 1 - exponent;
+  Uint new_value =
+      (uint_value & kSignMask) | (new_exponent << kSigSize) |
+      (static_cast<Uint>(kRecipMantissaTable[index]) << (kSigSize - 7));
+  return *reinterpret_cast<T *>(&new_value);
+}
+
 // Approximate reciprocal to 7 bits of mantissa.
 void Vfrec7v(const Instruction *inst) {
   auto *rv_fp = static_cast<CheriotState *>(inst->state())->rv_fp();
@@ -927,13 +946,13 @@ void Vfrec7v(const Instruction *inst) {
   auto rm = rv_fp->GetRoundingMode();
   switch (sew) {
     case 4:
-      return RiscVUnaryVectorOp<float, float>(
+      return RiscVUnaryVectorSpanOp<float, float>(
           rv_vector, inst,
-          [rm](float vs2) -> float { return Recip7Helper(vs2, rm); });
+          [rm](float vs2) -> float { return Recip7Estimate(vs2, rm); });
     case 8:
-      return RiscVUnaryVectorOp<double, double>(
+      return RiscVUnaryVectorSpanOp<double, double>(
           rv_vector, inst,
-          [rm](double vs2) -> double { return Recip7Helper(vs2, rm); });
+          [rm](double vs2) -> double { return Recip7Estimate(vs2, rm); });
     default:
       LOG(ERROR) << "vfrec7.v: Illegal sew (" << sew << ")";
       rv_vector->set_vector_exception();
@@ -941,21 +960,50 @@ void Vfrec7v(const Instruction *inst) {
   }
 }
 
+// Branch free version of ClassifyFP that operates on the bit pattern of the
+// floating point value, so that it can be applied to whole register spans.
+template <typename T>
+inline typename FPTypeInfo<T>::UIntType ClassifyFPBits(
+    typename FPTypeInfo<T>::UIntType bits) {
+  using UIntType = typename FPTypeInfo<T>::UIntType;
+  constexpr UIntType kExpMask =
+      (static_cast<UIntType>(1) << FPTypeInfo<T>::kExpSize) - 1;
+  constexpr UIntType kSigMask =
+      (static_cast<UIntType>(1) << FPTypeInfo<T>::kSigSize) - 1;
+  UIntType sign = bits >> (FPTypeInfo<T>::kBitSize - 1);
+  UIntType pos = sign ^ 1;
+  UIntType exp = (bits >> FPTypeInfo<T>::kSigSize) & kExpMask;
+  UIntType sig = bits & kSigMask;
+  UIntType exp_zero = exp == 0;
+  UIntType exp_max = exp == kExpMask;
+  UIntType normal = (exp_zero | exp_max) ^ 1;
+  UIntType sig_zero = sig == 0;
+  UIntType sig_nonzero = sig_zero ^ 1;
+  UIntType quiet = (sig >> (FPTypeInfo<T>::kSigSize - 1)) & 1;
+  return ((sign & exp_max & sig_zero) << 0) | ((sign & normal) << 1) |
+         ((sign & exp_zero & sig_nonzero) << 2) |
+         ((sign & exp_zero & sig_zero) << 3) |
+         ((pos & exp_zero & sig_zero) << 4) |
+         ((pos & exp_zero & sig_nonzero) << 5) | ((pos & normal) << 6) |
+         ((pos & exp_max & sig_zero) << 7) |
+         ((exp_max & sig_nonzero & (quiet ^ 1)) << 8) |
+         ((exp_max & sig_nonzero & quiet) << 9);
+}
+
 // Classify floating point value.
 void Vfclassv(const Instruction *inst) {
   auto *rv_vector = static_cast<CheriotState *>(inst->state())->rv_vector();
   int sew = rv_vector->selected_element_width();
+  // The source is read as raw bits, as only the bit pattern is classified.
   switch (sew) {
     case 4:
-      return RiscVUnaryVectorOp<uint32_t, float>(
-          rv_vector, inst, [](float vs2) -> uint32_t {
-            return static_cast<uint32_t>(ClassifyFP(vs2));
-          });
+      return RiscVUnaryVectorSpanOp<uint32_t, uint32_t>(
+          rv_vector, inst,
+          [](uint32_t vs2) -> uint32_t { return ClassifyFPBits<float>(vs2); });
     case 8:
-      return RiscVUnaryVectorOp<uint64_t, double>(
-          rv_vector, inst, [](double vs2) -> uint64_t {
-            return static_cast<uint64_t>(ClassifyFP(vs2));
-          });
+      return RiscVUnaryVectorSpanOp<uint64_t, uint64_t>(
+          rv_vector, inst,
+          [](uint64_t vs2) -> uint64_t { return ClassifyFPBits<double>(vs2); });
     default:
       rv_vector->set_vector_exception();
       LOG(ERROR) << "vfclass.v: Illegal sew (" << sew << ")";
@@ -24,7 +24,10 @@
 
 #include "absl/log/log.h"
 #include "absl/strings/str_cat.h"
+#include "absl/types/span.h"
+#include "cheriot/cheriot_vector_overlap.h"
 #include "cheriot/cheriot_vector_state.h"
+#include "mpact/sim/generic/data_buffer.h"
 #include "mpact/sim/generic/instruction.h"
 #include "mpact/sim/generic/type_helpers.h"
 #include "riscv//riscv_fp_host.h"
@@ -37,6 +40,7 @@ namespace sim {
 namespace cheriot {
 
 using ::mpact::sim::cheriot::CheriotVectorState;
+using ::mpact::sim::generic::DataBuffer;
 using ::mpact::sim::generic::FPTypeInfo;
 using ::mpact::sim::generic::GetInstructionSource;
 using ::mpact::sim::generic::Instruction;
@@ -46,6 +50,39 @@ using ::mpact::sim::riscv::RV32VectorSourceOperand;
 using ::mpact::sim::riscv::ScopedFPStatus;
 using ::mpact::sim::riscv::VectorLoadContext;
 
+// Returns the data buffer through which to write destination register reg. If
+// in_place is true and the register's data buffer is not shared, the
+// register's own data buffer is returned, which avoids the allocation and copy
+// done by CopyDataBuffer. Otherwise in_place is set to false and a copy of the
+// register's data buffer is returned, which must be submitted.
+inline DataBuffer *GetVectorDestinationDataBuffer(
+    const Instruction *inst, RV32VectorDestinationOperand *dest_op, int reg,
+    bool &in_place) {
+  if (in_place) {
+    auto *db = GetVectorOverlapInfo(inst)->dest_register(reg)->data_buffer();
+    if (db->ref_count() == 1) return db;
+    in_place = false;
+  }
+  return dest_op->CopyDataBuffer(reg);
+}
+
+// Returns a pointer to element index of the source register group, which is
+// read directly from the data buffer of the register that holds it. Run is
+// reduced to the number of elements up to the end of that register, so that
+// run elements may be read from the pointer.
+template <typename T>
+inline const T *GetVectorSourceRun(RV32VectorSourceOperand *op,
+                                   int elements_per_vector, int index,
+                                   int &run) {
+  int offset = index % elements_per_vector;
+  run = std::min(run, elements_per_vector - offset);
+  return op->GetRegister(index / elements_per_vector)
+             ->data_buffer()
+             ->template Get<T>()
+             .data() +
+         offset;
+}
+
 // This helper function handles the case of instructions that target a vector
 // mask.
 // It clears the masked bit and uses the mask value in the
@@ -385,6 +422,184 @@ void RiscVUnaryVectorOpWithFflags(
   rv_vector->clear_vstart();
 }
 
+// Returns true if the mask bits for the count elements starting at element
+// start are all set.
+inline bool IsMaskRangeSet(absl::Span<const uint8_t> mask_span, int start,
+                           int count) {
+  int end = start + count;
+  // Leading partial byte.
+  while ((start < end) && (start & 0b111)) {
+    if (((mask_span[start >> 3] >> (start & 0b111)) & 0b1) == 0) return false;
+    start++;
+  }
+  // Whole bytes.
+  while (end - start >= 8) {
+    if (mask_span[start >> 3] != 0xff) return false;
+    start += 8;
+  }
+  // Trailing partial byte.
+  while (start < end) {
+    if (((mask_span[start >> 3] >> (start & 0b111)) & 0b1) == 0) return false;
+    start++;
+  }
+  return true;
+}
+
+// This helper function handles the case of unary vector operations where the
+// element operation only depends on the source element value. Unlike
+// RiscVUnaryVectorOp, the operation is passed as a template parameter so that
+// it can be inlined, and the source register group is read directly from the
+// register data buffers one contiguous run at a time instead of through
+// GetInstructionSource for each element. Runs that are fully enabled by the
+// mask are processed in a tight loop that the host compiler can vectorize.
+// The operation returns either Vd, or std::tuple<Vd, uint32_t> when WithFflags
+// is true, in which case the flags are accumulated and written to the fflags
+// destination operand. Each fully enabled run is first passed to run_op, with
+// the signature bool(Vd *dest, const Vs2 *src, int run), which may compute the
+// whole run at once without raising any flags. If it returns false, the run is
+// computed by op one element at a time.
+template <typename Vd, typename Vs2, bool WithFflags, typename Op,
+          typename RunOp>
+void RiscVUnaryVectorSpanOpImpl(CheriotVectorState *rv_vector,
+                                const Instruction *inst, Op op, RunOp run_op) {
+  if (rv_vector->vector_exception()) return;
+  int num_elements = rv_vector->vector_length();
+  int lmul = rv_vector->vector_length_multiplier();
+  int sew = rv_vector->selected_element_width();
+  int lmul_vd = lmul * sizeof(Vd) / sew;
+  int lmul_vs2 = lmul * sizeof(Vs2) / sew;
+  if (lmul_vd > 64 || lmul_vd == 0) {
+    rv_vector->set_vector_exception();
+    LOG(ERROR) << "Illegal lmul value vd (" << lmul_vd << ")";
+    return;
+  }
+  if (lmul_vs2 > 64 || lmul_vs2 == 0) {
+    rv_vector->set_vector_exception();
+    LOG(ERROR) << "Illegal lmul_value vs2 (" << lmul_vs2 << ")";
+    return;
+  }
+  int byte_length = rv_vector->vector_register_byte_length();
+  int elements_per_vector = byte_length / sizeof(Vd);
+  int src_elements_per_vector = byte_length / sizeof(Vs2);
+  int max_regs = (num_elements + elements_per_vector - 1) / elements_per_vector;
+  int max_src_regs =
+      (num_elements + src_elements_per_vector - 1) / src_elements_per_vector;
+  auto *dest_op =
+      static_cast<RV32VectorDestinationOperand *>(inst->Destination(0));
+  // Verify that there are enough registers in the destination operand.
+  if (dest_op->size() < max_regs) {
+    rv_vector->set_vector_exception();
+    LOG(ERROR) << absl::StrCat(
+        "Vector destination '", dest_op->AsString(), "' has fewer registers (",
+        dest_op->size(), ") than required by the operation (", max_regs, ")");
+    return;
+  }
+  auto *src_op = static_cast<RV32VectorSourceOperand *>(inst->Source(0));
+  // Verify that there are enough registers in the source operand.
+  if (src_op->size() < max_src_regs) {
+    rv_vector->set_vector_exception();
+    LOG(ERROR) << absl::StrCat(
+        "Vector source '", src_op->AsString(), "' has fewer registers (",
+        src_op->size(), ") than required by the operation (", max_src_regs,
+        ")");
+    return;
+  }
+  // Get the vector mask.
+  auto *mask_op = static_cast<RV32VectorSourceOperand *>(inst->Source(1));
+  auto mask_span = mask_op->GetRegister(0)->data_buffer()->Get<uint8_t>();
+  // Get the vector start element index and compute where to start
+  // the operation.
+  int vector_index = rv_vector->vstart();
+  int start_reg = vector_index / elements_per_vector;
+  int item_index = vector_index % elements_per_vector;
+  uint32_t fflags = 0;
+  // Elementwise operations may update the destination in place unless it
+  // overlaps the source in a way that would change the values read.
+  bool can_update_in_place =
+      CanUpdateDestinationInPlace(inst, sizeof(Vd) == sizeof(Vs2));
+  // Iterate over the number of registers to write.
+  for (int reg = start_reg; (reg < max_regs) && (vector_index < num_elements);
+       reg++) {
+    // Get the data buffer for the new register data.
+    bool in_place = can_update_in_place;
+    auto *dest_db =
+        GetVectorDestinationDataBuffer(inst, dest_op, reg, in_place);
+    Vd *dest = dest_db->Get<Vd>().data();
+    int element_count =
+        std::min(elements_per_vector, item_index + num_elements - vector_index);
+    // Process the destination register in runs that are contiguous in a
+    // single source register.
+    while (item_index < element_count) {
+      int run = element_count - item_index;
+      const Vs2 *src = GetVectorSourceRun<Vs2>(src_op, src_elements_per_vector,
+                                               vector_index, run);
+      if (IsMaskRangeSet(mask_span, vector_index, run)) {
+        if (!run_op(dest + item_index, src, run)) {
+          for (int i = 0; i < run; i++) {
+            if constexpr (WithFflags) {
+              auto [value, flag] = op(src[i]);
+              dest[item_index + i] = value;
+              fflags |= flag;
+            } else {
+              dest[item_index + i] = op(src[i]);
+            }
+          }
+        }
+      } else {
+        for (int i = 0; i < run; i++) {
+          int index = vector_index + i;
+          if (((mask_span[index >> 3] >> (index & 0b111)) & 0b1) == 0) continue;
+          if constexpr (WithFflags) {
+            auto [value, flag] = op(src[i]);
+            dest[item_index + i] = value;
+            fflags |= flag;
+          } else {
+            dest[item_index + i] = op(src[i]);
+          }
+        }
+      }
+      item_index += run;
+      vector_index += run;
+    }
+    // Submit the destination db .
+    if (!in_place) dest_db->Submit();
+    item_index = 0;
+  }
+  if constexpr (WithFflags) {
+    auto *flag_db = inst->Destination(1)->AllocateDataBuffer();
+    flag_db->Set<uint32_t>(0, fflags);
+    flag_db->Submit();
+  }
+  rv_vector->clear_vstart();
+}
+
+// Span based unary vector operation. Op has the signature Vd(Vs2).
+template <typename Vd, typename Vs2, typename Op>
+inline void RiscVUnaryVectorSpanOp(CheriotVectorState *rv_vector,
+                                   const Instruction *inst, Op op) {
+  RiscVUnaryVectorSpanOpImpl<Vd, Vs2, /*WithFflags=*/false>(
+      rv_vector, inst, op, [](Vd *, const Vs2 *, int) { return false; });
+}
+
+// Span based unary vector operation that sets fflags. Op has the signature
+// std::tuple<Vd, uint32_t>(Vs2).
+template <typename Vd, typename Vs2, typename Op>
+inline void RiscVUnaryVectorSpanOpWithFflags(CheriotVectorState *rv_vector,
+                                             const Instruction *inst, Op op) {
+  RiscVUnaryVectorSpanOpImpl<Vd, Vs2, /*WithFflags=*/true>(
+      rv_vector, inst, op, [](Vd *, const Vs2 *, int) { return false; });
+}
+
+// As above, but with a run operation for fully enabled runs (see
+// RiscVUnaryVectorSpanOpImpl).
+template <typename Vd, typename Vs2, typename Op, typename RunOp>
+inline void RiscVUnaryVectorSpanOpWithFflags(CheriotVectorState *rv_vector,
+                                             const Instruction *inst, Op op,
+                                             RunOp run_op) {
+  RiscVUnaryVectorSpanOpImpl<Vd, Vs2, /*WithFflags=*/true>(rv_vector, inst, op,
+                                                           run_op);
+}
+
 // This helper function handles the case of mask + two source operand vector
 // operations. It implements all the checking necessary for both widening and
 // narrowing operations.
@@ -432,41 +647,78 @@ void RiscVMaskBinaryVectorOp(
   int item_index = vector_index % elements_per_vector;
   // Determine if it's vector-vector or vector-scalar.
   bool vector_scalar = inst->Source(1)->shape()[0] == 1;
+  // The source register groups are read directly from the register data
+  // buffers, one run of elements that lies within a single register of each
+  // group at a time, instead of through GetInstructionSource for each element.
+  int byte_length = rv_vector->vector_register_byte_length();
+  int vs2_elements_per_vector = byte_length / sizeof(Vs2);
+  int vs1_elements_per_vector = byte_length / sizeof(Vs1);
+  // Only vs1 of the vector-vector forms is a vector register group. The
+  // scalar register or immediate of the .vx and .vi forms is read once.
+  auto *vs2_op = static_cast<RV32VectorSourceOperand *>(inst->Source(0));
+  RV32VectorSourceOperand *vs1_op = nullptr;
+  Vs1 scalar_vs1 = Vs1();
+  if (vector_scalar) {
+    scalar_vs1 = GetInstructionSource<Vs1>(inst, 1, 0);
+  } else {
+    vs1_op = static_cast<RV32VectorSourceOperand *>(inst->Source(1));
+  }
+  if ((vs2_op->size() * vs2_elements_per_vector < num_elements) ||
+      ((vs1_op != nullptr) &&
+       (vs1_op->size() * vs1_elements_per_vector < num_elements))) {
+    rv_vector->set_vector_exception();
+    LOG(ERROR) << absl::StrCat("Vector sources '", vs2_op->AsString(), "', '",
+                               inst->Source(1)->AsString(),
+                               "' have fewer registers than required by the "
+                               "operation");
+    return;
+  }
+  bool can_update_in_place = CanUpdateDestinationInPlace(
+      inst, (sizeof(Vd) == sizeof(Vs2)) && (sizeof(Vd) == sizeof(Vs1)));
   // Iterate over the number of registers to write.
   bool exception = false;
   for (int reg = start_reg;
        !exception && (reg < max_regs) && (vector_index < num_elements); reg++) {
-    // Allocate data buffer for the new register data.
-    auto *dest_db = dest_op->CopyDataBuffer(reg);
-    auto dest_span = dest_db->Get<Vd>();
+    // Get the data buffer for the new register data.
+    bool in_place = can_update_in_place;
+    auto *dest_db =
+        GetVectorDestinationDataBuffer(inst, dest_op, reg, in_place);
+    Vd *dest = dest_db->Get<Vd>().data();
     // Write data into register subject to masking.
     int element_count = std::min(elements_per_vector, num_elements);
-    for (int i = item_index;
-         (i < element_count) && (vector_index < num_elements); i++) {
-      // Get the mask value.
-      int mask_index = vector_index >> 3;
-      int mask_offset = vector_index & 0b111;
-      bool mask_value = ((mask_span[mask_index] >> mask_offset) & 0b1) != 0;
-      // Compute result.
-      Vs2 vs2 = GetInstructionSource<Vs2>(inst, 0, vector_index);
-      Vs1 vs1 = GetInstructionSource<Vs1>(inst, 1,
-                                          (vector_scalar ? 0 : vector_index));
-      auto value = op(vs2, vs1, mask_value);
-      if (value.has_value()) {
-        dest_span[i] = value.value();
-      } else if (mask_value) {
-        // If there is no value returned, but the mask_value is true, check
-        // to see if there was an exception.
-        if (rv_vector->vector_exception()) {
-          rv_vector->set_vstart(vector_index);
-          exception = true;
-          break;
+    int i = item_index;
+    while (!exception && (i < element_count) && (vector_index < num_elements)) {
+      int run = std::min(element_count - i, num_elements - vector_index);
+      const Vs2 *vs2 = GetVectorSourceRun<Vs2>(vs2_op, vs2_elements_per_vector,
+                                               vector_index, run);
+      const Vs1 *vs1 =
+          (vs1_op == nullptr)
+              ? nullptr
+              : GetVectorSourceRun<Vs1>(vs1_op, vs1_elements_per_vector,
+                                        vector_index, run);
+      for (int j = 0; j < run; j++, i++, vector_index++) {
+        // Get the mask value.
+        int mask_index = vector_index >> 3;
+        int mask_offset = vector_index & 0b111;
+        bool mask_value = ((mask_span[mask_index] >> mask_offset) & 0b1) != 0;
+        // Compute result.
+        auto value =
+            op(vs2[j], (vs1 == nullptr) ? scalar_vs1 : vs1[j], mask_value);
+        if (value.has_value()) {
+          dest[i] = value.value();
+        } else if (mask_value) {
+          // If there is no value returned, but the mask_value is true, check
+          // to see if there was an exception.
+          if (rv_vector->vector_exception()) {
+            rv_vector->set_vstart(vector_index);
+            exception = true;
+            break;
+          }
         }
       }
-      vector_index++;
     }
     // Submit the destination db .
-    dest_db->Submit();
+    if (!in_place) dest_db->Submit();
     item_index = 0;
   }
   rv_vector->clear_vstart();
@@ -19,6 +19,9 @@
 
 #include "absl/log/log.h"
 #include "absl/strings/str_cat.h"
+#include "cheriot/cheriot_coverage.h"
+#include "cheriot/cheriot_csr_operand.h"
+#include "cheriot/cheriot_pmp_checker.h"
 #include "cheriot/cheriot_register.h"
 #include "cheriot/cheriot_state.h"
 #include "cheriot/riscv_cheriot_csr_enum.h"
@@ -33,7 +36,6 @@ namespace sim {
 namespace cheriot {
 
 using ::mpact::sim::generic::operator*;  // NOLINT: is used below (clang error).
-using ::mpact::sim::riscv::PrivilegeMode;
 using PB = ::mpact::sim::cheriot::CheriotRegister::PermissionBits;
 using RV_EC = ::mpact::sim::riscv::ExceptionCode;
 using CH_EC = ::mpact::sim::cheriot::ExceptionCode;
@@ -70,40 +72,18 @@ inline uint64_t ReadCsr<uint64_t>(RiscVCsrInterface *csr) {
   return csr->AsUint64();
 }
 
-// Helper function to check that the CSR permission is valid. If not, throw
-// an illegal instruction exception.
-bool CheckCsrPermission(int csr_index, Instruction *instruction,
-                        bool is_write) {
-  auto required_mode = (csr_index >> 8) & 0x3;
+// Raise the exception for a denied CSR access. Returns true if the access is
+// allowed.
+static bool HandleCsrAccess(CsrAccess access, Instruction *instruction) {
+  if (access == CsrAccess::kAllowed) return true;
   auto *state = static_cast<CheriotState *>(instruction->state());
-  auto current_mode = PrivilegeMode::kMachine;
-  // If the register isn't available in CHERIoT, throw an exception.
-  if (required_mode == *PrivilegeMode::kSupervisor) {
+  if (access == CsrAccess::kIllegal) {
     state->Trap(/*is_interrupt*/ false, 0, *RV_EC::kIllegalInstruction,
                 instruction->address(), instruction);
     return false;
   }
-  // If the privilege mode is too low, throw an exception.
-  if (*current_mode < required_mode) {
-    state->Trap(/*is_interrupt*/ false, 0, *RV_EC::kIllegalInstruction,
-                instruction->address(), instruction);
-    return false;
-  }
-  // Accesses to fflags, frm, and fcsr are all ok.
-  if ((csr_index >= *RiscVCheriotCsrEnum::kFFlags) &&
-      (csr_index <= *RiscVCheriotCsrEnum::kFCsr)) {
-    return true;
-  }
-  // Reads to MCycle, MInstret, MHpmcounterN are all ok.
-  if (!is_write && (((csr_index >= *RiscVCheriotCsrEnum::kMCycle) &&
-                     (csr_index <= *RiscVCheriotCsrEnum::kMHpmcounter31)) ||
-                    ((csr_index >= *RiscVCheriotCsrEnum::kMCycleH) &&
-                     (csr_index <= *RiscVCheriotCsrEnum::kMHpmcounter31H)))) {
-    return true;
-  }
   // Check pcc capability.
-  if ((required_mode != *PrivilegeMode::kUser) &&
-      (!state->pcc()->HasPermission(PB::kPermitAccessSystemRegisters))) {
+  if (!state->pcc()->HasPermission(PB::kPermitAccessSystemRegisters)) {
     state->HandleCheriRegException(
         instruction, instruction->address(),
         CH_EC::kCapExPermitAccessSystemRegistersViolation, state->pcc());
@@ -112,134 +92,134 @@ bool CheckCsrPermission(int csr_index, Instruction *instruction,
   return true;
 }
 
-// Templated helper functions.
+// Record a permitted CSR access in the ISA coverage, if it is enabled.
+static inline void RecordCsrCoverage(Instruction *instruction, int csr_index,
+                                     bool is_write) {
+  auto *coverage =
+      static_cast<CheriotState *>(instruction->state())->coverage();
+  if (coverage != nullptr) coverage->CsrAccess(csr_index, is_write);
+}
 
-// Read the CSR, write a new value back.
-template <typename T>
-static inline void RVZiCsrrw(Instruction *instruction) {
-  // Get a handle to the state instance.
-  auto state = static_cast<CheriotState *>(instruction->state());
-  // Get the csr index.
-  int csr_index = instruction->Source(1)->AsInt32(0);
-  if (!CheckCsrPermission(csr_index, instruction, /*is_write=*/true)) return;
-  // Read the csr.
+// Looks up the CSR with the given index in the CSR set and checks the access
+// to it. This is used for CSR operands that the decoder didn't resolve.
+static RiscVCsrInterface *LookupCsr(Instruction *instruction, int csr_index,
+                                    bool is_write, bool *is_pmp_csr) {
+  if (!HandleCsrAccess(GetCsrAccess(csr_index, is_write), instruction)) {
+    return nullptr;
+  }
+  *is_pmp_csr = CheriotPmpChecker::IsPmpCsr(csr_index);
+  RecordCsrCoverage(instruction, csr_index, is_write);
+  auto *state = static_cast<CheriotState *>(instruction->state());
   auto result = state->csr_set()->GetCsr(csr_index);
   if (!result.ok()) {
-    // Signal error if it failed.
     LOG(ERROR) << absl::StrCat("Instruction at address 0x",
                                absl::Hex(instruction->address()),
-                               " failed to read CSR 0x", absl::Hex(csr_index),
+                               " failed to access CSR 0x", absl::Hex(csr_index),
                                ": ", result.status().message());
-    return;
+    return nullptr;
   }
+  return result.value();
+}
+
+// Returns the CSR accessed by the instruction, or nullptr if the access isn't
+// permitted or the CSR doesn't exist. The CSR source operand is always a
+// CheriotCsrOperand created by the decoder, which normally already holds the
+// CSR and its access permissions, so no lookup in the CSR set is needed.
+static inline RiscVCsrInterface *ResolveCsr(Instruction *instruction, int src,
+                                            bool is_write, bool *is_pmp_csr) {
+  auto *csr_op = static_cast<CheriotCsrOperand *>(instruction->Source(src));
+  if (!csr_op->is_resolved()) {
+    return LookupCsr(instruction, csr_op->AsUint32(0), is_write, is_pmp_csr);
+  }
+  if (!HandleCsrAccess(csr_op->access(is_write), instruction)) return nullptr;
+  *is_pmp_csr = csr_op->is_pmp_csr();
+  RecordCsrCoverage(instruction, csr_op->AsUint32(0), is_write);
+  if (csr_op->csr() == nullptr) {
+    LOG(ERROR) << absl::StrCat("Instruction at address 0x",
+                               absl::Hex(instruction->address()),
+                               " failed to access CSR 0x",
+                               absl::Hex(csr_op->AsUint32(0)),
+                               ": no such CSR");
+  }
+  return csr_op->csr();
+}
+
+// Cached PMP decisions must be recomputed after a PMP CSR is written.
+static inline void InvalidatePmpDecisions(Instruction *instruction) {
+  static_cast<CheriotState *>(instruction->state())
+      ->pmp_checker()
+      ->Invalidate();
+}
+
+// Templated helper functions.
+
+// Read the CSR, write a new value back.
+template <typename T>
+static inline void RVZiCsrrw(Instruction *instruction) {
+  bool is_pmp_csr = false;
+  auto *csr = ResolveCsr(instruction, 1, /*is_write=*/true, &is_pmp_csr);
+  if (csr == nullptr) return;
   // Get the new value.
   T new_value = generic::GetInstructionSource<T>(instruction, 0);
-  auto *csr = result.value();
   // Update the register.
   auto csr_val = ReadCsr<T>(csr);
   WriteCapIntResult(instruction, 0, csr_val);
   // Write the new value to the csr.
   csr->Write(new_value);
+  if (is_pmp_csr) InvalidatePmpDecisions(instruction);
 }
 
 // Read the CSR, set the bits specified by the new value and write back.
 template <typename T>
 static inline void RVZiCsrrs(Instruction *instruction) {
-  // Get a handle to the state instance.
-  auto state = static_cast<CheriotState *>(instruction->state());
-  // Get the csr index.
-  int csr_index = instruction->Source(1)->AsInt32(0);
-  if (!CheckCsrPermission(csr_index, instruction, /*is_write=*/true)) return;
-  // Read the csr.
-  auto result = state->csr_set()->GetCsr(csr_index);
-  if (!result.ok()) {
-    // Signal error if it failed.
-    LOG(ERROR) << absl::StrCat("Instruction at address 0x",
-                               absl::Hex(instruction->address()),
-                               " failed to read CSR 0x", absl::Hex(csr_index),
-                               ": ", result.status().message());
-    return;
-  }
+  bool is_pmp_csr = false;
+  auto *csr = ResolveCsr(instruction, 1, /*is_write=*/true, &is_pmp_csr);
+  if (csr == nullptr) return;
   // Get the new value.
   T new_value = generic::GetInstructionSource<T>(instruction, 0);
-  auto *csr = result.value();
   // Update the register.
   auto csr_val = ReadCsr<T>(csr);
   WriteCapIntResult(instruction, 0, csr_val);
   // Write the new value to the csr.
   csr->SetBits(new_value);
+  if (is_pmp_csr) InvalidatePmpDecisions(instruction);
 }
 
 // Read the CSR, clear the bits specified by the new value and write back.
 template <typename T>
 static inline void RVZiCsrrc(Instruction *instruction) {
-  // Get a handle to the state instance.
-  auto state = static_cast<CheriotState *>(instruction->state());
-  // Get the csr index.
-  int csr_index = instruction->Source(1)->AsInt32(0);
-  if (!CheckCsrPermission(csr_index, instruction, /*is_write=*/true)) return;
-  // Read the csr.
-  auto result = state->csr_set()->GetCsr(csr_index);
-  if (!result.ok()) {
-    // Signal error if it failed.
-    LOG(ERROR) << absl::StrCat("Instruction at address 0x",
-                               absl::Hex(instruction->address()),
-                               " failed to read CSR 0x", absl::Hex(csr_index),
-                               ": ", result.status().message());
-    return;
-  }
+  bool is_pmp_csr = false;
+  auto *csr = ResolveCsr(instruction, 1, /*is_write=*/true, &is_pmp_csr);
+  if (csr == nullptr) return;
   // Get the new value.
   T new_value = generic::GetInstructionSource<T>(instruction, 0);
-  auto *csr = result.value();
   // Write the current value of the CSR to the destination register.
   auto csr_val = ReadCsr<T>(csr);
   WriteCapIntResult(instruction, 0, csr_val);
   // Write the new value to the csr.
   csr->ClearBits(new_value);
+  if (is_pmp_csr) InvalidatePmpDecisions(instruction);
 }
 
 // Do not read the CSR, just write the new value back.
 template <typename T>
 static inline void RVZiCsrrwNr(Instruction *instruction) {
-  // Get a handle to the state instance.
-  auto state = static_cast<CheriotState *>(instruction->state());
-  // Get the csr index.
-  int csr_index = instruction->Source(1)->AsInt32(0);
-  if (!CheckCsrPermission(csr_index, instruction, /*is_write=*/true)) return;
-  // Read the csr.
-  auto result = state->csr_set()->GetCsr(csr_index);
-  if (!result.ok()) {
-    LOG(ERROR) << absl::StrCat("Instruction at address 0x",
-                               absl::Hex(instruction->address()),
-                               " failed to write CSR 0x", absl::Hex(csr_index),
-                               ": ", result.status().message());
-    return;
-  }
-  auto *csr = result.value();
+  bool is_pmp_csr = false;
+  auto *csr = ResolveCsr(instruction, 1, /*is_write=*/true, &is_pmp_csr);
+  if (csr == nullptr) return;
   // Write the new value to the csr.
   T new_value = generic::GetInstructionSource<T>(instruction, 0);
   csr->Write(new_value);
+  if (is_pmp_csr) InvalidatePmpDecisions(instruction);
 }
 
-// Do not write a value back to the CSR, just read it.
+// Do not write a value back to the CSR, just read it. This is the form used
+// to read the counter CSRs, which are read exactly once.
 template <typename T>
 static inline void RVZiCsrrNw(Instruction *instruction) {
-  // Get a handle to the state instance.
-  auto state = static_cast<CheriotState *>(instruction->state());
-  // Get the csr index.
-  int csr_index = instruction->Source(0)->AsInt32(0);
-  if (!CheckCsrPermission(csr_index, instruction, /*is_write=*/false)) return;
-  // Read the csr.
-  auto result = state->csr_set()->GetCsr(csr_index);
-  if (!result.ok()) {
-    LOG(ERROR) << absl::StrCat("Instruction at address 0x",
-                               absl::Hex(instruction->address()),
-                               " failed to read CSR 0x", absl::Hex(csr_index),
-                               ": ", result.status().message());
-    return;
-  }
-  // Get the CSR object.
-  auto *csr = result.value();
+  bool is_pmp_csr = false;
+  auto *csr = ResolveCsr(instruction, 0, /*is_write=*/false, &is_pmp_csr);
+  if (csr == nullptr) return;
   auto csr_val = ReadCsr<T>(csr);
   WriteCapIntResult(instruction, 0, csr_val);
 }
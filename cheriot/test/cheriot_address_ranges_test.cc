@@ -0,0 +1,48 @@
+// Copyright 2024 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "cheriot/cheriot_address_ranges.h"
+
+#include <cstdint>
+
+#include "googlemock/include/gmock/gmock.h"
+
+namespace {
+
+using ::mpact::sim::cheriot::CheriotAddressRanges;
+
+TEST(CheriotAddressRangesTest, Empty) {
+  CheriotAddressRanges ranges;
+  EXPECT_TRUE(ranges.empty());
+  EXPECT_FALSE(ranges.Overlaps(0, 8));
+}
+
+TEST(CheriotAddressRangesTest, Overlaps) {
+  CheriotAddressRanges ranges;
+  ranges.Add(0x1000, 0x10ff);
+  ranges.Add(0x2'0000, 0x2'ffff);
+  EXPECT_FALSE(ranges.empty());
+  // Accesses that end just before or start just after a range.
+  EXPECT_FALSE(ranges.Overlaps(0xff8, 8));
+  EXPECT_FALSE(ranges.Overlaps(0x1100, 4));
+  // Accesses that straddle either end of a range.
+  EXPECT_TRUE(ranges.Overlaps(0xffc, 8));
+  EXPECT_TRUE(ranges.Overlaps(0x10fc, 8));
+  // Accesses inside a range, and one that spans all of it.
+  EXPECT_TRUE(ranges.Overlaps(0x1010, 1));
+  EXPECT_TRUE(ranges.Overlaps(0x2'8000, 4));
+  EXPECT_TRUE(ranges.Overlaps(0x0, 0x1'0000));
+}
+
+}  // namespace
@@ -0,0 +1,152 @@
+// Copyright 2024 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "cheriot/cheriot_branch_predictor.h"
+
+#include <cstdint>
+#include <sstream>
+
+#include "absl/log/check.h"
+#include "cheriot/cheriot_decoder.h"
+#include "cheriot/cheriot_state.h"
+#include "cheriot/cheriot_top.h"
+#include "googlemock/include/gmock/gmock.h"
+#include "mpact/sim/generic/counters.h"
+#include "mpact/sim/proto/component_data.pb.h"
+#include "mpact/sim/util/memory/tagged_flat_demand_memory.h"
+
+namespace {
+
+using ::mpact::sim::cheriot::CheriotBranchPredictor;
+using ::mpact::sim::cheriot::CheriotDecoder;
+using ::mpact::sim::cheriot::CheriotState;
+using ::mpact::sim::cheriot::CheriotTop;
+using ::mpact::sim::generic::SimpleCounter;
+using ::mpact::sim::proto::ComponentValueEntry;
+using ::mpact::sim::util::TaggedFlatDemandMemory;
+
+TEST(CheriotBranchPredictorTest, Configure) {
+  CheriotBranchPredictor predictor("branch_predictor");
+  EXPECT_FALSE(predictor.Configure("", nullptr).ok());
+  EXPECT_FALSE(predictor.Configure("perceptron", nullptr).ok());
+  EXPECT_FALSE(predictor.Configure("gshare,1000", nullptr).ok());
+  EXPECT_FALSE(predictor.Configure("gshare,1024,8,2,1", nullptr).ok());
+  EXPECT_FALSE(predictor.is_configured());
+  EXPECT_TRUE(predictor.Configure("gshare,256,4", nullptr).ok());
+  EXPECT_TRUE(predictor.is_configured());
+  EXPECT_EQ(predictor.type(), CheriotBranchPredictor::Type::kGshare);
+  EXPECT_EQ(predictor.table_size(), 256);
+  EXPECT_EQ(predictor.ras_depth(), 4);
+  EXPECT_FALSE(predictor.Configure("static", nullptr).ok());
+}
+
+// A configuration that fails does not leave a predictor in the top, so that
+// it can be configured again.
+TEST(CheriotBranchPredictorTest, TopConfigure) {
+  TaggedFlatDemandMemory memory(8);
+  CheriotState state("test", &memory, nullptr);
+  CheriotDecoder decoder(&state, &memory);
+  CheriotTop top("test", &state, &decoder);
+  ComponentValueEntry value;
+  value.set_name("branch_predictor");
+  value.set_string_value("gshare,1000");
+  CHECK_OK(top.GetConfig("branch_predictor")->Import(&value));
+  EXPECT_EQ(top.branch_predictor(), nullptr);
+  EXPECT_FALSE(top.branch_predictor_status().ok());
+  value.set_string_value("gshare,256,4");
+  CHECK_OK(top.GetConfig("branch_predictor")->Import(&value));
+  ASSERT_NE(top.branch_predictor(), nullptr);
+  EXPECT_TRUE(top.branch_predictor()->is_configured());
+  CHECK_OK(top.branch_predictor_status());
+}
+
+// Backward branches are predicted taken, forward branches not taken.
+TEST(CheriotBranchPredictorTest, Static) {
+  CheriotBranchPredictor predictor("branch_predictor");
+  CHECK_OK(predictor.Configure("static", nullptr));
+  predictor.ConditionalBranch(0x100, 0x80, true);
+  predictor.ConditionalBranch(0x100, 0x180, false);
+  EXPECT_EQ(predictor.counter_branch_mispredicts()->GetValue(), 0);
+  predictor.ConditionalBranch(0x100, 0x80, false);
+  predictor.ConditionalBranch(0x100, 0x180, true);
+  EXPECT_EQ(predictor.counter_branches()->GetValue(), 4);
+  EXPECT_EQ(predictor.counter_branch_mispredicts()->GetValue(), 2);
+}
+
+// A loop branch is mispredicted while the counter warms up and at loop exit.
+TEST(CheriotBranchPredictorTest, Bimodal) {
+  CheriotBranchPredictor predictor("branch_predictor");
+  CHECK_OK(predictor.Configure("bimodal,64", nullptr));
+  for (int i = 0; i < 10; i++) predictor.ConditionalBranch(0x200, 0x1f0, true);
+  predictor.ConditionalBranch(0x200, 0x1f0, false);
+  EXPECT_EQ(predictor.counter_branch_mispredicts()->GetValue(), 2);
+  EXPECT_EQ(predictor.mispredicts_by_pc().at(0x200), 2);
+}
+
+// Gshare learns a strictly alternating pattern that bimodal cannot.
+TEST(CheriotBranchPredictorTest, Gshare) {
+  CheriotBranchPredictor gshare("gshare");
+  CheriotBranchPredictor bimodal("bimodal");
+  CHECK_OK(gshare.Configure("gshare,64", nullptr));
+  CHECK_OK(bimodal.Configure("bimodal,64", nullptr));
+  for (int i = 0; i < 100; i++) {
+    gshare.ConditionalBranch(0x300, 0x310, i & 1);
+    bimodal.ConditionalBranch(0x300, 0x310, i & 1);
+  }
+  EXPECT_LT(gshare.counter_branch_mispredicts()->GetValue(), 10);
+  EXPECT_GT(bimodal.counter_branch_mispredicts()->GetValue(), 40);
+}
+
+TEST(CheriotBranchPredictorTest, ReturnAddressStack) {
+  CheriotBranchPredictor predictor("branch_predictor");
+  CHECK_OK(predictor.Configure("static,64,2", nullptr));
+  // Three nested calls overflow the two entry stack, so the outermost return
+  // is mispredicted.
+  predictor.DirectJump(0x100, /*is_call=*/true, 0x104);
+  predictor.IndirectJump(0x200, 0x400, /*is_call=*/true, /*is_return=*/false,
+                         0x204);
+  predictor.DirectJump(0x400, /*is_call=*/true, 0x404);
+  predictor.IndirectJump(0x500, 0x404, false, /*is_return=*/true, 0);
+  predictor.IndirectJump(0x408, 0x204, false, /*is_return=*/true, 0);
+  predictor.IndirectJump(0x208, 0x104, false, /*is_return=*/true, 0);
+  EXPECT_EQ(predictor.counter_jumps()->GetValue(), 6);
+  EXPECT_EQ(predictor.counter_returns()->GetValue(), 3);
+  EXPECT_EQ(predictor.counter_return_mispredicts()->GetValue(), 1);
+  EXPECT_EQ(predictor.mispredicts_by_pc().at(0x208), 1);
+}
+
+TEST(CheriotBranchPredictorTest, IndirectJumps) {
+  CheriotBranchPredictor predictor("branch_predictor");
+  CHECK_OK(predictor.Configure("static", nullptr));
+  predictor.IndirectJump(0x100, 0x800, false, false, 0);
+  predictor.IndirectJump(0x100, 0x800, false, false, 0);
+  predictor.IndirectJump(0x100, 0x900, false, false, 0);
+  EXPECT_EQ(predictor.counter_indirect_mispredicts()->GetValue(), 2);
+}
+
+TEST(CheriotBranchPredictorTest, PenaltyAndProfile) {
+  SimpleCounter<uint64_t> cycles("cycles", 0);
+  CheriotBranchPredictor predictor("branch_predictor");
+  CHECK_OK(predictor.Configure("static,1024,8,3", &cycles));
+  predictor.ConditionalBranch(0x100, 0x180, true);
+  predictor.ConditionalBranch(0x200, 0x280, true);
+  predictor.ConditionalBranch(0x200, 0x280, true);
+  EXPECT_EQ(cycles.GetValue(), 9);
+  EXPECT_EQ(predictor.counter_penalty_cycles()->GetValue(), 9);
+  std::stringstream profile;
+  predictor.WriteProfile(profile);
+  EXPECT_EQ(profile.str(), "pc,mispredicts\n0x200,2\n0x100,1\n");
+}
+
+}  // namespace
@@ -0,0 +1,100 @@
+// Copyright 2024 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "cheriot/cheriot_coverage.h"
+
+#include <cstdint>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "googlemock/include/gmock/gmock.h"
+
+namespace {
+
+using ::mpact::sim::cheriot::CheriotCoverage;
+using ::testing::HasSubstr;
+
+constexpr int kAdd = 1;
+constexpr int kLoad = 2;
+constexpr int kCjalr = 3;
+constexpr uint32_t kMstatus = 0x300;
+
+std::vector<std::string> OpcodeNames() {
+  return {"none", "add", "load", "cjalr"};
+}
+
+TEST(CheriotCoverageTest, Record) {
+  CheriotCoverage coverage(OpcodeNames());
+  EXPECT_EQ(coverage.num_opcodes(), 4);
+  coverage.Executed(kAdd);
+  coverage.Trap(/*is_interrupt=*/false, kLoad, 5);
+  coverage.Trap(/*is_interrupt=*/true, 0, 7);
+  coverage.CheriException(kLoad, 0x12, 3, 0);
+  coverage.CapabilityJump(4, 5);
+  coverage.CsrAccess(kMstatus, /*is_write=*/true);
+  EXPECT_TRUE(coverage.executed(kAdd));
+  EXPECT_FALSE(coverage.executed(kLoad));
+  EXPECT_EQ(coverage.exceptions(kLoad), 1 << 5);
+  EXPECT_EQ(coverage.exceptions(0), 0);
+  EXPECT_EQ(coverage.interrupts(), 1 << 7);
+  EXPECT_EQ(coverage.cheri_exceptions(kLoad), 1 << 0x12);
+  EXPECT_EQ(coverage.cap_faults(0x12, 3), 1 << 0);
+  EXPECT_EQ(coverage.cap_jumps(4), 1 << 5);
+  EXPECT_EQ(coverage.csr(kMstatus), CheriotCoverage::kCsrWrite);
+}
+
+// Coverage written by one run and merged into another is the union of both.
+TEST(CheriotCoverageTest, WriteAndMerge) {
+  CheriotCoverage first(OpcodeNames());
+  first.Executed(kAdd);
+  first.Trap(/*is_interrupt=*/false, kLoad, 5);
+  first.CheriException(kLoad, 0x12, 3, 9);
+  first.CapabilityJump(4, 5);
+  first.CsrAccess(kMstatus, /*is_write=*/false);
+  std::stringstream report;
+  first.WriteReport(report);
+  EXPECT_THAT(report.str(), HasSubstr("# opcodes executed: 1/4\n"));
+  EXPECT_THAT(report.str(), HasSubstr("opcode add 1 0x0 0x0\n"));
+  EXPECT_THAT(report.str(), HasSubstr("opcode cjalr 0 0x0 0x0\n"));
+
+  CheriotCoverage second(OpcodeNames());
+  second.Executed(kCjalr);
+  second.CsrAccess(kMstatus, /*is_write=*/true);
+  ASSERT_TRUE(second.Merge(report).ok());
+  EXPECT_TRUE(second.executed(kAdd));
+  EXPECT_TRUE(second.executed(kCjalr));
+  EXPECT_FALSE(second.executed(kLoad));
+  EXPECT_EQ(second.exceptions(kLoad), 1 << 5);
+  EXPECT_EQ(second.cheri_exceptions(kLoad), 1 << 0x12);
+  EXPECT_EQ(second.cap_faults(0x12, 3), 1 << 9);
+  EXPECT_EQ(second.cap_jumps(4), 1 << 5);
+  EXPECT_EQ(second.csr(kMstatus),
+            CheriotCoverage::kCsrRead | CheriotCoverage::kCsrWrite);
+}
+
+TEST(CheriotCoverageTest, MergeErrors) {
+  CheriotCoverage coverage(OpcodeNames());
+  // Unknown opcodes are ignored.
+  std::stringstream unknown("opcode mul 1 0x0 0x0\n");
+  EXPECT_TRUE(coverage.Merge(unknown).ok());
+  std::stringstream bad_opcode("opcode add x 0x0 0x0\n");
+  EXPECT_FALSE(coverage.Merge(bad_opcode).ok());
+  std::stringstream bad_csr("csr 0x1000 1\n");
+  EXPECT_FALSE(coverage.Merge(bad_csr).ok());
+  std::stringstream bad_keyword("branch 1\n");
+  EXPECT_FALSE(coverage.Merge(bad_keyword).ok());
+}
+
+}  // namespace
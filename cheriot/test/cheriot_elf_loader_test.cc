@@ -0,0 +1,160 @@
+// Copyright 2024 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "cheriot/cheriot_elf_loader.h"
+
+#include <elf.h>
+
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include "googlemock/include/gmock/gmock.h"
+#include "mpact/sim/generic/data_buffer.h"
+#include "mpact/sim/util/memory/flat_demand_memory.h"
+
+namespace {
+
+using ::mpact::sim::cheriot::CheriotElfLoader;
+using ::mpact::sim::generic::DataBuffer;
+using ::mpact::sim::generic::DataBufferFactory;
+using ::mpact::sim::util::FlatDemandMemory;
+
+constexpr uint32_t kEntry = 0x8000'0000;
+constexpr uint32_t kDataSize = 16;
+constexpr uint32_t kBssSize = 32;
+constexpr char kStrtab[] = "\0tohost\0__stack_size";
+
+// Writes a minimal ELF file with one PT_LOAD segment (with bss), a
+// PT_GNU_STACK segment, and a symbol table with two symbols.
+std::string WriteElfFile() {
+  std::vector<uint8_t> file(4096, 0);
+  auto *ehdr = reinterpret_cast<Elf32_Ehdr *>(file.data());
+  std::memcpy(ehdr->e_ident, ELFMAG, SELFMAG);
+  ehdr->e_ident[EI_CLASS] = ELFCLASS32;
+  ehdr->e_ident[EI_DATA] = ELFDATA2LSB;
+  ehdr->e_ident[EI_VERSION] = EV_CURRENT;
+  ehdr->e_type = ET_EXEC;
+  ehdr->e_machine = EM_RISCV;
+  ehdr->e_entry = kEntry;
+  ehdr->e_ehsize = sizeof(Elf32_Ehdr);
+  ehdr->e_phoff = 0x40;
+  ehdr->e_phentsize = sizeof(Elf32_Phdr);
+  ehdr->e_phnum = 2;
+  ehdr->e_shoff = 0x100;
+  ehdr->e_shentsize = sizeof(Elf32_Shdr);
+  ehdr->e_shnum = 3;
+  auto *phdr = reinterpret_cast<Elf32_Phdr *>(file.data() + ehdr->e_phoff);
+  phdr[0].p_type = PT_LOAD;
+  phdr[0].p_offset = 0x400;
+  phdr[0].p_vaddr = kEntry;
+  phdr[0].p_paddr = kEntry;
+  phdr[0].p_filesz = kDataSize;
+  phdr[0].p_memsz = kDataSize + kBssSize;
+  phdr[1].p_type = PT_GNU_STACK;
+  phdr[1].p_memsz = 0x1000;
+  for (int i = 0; i < kDataSize; i++) file[0x400 + i] = i + 1;
+  auto *shdr = reinterpret_cast<Elf32_Shdr *>(file.data() + ehdr->e_shoff);
+  // Section 1: symbol table, section 2: string table.
+  shdr[1].sh_type = SHT_SYMTAB;
+  shdr[1].sh_offset = 0x200;
+  shdr[1].sh_size = 3 * sizeof(Elf32_Sym);
+  shdr[1].sh_link = 2;
+  shdr[1].sh_entsize = sizeof(Elf32_Sym);
+  shdr[2].sh_type = SHT_STRTAB;
+  shdr[2].sh_offset = 0x300;
+  shdr[2].sh_size = sizeof(kStrtab);
+  std::memcpy(file.data() + 0x300, kStrtab, sizeof(kStrtab));
+  auto *sym = reinterpret_cast<Elf32_Sym *>(file.data() + 0x200);
+  sym[1].st_name = 1;
+  sym[1].st_value = kEntry + 8;
+  sym[1].st_size = 8;
+  sym[2].st_name = 8;
+  sym[2].st_value = 0x800;
+  std::string file_name = testing::TempDir() + "/cheriot_elf_loader_test.elf";
+  std::ofstream os(file_name, std::ios::binary);
+  os.write(reinterpret_cast<const char *>(file.data()), file.size());
+  return file_name;
+}
+
+class CheriotElfLoaderTest : public testing::Test {
+ protected:
+  CheriotElfLoaderTest() { file_name_ = WriteElfFile(); }
+
+  std::vector<uint8_t> Read(uint64_t address, int size) {
+    DataBuffer *db = db_factory_.Allocate<uint8_t>(size);
+    memory_.Load(address, db, nullptr, nullptr);
+    auto span = db->Get<uint8_t>();
+    std::vector<uint8_t> bytes(span.begin(), span.end());
+    db->DecRef();
+    return bytes;
+  }
+
+  std::string file_name_;
+  DataBufferFactory db_factory_;
+  FlatDemandMemory memory_;
+};
+
+TEST_F(CheriotElfLoaderTest, LoadProgram) {
+  CheriotElfLoader loader;
+  auto res = loader.LoadProgram(file_name_, &memory_, /*memory_is_zero=*/true);
+  ASSERT_TRUE(res.ok()) << res.status().message();
+  EXPECT_EQ(res.value(), kEntry);
+  auto bytes = Read(kEntry, kDataSize);
+  for (int i = 0; i < kDataSize; i++) EXPECT_EQ(bytes[i], i + 1);
+  auto stack_size = loader.GetStackSize();
+  ASSERT_TRUE(stack_size.ok());
+  EXPECT_EQ(stack_size.value(), 0x1000);
+}
+
+// Bss is zero filled when the memory isn't known to be zero.
+TEST_F(CheriotElfLoaderTest, ZeroFillBss) {
+  DataBuffer *db = db_factory_.Allocate<uint8_t>(kBssSize);
+  std::memset(db->raw_ptr(), 0xff, kBssSize);
+  memory_.Store(kEntry + kDataSize, db);
+  db->DecRef();
+  CheriotElfLoader loader;
+  ASSERT_TRUE(loader.LoadProgram(file_name_, &memory_, true).ok());
+  EXPECT_EQ(Read(kEntry + kDataSize, 1)[0], 0xff);
+  ASSERT_TRUE(loader.LoadProgram(file_name_, &memory_, false).ok());
+  for (auto byte : Read(kEntry + kDataSize, kBssSize)) EXPECT_EQ(byte, 0);
+}
+
+TEST_F(CheriotElfLoaderTest, Symbols) {
+  CheriotElfLoader loader;
+  ASSERT_TRUE(loader.Open(file_name_).ok());
+  auto tohost = loader.GetSymbol("tohost");
+  ASSERT_TRUE(tohost.ok());
+  EXPECT_EQ(tohost.value().first, kEntry + 8);
+  EXPECT_EQ(tohost.value().second, 8);
+  auto stack_size = loader.GetSymbol("__stack_size");
+  ASSERT_TRUE(stack_size.ok());
+  EXPECT_EQ(stack_size.value().first, 0x800);
+  EXPECT_FALSE(loader.GetSymbol("main").ok());
+}
+
+TEST_F(CheriotElfLoaderTest, NotAnElfFile) {
+  std::string file_name = testing::TempDir() + "/cheriot_elf_loader_test.txt";
+  {
+    std::ofstream os(file_name);
+    os << std::string(128, 'x');
+  }
+  CheriotElfLoader loader;
+  EXPECT_FALSE(loader.Open(file_name).ok());
+  EXPECT_FALSE(loader.Open(file_name + ".missing").ok());
+}
+
+}  // namespace
@@ -0,0 +1,188 @@
+// Copyright 2024 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "cheriot/cheriot_fault_campaign.h"
+
+#include <cstdint>
+
+#include "absl/log/check.h"
+#include "absl/status/status.h"
+#include "cheriot/cheriot_top.h"
+#include "cheriot/test/cheriot_test_instance.h"
+#include "googlemock/include/gmock/gmock.h"
+
+namespace {
+
+using ::mpact::sim::cheriot::CheriotFaultCampaign;
+using ::mpact::sim::cheriot::CheriotTop;
+using ::mpact::sim::cheriot::test::CheriotTestInstance;
+using ::mpact::sim::cheriot::test::kAddiA0;
+using ::mpact::sim::cheriot::test::kJSelf;
+using ::mpact::sim::cheriot::test::kPc;
+using Fault = CheriotFaultCampaign::Fault;
+using FaultType = CheriotFaultCampaign::FaultType;
+using Outcome = CheriotFaultCampaign::Outcome;
+
+constexpr int kNumInstructions = 32;
+// The program ends at a breakpoint on the last instruction.
+constexpr uint64_t kEnd = kPc + (kNumInstructions - 1) * sizeof(uint32_t);
+// Index of a bne instruction that loops forever if a1 is not zero.
+constexpr int kLoopIndex = 16;
+// bne a1, zero, 0
+constexpr uint32_t kBneA1Self = 0x0005'9063;
+// csrrw zero, pmpcfg0, a2
+constexpr uint32_t kCsrwPmpcfg0A2 = 0x3a06'1073;
+// The trap handler loops forever.
+constexpr uint64_t kHandler = 0x2000;
+
+class CheriotFaultCampaignTest : public testing::Test {
+ protected:
+  CheriotFaultCampaignTest()
+      : instance_(kNumInstructions),
+        top_(instance_.top()),
+        campaign_(top_) {
+    instance_.StoreWord(kPc + kLoopIndex * sizeof(uint32_t), kBneA1Self);
+    instance_.StoreWord(kHandler, kJSelf);
+    CHECK_OK(top_->WriteRegister("mtcc", kHandler));
+    CHECK_OK(top_->SetSwBreakpoint(kEnd));
+    campaign_.set_hang_limit(/*factor=*/2, /*margin=*/16);
+  }
+
+  uint32_t ReadWord(uint64_t address) {
+    uint32_t value = 0;
+    CHECK_OK(top_->ReadMemory(address, &value, sizeof(value)).status());
+    return value;
+  }
+
+  CheriotTestInstance instance_;
+  CheriotTop *top_;
+  CheriotFaultCampaign campaign_;
+};
+
+TEST_F(CheriotFaultCampaignTest, Prepare) {
+  CHECK_OK(campaign_.Prepare(/*injection_point=*/8, /*max_instructions=*/0));
+  EXPECT_GE(campaign_.golden_instructions(), kNumInstructions - 9);
+  EXPECT_EQ(campaign_.golden_cheri_traps(), 0);
+  // The state is restored to the snapshot.
+  EXPECT_EQ(top_->ReadRegister("c10").value(), 8);
+  EXPECT_EQ(top_->ReadRegister("pcc").value(), kPc + 8 * sizeof(uint32_t));
+  // A second campaign cannot be prepared.
+  EXPECT_EQ(campaign_.Prepare(8, 0).code(),
+            absl::StatusCode::kFailedPrecondition);
+}
+
+TEST_F(CheriotFaultCampaignTest, PrepareAfterEnd) {
+  EXPECT_EQ(campaign_.Prepare(/*injection_point=*/1000, 0).code(),
+            absl::StatusCode::kInvalidArgument);
+}
+
+TEST_F(CheriotFaultCampaignTest, Outcomes) {
+  CHECK_OK(campaign_.Prepare(/*injection_point=*/8, /*max_instructions=*/0));
+  // Interrupts are disabled, so the interrupt is masked.
+  Fault irq{.type = FaultType::kInterrupt, .delay = 2, .bit = 7};
+  EXPECT_EQ(campaign_.RunVariant(irq).value(), Outcome::kMasked);
+  // The flipped bit of a0 propagates to the final state.
+  Fault a0{.type = FaultType::kRegisterBitFlip, .delay = 2, .reg = "c10",
+           .bit = 4};
+  EXPECT_EQ(campaign_.RunVariant(a0).value(), Outcome::kSilentCorruption);
+  // A non-zero a1 makes the bne loop forever.
+  Fault a1{.type = FaultType::kRegisterBitFlip, .delay = 2, .reg = "c11",
+           .bit = 0};
+  EXPECT_EQ(campaign_.RunVariant(a1).value(), Outcome::kHang);
+  // Fetching through an untagged pcc raises a CHERI exception, after which
+  // the trap handler loops.
+  Fault pcc{.type = FaultType::kRegisterTagDrop, .delay = 2, .reg = "pcc"};
+  EXPECT_EQ(campaign_.RunVariant(pcc).value(), Outcome::kCheriTrap);
+  // The state is restored after each variant.
+  EXPECT_EQ(top_->ReadRegister("c10").value(), 8);
+  EXPECT_EQ(top_->ReadRegister("c11").value(), 0);
+  EXPECT_EQ(campaign_.RunVariant(irq).value(), Outcome::kMasked);
+}
+
+TEST_F(CheriotFaultCampaignTest, MemoryRestore) {
+  CHECK_OK(campaign_.Prepare(/*injection_point=*/8, /*max_instructions=*/0));
+  // Corrupting an instruction that has already executed only changes memory.
+  Fault mem{.type = FaultType::kMemoryBitFlip, .delay = 2, .address = kPc,
+            .bit = 1};
+  EXPECT_EQ(campaign_.RunVariant(mem).value(), Outcome::kSilentCorruption);
+  // The page is restored.
+  EXPECT_EQ(ReadWord(kPc), kAddiA0);
+  // An unknown register is an error, and the state is still restored.
+  Fault bad{.type = FaultType::kRegisterBitFlip, .delay = 2, .reg = "c99"};
+  EXPECT_EQ(campaign_.RunVariant(bad).status().code(),
+            absl::StatusCode::kNotFound);
+  EXPECT_EQ(top_->ReadRegister("c10").value(), 8);
+}
+
+// A variant that changes the PMP configuration doesn't affect the next one.
+TEST_F(CheriotFaultCampaignTest, PmpRestore) {
+  // After the injection point the program writes a2 to pmpcfg0. The region is
+  // not locked, so it doesn't apply in machine mode.
+  instance_.StoreWord(kPc + 12 * sizeof(uint32_t), kCsrwPmpcfg0A2);
+  instance_.state()->set_pmp_enabled(true);
+  // Read only, 4KiB NAPOT region covering the program.
+  CHECK_OK(top_->WriteRegister("pmpaddr0", (kPc >> 2) | 0x1ff));
+  CHECK_OK(top_->WriteRegister("c12", (3 << 3) | 0b001));
+  CHECK_OK(campaign_.Prepare(/*injection_point=*/8, /*max_instructions=*/0));
+  EXPECT_EQ(top_->ReadRegister("pmpcfg0").value(), 0);
+  // Setting the lock bit makes the program unexecutable, so once pmpcfg0 is
+  // written the fetch faults and the trap handler loops.
+  Fault lock{.type = FaultType::kRegisterBitFlip, .delay = 2, .reg = "c12",
+             .bit = 7};
+  EXPECT_EQ(campaign_.RunVariant(lock).value(), Outcome::kHang);
+  EXPECT_EQ(top_->ReadRegister("pmpcfg0").value(), 0);
+  // The decisions cached for the locked region are dropped on restore.
+  Fault irq{.type = FaultType::kInterrupt, .delay = 2, .bit = 7};
+  EXPECT_EQ(campaign_.RunVariant(irq).value(), Outcome::kMasked);
+}
+
+TEST_F(CheriotFaultCampaignTest, GenerateFaults) {
+  CHECK_OK(campaign_.Prepare(/*injection_point=*/8, /*max_instructions=*/0));
+  auto faults = campaign_.GenerateFaults(/*count=*/32, /*seed=*/1);
+  auto same = campaign_.GenerateFaults(/*count=*/32, /*seed=*/1);
+  ASSERT_EQ(faults.size(), 32);
+  for (size_t i = 0; i < faults.size(); i++) {
+    EXPECT_EQ(CheriotFaultCampaign::FaultString(faults[i]),
+              CheriotFaultCampaign::FaultString(same[i]));
+    EXPECT_LT(faults[i].delay, campaign_.golden_instructions());
+    // No memory is written by the golden run, so no memory faults are made.
+    EXPECT_NE(faults[i].type, FaultType::kMemoryBitFlip);
+    EXPECT_NE(faults[i].type, FaultType::kMemoryTagDrop);
+  }
+}
+
+TEST(CheriotFaultCampaignParseTest, ParseFault) {
+  for (auto const *text : {"10 reg c10 3", "0 cap c2 31", "5 regtag c3",
+                           "7 mem 0x2004 7", "7 memtag 0x2008", "1 irq 11 4"}) {
+    auto fault = CheriotFaultCampaign::ParseFault(text);
+    ASSERT_TRUE(fault.ok()) << text;
+    EXPECT_EQ(CheriotFaultCampaign::FaultString(fault.value()), text);
+  }
+  auto fault = CheriotFaultCampaign::ParseFault("  12\tmem  0x10 2 ");
+  ASSERT_TRUE(fault.ok());
+  EXPECT_EQ(fault->type, FaultType::kMemoryBitFlip);
+  EXPECT_EQ(fault->delay, 12);
+  EXPECT_EQ(fault->address, 0x10);
+  EXPECT_EQ(fault->bit, 2);
+  for (auto const *text : {"", "10", "x reg c1 1", "1 flip c1 1",
+                           "1 reg c1", "1 mem 0x10 8", "1 irq 5 1",
+                           "1 irq 7 0", "1 regtag c1 1", "1 reg c1 32",
+                           "1 cap c1 32"}) {
+    EXPECT_EQ(CheriotFaultCampaign::ParseFault(text).status().code(),
+              absl::StatusCode::kInvalidArgument)
+        << text;
+  }
+}
+
+}  // namespace
@@ -0,0 +1,191 @@
+// Copyright 2024 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "cheriot/cheriot_lockstep.h"
+
+#include <cstdint>
+
+#include "absl/log/check.h"
+#include "cheriot/cheriot_address_ranges.h"
+#include "cheriot/cheriot_register.h"
+#include "cheriot/cheriot_top.h"
+#include "cheriot/test/cheriot_test_instance.h"
+#include "googlemock/include/gmock/gmock.h"
+#include "mpact/sim/generic/instruction.h"
+
+namespace {
+
+using ::mpact::sim::cheriot::CheriotAddressRanges;
+using ::mpact::sim::cheriot::CheriotLockstep;
+using ::mpact::sim::cheriot::CheriotRegister;
+using ::mpact::sim::cheriot::CheriotTop;
+using ::mpact::sim::cheriot::test::CheriotTestInstance;
+using ::mpact::sim::cheriot::test::kPc;
+using ::mpact::sim::generic::Instruction;
+using ::testing::HasSubstr;
+
+constexpr uint64_t kDataAddress = 0x2000;
+constexpr int kNumInstructions = 64;
+constexpr uint32_t kEbreak = 0x0010'0073;
+// Semihosting read of 8 bytes to kDataAddress, with the parameter block at
+// kBlockAddress.
+constexpr uint32_t kSysRead = 0x06;
+constexpr uint64_t kBlockAddress = 0x3000;
+constexpr uint32_t kReadSize = 8;
+
+class CheriotLockstepTest : public testing::Test {
+ protected:
+  CheriotLockstepTest() : lockstep_(top_.top(), reference_.top()) {
+    lockstep_.TrackStores(top_.state());
+    lockstep_.TrackStores(reference_.state());
+  }
+
+  uint64_t ReadDoubleWord(CheriotTop *top, uint64_t address) {
+    uint64_t value = 0;
+    CHECK_OK(top->ReadMemory(address, &value, sizeof(value)).status());
+    return value;
+  }
+
+  // The fast paths are disabled for the reference.
+  CheriotTestInstance top_{kNumInstructions, /*fast_paths=*/true};
+  CheriotTestInstance reference_{kNumInstructions, /*fast_paths=*/false};
+  CheriotLockstep lockstep_;
+};
+
+TEST_F(CheriotLockstepTest, NoDivergence) {
+  CHECK_OK(lockstep_.Run(/*interval=*/4, /*max_instructions=*/16));
+  EXPECT_FALSE(lockstep_.diverged());
+  EXPECT_TRUE(lockstep_.report().empty());
+  EXPECT_EQ(lockstep_.num_instructions(), 16);
+  EXPECT_EQ(top_.top()->ReadRegister("c10").value(), 16);
+  EXPECT_EQ(reference_.top()->ReadRegister("c10").value(), 16);
+}
+
+TEST_F(CheriotLockstepTest, RegisterDivergence) {
+  CHECK_OK(reference_.top()->WriteRegister("c11", 1));
+  CHECK_OK(lockstep_.Run(/*interval=*/4, /*max_instructions=*/16));
+  EXPECT_TRUE(lockstep_.diverged());
+  // The divergence is found at the end of the first interval.
+  EXPECT_EQ(lockstep_.num_instructions(), 4);
+  EXPECT_THAT(lockstep_.report(), HasSubstr("after 4 instructions"));
+  EXPECT_THAT(lockstep_.report(), HasSubstr(" vs 0x1 tag 0"));
+}
+
+TEST_F(CheriotLockstepTest, MemoryDivergence) {
+  EXPECT_TRUE(lockstep_.Compare());
+  uint32_t value = 0x1234'5678;
+  CHECK_OK(
+      top_.top()->WriteMemory(kDataAddress, &value, sizeof(value)).status());
+  EXPECT_FALSE(lockstep_.Compare());
+  EXPECT_THAT(lockstep_.report(), HasSubstr("memory 0x00002000"));
+}
+
+TEST_F(CheriotLockstepTest, ExcludedRange) {
+  CheriotAddressRanges ranges;
+  ranges.Add(kDataAddress, kDataAddress + 0xff);
+  lockstep_.set_excluded_ranges(ranges);
+  uint32_t value = 0x1234'5678;
+  CHECK_OK(
+      top_.top()->WriteMemory(kDataAddress, &value, sizeof(value)).status());
+  EXPECT_TRUE(lockstep_.Compare());
+}
+
+// A PMP CSR that is changed without invalidating the cached PMP decisions, as
+// a bug in the top might do, leaves the top using a stale decision. The
+// reference doesn't cache decisions, so it takes the fetch fault and the
+// instances diverge.
+TEST_F(CheriotLockstepTest, StalePmpDecisionDivergence) {
+  for (auto *instance : {&top_, &reference_}) {
+    instance->state()->set_pmp_enabled(true);
+  }
+  CHECK_OK(lockstep_.Run(/*interval=*/1, /*max_instructions=*/1));
+  EXPECT_FALSE(lockstep_.diverged());
+  for (auto *instance : {&top_, &reference_}) {
+    auto *csr_set = instance->state()->csr_set();
+    // Locked, read only, 4KiB NAPOT region covering the program.
+    csr_set->GetCsr("pmpaddr0").value()->Set(
+        static_cast<uint32_t>((kPc >> 2) | 0x1ff));
+    csr_set->GetCsr("pmpcfg0").value()->Set(
+        static_cast<uint32_t>(0x80 | (3 << 3) | 0b001));
+  }
+  CHECK_OK(lockstep_.Run(/*interval=*/1, /*max_instructions=*/2));
+  EXPECT_TRUE(lockstep_.diverged());
+  EXPECT_EQ(lockstep_.num_instructions(), 2);
+}
+
+// The reference replays the semihosting calls of the top instead of making
+// them.
+TEST_F(CheriotLockstepTest, SemihostingReplay) {
+  uint32_t block[] = {0, kDataAddress, kReadSize};
+  for (auto *instance : {&top_, &reference_}) {
+    CHECK_OK(instance->top()->WriteMemory(kPc, &kEbreak, sizeof(kEbreak))
+                 .status());
+    CHECK_OK(instance->top()->WriteMemory(kBlockAddress, block, sizeof(block))
+                 .status());
+    CHECK_OK(instance->top()->WriteRegister("c10", kSysRead));
+    CHECK_OK(instance->top()->WriteRegister("c11", kBlockAddress));
+  }
+  int top_calls = 0;
+  int reference_calls = 0;
+  auto *state = top_.state();
+  state->AddEbreakHandler([this, state, &top_calls](const Instruction *) {
+    lockstep_.TopSemihostingCall([state, &top_calls]() {
+      top_calls++;
+      auto *db = state->db_factory()->Allocate<uint8_t>(kReadSize);
+      for (uint32_t i = 0; i < kReadSize; i++) db->Set<uint8_t>(i, i + 1);
+      state->DbgStoreMemory(kDataAddress, db);
+      db->DecRef();
+      // All bytes were read.
+      auto *a0 = state->GetRegister<CheriotRegister>("c10").first;
+      a0->data_buffer()->Set<uint32_t>(0, 0);
+      a0->Invalidate();
+      a0->set_is_null();
+    });
+    return true;
+  });
+  reference_.state()->AddEbreakHandler(
+      [this, &reference_calls](const Instruction *) {
+        lockstep_.ReferenceSemihostingCall(
+            [&reference_calls]() { reference_calls++; });
+        return true;
+      });
+  CHECK_OK(lockstep_.Run(/*interval=*/4, /*max_instructions=*/8));
+  EXPECT_FALSE(lockstep_.diverged()) << lockstep_.report();
+  EXPECT_EQ(top_calls, 1);
+  EXPECT_EQ(reference_calls, 0);
+  EXPECT_EQ(ReadDoubleWord(reference_.top(), kDataAddress),
+            0x0807'0605'0403'0201ULL);
+  EXPECT_EQ(reference_.top()->ReadRegister("c10").value(), 7);
+}
+
+// A semihosting call that the top didn't make is a divergence.
+TEST_F(CheriotLockstepTest, SemihostingMismatch) {
+  CHECK_OK(reference_.top()->WriteMemory(kPc, &kEbreak, sizeof(kEbreak))
+               .status());
+  CHECK_OK(reference_.top()->WriteRegister("c10", kSysRead));
+  int reference_calls = 0;
+  reference_.state()->AddEbreakHandler(
+      [this, &reference_calls](const Instruction *) {
+        lockstep_.ReferenceSemihostingCall(
+            [&reference_calls]() { reference_calls++; });
+        return true;
+      });
+  CHECK_OK(lockstep_.Run(/*interval=*/4, /*max_instructions=*/16));
+  EXPECT_TRUE(lockstep_.diverged());
+  EXPECT_EQ(reference_calls, 0);
+  EXPECT_THAT(lockstep_.report(),
+              HasSubstr("reference semihosting call 0x6 was not made"));
+}
+
+}  // namespace
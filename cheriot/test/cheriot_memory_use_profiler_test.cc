@@ -0,0 +1,113 @@
+// Copyright 2024 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "cheriot/cheriot_memory_use_profiler.h"
+
+#include <cstdint>
+#include <sstream>
+#include <string>
+
+#include "googlemock/include/gmock/gmock.h"
+#include "mpact/sim/generic/data_buffer.h"
+#include "mpact/sim/util/memory/tagged_flat_demand_memory.h"
+
+namespace {
+
+using ::mpact::sim::cheriot::CheriotMemoryUseProfiler;
+using ::mpact::sim::generic::DataBuffer;
+using ::mpact::sim::generic::DataBufferFactory;
+using ::mpact::sim::util::TaggedFlatDemandMemory;
+
+class CheriotMemoryUseProfilerTest : public testing::Test {
+ protected:
+  CheriotMemoryUseProfilerTest() : memory_(8), profiler_(&memory_) {
+    db4_ = db_factory_.Allocate<uint32_t>(1);
+    db8_ = db_factory_.Allocate<uint32_t>(2);
+    tag_db_ = db_factory_.Allocate<uint8_t>(1);
+  }
+  ~CheriotMemoryUseProfilerTest() override {
+    db4_->DecRef();
+    db8_->DecRef();
+    tag_db_->DecRef();
+  }
+
+  std::string Profile() {
+    std::ostringstream os;
+    profiler_.WriteProfile(os);
+    return os.str();
+  }
+
+  std::string Heatmap() {
+    std::ostringstream os;
+    profiler_.WriteTagHeatmap(os);
+    return os.str();
+  }
+
+  DataBufferFactory db_factory_;
+  TaggedFlatDemandMemory memory_;
+  CheriotMemoryUseProfiler profiler_;
+  DataBuffer *db4_;
+  DataBuffer *db8_;
+  DataBuffer *tag_db_;
+};
+
+// Adjacent accesses are coalesced into a single range, including across page
+// boundaries.
+TEST_F(CheriotMemoryUseProfilerTest, CoalesceRanges) {
+  profiler_.Store(0x1000, db4_);
+  profiler_.Load(0x1004, db4_, nullptr, nullptr);
+  profiler_.Store(0x1ffc, db8_);
+  profiler_.Load(0x3000, db4_, nullptr, nullptr);
+  EXPECT_EQ(Profile(),
+            "0x00001000 - 0x00001007\n"
+            "0x00001ffc - 0x00002003\n"
+            "0x00003000 - 0x00003003\n");
+}
+
+// Nothing is recorded while the profiler is disabled, but accesses are still
+// forwarded.
+TEST_F(CheriotMemoryUseProfilerTest, Disabled) {
+  profiler_.set_is_enabled(false);
+  db4_->Set<uint32_t>(0, 0x1234'5678);
+  profiler_.Store(0x1000, db4_);
+  db4_->Set<uint32_t>(0, 0);
+  profiler_.Load(0x1000, db4_, nullptr, nullptr);
+  EXPECT_EQ(db4_->Get<uint32_t>(0), 0x1234'5678);
+  EXPECT_EQ(Profile(), "");
+}
+
+// Capability stores set tags, data stores clear them.
+TEST_F(CheriotMemoryUseProfilerTest, TagHeatmap) {
+  tag_db_->Set<uint8_t>(0, 1);
+  profiler_.Store(0x1000, db8_, tag_db_);
+  profiler_.Store(0x1008, db8_, tag_db_);
+  profiler_.Store(0x2000, db8_, tag_db_);
+  EXPECT_EQ(Heatmap(),
+            "page,valid_capabilities\n"
+            "0x00001000,2\n"
+            "0x00002000,1\n");
+  profiler_.Store(0x1008, db4_);
+  profiler_.Store(0x2000, db4_);
+  EXPECT_EQ(Heatmap(),
+            "page,valid_capabilities\n"
+            "0x00001000,1\n");
+}
+
+// Pages above 4GiB are tracked as well.
+TEST_F(CheriotMemoryUseProfilerTest, HighAddress) {
+  profiler_.Store(0x1'0000'0000ULL, db4_);
+  EXPECT_EQ(Profile(), "0x100000000 - 0x100000003\n");
+}
+
+}  // namespace
@@ -0,0 +1,137 @@
+// Copyright 2024 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "cheriot/cheriot_metrics_server.h"
+
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <thread>  // NOLINT: third party code.
+
+#include "absl/log/check.h"
+#include "absl/strings/str_cat.h"
+#include "googlemock/include/gmock/gmock.h"
+#include "mpact/sim/generic/component.h"
+#include "mpact/sim/generic/counters.h"
+#include "mpact/sim/proto/component_data.pb.h"
+
+namespace {
+
+using ::mpact::sim::cheriot::CheriotMetricsServer;
+using ::mpact::sim::generic::Component;
+using ::mpact::sim::generic::SimpleCounter;
+using ::mpact::sim::proto::ComponentData;
+using ::testing::HasSubstr;
+using ::testing::Not;
+
+class CheriotMetricsServerTest : public testing::Test {
+ protected:
+  CheriotMetricsServerTest()
+      : top_("top"),
+        cycles_("cycles", 42),
+        server_(&top_),
+        socket_path_(absl::StrCat("/tmp/cheriot_metrics_test_", getpid(),
+                                  ".sock")) {
+    CHECK_OK(top_.AddCounter(&cycles_));
+  }
+
+  // Connects to the server, sends the request and returns the response.
+  std::string Request(const std::string &request) {
+    sockaddr_un addr;
+    std::memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    std::strncpy(addr.sun_path, socket_path_.c_str(),
+                 sizeof(addr.sun_path) - 1);
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    EXPECT_GE(fd, 0);
+    EXPECT_EQ(connect(fd, reinterpret_cast<sockaddr *>(&addr), sizeof(addr)),
+              0);
+    EXPECT_EQ(write(fd, request.data(), request.size()), request.size());
+    std::string response;
+    char buffer[256];
+    ssize_t count;
+    while ((count = read(fd, buffer, sizeof(buffer))) > 0) {
+      response.append(buffer, count);
+    }
+    close(fd);
+    return response;
+  }
+
+  Component top_;
+  SimpleCounter<uint64_t> cycles_;
+  CheriotMetricsServer server_;
+  std::string socket_path_;
+};
+
+TEST_F(CheriotMetricsServerTest, Prometheus) {
+  ComponentData data;
+  data.set_name("top");
+  auto *entry = data.add_statistics();
+  entry->set_name("num.instructions");
+  entry->set_uint64_value(5);
+  auto *child = data.add_component_data();
+  child->set_name("icache");
+  entry = child->add_statistics();
+  entry->set_name("read_hits");
+  entry->set_sint64_value(-3);
+  entry = child->add_statistics();
+  entry->set_name("config");
+  entry->set_string_value("ignored");
+  EXPECT_EQ(CheriotMetricsServer::ToPrometheus(data),
+            "top_num_instructions 5\ntop_icache_read_hits -3\n");
+}
+
+// With no simulation thread, the server takes the snapshot itself if the
+// simulation is halted.
+TEST_F(CheriotMetricsServerTest, IdleSnapshot) {
+  server_.set_is_halted([]() { return true; });
+  ASSERT_TRUE(server_.Start(socket_path_).ok());
+  EXPECT_FALSE(server_.Start(socket_path_).ok());
+  EXPECT_THAT(Request("\n"), HasSubstr("top_cycles 42\n"));
+  EXPECT_THAT(Request("proto\n"), HasSubstr("name: \"cycles\""));
+  server_.Stop();
+  EXPECT_NE(access(socket_path_.c_str(), F_OK), 0);
+}
+
+// If the simulation isn't advancing but isn't halted either, the counters are
+// not exported.
+TEST_F(CheriotMetricsServerTest, BusySnapshot) {
+  server_.set_is_halted([]() { return false; });
+  ASSERT_TRUE(server_.Start(socket_path_).ok());
+  auto response = Request("\n");
+  EXPECT_THAT(response, HasSubstr("# error: Snapshot unavailable"));
+  EXPECT_THAT(response, Not(HasSubstr("top_cycles")));
+  server_.Stop();
+}
+
+// Snapshots are taken by the thread that updates the counter.
+TEST_F(CheriotMetricsServerTest, SimulationThreadSnapshot) {
+  cycles_.AddListener(&server_);
+  ASSERT_TRUE(server_.Start(socket_path_).ok());
+  std::atomic<bool> done = false;
+  std::thread sim([this, &done]() {
+    while (!done) cycles_.Increment(1);
+  });
+  EXPECT_THAT(Request("\n"), HasSubstr("top_cycles "));
+  done = true;
+  sim.join();
+  server_.Stop();
+}
+
+}  // namespace
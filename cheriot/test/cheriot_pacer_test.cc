@@ -0,0 +1,82 @@
+// Copyright 2024 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "cheriot/cheriot_pacer.h"
+
+#include <chrono>  // NOLINT: steady_clock is needed for pacing.
+#include <cstdint>
+#include <thread>  // NOLINT: sleep_for is needed to fall behind.
+
+#include "absl/log/check.h"
+#include "cheriot/cheriot_top.h"
+#include "cheriot/test/cheriot_test_instance.h"
+#include "googlemock/include/gmock/gmock.h"
+
+namespace {
+
+using ::mpact::sim::cheriot::CheriotPacer;
+using ::mpact::sim::cheriot::CheriotTop;
+using ::mpact::sim::cheriot::test::CheriotTestInstance;
+using Clock = CheriotPacer::Clock;
+
+constexpr int kNumInstructions = 64;
+
+// Pacing to 1kHz, 20 cycles take at least 20ms.
+TEST(CheriotPacerTest, Sleep) {
+  CheriotPacer pacer(/*frequency=*/1000.0, CheriotPacer::kDefaultMaxLagUsec);
+  auto start = Clock::now();
+  pacer.Start(100);
+  pacer.Pace(110);
+  pacer.Pace(120);
+  EXPECT_GE(Clock::now() - start, std::chrono::milliseconds(20));
+  EXPECT_EQ(pacer.num_quanta(), 2);
+  EXPECT_EQ(pacer.num_resyncs(), 0);
+  EXPECT_GT(pacer.sleep_usec(), 0);
+}
+
+// A pacer that falls behind by more than the maximum lag resynchronizes.
+TEST(CheriotPacerTest, Resync) {
+  CheriotPacer pacer(/*frequency=*/1'000'000.0, /*max_lag_usec=*/1000);
+  pacer.Start(0);
+  std::this_thread::sleep_for(std::chrono::milliseconds(5));
+  pacer.Pace(1);
+  EXPECT_EQ(pacer.num_late_quanta(), 1);
+  EXPECT_EQ(pacer.num_resyncs(), 1);
+  EXPECT_GE(pacer.max_lag_usec(), 4000);
+  // After resynchronizing it is on time again.
+  auto start = Clock::now();
+  pacer.Pace(5001);
+  EXPECT_GE(Clock::now() - start, std::chrono::milliseconds(4));
+  EXPECT_EQ(pacer.num_late_quanta(), 1);
+}
+
+// The pacer is called between the run quanta of the top.
+TEST(CheriotPacerTest, RunQuantum) {
+  CheriotTestInstance instance(kNumInstructions);
+  CheriotTop &top = *instance.top();
+  CheriotPacer pacer(/*frequency=*/1000.0, CheriotPacer::kDefaultMaxLagUsec);
+  top.SetRunQuantumCallback(/*quantum=*/4, [&top, &pacer]() {
+    pacer.Pace(top.counter_num_cycles()->GetValue());
+  });
+  auto start = Clock::now();
+  pacer.Start(top.counter_num_cycles()->GetValue());
+  CHECK_OK(top.RunAsync(/*max_instructions=*/16, nullptr));
+  CHECK_OK(top.Wait());
+  // The callback is called after 4, 8 and 12 instructions.
+  EXPECT_EQ(pacer.num_quanta(), 3);
+  EXPECT_GE(Clock::now() - start, std::chrono::milliseconds(12));
+  EXPECT_EQ(top.ReadRegister("c10").value(), 16);
+}
+
+}  // namespace
@@ -482,6 +482,26 @@ TEST_F(CheriotRegisterTest, CopyFrom) {
   EXPECT_EQ(cap_reg_copy->object_type(), cap_reg()->object_type());
 }
 
+// The copy is a complete, independent value: it compresses to the same bits
+// and is not affected by later changes to the source.
+TEST_F(CheriotRegisterTest, CopyFromIsIndependent) {
+  constexpr uint32_t kAddress = 0xdeadbeef;
+  auto cap_reg_copy = std::make_unique<CheriotRegister>(arch_state_, "copy");
+  cap_reg()->ResetMemoryRoot();
+  cap_reg()->data_buffer()->Set<uint32_t>(0, kAddress);
+  (void)cap_reg()->SetBounds(kBase, kAddress + 1);
+  cap_reg_copy->CopyFrom(*cap_reg());
+  EXPECT_EQ(cap_reg_copy->Compress(), cap_reg()->Compress());
+  EXPECT_EQ(cap_reg_copy->permissions(), cap_reg()->permissions());
+  EXPECT_EQ(cap_reg_copy->object_type(), cap_reg()->object_type());
+  EXPECT_TRUE(*cap_reg_copy == *cap_reg());
+  uint32_t base = cap_reg()->base();
+  cap_reg()->ResetNull();
+  EXPECT_TRUE(cap_reg_copy->IsValid());
+  EXPECT_EQ(cap_reg_copy->address(), kAddress);
+  EXPECT_EQ(cap_reg_copy->base(), base);
+}
+
 // Test compress/expand of bounds.
 TEST_F(CheriotRegisterTest, CompressExpand) {
   // First some random combinations.
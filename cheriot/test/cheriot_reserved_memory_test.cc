@@ -0,0 +1,126 @@
+// Copyright 2024 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "cheriot/cheriot_reserved_memory.h"
+
+#include <cstdint>
+
+#include "googlemock/include/gmock/gmock.h"
+#include "mpact/sim/generic/data_buffer.h"
+#include "mpact/sim/util/memory/tagged_flat_demand_memory.h"
+
+namespace {
+
+using ::mpact::sim::cheriot::CheriotReservedMemory;
+using ::mpact::sim::generic::DataBuffer;
+using ::mpact::sim::generic::DataBufferFactory;
+using ::mpact::sim::util::TaggedFlatDemandMemory;
+
+constexpr uint64_t kBase = 0x8000'0000;
+constexpr uint64_t kSize = 0x1000'0000;
+
+class CheriotReservedMemoryTest : public testing::Test {
+ protected:
+  CheriotReservedMemoryTest() : fallback_(8), memory_(8, &fallback_) {
+    db8_ = db_factory_.Allocate<uint32_t>(2);
+    tag_db_ = db_factory_.Allocate<uint8_t>(1);
+  }
+  ~CheriotReservedMemoryTest() override {
+    db8_->DecRef();
+    tag_db_->DecRef();
+  }
+
+  DataBufferFactory db_factory_;
+  TaggedFlatDemandMemory fallback_;
+  CheriotReservedMemory memory_;
+  DataBuffer *db8_;
+  DataBuffer *tag_db_;
+};
+
+TEST_F(CheriotReservedMemoryTest, Reserve) {
+  EXPECT_FALSE(memory_.is_reserved());
+  EXPECT_FALSE(memory_.Reserve(kBase + 4, kSize, false).ok());
+  EXPECT_FALSE(memory_.Reserve(kBase, 0, false).ok());
+  ASSERT_TRUE(memory_.Reserve(kBase, kSize, true).ok());
+  EXPECT_TRUE(memory_.is_reserved());
+  EXPECT_EQ(memory_.base(), kBase);
+  EXPECT_EQ(memory_.size(), kSize);
+  EXPECT_FALSE(memory_.Reserve(kBase, kSize, false).ok());
+}
+
+// Reserved memory is zero initialized, and accesses outside the range go to
+// the fallback memory.
+TEST_F(CheriotReservedMemoryTest, LoadStore) {
+  ASSERT_TRUE(memory_.Reserve(kBase, kSize, false).ok());
+  memory_.Load(kBase + kSize - 8, db8_, nullptr, nullptr);
+  EXPECT_EQ(db8_->Get<uint32_t>(0), 0);
+  db8_->Set<uint32_t>(0, 0x1234'5678);
+  db8_->Set<uint32_t>(1, 0x9abc'def0);
+  memory_.Store(kBase + kSize - 8, db8_);
+  memory_.Store(kBase - 8, db8_);
+  db8_->Set<uint32_t>(0, 0);
+  db8_->Set<uint32_t>(1, 0);
+  memory_.Load(kBase + kSize - 8, db8_, nullptr, nullptr);
+  EXPECT_EQ(db8_->Get<uint32_t>(0), 0x1234'5678);
+  EXPECT_EQ(db8_->Get<uint32_t>(1), 0x9abc'def0);
+  db8_->Set<uint32_t>(0, 0);
+  fallback_.Load(kBase - 8, db8_, nullptr, nullptr);
+  EXPECT_EQ(db8_->Get<uint32_t>(0), 0x1234'5678);
+  // An access that straddles the end of the range goes to the fallback.
+  memory_.Load(kBase + kSize - 4, db8_, nullptr, nullptr);
+  EXPECT_EQ(db8_->Get<uint32_t>(0), 0);
+}
+
+// Capability stores set tags, data stores clear them.
+TEST_F(CheriotReservedMemoryTest, Tags) {
+  ASSERT_TRUE(memory_.Reserve(kBase, kSize, false).ok());
+  tag_db_->Set<uint8_t>(0, 1);
+  memory_.Store(kBase + 0x100, db8_, tag_db_);
+  tag_db_->Set<uint8_t>(0, 0);
+  memory_.Load(kBase + 0x100, db8_, tag_db_, nullptr, nullptr);
+  EXPECT_EQ(tag_db_->Get<uint8_t>(0), 1);
+  memory_.Load(kBase + 0x108, db8_, tag_db_, nullptr, nullptr);
+  EXPECT_EQ(tag_db_->Get<uint8_t>(0), 0);
+  DataBuffer *db1 = db_factory_.Allocate<uint8_t>(1);
+  memory_.Store(kBase + 0x103, db1);
+  db1->DecRef();
+  memory_.Load(kBase + 0x100, db8_, tag_db_, nullptr, nullptr);
+  EXPECT_EQ(tag_db_->Get<uint8_t>(0), 0);
+}
+
+TEST_F(CheriotReservedMemoryTest, VectorLoadStore) {
+  ASSERT_TRUE(memory_.Reserve(kBase, kSize, false).ok());
+  DataBuffer *address_db = db_factory_.Allocate<uint64_t>(4);
+  DataBuffer *mask_db = db_factory_.Allocate<bool>(4);
+  DataBuffer *data_db = db_factory_.Allocate<uint16_t>(4);
+  for (int i = 0; i < 4; i++) {
+    address_db->Set<uint64_t>(i, kBase + 0x200 + 0x10 * i);
+    mask_db->Set<bool>(i, i != 2);
+    data_db->Set<uint16_t>(i, 0x100 + i);
+  }
+  memory_.Store(address_db, mask_db, sizeof(uint16_t), data_db);
+  for (int i = 0; i < 4; i++) data_db->Set<uint16_t>(i, 0xffff);
+  mask_db->Set<bool>(2, true);
+  memory_.Load(address_db, mask_db, sizeof(uint16_t), data_db, nullptr,
+               nullptr);
+  EXPECT_EQ(data_db->Get<uint16_t>(0), 0x100);
+  EXPECT_EQ(data_db->Get<uint16_t>(1), 0x101);
+  EXPECT_EQ(data_db->Get<uint16_t>(2), 0);
+  EXPECT_EQ(data_db->Get<uint16_t>(3), 0x103);
+  address_db->DecRef();
+  mask_db->DecRef();
+  data_db->DecRef();
+}
+
+}  // namespace
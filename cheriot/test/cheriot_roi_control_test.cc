@@ -0,0 +1,97 @@
+// Copyright 2024 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "cheriot/cheriot_roi_control.h"
+
+#include <cstdint>
+#include <optional>
+
+#include "absl/log/check.h"
+#include "absl/status/status.h"
+#include "cheriot/cheriot_top.h"
+#include "cheriot/test/cheriot_test_instance.h"
+#include "googlemock/include/gmock/gmock.h"
+
+namespace {
+
+using ::mpact::sim::cheriot::CheriotRoiControl;
+using ::mpact::sim::cheriot::CheriotTop;
+using ::mpact::sim::cheriot::test::CheriotTestInstance;
+using ::mpact::sim::cheriot::test::kPc;
+
+constexpr uint64_t kRoiStart = kPc + 16;
+constexpr uint64_t kRoiEnd = kPc + 48;
+constexpr int kNumInstructions = 64;
+
+class CheriotRoiControlTest : public testing::Test {
+ protected:
+  CheriotRoiControlTest()
+      : instance_(kNumInstructions),
+        top_(instance_.top()),
+        roi_control_(top_, /*dcache_memory=*/nullptr,
+                     /*mem_profiler=*/nullptr, /*inst_profile=*/false) {}
+
+  CheriotTestInstance instance_;
+  CheriotTop *top_;
+  CheriotRoiControl roi_control_;
+};
+
+TEST_F(CheriotRoiControlTest, SetModels) {
+  CHECK_OK(roi_control_.SetModels("icache, dcache"));
+  EXPECT_EQ(roi_control_.models(),
+            CheriotRoiControl::kICache | CheriotRoiControl::kDCache);
+  CHECK_OK(roi_control_.SetModels("all,counters"));
+  EXPECT_EQ(roi_control_.models(),
+            CheriotRoiControl::kDefaultModels | CheriotRoiControl::kCounters);
+  EXPECT_EQ(roi_control_.SetModels("icache,l2").code(),
+            absl::StatusCode::kInvalidArgument);
+}
+
+TEST_F(CheriotRoiControlTest, Region) {
+  // Scope the counters to the ROI, so that only the instructions in the ROI
+  // are counted.
+  CHECK_OK(roi_control_.SetModels("counters"));
+  CHECK_OK(roi_control_.SetRegion(kRoiStart, kRoiEnd));
+  EXPECT_FALSE(roi_control_.in_roi());
+  EXPECT_EQ(roi_control_.num_entries(), 0);
+  // Step up to the start of the ROI.
+  CHECK_OK(top_->Step(4).status());
+  EXPECT_FALSE(roi_control_.in_roi());
+  EXPECT_EQ(top_->counter_num_instructions()->GetValue(), 0);
+  // Step into the ROI.
+  CHECK_OK(top_->Step(4).status());
+  EXPECT_TRUE(roi_control_.in_roi());
+  EXPECT_EQ(roi_control_.num_entries(), 1);
+  // Step past the end of the ROI.
+  CHECK_OK(top_->Step(8).status());
+  EXPECT_FALSE(roi_control_.in_roi());
+  EXPECT_EQ(roi_control_.num_entries(), 1);
+  uint64_t roi_instructions = roi_control_.roi_instructions();
+  EXPECT_GE(roi_instructions, (kRoiEnd - kRoiStart) / sizeof(uint32_t));
+  EXPECT_EQ(roi_instructions, top_->counter_num_instructions()->GetValue());
+  // Execution continues as before.
+  EXPECT_EQ(top_->ReadRegister("c10").value(), 16);
+}
+
+TEST_F(CheriotRoiControlTest, NoStart) {
+  // Without a start address the program starts in the ROI.
+  CHECK_OK(roi_control_.SetRegion(std::nullopt, kRoiEnd));
+  EXPECT_TRUE(roi_control_.in_roi());
+  EXPECT_EQ(roi_control_.num_entries(), 1);
+  CHECK_OK(top_->Step(16).status());
+  EXPECT_FALSE(roi_control_.in_roi());
+  EXPECT_EQ(roi_control_.num_entries(), 1);
+}
+
+}  // namespace
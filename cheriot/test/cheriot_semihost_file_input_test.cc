@@ -0,0 +1,180 @@
+// Copyright 2024 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "cheriot/cheriot_semihost_file_input.h"
+
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <string>
+#include <tuple>
+#include <vector>
+
+#include "absl/log/check.h"
+#include "cheriot/cheriot_register.h"
+#include "cheriot/cheriot_reserved_memory.h"
+#include "cheriot/cheriot_state.h"
+#include "googlemock/include/gmock/gmock.h"
+#include "mpact/sim/generic/data_buffer.h"
+#include "mpact/sim/util/memory/tagged_flat_demand_memory.h"
+
+namespace {
+
+using ::mpact::sim::cheriot::CheriotRegister;
+using ::mpact::sim::cheriot::CheriotReservedMemory;
+using ::mpact::sim::cheriot::CheriotSemihostFileInput;
+using ::mpact::sim::cheriot::CheriotState;
+using ::mpact::sim::generic::DataBufferFactory;
+using ::mpact::sim::util::TaggedFlatDemandMemory;
+
+constexpr uint32_t kBlockAddress = 0x1000;
+constexpr uint32_t kNameAddress = 0x1100;
+constexpr uint32_t kBufferAddress = 0x1'0000;
+// Larger than a chunk, so that the buffered path stores several chunks.
+constexpr int kFileSize = CheriotSemihostFileInput::kChunkSize + 1000;
+
+// Tests are run with and without reserved memory, and with and without
+// mapping the file.
+class CheriotSemihostFileInputTest
+    : public testing::TestWithParam<std::tuple<bool, bool>> {
+ protected:
+  CheriotSemihostFileInputTest()
+      : demand_memory_(8), reserved_memory_(8, &demand_memory_) {
+    bool use_reserved = std::get<0>(GetParam());
+    if (use_reserved) {
+      CHECK_OK(reserved_memory_.Reserve(0, 0x100'0000, false));
+    }
+    memory_ = use_reserved
+                  ? static_cast<mpact::sim::util::TaggedMemoryInterface *>(
+                        &reserved_memory_)
+                  : &demand_memory_;
+    state_ = new CheriotState("test", memory_, nullptr);
+    file_input_ = new CheriotSemihostFileInput(
+        state_, memory_, use_reserved ? &reserved_memory_ : nullptr,
+        std::get<1>(GetParam()));
+    a0_ = state_->GetRegister<CheriotRegister>("c10").first;
+    a1_ = state_->GetRegister<CheriotRegister>("c11").first;
+    // Create the input file.
+    file_name_ = testing::TempDir() + "/semihost_input.bin";
+    contents_.resize(kFileSize);
+    for (int i = 0; i < kFileSize; i++) contents_[i] = (i * 7) & 0xff;
+    std::ofstream file(file_name_, std::ios::binary);
+    file.write(contents_.data(), contents_.size());
+  }
+
+  ~CheriotSemihostFileInputTest() override {
+    delete file_input_;
+    delete state_;
+  }
+
+  // Writes the parameter block, and performs the call. Returns true if it
+  // was handled.
+  bool Call(uint32_t operation, std::vector<uint32_t> parameters) {
+    auto *db = db_factory_.Allocate<uint32_t>(parameters.size());
+    for (int i = 0; i < parameters.size(); i++) {
+      db->Set<uint32_t>(i, parameters[i]);
+    }
+    memory_->Store(kBlockAddress, db);
+    db->DecRef();
+    a0_->data_buffer()->Set<uint32_t>(0, operation);
+    a1_->data_buffer()->Set<uint32_t>(0, kBlockAddress);
+    return file_input_->OnSemihostingCall();
+  }
+
+  // Opens the input file with the given mode.
+  bool Open(uint32_t mode) {
+    auto *db = db_factory_.Allocate<char>(file_name_.size());
+    std::memcpy(db->raw_ptr(), file_name_.data(), file_name_.size());
+    memory_->Store(kNameAddress, db);
+    db->DecRef();
+    return Call(CheriotSemihostFileInput::kSysOpen,
+                {kNameAddress, mode, static_cast<uint32_t>(file_name_.size())});
+  }
+
+  uint32_t result() const { return a0_->address(); }
+
+  DataBufferFactory db_factory_;
+  TaggedFlatDemandMemory demand_memory_;
+  CheriotReservedMemory reserved_memory_;
+  mpact::sim::util::TaggedMemoryInterface *memory_;
+  CheriotState *state_;
+  CheriotSemihostFileInput *file_input_;
+  CheriotRegister *a0_;
+  CheriotRegister *a1_;
+  std::string file_name_;
+  std::string contents_;
+};
+
+TEST_P(CheriotSemihostFileInputTest, Read) {
+  // Set a tag in the buffer, which must be cleared by the read.
+  auto *db = db_factory_.Allocate<uint64_t>(1);
+  auto *tag_db = db_factory_.Allocate<uint8_t>(1);
+  db->Set<uint64_t>(0, 0);
+  tag_db->Set<uint8_t>(0, 1);
+  memory_->Store(kBufferAddress + 8, db, tag_db);
+  EXPECT_EQ(file_input_->num_opened(), 0);
+  ASSERT_TRUE(Open(/*mode=*/1));
+  uint32_t handle = result();
+  EXPECT_GE(handle, CheriotSemihostFileInput::kHandleBase);
+  EXPECT_EQ(file_input_->num_opened(), 1);
+  ASSERT_TRUE(Call(CheriotSemihostFileInput::kSysFlen, {handle}));
+  EXPECT_EQ(result(), kFileSize);
+  // Read the whole file.
+  ASSERT_TRUE(
+      Call(CheriotSemihostFileInput::kSysRead, {handle, kBufferAddress,
+                                                static_cast<uint32_t>(
+                                                    kFileSize)}));
+  EXPECT_EQ(result(), 0);
+  auto *data_db = db_factory_.Allocate<char>(kFileSize);
+  memory_->Load(kBufferAddress, data_db, nullptr, nullptr);
+  EXPECT_EQ(std::memcmp(data_db->raw_ptr(), contents_.data(), kFileSize), 0);
+  data_db->DecRef();
+  memory_->Load(kBufferAddress + 8, nullptr, tag_db, nullptr, nullptr);
+  EXPECT_EQ(tag_db->Get<uint8_t>(0), 0);
+  // Seek near the end, and read past it.
+  ASSERT_TRUE(
+      Call(CheriotSemihostFileInput::kSysSeek, {handle, kFileSize - 10}));
+  EXPECT_EQ(result(), 0);
+  ASSERT_TRUE(
+      Call(CheriotSemihostFileInput::kSysRead, {handle, kBufferAddress, 16}));
+  EXPECT_EQ(result(), 6);
+  memory_->Load(kBufferAddress, db, nullptr, nullptr);
+  uint64_t expected;
+  std::memcpy(&expected, contents_.data() + kFileSize - 10, sizeof(expected));
+  EXPECT_EQ(db->Get<uint64_t>(0), expected);
+  // Close the file. Calls on the handle are no longer handled.
+  ASSERT_TRUE(Call(CheriotSemihostFileInput::kSysClose, {handle}));
+  EXPECT_EQ(result(), 0);
+  EXPECT_FALSE(
+      Call(CheriotSemihostFileInput::kSysRead, {handle, kBufferAddress, 16}));
+  db->DecRef();
+  tag_db->DecRef();
+}
+
+TEST_P(CheriotSemihostFileInputTest, NotHandled) {
+  // Files opened for writing, and unknown handles, are left to the general
+  // semihosting handler.
+  EXPECT_FALSE(Open(/*mode=*/4));
+  EXPECT_FALSE(Call(CheriotSemihostFileInput::kSysRead, {3, 0, 16}));
+  // So is the console.
+  file_name_ = ":tt";
+  EXPECT_FALSE(Open(/*mode=*/0));
+  EXPECT_EQ(file_input_->num_opened(), 0);
+}
+
+INSTANTIATE_TEST_SUITE_P(CheriotSemihostFileInputTests,
+                         CheriotSemihostFileInputTest,
+                         testing::Combine(testing::Bool(), testing::Bool()));
+
+}  // namespace
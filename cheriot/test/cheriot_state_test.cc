@@ -17,6 +17,7 @@
 #include <cstdint>
 #include <iostream>
 #include <string>
+#include <vector>
 
 #include "absl/log/check.h"
 #include "absl/strings/str_format.h"
@@ -125,4 +126,112 @@ TEST(CheriotStateTest, Mshwm) {
   delete mem;
 }
 
+// Verify that PMP checks are applied to memory accesses when enabled, and
+// that cached decisions are dropped when the PMP configuration changes.
+TEST(CheriotStateTest, Pmp) {
+  TaggedFlatDemandMemory mem(8);
+  auto *state = new CheriotState("test", &mem, nullptr);
+  std::vector<uint64_t> exception_codes;
+  state->set_on_trap(
+      [&exception_codes](bool, uint64_t, uint64_t exception_code, uint64_t,
+                         const mpact::sim::riscv::Instruction *) -> bool {
+        exception_codes.push_back(exception_code);
+        return true;
+      });
+  auto *pmpcfg0 = state->csr_set()->GetCsr("pmpcfg0").value();
+  auto *pmpaddr0 = state->csr_set()->GetCsr("pmpaddr0").value();
+  // Locked, read only, 4KiB NAPOT region at 0x1000.
+  pmpaddr0->Set(static_cast<uint32_t>((0x1000 >> 2) | 0x1ff));
+  pmpcfg0->Set(static_cast<uint32_t>(0x80 | (3 << 3) | 0b001));
+  auto *db = state->db_factory()->Allocate<uint32_t>(1);
+  // Nothing is checked until PMP is enabled.
+  state->StoreMemory(nullptr, kMemAddr, db);
+  EXPECT_TRUE(exception_codes.empty());
+  state->set_pmp_enabled(true);
+  state->LoadMemory(nullptr, kMemAddr, db, nullptr, nullptr);
+  EXPECT_TRUE(exception_codes.empty());
+  state->StoreMemory(nullptr, kMemAddr, db);
+  ASSERT_EQ(exception_codes.size(), 1);
+  EXPECT_EQ(exception_codes[0], static_cast<uint64_t>(RVEC::kStoreAccessFault));
+  // Accesses that are partially within the region fail.
+  state->LoadMemory(nullptr, 0x0ffe, db, nullptr, nullptr);
+  ASSERT_EQ(exception_codes.size(), 2);
+  EXPECT_EQ(exception_codes[1], static_cast<uint64_t>(RVEC::kLoadAccessFault));
+  // Machine mode accesses outside of any region are permitted.
+  state->StoreMemory(nullptr, 0x2000, db);
+  EXPECT_EQ(exception_codes.size(), 2);
+  // Make the region writable.
+  pmpcfg0->Set(static_cast<uint32_t>(0x80 | (3 << 3) | 0b011));
+  state->pmp_checker()->Invalidate();
+  state->StoreMemory(nullptr, kMemAddr, db);
+  EXPECT_EQ(exception_codes.size(), 2);
+  db->DecRef();
+  delete state;
+}
+
+// Verify that stores to the revocation bitmap, scalar or vector, count the
+// revocation bits they set and clear, and that other accesses do not.
+TEST(CheriotStateTest, RevocationCounters) {
+  TaggedFlatDemandMemory mem(8);
+  auto *state = new CheriotState("test", &mem, nullptr);
+  uint64_t bitmap = state->revocation_mem_base();
+  auto *set = state->counter_revocation_bits_set();
+  auto *cleared = state->counter_revocation_bits_cleared();
+  auto *db = state->db_factory()->Allocate<uint8_t>(1);
+  db->Set<uint8_t>(0, 0x0f);
+  state->StoreMemory(nullptr, bitmap, db);
+  EXPECT_EQ(set->GetValue(), 4);
+  EXPECT_EQ(cleared->GetValue(), 0);
+  EXPECT_TRUE(state->MustRevoke(state->revocation_ram_base()));
+  db->Set<uint8_t>(0, 0x03);
+  state->StoreMemory(nullptr, bitmap, db);
+  EXPECT_EQ(set->GetValue(), 4);
+  EXPECT_EQ(cleared->GetValue(), 2);
+  // Loads and stores outside of the bitmap are not counted.
+  state->LoadMemory(nullptr, bitmap, db, nullptr, nullptr);
+  db->Set<uint8_t>(0, 0xff);
+  state->StoreMemory(nullptr, kMemAddr, db);
+  EXPECT_EQ(set->GetValue(), 4);
+  EXPECT_EQ(cleared->GetValue(), 2);
+  db->DecRef();
+  // Only the active elements of a vector store are counted.
+  auto *address_db = state->db_factory()->Allocate<uint64_t>(3);
+  auto *mask_db = state->db_factory()->Allocate<bool>(3);
+  auto *data_db = state->db_factory()->Allocate<uint16_t>(3);
+  for (int i = 0; i < 3; i++) {
+    address_db->Set<uint64_t>(i, bitmap + 2 * i);
+    mask_db->Set<bool>(i, i != 1);
+    data_db->Set<uint16_t>(i, 0x0101);
+  }
+  state->StoreMemory(nullptr, address_db, mask_db, sizeof(uint16_t), data_db);
+  // Element 0 clears bit 1 of the first byte and sets bit 0 of the second,
+  // element 2 sets bit 0 of the fifth and sixth bytes.
+  EXPECT_EQ(set->GetValue(), 7);
+  EXPECT_EQ(cleared->GetValue(), 3);
+  EXPECT_EQ(state->counter_revoked_on_load()->GetValue(), 0);
+  address_db->DecRef();
+  mask_db->DecRef();
+  data_db->DecRef();
+  delete state;
+}
+
+// Verify that the old revocation bits are read from the uncached memory when
+// one is set, not from the memory port that a cache model is hooked into.
+TEST(CheriotStateTest, RevocationCountersUncached) {
+  TaggedFlatDemandMemory port(8);
+  TaggedFlatDemandMemory backing(8);
+  auto *state = new CheriotState("test", &port, nullptr);
+  state->set_uncached_memory(&backing);
+  uint64_t bitmap = state->revocation_mem_base();
+  auto *db = state->db_factory()->Allocate<uint8_t>(1);
+  db->Set<uint8_t>(0, 0xff);
+  backing.Store(bitmap, db);
+  db->Set<uint8_t>(0, 0x0f);
+  state->StoreMemory(nullptr, bitmap, db);
+  EXPECT_EQ(state->counter_revocation_bits_set()->GetValue(), 0);
+  EXPECT_EQ(state->counter_revocation_bits_cleared()->GetValue(), 4);
+  db->DecRef();
+  delete state;
+}
+
 }  // namespace
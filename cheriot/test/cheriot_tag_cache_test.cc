@@ -0,0 +1,116 @@
+// Copyright 2024 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "cheriot/cheriot_tag_cache.h"
+
+#include "absl/log/check.h"
+#include "cheriot/cheriot_decoder.h"
+#include "cheriot/cheriot_state.h"
+#include "cheriot/cheriot_top.h"
+#include "googlemock/include/gmock/gmock.h"
+#include "mpact/sim/proto/component_data.pb.h"
+#include "mpact/sim/util/memory/tagged_flat_demand_memory.h"
+
+namespace {
+
+using ::mpact::sim::cheriot::CheriotDecoder;
+using ::mpact::sim::cheriot::CheriotState;
+using ::mpact::sim::cheriot::CheriotTagCache;
+using ::mpact::sim::cheriot::CheriotTop;
+using ::mpact::sim::proto::ComponentValueEntry;
+using ::mpact::sim::util::TaggedFlatDemandMemory;
+
+// 2 sets of 2 ways, each line covering 512 bytes of data memory.
+constexpr char kConfig[] = "32,512,2";
+
+TEST(CheriotTagCacheTest, Configure) {
+  CheriotTagCache cache("tagcache");
+  EXPECT_FALSE(cache.Configure("32,512").ok());
+  EXPECT_FALSE(cache.Configure("32,500,2").ok());
+  EXPECT_FALSE(cache.Configure("32,32,2").ok());
+  EXPECT_FALSE(cache.Configure("8,512,2").ok());
+  EXPECT_FALSE(cache.is_configured());
+  EXPECT_TRUE(cache.Configure(kConfig).ok());
+  EXPECT_TRUE(cache.is_configured());
+  EXPECT_EQ(cache.num_sets(), 2);
+  EXPECT_EQ(cache.num_ways(), 2);
+  EXPECT_EQ(cache.line_coverage(), 512);
+  EXPECT_FALSE(cache.Configure(kConfig).ok());
+}
+
+// A tag cache with an invalid configuration is not attached to the top, so
+// that the error can be detected, and a valid configuration can follow.
+TEST(CheriotTagCacheTest, TopConfigure) {
+  TaggedFlatDemandMemory memory(8);
+  CheriotState state("test", &memory, nullptr);
+  CheriotDecoder decoder(&state, &memory);
+  CheriotTop top("test", &state, &decoder);
+  ComponentValueEntry value;
+  value.set_name("tagcache");
+  value.set_string_value("32,500,2");
+  CHECK_OK(top.GetConfig("tagcache")->Import(&value));
+  EXPECT_EQ(top.tag_cache(), nullptr);
+  value.set_string_value(kConfig);
+  CHECK_OK(top.GetConfig("tagcache")->Import(&value));
+  ASSERT_NE(top.tag_cache(), nullptr);
+  EXPECT_TRUE(top.tag_cache()->is_configured());
+}
+
+TEST(CheriotTagCacheTest, ReadHitsAndMisses) {
+  CheriotTagCache cache("tagcache");
+  CHECK_OK(cache.Configure(kConfig));
+  cache.ReadTags(0x1000, 8);
+  cache.ReadTags(0x1008, 8);
+  cache.ReadTags(0x11f8, 8);
+  EXPECT_EQ(cache.counter_read_misses()->GetValue(), 1);
+  EXPECT_EQ(cache.counter_read_hits()->GetValue(), 2);
+  // An access that straddles two lines accesses both.
+  cache.ReadTags(0x13fc, 8);
+  EXPECT_EQ(cache.counter_read_misses()->GetValue(), 3);
+}
+
+TEST(CheriotTagCacheTest, LruReplacementAndWriteback) {
+  CheriotTagCache cache("tagcache");
+  CHECK_OK(cache.Configure(kConfig));
+  // Lines 0x0000, 0x0400 and 0x0800 all map to set 0.
+  cache.WriteTags(0x0000, 4);
+  cache.ReadTags(0x0400, 8);
+  // Make 0x0000 the most recently used line.
+  cache.ReadTags(0x0000, 8);
+  EXPECT_EQ(cache.counter_write_misses()->GetValue(), 1);
+  EXPECT_EQ(cache.counter_read_hits()->GetValue(), 1);
+  // Evicts the clean line 0x0400.
+  cache.ReadTags(0x0800, 8);
+  EXPECT_EQ(cache.counter_writebacks()->GetValue(), 0);
+  // Evicts the dirty line 0x0000.
+  cache.ReadTags(0x0400, 8);
+  EXPECT_EQ(cache.counter_writebacks()->GetValue(), 1);
+  cache.ReadTags(0x0800, 8);
+  EXPECT_EQ(cache.counter_read_hits()->GetValue(), 2);
+}
+
+TEST(CheriotTagCacheTest, RevocationLookups) {
+  CheriotTagCache cache("tagcache");
+  CHECK_OK(cache.Configure(kConfig));
+  cache.ReadTags(0x1000, 8);
+  // Revocation bitmap lines are separate from tag lines.
+  cache.LookupRevocationBit(0x1000);
+  cache.LookupRevocationBit(0x1010);
+  EXPECT_EQ(cache.counter_revocation_misses()->GetValue(), 1);
+  EXPECT_EQ(cache.counter_revocation_hits()->GetValue(), 1);
+  EXPECT_EQ(cache.counter_read_misses()->GetValue(), 1);
+  EXPECT_EQ(cache.counter_read_hits()->GetValue(), 0);
+}
+
+}  // namespace
@@ -0,0 +1,92 @@
+// Copyright 2024 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef MPACT_CHERIOT_TEST_CHERIOT_TEST_INSTANCE_H_
+#define MPACT_CHERIOT_TEST_CHERIOT_TEST_INSTANCE_H_
+
+#include <cstdint>
+
+#include "absl/log/check.h"
+#include "cheriot/cheriot_decoder.h"
+#include "cheriot/cheriot_state.h"
+#include "cheriot/cheriot_top.h"
+#include "mpact/sim/generic/data_buffer.h"
+#include "mpact/sim/util/memory/tagged_flat_demand_memory.h"
+
+// This file defines a small simulator instance for the tests of the classes
+// that drive a CheriotTop. The memory holds a program of increments of a0
+// starting at kPc, and the pcc is set to the start of the program.
+
+namespace mpact {
+namespace sim {
+namespace cheriot {
+namespace test {
+
+inline constexpr uint64_t kPc = 0x1000;
+// addi a0, a0, 1
+inline constexpr uint32_t kAddiA0 = 0x0015'0513;
+// j 0
+inline constexpr uint32_t kJSelf = 0x0000'006f;
+
+class CheriotTestInstance {
+ public:
+  // The fast paths of the decoder and the pmp checker can be disabled, as they
+  // are for the reference of a lockstep run.
+  explicit CheriotTestInstance(int num_instructions, bool fast_paths = true)
+      : memory_(8),
+        state_("test", &memory_, nullptr),
+        decoder_(&state_, &memory_),
+        top_("test", &state_, &decoder_) {
+    generic::DataBufferFactory db_factory;
+    auto *db = db_factory.Allocate<uint32_t>(num_instructions);
+    for (int i = 0; i < num_instructions; i++) db->Set<uint32_t>(i, kAddiA0);
+    memory_.Store(kPc, db);
+    db->DecRef();
+    if (!fast_paths) {
+      decoder_.DisableFastPaths();
+      state_.pmp_checker()->set_cache_enabled(false);
+    }
+    CHECK_OK(top_.WriteRegister("pcc", kPc));
+  }
+  CheriotTestInstance(const CheriotTestInstance &) = delete;
+  CheriotTestInstance &operator=(const CheriotTestInstance &) = delete;
+
+  // Stores a word to memory, e.g., to replace an instruction of the program.
+  // This bypasses the top, so it must be done before the program is run.
+  void StoreWord(uint64_t address, uint32_t word) {
+    generic::DataBufferFactory db_factory;
+    auto *db = db_factory.Allocate<uint32_t>(1);
+    db->Set<uint32_t>(0, word);
+    memory_.Store(address, db);
+    db->DecRef();
+  }
+
+  util::TaggedFlatDemandMemory *memory() { return &memory_; }
+  CheriotState *state() { return &state_; }
+  CheriotDecoder *decoder() { return &decoder_; }
+  CheriotTop *top() { return &top_; }
+
+ private:
+  util::TaggedFlatDemandMemory memory_;
+  CheriotState state_;
+  CheriotDecoder decoder_;
+  CheriotTop top_;
+};
+
+}  // namespace test
+}  // namespace cheriot
+}  // namespace sim
+}  // namespace mpact
+
+#endif  // MPACT_CHERIOT_TEST_CHERIOT_TEST_INSTANCE_H_
@@ -0,0 +1,148 @@
+// Copyright 2024 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "cheriot/cheriot_top.h"
+
+#include <unistd.h>
+
+#include <atomic>
+#include <cerrno>
+#include <chrono>  // NOLINT: used to delay a completion callback.
+#include <cstdint>
+#include <thread>  // NOLINT: used to delay a completion callback.
+#include <vector>
+
+#include "absl/log/check.h"
+#include "cheriot/test/cheriot_test_instance.h"
+#include "googlemock/include/gmock/gmock.h"
+#include "mpact/sim/generic/core_debug_interface.h"
+#include "mpact/sim/generic/type_helpers.h"
+
+namespace {
+
+using ::mpact::sim::cheriot::CheriotTop;
+using ::mpact::sim::cheriot::test::CheriotTestInstance;
+using ::mpact::sim::cheriot::test::kJSelf;
+using ::mpact::sim::cheriot::test::kPc;
+using ::mpact::sim::generic::operator*;  // NOLINT: used below (clang error).
+using HaltReason = ::mpact::sim::generic::CoreDebugInterface::HaltReason;
+using RunResult = CheriotTop::RunResult;
+using RunStatus = CheriotTop::RunStatus;
+
+// The program is a sequence of increments of a0 followed by an endless loop.
+constexpr int kLoopIndex = 32;
+
+class CheriotTopTest : public testing::Test {
+ protected:
+  CheriotTopTest() : instance_(kLoopIndex + 1), top_(instance_.top()) {
+    instance_.StoreWord(kPc + kLoopIndex * sizeof(uint32_t), kJSelf);
+  }
+
+  CheriotTestInstance instance_;
+  CheriotTop *top_;
+};
+
+TEST_F(CheriotTopTest, RunAsyncCallback) {
+  std::vector<RunResult> results;
+  CHECK_OK(top_->RunAsync(
+      /*max_instructions=*/16,
+      [&results](const RunResult &result) { results.push_back(result); }));
+  CHECK_OK(top_->Wait());
+  // The callback has returned once Wait() returns.
+  ASSERT_EQ(results.size(), 1);
+  EXPECT_EQ(results[0].halt_reason, CheriotTop::kInstructionLimit);
+  EXPECT_EQ(results[0].num_instructions, 16);
+  EXPECT_GE(results[0].num_cycles, 16);
+  EXPECT_EQ(top_->GetRunStatus().value(), RunStatus::kHalted);
+  EXPECT_EQ(top_->GetLastHaltReason().value(), CheriotTop::kInstructionLimit);
+  EXPECT_EQ(top_->ReadRegister("c10").value(), 16);
+  // Waiting again returns immediately.
+  CHECK_OK(top_->Wait());
+}
+
+// A run started by a completion callback is also waited for.
+TEST_F(CheriotTopTest, CallbackStartsRun) {
+  std::vector<RunResult> results;
+  CHECK_OK(top_->RunAsync(
+      /*max_instructions=*/16, [this, &results](const RunResult &result) {
+        results.push_back(result);
+        CHECK_OK(top_->RunAsync(
+            /*max_instructions=*/8, [&results](const RunResult &result) {
+              results.push_back(result);
+            }));
+      }));
+  CHECK_OK(top_->Wait());
+  ASSERT_EQ(results.size(), 2);
+  EXPECT_EQ(results[1].num_instructions, 8);
+  EXPECT_EQ(top_->GetRunStatus().value(), RunStatus::kHalted);
+  EXPECT_EQ(top_->ReadRegister("c10").value(), 24);
+}
+
+TEST_F(CheriotTopTest, CancelRun) {
+  std::atomic<int> num_callbacks = 0;
+  CHECK_OK(top_->RunAsync(/*max_instructions=*/0,
+                          [&num_callbacks](const RunResult &result) {
+                            EXPECT_EQ(result.halt_reason,
+                                      *HaltReason::kUserRequest);
+                            num_callbacks++;
+                          }));
+  // A second run cannot be started while running.
+  EXPECT_FALSE(top_->RunAsync(0, nullptr).ok());
+  CHECK_OK(top_->CancelRun());
+  CHECK_OK(top_->Wait());
+  EXPECT_EQ(num_callbacks, 1);
+  EXPECT_EQ(top_->GetLastHaltReason().value(), *HaltReason::kUserRequest);
+  // The run may be cancelled anywhere before or in the loop at the end of the
+  // program, so only check that it did not run past it.
+  EXPECT_LE(top_->ReadRegister("c10").value(), kLoopIndex);
+  // Cancelling when halted does nothing.
+  CHECK_OK(top_->CancelRun());
+  CHECK_OK(top_->RunAsync(/*max_instructions=*/4, nullptr));
+  CHECK_OK(top_->Wait());
+  EXPECT_EQ(top_->GetLastHaltReason().value(), CheriotTop::kInstructionLimit);
+}
+
+TEST_F(CheriotTopTest, RunEventFd) {
+  auto fd_res = top_->GetRunEventFd();
+  CHECK_OK(fd_res.status());
+  int fd = fd_res.value();
+  // The same eventfd is returned each time.
+  EXPECT_EQ(top_->GetRunEventFd().value(), fd);
+  uint64_t count = 0;
+  // The eventfd is non-blocking, and is not signaled before a run completes.
+  EXPECT_EQ(read(fd, &count, sizeof(count)), -1);
+  EXPECT_EQ(errno, EAGAIN);
+  for (int i = 0; i < 2; i++) {
+    CHECK_OK(top_->RunAsync(/*max_instructions=*/4, nullptr));
+    CHECK_OK(top_->Wait());
+  }
+  ASSERT_EQ(read(fd, &count, sizeof(count)), sizeof(count));
+  EXPECT_EQ(count, 2);
+}
+
+// The destructor waits for the completion callback to return.
+TEST_F(CheriotTopTest, DestructorWaitsForCallback) {
+  std::atomic<bool> callback_done = false;
+  CHECK_OK(top_->RunAsync(/*max_instructions=*/4,
+                          [&callback_done](const RunResult &) {
+                            std::this_thread::sleep_for(
+                                std::chrono::milliseconds(10));
+                            callback_done = true;
+                          }));
+  delete top_;
+  top_ = nullptr;
+  EXPECT_TRUE(callback_done);
+}
+
+}  // namespace
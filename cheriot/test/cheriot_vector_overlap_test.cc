@@ -0,0 +1,297 @@
+// Copyright 2024 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "cheriot/cheriot_vector_overlap.h"
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "absl/strings/str_cat.h"
+#include "absl/types/span.h"
+#include "cheriot/cheriot_state.h"
+#include "cheriot/cheriot_vector_state.h"
+#include "cheriot/cheriot_vector_true_operand.h"
+#include "cheriot/riscv_cheriot_vector_opi_instructions.h"
+#include "googlemock/include/gmock/gmock.h"
+#include "mpact/sim/generic/data_buffer.h"
+#include "mpact/sim/generic/instruction.h"
+#include "mpact/sim/generic/register.h"
+#include "mpact/sim/util/memory/tagged_flat_demand_memory.h"
+#include "riscv//riscv_register.h"
+
+namespace {
+
+using ::mpact::sim::cheriot::CanUpdateDestinationInPlace;
+using ::mpact::sim::cheriot::CheriotRegister;
+using ::mpact::sim::cheriot::CheriotState;
+using ::mpact::sim::cheriot::CheriotVectorState;
+using ::mpact::sim::cheriot::CheriotVectorTrueOperand;
+using ::mpact::sim::cheriot::GetVectorOverlapInfo;
+using ::mpact::sim::cheriot::Vadc;
+using ::mpact::sim::cheriot::VectorOverlapTable;
+using ::mpact::sim::cheriot::VectorRegisterOverlap;
+using ::mpact::sim::generic::DataBuffer;
+using ::mpact::sim::generic::Instruction;
+using ::mpact::sim::generic::RegisterBase;
+using ::mpact::sim::riscv::RV32VectorDestinationOperand;
+using ::mpact::sim::riscv::RV32VectorSourceOperand;
+using ::mpact::sim::riscv::RVVectorRegister;
+using ::mpact::sim::util::TaggedFlatDemandMemory;
+
+constexpr int kVLengthInBytes = 64;
+constexpr int kElementsPerVector = kVLengthInBytes / sizeof(uint32_t);
+// Vtype for sew 32 and lmul 1.
+constexpr uint32_t kVtypeSew32 = 0b010'000;
+
+class CheriotVectorOverlapTest : public testing::Test {
+ protected:
+  CheriotVectorOverlapTest() : memory_(8) {
+    state_ = new CheriotState("test", &memory_);
+    vstate_ = new CheriotVectorState(state_, kVLengthInBytes);
+    table_ = new VectorOverlapTable(state_);
+    inst_ = new Instruction(0x1000, state_);
+  }
+  ~CheriotVectorOverlapTest() override {
+    inst_->DecRef();
+    delete table_;
+    delete state_;
+    delete vstate_;
+  }
+
+  RVVectorRegister *GetVreg(int reg_num) {
+    return state_
+        ->GetRegister<RVVectorRegister>(
+            absl::StrCat(CheriotState::kVregPrefix, reg_num))
+        .first;
+  }
+
+  // Sets up inst_ as vadc.vvm vd, vs2, vs1, v0 with sew 32 and lmul 1, and
+  // initializes vs2 to i, vs1 to 100 * i and the carry mask v0 to 0b0101...
+  void SetUpVadc(int vd, int vs2, int vs1) {
+    inst_->set_semantic_function(&Vadc);
+    AppendVectorSource(vs2, 8);
+    AppendVectorSource(vs1, 8);
+    AppendVectorSource(0, 1);
+    AppendVectorDestination(vd, 8);
+    for (int i = 0; i < kElementsPerVector; i++) {
+      GetVreg(vs2)->data_buffer()->Set<uint32_t>(i, i);
+      GetVreg(vs1)->data_buffer()->Set<uint32_t>(i, 100 * i);
+    }
+    for (int i = 0; i < kVLengthInBytes; i++) {
+      GetVreg(0)->data_buffer()->Set<uint8_t>(i, 0x55);
+    }
+    vstate_->SetVectorType(kVtypeSew32);
+    vstate_->set_vector_length(kElementsPerVector);
+  }
+
+  // Checks the result of the vadc set up by SetUpVadc.
+  void CheckVadc(int vd) {
+    EXPECT_FALSE(vstate_->vector_exception());
+    auto *db = GetVreg(vd)->data_buffer();
+    for (int i = 0; i < kElementsPerVector; i++) {
+      EXPECT_EQ(db->Get<uint32_t>(i), 101 * i + ((i & 1) == 0 ? 1 : 0))
+          << "element " << i;
+    }
+  }
+
+  std::vector<RegisterBase *> GetGroup(int reg_num, int size) {
+    std::vector<RegisterBase *> group;
+    for (int i = 0; i < size; i++) {
+      group.push_back(state_
+                          ->GetRegister<RVVectorRegister>(
+                              absl::StrCat(CheriotState::kVregPrefix,
+                                           reg_num + i))
+                          .first);
+    }
+    return group;
+  }
+
+  void AppendVectorSource(int reg_num, int size) {
+    auto group = GetGroup(reg_num, size);
+    inst_->AppendSource(new RV32VectorSourceOperand(
+        absl::Span<RegisterBase *>(group),
+        absl::StrCat(CheriotState::kVregPrefix, reg_num)));
+  }
+
+  void AppendVectorDestination(int reg_num, int size) {
+    auto group = GetGroup(reg_num, size);
+    inst_->AppendDestination(new RV32VectorDestinationOperand(
+        absl::Span<RegisterBase *>(group), 0,
+        absl::StrCat(CheriotState::kVregPrefix, reg_num)));
+  }
+
+  TaggedFlatDemandMemory memory_;
+  CheriotState *state_;
+  CheriotVectorState *vstate_;
+  VectorOverlapTable *table_;
+  Instruction *inst_;
+};
+
+// Disjoint register groups.
+TEST_F(CheriotVectorOverlapTest, NoOverlap) {
+  AppendVectorSource(16, 8);
+  AppendVectorSource(24, 8);
+  inst_->AppendSource(new CheriotVectorTrueOperand(state_));
+  AppendVectorDestination(8, 8);
+  table_->Annotate(inst_);
+  auto *info = GetVectorOverlapInfo(inst_);
+  ASSERT_NE(info, nullptr);
+  EXPECT_EQ(info->source(0), VectorRegisterOverlap::kNone);
+  EXPECT_EQ(info->source(1), VectorRegisterOverlap::kNone);
+  EXPECT_EQ(info->source(2), VectorRegisterOverlap::kNone);
+  EXPECT_EQ(info->summary(), VectorRegisterOverlap::kNone);
+  EXPECT_EQ(info->dest_size(), 8);
+  EXPECT_EQ(info->dest_register(0),
+            state_->GetRegister<RVVectorRegister>("v8").first);
+  EXPECT_TRUE(CanUpdateDestinationInPlace(inst_, false));
+}
+
+// The destination is the same register group as a source.
+TEST_F(CheriotVectorOverlapTest, ExactOverlap) {
+  AppendVectorSource(8, 8);
+  AppendVectorSource(24, 8);
+  AppendVectorDestination(8, 8);
+  table_->Annotate(inst_);
+  auto *info = GetVectorOverlapInfo(inst_);
+  ASSERT_NE(info, nullptr);
+  EXPECT_EQ(info->source(0), VectorRegisterOverlap::kExact);
+  EXPECT_EQ(info->source(1), VectorRegisterOverlap::kNone);
+  EXPECT_EQ(info->summary(), VectorRegisterOverlap::kExact);
+  EXPECT_TRUE(CanUpdateDestinationInPlace(inst_, true));
+  EXPECT_FALSE(CanUpdateDestinationInPlace(inst_, false));
+}
+
+// The destination group partially overlaps a source group.
+TEST_F(CheriotVectorOverlapTest, PartialOverlap) {
+  AppendVectorSource(12, 4);
+  // Mask register that is the first register of the destination group.
+  AppendVectorSource(8, 1);
+  AppendVectorDestination(8, 8);
+  table_->Annotate(inst_);
+  auto *info = GetVectorOverlapInfo(inst_);
+  ASSERT_NE(info, nullptr);
+  EXPECT_EQ(info->source(0), VectorRegisterOverlap::kPartial);
+  EXPECT_EQ(info->source(1), VectorRegisterOverlap::kPartial);
+  EXPECT_EQ(info->summary(), VectorRegisterOverlap::kPartial);
+  EXPECT_FALSE(CanUpdateDestinationInPlace(inst_, true));
+}
+
+// Instructions without a vector destination are not annotated.
+TEST_F(CheriotVectorOverlapTest, ScalarDestination) {
+  AppendVectorSource(8, 8);
+  auto *reg = state_->GetRegister<CheriotRegister>("c1").first;
+  inst_->AppendDestination(reg->CreateDestinationOperand(0));
+  table_->Annotate(inst_);
+  EXPECT_EQ(GetVectorOverlapInfo(inst_), nullptr);
+  EXPECT_FALSE(CanUpdateDestinationInPlace(inst_, true));
+}
+
+// The overlap properties are still available after the instruction has been
+// executed, which replaces the instruction's context.
+TEST_F(CheriotVectorOverlapTest, InfoKeptOnExecute) {
+  SetUpVadc(/*vd=*/8, /*vs2=*/16, /*vs1=*/24);
+  table_->Annotate(inst_);
+  inst_->Execute(nullptr);
+  EXPECT_NE(GetVectorOverlapInfo(inst_), nullptr);
+  inst_->Execute(nullptr);
+  EXPECT_NE(GetVectorOverlapInfo(inst_), nullptr);
+  EXPECT_EQ(table_->size(), 1);
+}
+
+// Without overlap, the destination register's data buffer is updated in
+// place, so the register keeps its data buffer.
+TEST_F(CheriotVectorOverlapTest, ExecuteInPlace) {
+  SetUpVadc(/*vd=*/8, /*vs2=*/16, /*vs1=*/24);
+  table_->Annotate(inst_);
+  DataBuffer *db = GetVreg(8)->data_buffer();
+  inst_->Execute(nullptr);
+  EXPECT_EQ(GetVreg(8)->data_buffer(), db);
+  CheckVadc(8);
+}
+
+// The destination is the same register group as vs2, and is also updated in
+// place, as each element only depends on the source element with the same
+// index.
+TEST_F(CheriotVectorOverlapTest, ExecuteInPlaceExactOverlap) {
+  SetUpVadc(/*vd=*/16, /*vs2=*/16, /*vs1=*/24);
+  table_->Annotate(inst_);
+  DataBuffer *db = GetVreg(16)->data_buffer();
+  inst_->Execute(nullptr);
+  EXPECT_EQ(GetVreg(16)->data_buffer(), db);
+  CheckVadc(16);
+}
+
+// With the table disabled, the destination is written to a copy even if it
+// doesn't overlap the sources.
+TEST_F(CheriotVectorOverlapTest, ExecuteCopyDisabled) {
+  SetUpVadc(/*vd=*/8, /*vs2=*/16, /*vs1=*/24);
+  table_->Annotate(inst_);
+  table_->set_enabled(false);
+  EXPECT_EQ(table_->size(), 0);
+  table_->Annotate(inst_);
+  EXPECT_EQ(GetVectorOverlapInfo(inst_), nullptr);
+  DataBuffer *db = GetVreg(8)->data_buffer();
+  inst_->Execute(nullptr);
+  EXPECT_NE(GetVreg(8)->data_buffer(), db);
+  CheckVadc(8);
+}
+
+// A partially overlapping destination is written to a copy of the register's
+// data buffer, which is then submitted to the register.
+TEST_F(CheriotVectorOverlapTest, ExecuteCopyPartialOverlap) {
+  SetUpVadc(/*vd=*/8, /*vs2=*/12, /*vs1=*/24);
+  table_->Annotate(inst_);
+  EXPECT_FALSE(CanUpdateDestinationInPlace(inst_, true));
+  DataBuffer *db = GetVreg(8)->data_buffer();
+  inst_->Execute(nullptr);
+  EXPECT_NE(GetVreg(8)->data_buffer(), db);
+  CheckVadc(8);
+}
+
+// A destination register whose data buffer is shared is not updated in place,
+// so the other reference sees the old contents.
+TEST_F(CheriotVectorOverlapTest, ExecuteCopySharedDataBuffer) {
+  SetUpVadc(/*vd=*/8, /*vs2=*/16, /*vs1=*/24);
+  table_->Annotate(inst_);
+  DataBuffer *db = GetVreg(8)->data_buffer();
+  db->Set<uint32_t>(0, 0xdead'beef);
+  db->IncRef();
+  inst_->Execute(nullptr);
+  EXPECT_NE(GetVreg(8)->data_buffer(), db);
+  EXPECT_EQ(db->Get<uint32_t>(0), 0xdead'beef);
+  db->DecRef();
+  CheckVadc(8);
+}
+
+// Instructions that are only referenced by the table are dropped once it
+// grows, while annotated instructions still in use are kept.
+TEST_F(CheriotVectorOverlapTest, Sweep) {
+  AppendVectorSource(16, 8);
+  AppendVectorDestination(8, 8);
+  table_->Annotate(inst_);
+  for (int i = 0; i < 2048; i++) {
+    auto *inst = new Instruction(0x2000 + 4 * i, state_);
+    auto group = GetGroup(8, 8);
+    inst->AppendDestination(new RV32VectorDestinationOperand(
+        absl::Span<RegisterBase *>(group), 0,
+        absl::StrCat(CheriotState::kVregPrefix, 8)));
+    table_->Annotate(inst);
+    inst->DecRef();
+  }
+  EXPECT_LT(table_->size(), 2048);
+  EXPECT_NE(GetVectorOverlapInfo(inst_), nullptr);
+}
+
+}  // namespace
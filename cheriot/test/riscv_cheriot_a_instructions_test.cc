@@ -24,7 +24,9 @@
 
 #include "absl/log/check.h"
 #include "absl/strings/string_view.h"
+#include "cheriot/cheriot_address_ranges.h"
 #include "cheriot/cheriot_register.h"
+#include "cheriot/cheriot_reserved_memory.h"
 #include "cheriot/cheriot_state.h"
 #include "cheriot/riscv_cheriot_i_instructions.h"
 #include "googlemock/include/gmock/gmock.h"
@@ -36,7 +38,9 @@
 
 namespace {
 
+using ::mpact::sim::cheriot::CheriotAddressRanges;
 using ::mpact::sim::cheriot::CheriotRegister;
+using ::mpact::sim::cheriot::CheriotReservedMemory;
 using ::mpact::sim::cheriot::CheriotState;
 using ::mpact::sim::generic::DataBuffer;
 using ::mpact::sim::generic::Instruction;
@@ -362,4 +366,52 @@ TEST_F(RiscVAInstructionsTest, AAmominuw) {
       << std::hex << db_w_->Get<uint32_t>(0);
 }
 
+// Atomic memory operations on host backed memory are performed in place, and
+// clear the tag of the granule.
+TEST_F(RiscVAInstructionsTest, AmoHostMemory) {
+  CheriotReservedMemory reserved(8, memory_);
+  CHECK_OK(reserved.Reserve(0, 0x1'0000, /*use_huge_pages=*/false));
+  auto *tag_db = state_->db_factory()->Allocate<uint8_t>(1);
+  tag_db->Set<uint8_t>(0, 1);
+  reserved.Store(kWMemAddress, db_w_, tag_db);
+  state_->set_amo_memory(&reserved);
+  AppendRegisterOperands({kX1, kX2, kX4, kX5}, {});
+  AppendRegisterOperands(child_instruction_, {}, {kX3});
+  SetRegisterValues<uint32_t>(
+      {{kX1, kWMemAddress}, {kX2, kWA5}, {kX3, 0}, {kX4, 0}, {kX5, 0}});
+  SetSemanticFunction(&AAmomaxw);
+  SetChildSemanticFunction(&RiscVILwChild);
+  instruction_->Execute();
+  // The memory value should now be in the register.
+  EXPECT_EQ(GetRegisterValue<uint32_t>(kX3), kWRegContent)
+      << std::hex << GetRegisterValue<uint32_t>(kX3);
+  // The memory location will have the new value, and the tag is cleared.
+  reserved.Load(kWMemAddress, db_w_, tag_db, nullptr, nullptr);
+  EXPECT_EQ(db_w_->Get<int32_t>(0), std::max(static_cast<int32_t>(kWMemContent),
+                                             static_cast<int32_t>(kWA5)))
+      << std::hex << db_w_->Get<uint32_t>(0);
+  EXPECT_EQ(tag_db->Get<uint8_t>(0), 0);
+  tag_db->DecRef();
+  state_->set_amo_memory(nullptr);
+}
+
+// Excluded ranges and misaligned addresses take the regular path.
+TEST_F(RiscVAInstructionsTest, AmoHostPointer) {
+  CheriotReservedMemory reserved(8, memory_);
+  CHECK_OK(reserved.Reserve(0, 0x1'0000, /*use_huge_pages=*/false));
+  EXPECT_EQ(state_->GetAmoHostPointer(kWMemAddress, 4), nullptr);
+  state_->set_amo_memory(&reserved);
+  EXPECT_NE(state_->GetAmoHostPointer(kWMemAddress, 4), nullptr);
+  EXPECT_EQ(state_->GetAmoHostPointer(kWMemAddress + 2, 4), nullptr);
+  EXPECT_EQ(state_->GetAmoHostPointer(0x1'0000, 4), nullptr);
+  CheriotAddressRanges ranges;
+  ranges.Add(kWMemAddress, kWMemAddress + 0xff);
+  state_->set_amo_excluded_ranges(ranges);
+  EXPECT_EQ(state_->GetAmoHostPointer(kWMemAddress, 4), nullptr);
+  EXPECT_NE(state_->GetAmoHostPointer(kWMemAddress + 0x100, 4), nullptr);
+  state_->set_amo_direct_enabled(false);
+  EXPECT_EQ(state_->GetAmoHostPointer(kWMemAddress + 0x100, 4), nullptr);
+  state_->set_amo_memory(nullptr);
+}
+
 }  // namespace
@@ -15,8 +15,10 @@
 #include "cheriot/riscv_cheriot_encoding.h"
 
 #include <cstdint>
+#include <random>
 
 #include "cheriot/cheriot_state.h"
+#include "cheriot/riscv_cheriot_bin_decoder.h"
 #include "cheriot/riscv_cheriot_enums.h"
 #include "googlemock/include/gmock/gmock.h"
 #include "mpact/sim/generic/type_helpers.h"
@@ -25,6 +27,8 @@
 namespace {
 
 using ::mpact::sim::cheriot::CheriotState;
+using ::mpact::sim::cheriot::encoding::DecodeRiscVCheriotInst16WithFormat;
+using ::mpact::sim::cheriot::encoding::DecodeRiscVCheriotInst32WithFormat;
 using ::mpact::sim::cheriot::isa32::kOpcodeNames;
 using ::mpact::sim::cheriot::isa32::RiscVCheriotEncoding;
 using ::mpact::sim::generic::operator*;  // NOLINT: is used below (clang error).
@@ -605,9 +609,17 @@ TEST_F(RiscVCheriotEncodingTest, RiscVCheriotOpcodes) {
             OpcodeEnum::kCheriotSpecialr)
       << kOpcodeNames[*enc_->GetOpcode(SlotEnum::kRiscv32Cheriot, 0)];
   enc_->ParseInstruction(SetRs2(SetRs1(kCheriotSpecialrw, kRdValue), 28));
+  EXPECT_EQ(enc_->GetOpcode(SlotEnum::kRiscv32Cheriot, 0),
+            OpcodeEnum::kCheriotSpecialrwMtcc)
+      << kOpcodeNames[*enc_->GetOpcode(SlotEnum::kRiscv32Cheriot, 0)];
+  enc_->ParseInstruction(SetRs2(SetRs1(kCheriotSpecialrw, kRdValue), 29));
   EXPECT_EQ(enc_->GetOpcode(SlotEnum::kRiscv32Cheriot, 0),
             OpcodeEnum::kCheriotSpecialrw)
       << kOpcodeNames[*enc_->GetOpcode(SlotEnum::kRiscv32Cheriot, 0)];
+  enc_->ParseInstruction(SetRs2(SetRs1(kCheriotSpecialrw, kRdValue), 31));
+  EXPECT_EQ(enc_->GetOpcode(SlotEnum::kRiscv32Cheriot, 0),
+            OpcodeEnum::kCheriotSpecialrwMepcc)
+      << kOpcodeNames[*enc_->GetOpcode(SlotEnum::kRiscv32Cheriot, 0)];
   enc_->ParseInstruction(kCheriotSub);
   EXPECT_EQ(enc_->GetOpcode(SlotEnum::kRiscv32Cheriot, 0),
             OpcodeEnum::kCheriotSub);
@@ -639,4 +651,57 @@ TEST_F(RiscVCheriotEncodingTest, RiscVCheriotOpcodes) {
 //   OpcodeEnum::kSfenceVmaNn);
 // }
 
+// The decode tables must agree with the generated decoder for all 16 bit
+// instruction words.
+TEST_F(RiscVCheriotEncodingTest, Inst16TableMatchesDecoder) {
+  for (uint32_t word = 0; word < (1 << 16); word++) {
+    if ((word & 0x3) == 0x3) continue;
+    auto [opcode, format] =
+        DecodeRiscVCheriotInst16WithFormat(static_cast<uint16_t>(word));
+    enc_->ParseInstruction(word);
+    ASSERT_EQ(enc_->GetOpcode(SlotEnum::kRiscv32Cheriot, 0), opcode)
+        << "word: " << std::hex << word;
+    ASSERT_EQ(enc_->GetFormat(SlotEnum::kRiscv32Cheriot, 0), format)
+        << "word: " << std::hex << word;
+  }
+}
+
+// With the decode tables disabled, every word is parsed by the generated
+// decoder.
+TEST_F(RiscVCheriotEncodingTest, DecodeTablesDisabled) {
+  enc_->set_use_decode_tables(false);
+  for (uint32_t word : {0x0015'0513U, 0x0005'2583U, 0x0000'0505U}) {
+    auto [opcode, format] =
+        (word & 0x3) == 0x3
+            ? DecodeRiscVCheriotInst32WithFormat(word)
+            : DecodeRiscVCheriotInst16WithFormat(static_cast<uint16_t>(word));
+    enc_->ParseInstruction(word);
+    EXPECT_EQ(enc_->GetOpcode(SlotEnum::kRiscv32Cheriot, 0), opcode)
+        << "word: " << std::hex << word;
+    EXPECT_EQ(enc_->GetFormat(SlotEnum::kRiscv32Cheriot, 0), format)
+        << "word: " << std::hex << word;
+  }
+}
+
+// The decode tables must agree with the generated decoder for 32 bit
+// instruction words. Every major opcode and func3 combination is tried with
+// random values in the remaining fields.
+TEST_F(RiscVCheriotEncodingTest, Inst32TableMatchesDecoder) {
+  std::mt19937 rng(0x5eed);
+  for (uint32_t index = 0; index < (1 << 10); index++) {
+    uint32_t major_opcode = index >> 3;
+    uint32_t func3 = index & 0x7;
+    if ((major_opcode & 0x3) != 0x3) continue;
+    for (int i = 0; i < 256; i++) {
+      uint32_t word = (rng() & ~0x707fU) | (func3 << 12) | major_opcode;
+      auto [opcode, format] = DecodeRiscVCheriotInst32WithFormat(word);
+      enc_->ParseInstruction(word);
+      ASSERT_EQ(enc_->GetOpcode(SlotEnum::kRiscv32Cheriot, 0), opcode)
+          << "word: " << std::hex << word;
+      ASSERT_EQ(enc_->GetFormat(SlotEnum::kRiscv32Cheriot, 0), format)
+          << "word: " << std::hex << word;
+    }
+  }
+}
+
 }  // namespace
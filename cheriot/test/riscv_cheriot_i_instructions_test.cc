@@ -20,7 +20,9 @@
 #include <tuple>
 #include <vector>
 
+#include "absl/log/check.h"
 #include "absl/types/span.h"
+#include "cheriot/cheriot_branch_predictor.h"
 #include "cheriot/cheriot_register.h"
 #include "cheriot/cheriot_state.h"
 #include "googlemock/include/gmock/gmock.h"
@@ -35,6 +37,7 @@
 namespace {
 
 using ::mpact::sim::generic::operator*;  // NOLINT: used below (clang error).
+using ::mpact::sim::cheriot::CheriotBranchPredictor;
 using ::mpact::sim::cheriot::CheriotRegister;
 using ::mpact::sim::cheriot::CheriotState;
 using ::mpact::sim::generic::ImmediateOperand;
@@ -399,6 +402,31 @@ TEST_F(RVCheriotIInstructionTest, RV32IBne) {
   EXPECT_EQ(state_->pcc()->address(), kInstAddress);
 }
 
+// A taken branch that traps does not commit, so the branch predictor must not
+// see it.
+TEST_F(RVCheriotIInstructionTest, RV32IBranchPredictorCommitted) {
+  CheriotBranchPredictor branch_predictor("bpred");
+  CHECK_OK(branch_predictor.Configure("bimodal", nullptr));
+  state_->set_branch_predictor(&branch_predictor);
+  AppendRegisterOperands({kC1, kC2}, {});
+  AppendImmediateOperands<int32_t>({kOffset});
+  SetSemanticFunction(&::mpact::sim::cheriot::RiscVIBeq);
+
+  state_->pcc()->ClearPermissions(PB::kPermitExecute);
+  SetRegisterValues<int32_t>(
+      {{kC1, kVal1}, {kC2, kVal1}, {CheriotState::kPcName, kInstAddress}});
+  instruction_->Execute(nullptr);
+  EXPECT_TRUE(trap_taken_);
+  EXPECT_EQ(branch_predictor.counter_branches()->GetValue(), 0);
+
+  // A branch that is not taken commits.
+  SetRegisterValues<int32_t>(
+      {{kC1, kVal1}, {kC2, kVal2}, {CheriotState::kPcName, kInstAddress}});
+  instruction_->Execute(nullptr);
+  EXPECT_EQ(branch_predictor.counter_branches()->GetValue(), 1);
+  state_->set_branch_predictor(nullptr);
+}
+
 TEST_F(RVCheriotIInstructionTest, RV32IBlt) {
   AppendRegisterOperands({kC1, kC2}, {});
   AppendImmediateOperands<int32_t>({kOffset});
@@ -67,6 +67,8 @@ using ::mpact::sim::cheriot::CheriotCJal;
 using ::mpact::sim::cheriot::CheriotCJalCra;
 using ::mpact::sim::cheriot::CheriotCJalr;
 using ::mpact::sim::cheriot::CheriotCJalrCra;
+using ::mpact::sim::cheriot::CheriotCJalrV0Dot5;
+using ::mpact::sim::cheriot::CheriotCJalV0Dot5;
 using ::mpact::sim::cheriot::CheriotCLc;
 using ::mpact::sim::cheriot::CheriotCLcChild;
 using ::mpact::sim::cheriot::CheriotCMove;
@@ -81,6 +83,8 @@ using ::mpact::sim::cheriot::CheriotCSetEqualExact;
 using ::mpact::sim::cheriot::CheriotCSetHigh;
 using ::mpact::sim::cheriot::CheriotCSpecialR;
 using ::mpact::sim::cheriot::CheriotCSpecialRW;
+using ::mpact::sim::cheriot::CheriotCSpecialRWMepcc;
+using ::mpact::sim::cheriot::CheriotCSpecialRWMtcc;
 using ::mpact::sim::cheriot::CheriotCSub;
 using ::mpact::sim::cheriot::CheriotCTestSubset;
 using ::mpact::sim::cheriot::CheriotCUnseal;
@@ -100,8 +104,6 @@ constexpr uint32_t kMemAddress = 0x1000;
 
 constexpr int kDataSeal10 = 10;
 constexpr int kInstSizeNormal = 4;
-constexpr int kVersion0Dot5 = 50;
-constexpr int kVersion1Dot0 = 100;
 
 // Test fixture.
 class RiscVCheriotInstructionsTest : public ::testing::Test {
@@ -618,12 +620,11 @@ TEST_F(RiscVCheriotInstructionsTest, CJalCraMisaligned) {
 
 // Jump and link - rd != ra.
 TEST_F(RiscVCheriotInstructionsTest, CJalNonCra) {
-  inst()->set_semantic_function(&CheriotCJal);
+  // Core version 0.5 version.
+  inst()->set_semantic_function(&CheriotCJalV0Dot5);
   AppendCapabilityOperands(inst(), {kC1}, {kC3});
   state()->pcc()->set_address(inst()->address());
   c1_reg()->set_address(0x200);
-  // Set core version to 0.5.
-  state()->set_core_version(kVersion0Dot5);
   // Set interrupt enable to true.
   state()->mstatus()->set_mie(1);
   state()->mstatus()->Submit();
@@ -649,9 +650,9 @@ TEST_F(RiscVCheriotInstructionsTest, CJalNonCra) {
   EXPECT_EQ(c3_reg()->object_type(), OT::kInterruptDisablingBackwardSentry);
   EXPECT_TRUE(state()->pcc()->tag());
 
-  // Now set core version to 1.0 - this behavior should return an unsealed
+  // Now use the core version 1.0 version - this should return an unsealed
   // capability.
-  state()->set_core_version(kVersion1Dot0);
+  inst()->set_semantic_function(&CheriotCJal);
   // Set interrupt enable to true.
   state()->mstatus()->set_mie(1);
   state()->mstatus()->Submit();
@@ -716,7 +717,8 @@ TEST_F(RiscVCheriotInstructionsTest, CJalrCra) {
 // Jump and link register (capability) indirect - no traps, unsealed source.
 // Non cra register used for destination.
 TEST_F(RiscVCheriotInstructionsTest, CJalr) {
-  inst()->set_semantic_function(&CheriotCJalr);
+  // Core version 0.5 version.
+  inst()->set_semantic_function(&CheriotCJalrV0Dot5);
   AppendCapabilityOperands(inst(), {kC1, kC2}, {kCra});
   state()->pcc()->set_address(inst()->address());
   // Set up the destination capability.
@@ -725,8 +727,6 @@ TEST_F(RiscVCheriotInstructionsTest, CJalr) {
   c1_reg()->SetBounds(kInstAddress, 0x400);
   // Set offset.
   c2_reg()->set_address(0x100);
-  // Set core version to 0.5.
-  state()->set_core_version(kVersion0Dot5);
   // Set interrupt enable to true.
   state()->mstatus()->set_mie(1);
   state()->mstatus()->Submit();
@@ -751,9 +751,9 @@ TEST_F(RiscVCheriotInstructionsTest, CJalr) {
   EXPECT_EQ(cra_reg()->object_type(), OT::kInterruptDisablingBackwardSentry);
   EXPECT_TRUE(state()->pcc()->tag());
 
-  // Set core version to 1.0 - this behavior should return an unsealed
+  // Use the core version 1.0 version - this should return an unsealed
   // capability.
-  state()->set_core_version(kVersion1Dot0);
+  inst()->set_semantic_function(&CheriotCJalr);
 
   // Set interrupt enable to true.
   state()->mstatus()->set_mie(1);
@@ -1712,6 +1712,41 @@ TEST_F(RiscVCheriotInstructionsTest, CSpecialRW) {
   EXPECT_TRUE(*state()->memory_root() == *c2_reg());
 }
 
+// Writes to mtcc and mepcc clear the low address bits and invalidate the
+// capability if any were set.
+TEST_F(RiscVCheriotInstructionsTest, CSpecialRWMtccMepcc) {
+  inst()->set_semantic_function(&CheriotCSpecialRWMtcc);
+  AppendCapabilityOperands(inst(), {kC1, kC2}, {kC3});
+  c1_reg()->ResetExecuteRoot();
+  c1_reg()->set_address(0x102);
+  inst()->Execute(nullptr);
+  EXPECT_FALSE(trap_taken());
+  EXPECT_FALSE(c2_reg()->tag());
+  EXPECT_EQ(c2_reg()->address(), 0x100);
+  c1_reg()->ResetExecuteRoot();
+  c1_reg()->set_address(0x104);
+  inst()->Execute(nullptr);
+  EXPECT_TRUE(c2_reg()->tag());
+  EXPECT_EQ(c2_reg()->address(), 0x104);
+
+  inst()->set_semantic_function(&CheriotCSpecialRWMepcc);
+  c1_reg()->ResetExecuteRoot();
+  c1_reg()->set_address(0x103);
+  inst()->Execute(nullptr);
+  EXPECT_FALSE(c2_reg()->tag());
+  EXPECT_EQ(c2_reg()->address(), 0x102);
+  c1_reg()->ResetExecuteRoot();
+  c1_reg()->set_address(0x102);
+  inst()->Execute(nullptr);
+  EXPECT_TRUE(c2_reg()->tag());
+  EXPECT_EQ(c2_reg()->address(), 0x102);
+  // Mepcc must be executable.
+  c1_reg()->ResetMemoryRoot();
+  c1_reg()->set_address(0x102);
+  inst()->Execute(nullptr);
+  EXPECT_FALSE(c2_reg()->tag());
+}
+
 TEST_F(RiscVCheriotInstructionsTest, CSpecialRWException) {
   inst()->set_semantic_function(&CheriotCSpecialRW);
   AppendCapabilityOperands(inst(), {kC1, kC2}, {kC3});
@@ -0,0 +1,374 @@
+// Copyright 2024 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Microbenchmarks for the vector semantic functions. Each semantic function is
+// timed across selected element widths, lmul values, vector lengths and mask
+// densities. Use the standard benchmark flags to select benchmarks and output
+// format, e.g.:
+//
+//   riscv_cheriot_vector_benchmark --benchmark_filter='vfadd.*' \
+//       --benchmark_out=vector.json --benchmark_out_format=json
+//
+// The vector load/store semantic functions are not included, as their cost is
+// dominated by the memory model rather than the vector state.
+
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "absl/functional/bind_front.h"
+#include "absl/types/span.h"
+#include "benchmark/benchmark.h"
+#include "cheriot/riscv_cheriot_vector_fp_compare_instructions.h"
+#include "cheriot/riscv_cheriot_vector_fp_instructions.h"
+#include "cheriot/riscv_cheriot_vector_fp_reduction_instructions.h"
+#include "cheriot/riscv_cheriot_vector_fp_unary_instructions.h"
+#include "cheriot/riscv_cheriot_vector_opi_instructions.h"
+#include "cheriot/riscv_cheriot_vector_opm_instructions.h"
+#include "cheriot/riscv_cheriot_vector_permute_instructions.h"
+#include "cheriot/riscv_cheriot_vector_reduction_instructions.h"
+#include "cheriot/riscv_cheriot_vector_unary_instructions.h"
+#include "cheriot/test/riscv_cheriot_vector_benchmark_base.h"
+#include "mpact/sim/generic/instruction.h"
+
+namespace {
+
+namespace cheriot = ::mpact::sim::cheriot;
+
+using Op = VectorBenchmarkOperand;
+using SemanticFunction = std::function<void(Instruction *)>;
+
+constexpr int64_t kAllSews[] = {1, 2, 4, 8};
+constexpr int64_t kWideningSews[] = {1, 2, 4};
+constexpr int64_t kFPSews[] = {4, 8};
+// Integer source element widths of the widening integer to fp conversions.
+constexpr int64_t kFPWideningIntSews[] = {2, 4};
+
+std::vector<int64_t> Sews(absl::Span<const int64_t> sews) {
+  return std::vector<int64_t>(sews.begin(), sews.end());
+}
+
+// Helpers that create specs for the common operand forms.
+
+// vd = op(vs2, vs1), masked.
+VectorBenchmarkSpec VV(std::string name, SemanticFunction fcn,
+                       std::vector<int64_t> sews = Sews(kAllSews)) {
+  return {std::move(name), std::move(fcn), {Op::kVs2, Op::kVs1, Op::kVmask},
+          {Op::kVd},       std::move(sews)};
+}
+
+// vd = op(vs2, rs1), masked.
+VectorBenchmarkSpec VX(std::string name, SemanticFunction fcn,
+                       std::vector<int64_t> sews = Sews(kAllSews)) {
+  return {std::move(name), std::move(fcn), {Op::kVs2, Op::kRs1, Op::kVmask},
+          {Op::kVd},       std::move(sews)};
+}
+
+// vd = op(vs2, vs1, vd), masked.
+VectorBenchmarkSpec VVV(std::string name, SemanticFunction fcn,
+                        std::vector<int64_t> sews = Sews(kAllSews)) {
+  return {std::move(name),
+          std::move(fcn),
+          {Op::kVs2, Op::kVs1, Op::kVd, Op::kVmask},
+          {Op::kVd},
+          std::move(sews)};
+}
+
+// vd = op(vs2, rs1, vd), masked.
+VectorBenchmarkSpec VXV(std::string name, SemanticFunction fcn,
+                        std::vector<int64_t> sews = Sews(kAllSews)) {
+  return {std::move(name),
+          std::move(fcn),
+          {Op::kVs2, Op::kRs1, Op::kVd, Op::kVmask},
+          {Op::kVd},
+          std::move(sews)};
+}
+
+// vd = op(vs2), masked.
+VectorBenchmarkSpec V(std::string name, SemanticFunction fcn,
+                      std::vector<int64_t> sews = Sews(kAllSews)) {
+  return {std::move(name), std::move(fcn), {Op::kVs2, Op::kVmask},
+          {Op::kVd},       std::move(sews)};
+}
+
+// Floating point forms. These also write fflags.
+VectorBenchmarkSpec FVV(std::string name, SemanticFunction fcn,
+                        std::vector<int64_t> sews = Sews(kFPSews)) {
+  return {std::move(name),        std::move(fcn),
+          {Op::kVs2, Op::kVs1, Op::kVmask}, {Op::kVd, Op::kFflags},
+          std::move(sews),        /*is_fp=*/true};
+}
+
+VectorBenchmarkSpec FVF(std::string name, SemanticFunction fcn,
+                        std::vector<int64_t> sews = Sews(kFPSews)) {
+  return {std::move(name),        std::move(fcn),
+          {Op::kVs2, Op::kFs1, Op::kVmask}, {Op::kVd, Op::kFflags},
+          std::move(sews),        /*is_fp=*/true};
+}
+
+VectorBenchmarkSpec FVVV(std::string name, SemanticFunction fcn,
+                         std::vector<int64_t> sews = Sews(kFPSews)) {
+  return {std::move(name),
+          std::move(fcn),
+          {Op::kVs2, Op::kVs1, Op::kVd, Op::kVmask},
+          {Op::kVd, Op::kFflags},
+          std::move(sews),
+          /*is_fp=*/true};
+}
+
+VectorBenchmarkSpec FVFV(std::string name, SemanticFunction fcn,
+                         std::vector<int64_t> sews = Sews(kFPSews)) {
+  return {std::move(name),
+          std::move(fcn),
+          {Op::kVs2, Op::kFs1, Op::kVd, Op::kVmask},
+          {Op::kVd, Op::kFflags},
+          std::move(sews),
+          /*is_fp=*/true};
+}
+
+VectorBenchmarkSpec FV(std::string name, SemanticFunction fcn,
+                       std::vector<int64_t> sews = Sews(kFPSews)) {
+  return {std::move(name),  std::move(fcn), {Op::kVs2, Op::kVmask},
+          {Op::kVd, Op::kFflags}, std::move(sews), /*is_fp=*/true};
+}
+
+std::vector<VectorBenchmarkSpec> *CreateSpecs() {
+  auto *specs = new std::vector<VectorBenchmarkSpec>({
+      // Integer arithmetic (opi).
+      VV("vadd.vv", &cheriot::Vadd),
+      VX("vadd.vx", &cheriot::Vadd),
+      VV("vsub.vv", &cheriot::Vsub),
+      VX("vsub.vx", &cheriot::Vsub),
+      VX("vrsub.vx", &cheriot::Vrsub),
+      VV("vand.vv", &cheriot::Vand),
+      VX("vand.vx", &cheriot::Vand),
+      VV("vor.vv", &cheriot::Vor),
+      VX("vor.vx", &cheriot::Vor),
+      VV("vxor.vv", &cheriot::Vxor),
+      VX("vxor.vx", &cheriot::Vxor),
+      VV("vsll.vv", &cheriot::Vsll),
+      VX("vsll.vx", &cheriot::Vsll),
+      VV("vsrl.vv", &cheriot::Vsrl),
+      VX("vsrl.vx", &cheriot::Vsrl),
+      VV("vsra.vv", &cheriot::Vsra),
+      VX("vsra.vx", &cheriot::Vsra),
+      VV("vnsrl.wv", &cheriot::Vnsrl, Sews(kWideningSews)),
+      VX("vnsrl.wx", &cheriot::Vnsrl, Sews(kWideningSews)),
+      VV("vnsra.wv", &cheriot::Vnsra, Sews(kWideningSews)),
+      VX("vnsra.wx", &cheriot::Vnsra, Sews(kWideningSews)),
+      VV("vmin.vv", &cheriot::Vmin),
+      VV("vminu.vv", &cheriot::Vminu),
+      VV("vmax.vv", &cheriot::Vmax),
+      VV("vmaxu.vv", &cheriot::Vmaxu),
+      VV("vmseq.vv", &cheriot::Vmseq),
+      VV("vmsne.vv", &cheriot::Vmsne),
+      VV("vmsltu.vv", &cheriot::Vmsltu),
+      VV("vmslt.vv", &cheriot::Vmslt),
+      VV("vmsleu.vv", &cheriot::Vmsleu),
+      VV("vmsle.vv", &cheriot::Vmsle),
+      VX("vmsgtu.vx", &cheriot::Vmsgtu),
+      VX("vmsgt.vx", &cheriot::Vmsgt),
+      VV("vsaddu.vv", &cheriot::Vsaddu),
+      VV("vsadd.vv", &cheriot::Vsadd),
+      VV("vssubu.vv", &cheriot::Vssubu),
+      VV("vssub.vv", &cheriot::Vssub),
+      VV("vadc.vvm", &cheriot::Vadc),
+      VV("vmadc.vvm", &cheriot::Vmadc),
+      VV("vsbc.vvm", &cheriot::Vsbc),
+      VV("vmsbc.vvm", &cheriot::Vmsbc),
+      VV("vmerge.vvm", &cheriot::Vmerge),
+      {"vmv2r.v", absl::bind_front(&cheriot::Vmvr, 2), {Op::kVs2}, {Op::kVd}},
+      {"vmv8r.v", absl::bind_front(&cheriot::Vmvr, 8), {Op::kVs2}, {Op::kVd}},
+      VV("vssrl.vv", &cheriot::Vssrl),
+      VV("vssra.vv", &cheriot::Vssra),
+      VV("vnclipu.wv", &cheriot::Vnclipu, Sews(kWideningSews)),
+      VV("vnclip.wv", &cheriot::Vnclip, Sews(kWideningSews)),
+      VV("vsmul.vv", &cheriot::Vsmul),
+      // Integer arithmetic (opm).
+      VV("vaaddu.vv", &cheriot::Vaaddu),
+      VV("vaadd.vv", &cheriot::Vaadd),
+      VV("vasubu.vv", &cheriot::Vasubu),
+      VV("vasub.vv", &cheriot::Vasub),
+      {"vmandnot.mm", &cheriot::Vmandnot, {Op::kVs2, Op::kVs1}, {Op::kVd}},
+      {"vmand.mm", &cheriot::Vmand, {Op::kVs2, Op::kVs1}, {Op::kVd}},
+      {"vmor.mm", &cheriot::Vmor, {Op::kVs2, Op::kVs1}, {Op::kVd}},
+      {"vmxor.mm", &cheriot::Vmxor, {Op::kVs2, Op::kVs1}, {Op::kVd}},
+      {"vmornot.mm", &cheriot::Vmornot, {Op::kVs2, Op::kVs1}, {Op::kVd}},
+      {"vmnand.mm", &cheriot::Vmnand, {Op::kVs2, Op::kVs1}, {Op::kVd}},
+      {"vmnor.mm", &cheriot::Vmnor, {Op::kVs2, Op::kVs1}, {Op::kVd}},
+      {"vmxnor.mm", &cheriot::Vmxnor, {Op::kVs2, Op::kVs1}, {Op::kVd}},
+      VV("vdivu.vv", &cheriot::Vdivu),
+      VV("vdiv.vv", &cheriot::Vdiv),
+      VV("vremu.vv", &cheriot::Vremu),
+      VV("vrem.vv", &cheriot::Vrem),
+      VV("vmulhu.vv", &cheriot::Vmulhu),
+      VV("vmul.vv", &cheriot::Vmul),
+      VX("vmul.vx", &cheriot::Vmul),
+      VV("vmulhsu.vv", &cheriot::Vmulhsu),
+      VV("vmulh.vv", &cheriot::Vmulh),
+      VVV("vmadd.vv", &cheriot::Vmadd),
+      VVV("vnmsub.vv", &cheriot::Vnmsub),
+      VVV("vmacc.vv", &cheriot::Vmacc),
+      VXV("vmacc.vx", &cheriot::Vmacc),
+      VVV("vnmsac.vv", &cheriot::Vnmsac),
+      VV("vwaddu.vv", &cheriot::Vwaddu, Sews(kWideningSews)),
+      VV("vwadd.vv", &cheriot::Vwadd, Sews(kWideningSews)),
+      VV("vwsubu.vv", &cheriot::Vwsubu, Sews(kWideningSews)),
+      VV("vwsub.vv", &cheriot::Vwsub, Sews(kWideningSews)),
+      VV("vwaddu.wv", &cheriot::Vwadduw, Sews(kWideningSews)),
+      VV("vwadd.wv", &cheriot::Vwaddw, Sews(kWideningSews)),
+      VV("vwsubu.wv", &cheriot::Vwsubuw, Sews(kWideningSews)),
+      VV("vwsub.wv", &cheriot::Vwsubw, Sews(kWideningSews)),
+      VV("vwmulu.vv", &cheriot::Vwmulu, Sews(kWideningSews)),
+      VV("vwmulsu.vv", &cheriot::Vwmulsu, Sews(kWideningSews)),
+      VV("vwmul.vv", &cheriot::Vwmul, Sews(kWideningSews)),
+      VVV("vwmaccu.vv", &cheriot::Vwmaccu, Sews(kWideningSews)),
+      VVV("vwmacc.vv", &cheriot::Vwmacc, Sews(kWideningSews)),
+      VXV("vwmaccus.vx", &cheriot::Vwmaccus, Sews(kWideningSews)),
+      VVV("vwmaccsu.vv", &cheriot::Vwmaccsu, Sews(kWideningSews)),
+      // Integer unary.
+      {"vmv.x.s", &cheriot::VmvToScalar, {Op::kVs2}, {Op::kRd}},
+      {"vmv.s.x", &cheriot::VmvFromScalar, {Op::kRs1}, {Op::kVd}},
+      {"vcpop.m", &cheriot::Vcpop, {Op::kVs2, Op::kVmask}, {Op::kRd}},
+      {"vfirst.m", &cheriot::Vfirst, {Op::kVs2, Op::kVmask}, {Op::kRd}},
+      V("vzext.vf2", &cheriot::Vzext2, {2, 4, 8}),
+      V("vsext.vf2", &cheriot::Vsext2, {2, 4, 8}),
+      V("vzext.vf4", &cheriot::Vzext4, {4, 8}),
+      V("vsext.vf4", &cheriot::Vsext4, {4, 8}),
+      V("vzext.vf8", &cheriot::Vzext8, {8}),
+      V("vsext.vf8", &cheriot::Vsext8, {8}),
+      V("vmsbf.m", &cheriot::Vmsbf),
+      V("vmsof.m", &cheriot::Vmsof),
+      V("vmsif.m", &cheriot::Vmsif),
+      V("viota.m", &cheriot::Viota),
+      {"vid.v", &cheriot::Vid, {Op::kVmask}, {Op::kVd}},
+      // Permute.
+      VV("vrgather.vv", &cheriot::Vrgather),
+      VX("vrgather.vx", &cheriot::Vrgather),
+      VV("vrgatherei16.vv", &cheriot::Vrgatherei16),
+      VX("vslideup.vx", &cheriot::Vslideup),
+      VX("vslidedown.vx", &cheriot::Vslidedown),
+      VX("vslide1up.vx", &cheriot::Vslide1up),
+      VX("vslide1down.vx", &cheriot::Vslide1down),
+      FVF("vfslide1up.vf", &cheriot::Vfslide1up),
+      FVF("vfslide1down.vf", &cheriot::Vfslide1down),
+      V("vcompress.vm", &cheriot::Vcompress),
+      // Integer reductions.
+      VV("vredsum.vs", &cheriot::Vredsum),
+      VV("vredand.vs", &cheriot::Vredand),
+      VV("vredor.vs", &cheriot::Vredor),
+      VV("vredxor.vs", &cheriot::Vredxor),
+      VV("vredminu.vs", &cheriot::Vredminu),
+      VV("vredmin.vs", &cheriot::Vredmin),
+      VV("vredmaxu.vs", &cheriot::Vredmaxu),
+      VV("vredmax.vs", &cheriot::Vredmax),
+      VV("vwredsumu.vs", &cheriot::Vwredsumu, Sews(kWideningSews)),
+      VV("vwredsum.vs", &cheriot::Vwredsum, Sews(kWideningSews)),
+      // Floating point arithmetic.
+      FVV("vfadd.vv", &cheriot::Vfadd),
+      FVF("vfadd.vf", &cheriot::Vfadd),
+      FVV("vfsub.vv", &cheriot::Vfsub),
+      FVF("vfrsub.vf", &cheriot::Vfrsub),
+      FVV("vfwadd.vv", &cheriot::Vfwadd),
+      FVV("vfwsub.vv", &cheriot::Vfwsub),
+      FVV("vfwadd.wv", &cheriot::Vfwaddw),
+      FVV("vfwsub.wv", &cheriot::Vfwsubw),
+      FVV("vfmul.vv", &cheriot::Vfmul),
+      FVF("vfmul.vf", &cheriot::Vfmul),
+      FVV("vfdiv.vv", &cheriot::Vfdiv),
+      FVF("vfrdiv.vf", &cheriot::Vfrdiv),
+      FVV("vfwmul.vv", &cheriot::Vfwmul),
+      FVVV("vfmadd.vv", &cheriot::Vfmadd),
+      FVVV("vfnmadd.vv", &cheriot::Vfnmadd),
+      FVVV("vfmsub.vv", &cheriot::Vfmsub),
+      FVVV("vfnmsub.vv", &cheriot::Vfnmsub),
+      FVVV("vfmacc.vv", &cheriot::Vfmacc),
+      FVFV("vfmacc.vf", &cheriot::Vfmacc),
+      FVVV("vfnmacc.vv", &cheriot::Vfnmacc),
+      FVVV("vfmsac.vv", &cheriot::Vfmsac),
+      FVVV("vfnmsac.vv", &cheriot::Vfnmsac),
+      FVVV("vfwmacc.vv", &cheriot::Vfwmacc),
+      FVVV("vfwnmacc.vv", &cheriot::Vfwnmacc),
+      FVVV("vfwmsac.vv", &cheriot::Vfwmsac),
+      FVVV("vfwnmsac.vv", &cheriot::Vfwnmsac),
+      FVV("vfsgnj.vv", &cheriot::Vfsgnj),
+      FVV("vfsgnjn.vv", &cheriot::Vfsgnjn),
+      FVV("vfsgnjx.vv", &cheriot::Vfsgnjx),
+      FVV("vfmin.vv", &cheriot::Vfmin),
+      FVV("vfmax.vv", &cheriot::Vfmax),
+      FVF("vfmerge.vfm", &cheriot::Vfmerge),
+      // Floating point compare.
+      FVV("vmfeq.vv", &cheriot::Vmfeq),
+      FVV("vmfle.vv", &cheriot::Vmfle),
+      FVV("vmflt.vv", &cheriot::Vmflt),
+      FVV("vmfne.vv", &cheriot::Vmfne),
+      FVF("vmfgt.vf", &cheriot::Vmfgt),
+      FVF("vmfge.vf", &cheriot::Vmfge),
+      // Floating point reductions.
+      FVV("vfredosum.vs", &cheriot::Vfredosum),
+      FVV("vfwredosum.vs", &cheriot::Vfwredosum),
+      FVV("vfredmin.vs", &cheriot::Vfredmin),
+      FVV("vfredmax.vs", &cheriot::Vfredmax),
+      // Floating point unary.
+      {"vfmv.v.f", &cheriot::Vfmvvf, {Op::kFs1}, {Op::kVd}, Sews(kFPSews),
+       /*is_fp=*/true},
+      {"vfmv.s.f", &cheriot::Vfmvsf, {Op::kFs1}, {Op::kVd}, Sews(kFPSews),
+       /*is_fp=*/true},
+      {"vfmv.f.s", &cheriot::Vfmvfs, {Op::kVs2}, {Op::kFs1}, Sews(kFPSews),
+       /*is_fp=*/true},
+      FV("vfcvt.xu.f.v", &cheriot::Vfcvtxufv),
+      FV("vfcvt.x.f.v", &cheriot::Vfcvtxfv),
+      FV("vfcvt.f.xu.v", &cheriot::Vfcvtfxuv),
+      FV("vfcvt.f.x.v", &cheriot::Vfcvtfxv),
+      FV("vfcvt.rtz.xu.f.v", &cheriot::Vfcvtrtzxufv),
+      FV("vfcvt.rtz.x.f.v", &cheriot::Vfcvtrtzxfv),
+      FV("vfwcvt.xu.f.v", &cheriot::Vfwcvtxufv),
+      FV("vfwcvt.x.f.v", &cheriot::Vfwcvtxfv),
+      FV("vfwcvt.f.f.v", &cheriot::Vfwcvtffv),
+      FV("vfwcvt.f.xu.v", &cheriot::Vfwcvtfxuv, Sews(kFPWideningIntSews)),
+      FV("vfwcvt.f.x.v", &cheriot::Vfwcvtfxv, Sews(kFPWideningIntSews)),
+      FV("vfwcvt.rtz.xu.f.v", &cheriot::Vfwcvtrtzxufv),
+      FV("vfwcvt.rtz.x.f.v", &cheriot::Vfwcvtrtzxfv),
+      FV("vfncvt.xu.f.w", &cheriot::Vfncvtxufw),
+      FV("vfncvt.x.f.w", &cheriot::Vfncvtxfw),
+      FV("vfncvt.f.f.w", &cheriot::Vfncvtffw),
+      FV("vfncvt.rod.f.f.w", &cheriot::Vfncvtrodffw),
+      FV("vfncvt.f.xu.w", &cheriot::Vfncvtfxuw),
+      FV("vfncvt.f.x.w", &cheriot::Vfncvtfxw),
+      FV("vfncvt.rtz.xu.f.w", &cheriot::Vfncvtrtzxufw),
+      FV("vfncvt.rtz.x.f.w", &cheriot::Vfncvtrtzxfw),
+      FV("vfsqrt.v", &cheriot::Vfsqrtv),
+      FV("vfrsqrt7.v", &cheriot::Vfrsqrt7v),
+      FV("vfrec7.v", &cheriot::Vfrec7v),
+      FV("vfclass.v", &cheriot::Vfclassv),
+  });
+  return specs;
+}
+
+}  // namespace
+
+int main(int argc, char **argv) {
+  // The specs are referenced by the registered benchmarks, so they are never
+  // freed.
+  auto *specs = CreateSpecs();
+  for (auto const &spec : *specs) {
+    RegisterVectorBenchmark(spec);
+  }
+  benchmark::Initialize(&argc, argv);
+  if (benchmark::ReportUnrecognizedArguments(argc, argv)) return 1;
+  benchmark::RunSpecifiedBenchmarks();
+  benchmark::Shutdown();
+  return 0;
+}
@@ -0,0 +1,248 @@
+// Copyright 2024 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef MPACT_CHERIOT_TEST_RISCV_CHERIOT_VECTOR_BENCHMARK_BASE_H_
+#define MPACT_CHERIOT_TEST_RISCV_CHERIOT_VECTOR_BENCHMARK_BASE_H_
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <string>
+#include <vector>
+
+#include "absl/log/log.h"
+#include "absl/random/random.h"
+#include "absl/strings/str_cat.h"
+#include "benchmark/benchmark.h"
+#include "cheriot/cheriot_register.h"
+#include "cheriot/cheriot_state.h"
+#include "cheriot/test/riscv_cheriot_vector_instructions_test_base.h"
+#include "mpact/sim/generic/instruction.h"
+#include "riscv//riscv_fp_state.h"
+#include "riscv//riscv_register.h"
+
+// This file defines a harness for timing vector semantic functions. It reuses
+// the vector instruction test fixture to set up the CheriotState, the vector
+// state and the register operands, and then calls the semantic function
+// repeatedly for a given selected element width, lmul, vector length and mask
+// density.
+
+// Operands that can be attached to the instruction under test. The vector
+// register operands use the same register groups as the instruction tests.
+enum class VectorBenchmarkOperand {
+  kVs2,     // Vector register group v24.
+  kVs1,     // Vector register group v16.
+  kVd,      // Vector register group v8.
+  kVmask,   // Vector mask register v1.
+  kRs1,     // Scalar capability register c1.
+  kRd,      // Scalar capability register c8.
+  kFs1,     // Scalar floating point register f4.
+  kFflags,  // The fflags csr (destination only).
+};
+
+// Describes how to set up and call a single vector semantic function.
+struct VectorBenchmarkSpec {
+  // Name of the benchmark, typically the instruction mnemonic plus the
+  // operand form, e.g., "vadd.vv".
+  std::string name;
+  std::function<void(Instruction *)> semantic_function;
+  std::vector<VectorBenchmarkOperand> sources;
+  std::vector<VectorBenchmarkOperand> destinations;
+  // Element widths (in bytes) to benchmark.
+  std::vector<int64_t> sews = {1, 2, 4, 8};
+  // True if the source register groups should be filled with finite floating
+  // point values instead of random bits.
+  bool is_fp = false;
+};
+
+// Value of the scalar integer source. Kept small so that it is a reasonable
+// shift, slide or index amount.
+constexpr uint32_t kBenchmarkScalarValue = 3;
+
+// Harness that sets up the vector instruction fixture for a given benchmark
+// spec.
+class RiscVCheriotVectorBenchmarkHarness
+    : public RiscVCheriotVectorInstructionsTestBase {
+ public:
+  explicit RiscVCheriotVectorBenchmarkHarness(const VectorBenchmarkSpec &spec)
+      : spec_(spec) {
+    rv_fp_ = new mpact::sim::riscv::RiscVFPState(state_->csr_set(), state_);
+    state_->set_rv_fp(rv_fp_);
+    for (auto operand : spec_.sources) AppendSource(operand);
+    for (auto operand : spec_.destinations) AppendDestination(operand);
+    SetSemanticFunction(spec_.semantic_function);
+  }
+
+  ~RiscVCheriotVectorBenchmarkHarness() override {
+    state_->set_rv_fp(nullptr);
+    delete rv_fp_;
+  }
+
+  // Not a test, but the fixture base class requires it.
+  void TestBody() override {}
+
+  // Runs the benchmark. The benchmark arguments are: sew (bytes), lmul,
+  // vector length as a percentage of vlmax, and the percentage of mask bits
+  // that are set.
+  void Run(benchmark::State &state) {
+    int sew = state.range(0);
+    int lmul = state.range(1);
+    int vl_percent = state.range(2);
+    int mask_percent = state.range(3);
+    FillSources(sew, mask_percent);
+    int vlmax = lmul * kVectorLengthInBytes / sew;
+    int vl = std::max(1, vlmax * vl_percent / 100);
+    int lmul_log = 0;
+    while ((1 << lmul_log) < lmul) lmul_log++;
+    uint32_t vtype = (kSewSettingsByByteSize[sew] << 3) |
+                     kLmulSettingByLogSize[lmul_log + 4];
+    ConfigureVectorUnit(vtype, vl);
+    // Execute once outside of the timing loop to reject configurations that
+    // the semantic function does not support (e.g., widening at lmul 8).
+    instruction_->Execute(nullptr);
+    if (rv_vector_->vector_exception()) {
+      rv_vector_->clear_vector_exception();
+      state.SkipWithError("configuration not supported by instruction");
+      return;
+    }
+    for (auto _ : state) {
+      instruction_->Execute(nullptr);
+    }
+    state.SetItemsProcessed(state.iterations() * vl);
+    state.counters["vl"] = vl;
+  }
+
+ private:
+  // Returns the vector register number of the given operand.
+  static int VectorRegister(VectorBenchmarkOperand operand) {
+    switch (operand) {
+      case VectorBenchmarkOperand::kVs2:
+        return kVs2;
+      case VectorBenchmarkOperand::kVs1:
+        return kVs1;
+      case VectorBenchmarkOperand::kVd:
+        return kVd;
+      case VectorBenchmarkOperand::kVmask:
+        return kVmask;
+      default:
+        return -1;
+    }
+  }
+
+  void AppendSource(VectorBenchmarkOperand operand) {
+    switch (operand) {
+      case VectorBenchmarkOperand::kRs1:
+        AppendRegisterOperands({kRs1Name}, {});
+        break;
+      case VectorBenchmarkOperand::kRd:
+        AppendRegisterOperands({kRdName}, {});
+        break;
+      case VectorBenchmarkOperand::kFs1:
+        instruction_->AppendSource(freg_[kBenchmarkFs1]->CreateSourceOperand());
+        break;
+      case VectorBenchmarkOperand::kFflags:
+        LOG(FATAL) << "fflags can only be a destination operand";
+        break;
+      default:
+        AppendVectorRegisterOperands({VectorRegister(operand)}, {});
+        break;
+    }
+  }
+
+  void AppendDestination(VectorBenchmarkOperand operand) {
+    switch (operand) {
+      case VectorBenchmarkOperand::kRs1:
+        AppendRegisterOperands({}, {kRs1Name});
+        break;
+      case VectorBenchmarkOperand::kRd:
+        AppendRegisterOperands({}, {kRdName});
+        break;
+      case VectorBenchmarkOperand::kFs1:
+        instruction_->AppendDestination(
+            freg_[kBenchmarkFs1]->CreateDestinationOperand(0));
+        break;
+      case VectorBenchmarkOperand::kFflags:
+        instruction_->AppendDestination(
+            rv_fp_->fflags()->CreateSetDestinationOperand(0, "fflags"));
+        break;
+      default:
+        AppendVectorRegisterOperands({}, {VectorRegister(operand)});
+        break;
+    }
+  }
+
+  // Fills the source registers with values appropriate for the element width
+  // and sets the mask register so that mask_percent of the bits are set.
+  void FillSources(int sew, int mask_percent) {
+    for (int reg = 2; reg < 32; reg++) {
+      auto span = vreg_[reg]->data_buffer()->Get<uint8_t>();
+      if (spec_.is_fp && (sew == 4)) {
+        FillWithFPValues<float>(span);
+      } else if (spec_.is_fp && (sew == 8)) {
+        FillWithFPValues<double>(span);
+      } else {
+        FillArrayWithRandomValues<uint8_t>(span);
+      }
+    }
+    auto mask_span = vreg_[kVmask]->data_buffer()->Get<uint8_t>();
+    std::memset(mask_span.data(), 0, mask_span.size());
+    for (int i = 0; i < mask_span.size() * 8; i++) {
+      if (absl::Uniform(bitgen_, 0, 100) < mask_percent) {
+        mask_span[i >> 3] |= 1 << (i & 0b111);
+      }
+    }
+    creg_[kRs1]->data_buffer()->Set<uint32_t>(0, kBenchmarkScalarValue);
+    // Scalar fp values are NaN boxed when narrower than the register.
+    if (sew == 4) {
+      float value = 1.5f;
+      uint32_t bits;
+      std::memcpy(&bits, &value, sizeof(bits));
+      freg_[kBenchmarkFs1]->data_buffer()->Set<uint64_t>(
+          0, 0xffff'ffff'0000'0000ULL | bits);
+    } else {
+      freg_[kBenchmarkFs1]->data_buffer()->Set<double>(0, 1.5);
+    }
+  }
+
+  // Fills the byte span with finite floating point values in [1.0, 2.0).
+  template <typename T>
+  void FillWithFPValues(absl::Span<uint8_t> span) {
+    for (int i = 0; i + sizeof(T) <= span.size(); i += sizeof(T)) {
+      T value = absl::Uniform<T>(bitgen_, 1.0, 2.0);
+      std::memcpy(&span[i], &value, sizeof(T));
+    }
+  }
+
+  static constexpr int kBenchmarkFs1 = 4;
+
+  const VectorBenchmarkSpec &spec_;
+  mpact::sim::riscv::RiscVFPState *rv_fp_;
+};
+
+// Registers a benchmark for the spec across sew, lmul, vl and mask density.
+// The spec must outlive the benchmark run.
+inline benchmark::internal::Benchmark *RegisterVectorBenchmark(
+    const VectorBenchmarkSpec &spec) {
+  return benchmark::RegisterBenchmark(
+             spec.name.c_str(),
+             [&spec](benchmark::State &state) {
+               RiscVCheriotVectorBenchmarkHarness harness(spec);
+               harness.Run(state);
+             })
+      ->ArgsProduct({spec.sews, {1, 2, 4, 8}, {25, 100}, {50, 100}})
+      ->ArgNames({"sew", "lmul", "vl_pct", "mask_pct"});
+}
+
+#endif  // MPACT_CHERIOT_TEST_RISCV_CHERIOT_VECTOR_BENCHMARK_BASE_H_
@@ -18,6 +18,7 @@
 #include <cmath>
 #include <cstdint>
 #include <functional>
+#include <iterator>
 #include <limits>
 #include <string>
 #include <tuple>
@@ -593,6 +594,53 @@ TEST_F(RiscVCheriotFPUnaryInstructionsTest, Vfcvtxufv) {
       });
 }
 
+// Test convert from fp to signed integer over a register group where the
+// first register is converted as a whole run, and the second register holds
+// a NaN and an out of range value, so it is converted element by element.
+TEST_F(RiscVCheriotFPUnaryInstructionsTest, VfcvtxfvRuns) {
+  SetSemanticFunction(&Vfcvtxfv);
+  AppendVectorRegisterOperands({kVs2, kVmask}, {kVd});
+  auto *op = rv_fp_->fflags()->CreateSetDestinationOperand(0, "fflags");
+  instruction_->AppendDestination(op);
+  constexpr int kElementsPerVector = kVectorLengthInBytes / sizeof(float);
+  constexpr int kNumElements = 2 * kElementsPerVector;
+  uint8_t mask[kVectorLengthInBytes];
+  std::fill(std::begin(mask), std::end(mask), 0xff);
+  SetVectorRegisterValues<uint8_t>({{kVmaskName, Span<const uint8_t>(mask)}});
+  float vs2_value[kNumElements];
+  for (int i = 0; i < kNumElements; i++) {
+    vs2_value[i] = static_cast<float>(i) - 8.5f;
+  }
+  int nan_index = kElementsPerVector + 1;
+  int max_index = kElementsPerVector + 2;
+  vs2_value[nan_index] = std::numeric_limits<float>::quiet_NaN();
+  vs2_value[max_index] = 1.0e20f;
+  auto vs2_span = Span<const float>(vs2_value);
+  SetVectorRegisterValues<float>(
+      {{kVs2Name, vs2_span.subspan(0, kElementsPerVector)},
+       {"v25", vs2_span.subspan(kElementsPerVector, kElementsPerVector)}});
+  ClearVectorRegisterGroup(kVd, 2);
+  // Sew 32 and lmul 2.
+  ConfigureVectorUnit((kSewSettingsByByteSize[sizeof(float)] << 3) | 0b001,
+                      kNumElements);
+  rv_fp_->SetRoundingMode(FPRoundingMode::kRoundTowardsZero);
+  rv_fp_->fflags()->Write(0U);
+  instruction_->Execute();
+  EXPECT_FALSE(rv_vector_->vector_exception());
+  EXPECT_EQ(rv_fp_->fflags()->AsUint32(),
+            static_cast<uint32_t>(FPExceptions::kInvalidOp));
+  for (int i = 0; i < kNumElements; i++) {
+    int reg = kVd + i / kElementsPerVector;
+    int32_t value =
+        vreg_[reg]->data_buffer()->Get<int32_t>(i % kElementsPerVector);
+    if ((i == nan_index) || (i == max_index)) {
+      EXPECT_EQ(value, std::numeric_limits<int32_t>::max()) << "element " << i;
+    } else {
+      EXPECT_EQ(value, static_cast<int32_t>(vs2_value[i])) << "element " << i;
+    }
+  }
+}
+
 // Test vfmv.f.s instruction - move element 0 to scalar fp register.
 TEST_F(RiscVCheriotFPUnaryInstructionsTest, VfmvToScalar) {
   SetSemanticFunction(&Vfmvfs);
@@ -926,6 +974,56 @@ TEST_F(RiscVCheriotFPUnaryInstructionsTest, Vfsqrtv) {
       });
 }
 
+// Test square root across a register group boundary with runs of enabled
+// and disabled elements, so that both the fully enabled and the masked run
+// loops are used, and the fflags are accumulated across all the runs.
+TEST_F(RiscVCheriotFPUnaryInstructionsTest, VfsqrtvMaskRuns) {
+  SetSemanticFunction(&Vfsqrtv);
+  AppendVectorRegisterOperands({kVs2, kVmask}, {kVd});
+  auto *op = rv_fp_->fflags()->CreateSetDestinationOperand(0, "fflags");
+  instruction_->AppendDestination(op);
+  constexpr int kElementsPerVector = kVectorLengthInBytes / sizeof(float);
+  constexpr int kNumElements = 2 * kElementsPerVector;
+  // Elements 12-15 are disabled, all others are enabled.
+  uint8_t mask[kVectorLengthInBytes];
+  std::fill(std::begin(mask), std::end(mask), 0xff);
+  mask[1] = 0x0f;
+  SetVectorRegisterValues<uint8_t>({{kVmaskName, Span<const uint8_t>(mask)}});
+  // Perfect squares, except for a negative value in element 3.
+  float vs2_value[kNumElements];
+  for (int i = 0; i < kNumElements; i++) {
+    vs2_value[i] = static_cast<float>(i * i);
+  }
+  vs2_value[3] = -1.0f;
+  auto vs2_span = Span<const float>(vs2_value);
+  SetVectorRegisterValues<float>(
+      {{kVs2Name, vs2_span.subspan(0, kElementsPerVector)},
+       {"v25", vs2_span.subspan(kElementsPerVector, kElementsPerVector)}});
+  ClearVectorRegisterGroup(kVd, 2);
+  // Sew 32 and lmul 2.
+  ConfigureVectorUnit((kSewSettingsByByteSize[sizeof(float)] << 3) | 0b001,
+                      kNumElements);
+  rv_fp_->SetRoundingMode(FPRoundingMode::kRoundToNearest);
+  rv_fp_->fflags()->Write(0U);
+  instruction_->Execute();
+  EXPECT_FALSE(rv_vector_->vector_exception());
+  EXPECT_EQ(rv_vector_->vstart(), 0);
+  EXPECT_EQ(rv_fp_->fflags()->AsUint32(),
+            static_cast<uint32_t>(FPExceptions::kInvalidOp));
+  for (int i = 0; i < kNumElements; i++) {
+    int reg = kVd + i / kElementsPerVector;
+    float value =
+        vreg_[reg]->data_buffer()->Get<float>(i % kElementsPerVector);
+    if ((i >= 12) && (i < 16)) {
+      EXPECT_EQ(value, 0.0f) << "element " << i;
+    } else if (i == 3) {
+      EXPECT_TRUE(std::isnan(value)) << "element " << i;
+    } else {
+      EXPECT_EQ(value, static_cast<float>(i)) << "element " << i;
+    }
+  }
+}
+
 // Test widening convert fp to fp.
 TEST_F(RiscVCheriotFPUnaryInstructionsTest, Vfwcvtffv) {
   SetSemanticFunction(&Vfwcvtffv);
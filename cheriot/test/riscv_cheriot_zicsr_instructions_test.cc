@@ -22,11 +22,11 @@
 #include "absl/log/check.h"
 #include "absl/strings/string_view.h"
 #include "absl/types/span.h"
+#include "cheriot/cheriot_csr_operand.h"
 #include "cheriot/cheriot_register.h"
 #include "cheriot/cheriot_state.h"
 #include "cheriot/riscv_cheriot_csr_enum.h"
 #include "googlemock/include/gmock/gmock.h"
-#include "mpact/sim/generic/immediate_operand.h"
 #include "mpact/sim/generic/instruction.h"
 #include "mpact/sim/util/memory/tagged_flat_demand_memory.h"
 #include "riscv//riscv_csr.h"
@@ -37,10 +37,11 @@ namespace {
 
 using EC = ::mpact::sim::cheriot::ExceptionCode;
 using PB = ::mpact::sim::cheriot::CheriotRegister::PermissionBits;
+using ::mpact::sim::cheriot::CheriotCsrOperand;
 using ::mpact::sim::cheriot::CheriotRegister;
+using ::mpact::sim::cheriot::CsrAccess;
 using ::mpact::sim::cheriot::CheriotState;
 using ::mpact::sim::cheriot::RiscVCheriotCsrEnum;
-using ::mpact::sim::generic::ImmediateOperand;
 using ::mpact::sim::generic::Instruction;
 using ::mpact::sim::riscv::RiscV32SimpleCsr;
 using ::mpact::sim::util::TaggedFlatDemandMemory;
@@ -93,14 +94,12 @@ class ZicsrInstructionsTest : public testing::Test {
     }
   }
 
-  // Appends immediate source operands with the given values.
-  template <typename T>
-  void AppendImmediateOperands(Instruction *inst,
-                               const std::vector<T> &values) {
-    for (auto value : values) {
-      auto *src = new ImmediateOperand<T>(value);
-      inst->AppendSource(src);
-    }
+  // Appends the CSR source operand for the given CSR index, as created by
+  // the decoder.
+  void AppendCsrOperand(Instruction *inst, uint32_t csr_index) {
+    auto result = state_->csr_set()->GetCsr(csr_index);
+    inst->AppendSource(new CheriotCsrOperand(
+        csr_index, result.ok() ? result.value() : nullptr));
   }
 
   // Takes a vector of tuples of register names and values. Fetches each
@@ -175,7 +174,7 @@ TEST_F(ZicsrInstructionsTest, RiscVZiCsrrw) {
   csr->Set(kCsrValue1);
   SetRegisterValues<uint32_t>({{kX1, kCsrValue2}, {kX3, 0}});
   AppendRegisterOperands(instruction_, {kX1}, {kX3});
-  AppendImmediateOperands(instruction_, std::vector<uint32_t>{kMScratchValue});
+  AppendCsrOperand(instruction_, kMScratchValue);
   SetSemanticFunction(&::mpact::sim::cheriot::RiscVZiCsrrw);
 
   instruction_->Execute(nullptr);
@@ -195,7 +194,7 @@ TEST_F(ZicsrInstructionsTest, RiscVZiCsrrs) {
   csr->Set(kCsrValue1);
   SetRegisterValues<uint32_t>({{kX1, kCsrValue2}, {kX3, 0}});
   AppendRegisterOperands(instruction_, {kX1}, {kX3});
-  AppendImmediateOperands(instruction_, std::vector<uint32_t>{kMScratchValue});
+  AppendCsrOperand(instruction_, kMScratchValue);
   SetSemanticFunction(&::mpact::sim::cheriot::RiscVZiCsrrs);
 
   instruction_->Execute(nullptr);
@@ -214,7 +213,7 @@ TEST_F(ZicsrInstructionsTest, RiscVZiCsrrc) {
   csr->Set(kCsrValue1);
   SetRegisterValues<uint32_t>({{kX1, kCsrValue2}, {kX3, 0}});
   AppendRegisterOperands(instruction_, {kX1}, {kX3});
-  AppendImmediateOperands(instruction_, std::vector<uint32_t>{kMScratchValue});
+  AppendCsrOperand(instruction_, kMScratchValue);
   SetSemanticFunction(&::mpact::sim::cheriot::RiscVZiCsrrc);
 
   instruction_->Execute(nullptr);
@@ -233,7 +232,7 @@ TEST_F(ZicsrInstructionsTest, RiscVZiCsrrwNr) {
   csr->Set(kCsrValue1);
   SetRegisterValues<uint32_t>({{kX1, kCsrValue2}, {kX3, 0}});
   AppendRegisterOperands(instruction_, {kX1}, {kX3});
-  AppendImmediateOperands(instruction_, std::vector<uint32_t>{kMScratchValue});
+  AppendCsrOperand(instruction_, kMScratchValue);
   SetSemanticFunction(&::mpact::sim::cheriot::RiscVZiCsrrwNr);
 
   instruction_->Execute(nullptr);
@@ -251,7 +250,7 @@ TEST_F(ZicsrInstructionsTest, RiscVZiCsrrNw) {
   CHECK_NE(csr, nullptr);
   csr->Set(kCsrValue1);
   SetRegisterValues<uint32_t>({{kX1, kCsrValue2}, {kX3, 0}});
-  AppendImmediateOperands(instruction_, std::vector<uint32_t>{kMScratchValue});
+  AppendCsrOperand(instruction_, kMScratchValue);
   AppendRegisterOperands(instruction_, {}, {kX3});
   SetSemanticFunction(&::mpact::sim::cheriot::RiscVZiCsrrNw);
 
@@ -266,7 +265,7 @@ TEST_F(ZicsrInstructionsTest, RiscVZiCsrrNw) {
 TEST_F(ZicsrInstructionsTest, RiscVZiCsrrNwTrap) {
   state_->pcc()->ClearPermissions(PB::kPermitAccessSystemRegisters);
   SetRegisterValues<uint32_t>({{kX1, kCsrValue2}, {kX3, 0}});
-  AppendImmediateOperands(instruction_, std::vector<uint32_t>{kMScratchValue});
+  AppendCsrOperand(instruction_, kMScratchValue);
   AppendRegisterOperands(instruction_, {kX1}, {kX3});
   SetSemanticFunction(&::mpact::sim::cheriot::RiscVZiCsrrNw);
 
@@ -287,7 +286,7 @@ TEST_F(ZicsrInstructionsTest, RiscVZiCsrrNwTrap) {
 TEST_F(ZicsrInstructionsTest, RiscVZiCsrrNwNoTrap) {
   state_->pcc()->ClearPermissions(PB::kPermitAccessSystemRegisters);
   SetRegisterValues<uint32_t>({{kX1, kCsrValue2}, {kX3, 0}});
-  AppendImmediateOperands(instruction_, std::vector<uint32_t>{kCycleValue});
+  AppendCsrOperand(instruction_, kCycleValue);
   AppendRegisterOperands(instruction_, {kX1}, {kX3});
   SetSemanticFunction(&::mpact::sim::cheriot::RiscVZiCsrrNw);
 
@@ -296,4 +295,84 @@ TEST_F(ZicsrInstructionsTest, RiscVZiCsrrNwNoTrap) {
   EXPECT_FALSE(trap_taken_);
 }
 
+// Tests the access permissions computed by the CSR operand.
+TEST_F(ZicsrInstructionsTest, CsrOperandAccess) {
+  auto result = state_->csr_set()->GetCsr(kMScratchValue);
+  CHECK_OK(result);
+  CheriotCsrOperand mscratch(kMScratchValue, result.value());
+  EXPECT_EQ(mscratch.csr(), result.value());
+  EXPECT_EQ(mscratch.AsUint32(0), kMScratchValue);
+  EXPECT_EQ(mscratch.AsString(), "mscratch");
+  EXPECT_FALSE(mscratch.is_pmp_csr());
+  EXPECT_EQ(mscratch.access(/*is_write=*/false),
+            CsrAccess::kNeedsSystemRegisterPermission);
+  CheriotCsrOperand mcycle(static_cast<uint32_t>(RiscVCheriotCsrEnum::kMCycle),
+                           nullptr);
+  EXPECT_EQ(mcycle.access(/*is_write=*/false), CsrAccess::kAllowed);
+  EXPECT_EQ(mcycle.access(/*is_write=*/true),
+            CsrAccess::kNeedsSystemRegisterPermission);
+  CheriotCsrOperand cycle(kCycleValue, nullptr);
+  EXPECT_EQ(cycle.access(/*is_write=*/false), CsrAccess::kAllowed);
+}
+
+// Tests Csrrw with the CSR operand created by the decoder.
+TEST_F(ZicsrInstructionsTest, RiscVZiCsrrwCsrOperand) {
+  auto result = state_->csr_set()->GetCsr(kMScratchValue);
+  CHECK_OK(result);
+  auto *csr = result.value();
+  csr->Set(kCsrValue1);
+  SetRegisterValues<uint32_t>({{kX1, kCsrValue2}, {kX3, 0}});
+  AppendRegisterOperands(instruction_, {kX1}, {kX3});
+  instruction_->AppendSource(new CheriotCsrOperand(kMScratchValue, csr));
+  SetSemanticFunction(&::mpact::sim::cheriot::RiscVZiCsrrw);
+
+  instruction_->Execute(nullptr);
+
+  EXPECT_FALSE(trap_taken_);
+  EXPECT_EQ(GetRegisterValue<uint32_t>(kX3), kCsrValue1);
+  EXPECT_EQ(csr->AsUint32(), kCsrValue2);
+}
+
+// Tests Csrrw with a CSR operand that was not resolved by the decoder. The
+// CSR is looked up in the CSR set when the instruction is executed.
+TEST_F(ZicsrInstructionsTest, RiscVZiCsrrwUnresolvedCsrOperand) {
+  auto result = state_->csr_set()->GetCsr(kMScratchValue);
+  CHECK_OK(result);
+  auto *csr = result.value();
+  csr->Set(kCsrValue1);
+  SetRegisterValues<uint32_t>({{kX1, kCsrValue2}, {kX3, 0}});
+  AppendRegisterOperands(instruction_, {kX1}, {kX3});
+  instruction_->AppendSource(
+      new CheriotCsrOperand(kMScratchValue, nullptr, /*resolved=*/false));
+  SetSemanticFunction(&::mpact::sim::cheriot::RiscVZiCsrrw);
+
+  instruction_->Execute(nullptr);
+
+  EXPECT_FALSE(trap_taken_);
+  EXPECT_EQ(GetRegisterValue<uint32_t>(kX3), kCsrValue1);
+  EXPECT_EQ(csr->AsUint32(), kCsrValue2);
+  // The access is checked when the instruction is executed as well.
+  state_->pcc()->ClearPermissions(PB::kPermitAccessSystemRegisters);
+  instruction_->Execute(nullptr);
+  EXPECT_TRUE(trap_taken_);
+}
+
+// Tests that the CSR operand access check traps without permission in pcc.
+TEST_F(ZicsrInstructionsTest, RiscVZiCsrrNwCsrOperandTrap) {
+  state_->pcc()->ClearPermissions(PB::kPermitAccessSystemRegisters);
+  auto result = state_->csr_set()->GetCsr(kMScratchValue);
+  CHECK_OK(result);
+  SetRegisterValues<uint32_t>({{kX3, 0}});
+  instruction_->AppendSource(
+      new CheriotCsrOperand(kMScratchValue, result.value()));
+  AppendRegisterOperands(instruction_, {}, {kX3});
+  SetSemanticFunction(&::mpact::sim::cheriot::RiscVZiCsrrNw);
+
+  instruction_->Execute(nullptr);
+
+  EXPECT_TRUE(trap_taken_);
+  EXPECT_EQ(trap_exception_code_, CheriotState::kCheriExceptionCode);
+  EXPECT_EQ(GetRegisterValue<uint32_t>(kX3), 0);
+}
+
 }  // namespace
@@ -26,3 +26,12 @@ def mpact_cheriot_repos():
             strip_prefix = "mpact-riscv-f4334647f86fdda5a56c8776cfe0ce461f6ca840",
             url = "https://github.com/google/mpact-riscv/archive/f4334647f86fdda5a56c8776cfe0ce461f6ca840.tar.gz",
         )
+
+    # Google benchmark, used by the vector semantic function microbenchmarks.
+    if not native.existing_rule("com_github_google_benchmark"):
+        http_archive(
+            name = "com_github_google_benchmark",
+            sha256 = "6bc180a57d23d4d9515519f92b0c83d61b05b5bab188961f36ac7b06b0d9e9ce",
+            strip_prefix = "benchmark-1.8.3",
+            url = "https://github.com/google/benchmark/archive/refs/tags/v1.8.3.tar.gz",
+        )